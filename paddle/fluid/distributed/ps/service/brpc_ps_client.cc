@@ -12,11 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>  // NOLINT
 #include <memory>
 #include <sstream>
 #include <string>
 
 #include "paddle/fluid/distributed/ps/service/brpc_ps_client.h"
+#include "paddle/fluid/distributed/ps/service/sparse_push_codec.h"
 #include "paddle/fluid/framework/archive.h"
 
 static const int max_port = 65535;
@@ -55,6 +57,15 @@ DEFINE_int32(pserver_sparse_merge_thread, 1, "pserver sparse merge thread num");
 DEFINE_int32(pserver_sparse_table_shard_num, 1000,
              "sparse table shard for save & load");
 
+DEFINE_int32(pserver_pull_sparse_coalesce_us, 0,
+             "send the pull_sparse requests of a table arriving within this "
+             "many microseconds of the first one as one request per server, "
+             "0 to send every request on its own");
+
+DEFINE_int32(pserver_pull_sparse_coalesce_keys, 100000,
+             "send the collected pull_sparse requests early once they hold "
+             "this many keys");
+
 namespace paddle {
 namespace framework {
 class Scope;
@@ -207,6 +218,10 @@ int32_t BrpcPsClient::initialize() {
       _push_sparse_task_queue_map[table_id] =
           paddle::framework::MakeChannel<SparseAsyncTask *>();
       _push_sparse_merge_count_map[table_id] = 0;
+      _pull_sparse_coalescer_map[table_id] =
+          std::make_shared<SparsePullCoalescer>();
+      _sparse_push_codec_map[table_id] =
+          worker_param.downpour_table_param(i).sparse_push_codec();
     }
   }
 
@@ -788,6 +803,7 @@ std::future<int32_t> BrpcPsClient::push_sparse_raw_gradient(
     ids[pserver_idx].push_back(keys[i]);
     value_ptrs[pserver_idx].push_back(update_values[i]);
   }
+  uint32_t codec = sparse_push_codec(table_id);
 
   for (size_t shard_idx = 0; shard_idx < request_call_num; ++shard_idx) {
     auto kvs = ids[shard_idx];
@@ -803,14 +819,22 @@ std::future<int32_t> BrpcPsClient::push_sparse_raw_gradient(
     push_request->set_client_id(_client_id);
     push_request->add_params((char *)&kv_size, sizeof(uint32_t));  // NOLINT
     auto *push_data = push_request->mutable_data();
-    push_data->resize(kv_size * (sizeof(uint64_t) + accessor->update_size()));
-    char *push_data_ptr = const_cast<char *>(push_data->data());
-    memcpy(push_data_ptr, kvs.data(), kv_size * sizeof(uint64_t));
-    push_data_ptr += kv_size * sizeof(uint64_t);
-
-    for (int i = 0; i < kv_size; ++i) {
-      memcpy(push_data_ptr, value_ptr[i], accessor->update_size());
-      push_data_ptr += accessor->update_size();
+    if (codec != SPARSE_PUSH_RAW) {
+      push_request->add_params((char *)&codec, sizeof(uint32_t));  // NOLINT
+      push_data->clear();
+      SparsePushCodec::encode(kvs.data(), value_ptr.data(), kv_size,
+                              value_size / sizeof(float),
+                              accessor->update_exact_dim(), codec, push_data);
+    } else {
+      push_data->resize(kv_size * (sizeof(uint64_t) + value_size));
+      char *push_data_ptr = const_cast<char *>(push_data->data());
+      memcpy(push_data_ptr, kvs.data(), kv_size * sizeof(uint64_t));
+      push_data_ptr += kv_size * sizeof(uint64_t);
+
+      for (int i = 0; i < kv_size; ++i) {
+        memcpy(push_data_ptr, value_ptr[i], value_size);
+        push_data_ptr += value_size;
+      }
     }
     PsService_Stub rpc_stub(get_sparse_channel(shard_idx));
     closure->cntl(shard_idx)->set_request_compress_type(
@@ -884,6 +908,59 @@ std::future<int32_t> BrpcPsClient::pull_sparse(float **select_values,
                                                size_t table_id,
                                                const uint64_t *keys, size_t num,
                                                bool is_training) {
+  if (FLAGS_pserver_pull_sparse_coalesce_us > 0) {
+    auto iter = _pull_sparse_coalescer_map.find(table_id);
+    if (iter != _pull_sparse_coalescer_map.end()) {
+      return coalesce_pull_sparse(iter->second.get(), select_values, table_id,
+                                  keys, num, is_training);
+    }
+  }
+  std::vector<std::shared_ptr<std::promise<int32_t>>> promises(
+      1, std::make_shared<std::promise<int32_t>>());
+  std::future<int> fut = promises[0]->get_future();
+  send_pull_sparse(select_values, table_id, keys, num, is_training, promises);
+  return fut;
+}
+
+std::future<int32_t> BrpcPsClient::coalesce_pull_sparse(
+    SparsePullCoalescer *coalescer, float **select_values, size_t table_id,
+    const uint64_t *keys, size_t num, bool is_training) {
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  std::future<int> fut = promise->get_future();
+  std::unique_lock<std::mutex> lock(coalescer->mutex);
+  auto &batch = coalescer->batch[is_training ? 1 : 0];
+  // the first request of a batch waits for the others and sends them all
+  bool is_sender = batch == nullptr;
+  if (is_sender) {
+    batch = std::make_shared<SparsePullBatch>();
+  }
+  auto collected = batch;
+  collected->keys.insert(collected->keys.end(), keys, keys + num);
+  collected->select_values.insert(collected->select_values.end(),
+                                  select_values, select_values + num);
+  collected->promises.push_back(promise);
+  size_t key_limit = FLAGS_pserver_pull_sparse_coalesce_keys;
+  if (!is_sender) {
+    if (collected->keys.size() >= key_limit) {
+      coalescer->cv.notify_all();
+    }
+    return fut;
+  }
+  coalescer->cv.wait_for(
+      lock, std::chrono::microseconds(FLAGS_pserver_pull_sparse_coalesce_us),
+      [&collected, key_limit] { return collected->keys.size() >= key_limit; });
+  batch.reset();
+  lock.unlock();
+  send_pull_sparse(collected->select_values.data(), table_id,
+                   collected->keys.data(), collected->keys.size(), is_training,
+                   collected->promises);
+  return fut;
+}
+
+void BrpcPsClient::send_pull_sparse(
+    float **select_values, size_t table_id, const uint64_t *keys, size_t num,
+    bool is_training,
+    std::vector<std::shared_ptr<std::promise<int32_t>>> &promises) {
   auto timer = std::make_shared<CostTimer>("pserver_client_pull_sparse");
   auto local_timer =
       std::make_shared<CostTimer>("pserver_client_pull_sparse_local");
@@ -948,9 +1025,9 @@ std::future<int32_t> BrpcPsClient::pull_sparse(float **select_values,
         closure->set_promise_value(ret);
       });
   closure->add_timer(timer);
-  auto promise = std::make_shared<std::promise<int32_t>>();
-  closure->add_promise(promise);
-  std::future<int> fut = promise->get_future();
+  for (auto &promise : promises) {
+    closure->add_promise(promise);
+  }
 
   for (size_t i = 0; i < request_call_num; ++i) {
     auto &sorted_kvs = shard_sorted_kvs->at(i);
@@ -1000,7 +1077,6 @@ std::future<int32_t> BrpcPsClient::pull_sparse(float **select_values,
                        closure->response(i), closure);
     }
   }
-  return fut;
 }
 
 std::future<int32_t> BrpcPsClient::send_client2client_msg(
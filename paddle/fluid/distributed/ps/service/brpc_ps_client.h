@@ -15,7 +15,9 @@
 #pragma once
 
 #include <ThreadPool.h>
+#include <condition_variable>  // NOLINT
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <vector>
 
@@ -129,6 +131,20 @@ struct SparseTaskPool {
   std::mutex _mutex;
 };
 
+// pull_sparse requests of one table arriving within
+// FLAGS_pserver_pull_sparse_coalesce_us of the first are sent as one
+struct SparsePullBatch {
+  std::vector<uint64_t> keys;
+  std::vector<float *> select_values;
+  std::vector<std::shared_ptr<std::promise<int32_t>>> promises;
+};
+struct SparsePullCoalescer {
+  std::mutex mutex;
+  std::condition_variable cv;
+  // the batch being collected, by is_training
+  std::shared_ptr<SparsePullBatch> batch[2];
+};
+
 template <class T>
 struct array_deleter {
   void operator()(T *&x) const { delete[] x; }  // NOLINT
@@ -218,6 +234,11 @@ class BrpcPsClient : public PSClient {
   void print_queue_size();
   void print_queue_size_thread();
 
+  virtual int32_t sparse_push_codec(size_t table_id) {
+    auto itr = _sparse_push_codec_map.find(table_id);
+    return itr == _sparse_push_codec_map.end() ? 0 : itr->second;
+  }
+
  protected:
   virtual size_t get_server_nums() { return _server_channels.size(); }
   inline brpc::Channel *get_sparse_channel(size_t server_id) {
@@ -260,9 +281,24 @@ class BrpcPsClient : public PSClient {
   std::unordered_map<uint32_t, paddle::framework::Channel<SparseAsyncTask *>>
       _push_sparse_task_queue_map;
   std::unordered_map<uint32_t, uint32_t> _push_sparse_merge_count_map;
+  // table_id -> SparsePushCodecType of its push_sparse_raw_gradient
+  std::unordered_map<uint32_t, int32_t> _sparse_push_codec_map;
 
   std::thread _print_thread;
 
+  // pull sparse 请求合并
+  std::unordered_map<uint32_t, std::shared_ptr<SparsePullCoalescer>>
+      _pull_sparse_coalescer_map;
+  std::future<int32_t> coalesce_pull_sparse(SparsePullCoalescer *coalescer,
+                                            float **select_values,
+                                            size_t table_id,
+                                            const uint64_t *keys, size_t num,
+                                            bool is_training);
+  void send_pull_sparse(
+      float **select_values, size_t table_id, const uint64_t *keys,
+      size_t num, bool is_training,
+      std::vector<std::shared_ptr<std::promise<int32_t>>> &promises);  // NOLINT
+
   int push_sparse_async_shard_merge(
       std::vector<std::shared_ptr<SparseAsyncTask>> &task_list,       // NOLINT
       std::vector<int> &request_kv_num, int table_id, int shard_idx,  // NOLINT
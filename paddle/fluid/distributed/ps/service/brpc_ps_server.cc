@@ -16,6 +16,7 @@
 #include <thread>  // NOLINT
 #include "butil/object_pool.h"
 #include "paddle/fluid/distributed/common/cost_timer.h"
+#include "paddle/fluid/distributed/ps/service/sparse_push_codec.h"
 #include "paddle/fluid/distributed/ps/table/depends/sparse_utils.h"
 #include "paddle/fluid/distributed/ps/table/table.h"
 #include "paddle/fluid/framework/archive.h"
@@ -411,10 +412,27 @@ int32_t BrpcPsService::push_sparse(Table *table,
   Push Content:
   |---keysData---|---valuesData---|
   |---8*{num}B---|----------------|
+  or, with a SparsePushCodecType in params(1), the packed form of it
   */
   const uint64_t *keys = (const uint64_t *)push_data.data();
   const float *values =
       (const float *)(push_data.data() + sizeof(uint64_t) * num);
+  std::vector<uint64_t> decoded_keys;
+  std::vector<float> decoded_values;
+  if (request.params_size() > 1) {
+    uint32_t codec = *(uint32_t *)(request.params(1).c_str());
+    size_t dim = table->value_accesor()->update_size() / sizeof(float);
+    size_t exact_dim = table->value_accesor()->update_exact_dim();
+    if (codec > SPARSE_PUSH_PACKED_INT8 ||
+        SparsePushCodec::decode(push_data.data(), push_data.size(), num, dim,
+                                exact_dim, codec, &decoded_keys,
+                                &decoded_values) != 0) {
+      set_response_code(response, -1, "push_sparse decode error");
+      return 0;
+    }
+    keys = decoded_keys.data();
+    values = decoded_values.data();
+  }
   if (table->push_sparse(keys, values, num) != 0) {
     set_response_code(response, -1, "push_sparse error");
   }
@@ -18,12 +18,34 @@ limitations under the License. */
 
 #include "gflags/gflags.h"
 #include "paddle/fluid/distributed/ps/service/brpc_ps_client.h"
+#include "paddle/fluid/distributed/ps/service/sparse_push_codec.h"
 #include "paddle/fluid/platform/profiler.h"
 #include "paddle/fluid/string/string_helper.h"
 
 #define LEARNING_RATE_DECAY_COUNTER "@LR_DECAY_COUNTER@"
 #define STEP_COUNTER "@PS_STEP_COUNTER@"
 
+DEFINE_int32(communicator_embedding_cache_rows, 0,
+             "rows of every sparse table the trainer keeps for "
+             "distributed_lookup_table, 0 to pull every row from the servers");
+
+DEFINE_int32(communicator_embedding_cache_staleness, 10,
+             "number of steps a cached row is served for; a step ends at "
+             "every batch of gradients pushed to the table, or at every pull "
+             "of the table when not training");
+
+DEFINE_bool(communicator_embedding_cache_invalidate_on_push, false,
+            "drop the cached rows of a table whose gradients are pushed, so "
+            "that they are pulled again at their next lookup");
+
+DEFINE_bool(communicator_sparse_push_error_feedback, true,
+            "add what the lossy sparse_push_codec of a table dropped from a "
+            "sparse gradient row to the next push of the row");
+
+DEFINE_int32(communicator_sparse_push_residual_rows, 1000000,
+             "rows of every sparse table whose sparse push residual is kept "
+             "for communicator_sparse_push_error_feedback");
+
 namespace paddle {
 namespace distributed {
 
@@ -299,6 +321,11 @@ void Communicator::RpcSendSparse(const std::string &var_name, int table_id,
                  std::back_inserter(sparse_push_keys),
                  [&](int64_t id) { return static_cast<uint64_t>(id); });
 
+  if (SparsePushCodec::is_lossy(_worker_ptr->sparse_push_codec(table_id)) &&
+      FLAGS_communicator_sparse_push_error_feedback) {
+    FeedbackSparsePushError(table_id, sparse_push_keys,
+                            tensor->mutable_value()->data<float>(), dim);
+  }
   for (auto i = 0; i < static_cast<int>(sparse_push_keys.size()); ++i) {
     push_g_vec.push_back(tensor->mutable_value()->data<float>() + i * dim);
   }
@@ -333,9 +360,132 @@ void Communicator::RpcSendSparse(const std::string &var_name, int table_id,
       table_id, sparse_push_keys.data(), (const float **)push_g_vec.data(),
       sparse_push_keys.size(), closure);
   status.wait();
+  // the rows pulled before the push was applied are out of date
+  InvalidateEmbeddingCache(table_id, sparse_push_keys);
   return;
 }
 
+void Communicator::FeedbackSparsePushError(int table_id,
+                                           const std::vector<uint64_t> &keys,
+                                           float *values, int64_t dim) {
+  SparsePushErrorFeedback *feedback = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(sparse_push_feedback_mutex_);
+    auto &ptr = sparse_push_feedbacks_[table_id];
+    if (ptr == nullptr) {
+      ptr.reset(new SparsePushErrorFeedback(
+          _worker_ptr->sparse_push_codec(table_id),
+          _worker_ptr->table_accessor(table_id)->update_exact_dim(),
+          FLAGS_communicator_sparse_push_residual_rows));
+    }
+    feedback = ptr.get();
+  }
+  feedback->feedback(keys.data(), keys.size(), values, dim);
+}
+
+SparseEmbeddingCache *Communicator::GetEmbeddingCache(uint64_t table_id,
+                                                    int fea_dim) {
+  if (FLAGS_communicator_embedding_cache_rows <= 0) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(embedding_cache_mutex_);
+  auto &cache = embedding_caches_[table_id];
+  if (cache == nullptr) {
+    cache.reset(new SparseEmbeddingCache(
+        FLAGS_communicator_embedding_cache_rows, fea_dim,
+        FLAGS_communicator_embedding_cache_staleness));
+  }
+  PADDLE_ENFORCE_EQ(cache->dim(), fea_dim,
+                    platform::errors::InvalidArgument(
+                        "The embedding cache of table %d holds rows of %d "
+                        "floats, but %d are pulled.",
+                        table_id, cache->dim(), fea_dim));
+  return cache.get();
+}
+
+void Communicator::EmbeddingCacheNextStep(uint64_t table_id) {
+  std::shared_ptr<SparseEmbeddingCache> cache;
+  {
+    std::lock_guard<std::mutex> lock(embedding_cache_mutex_);
+    auto iter = embedding_caches_.find(table_id);
+    if (iter == embedding_caches_.end()) {
+      return;
+    }
+    cache = iter->second;
+  }
+  cache->next_step();
+  if (cache->step() % 1000 == 0) {
+    auto stat = cache->get_stat();
+    VLOG(1) << "embedding cache of table " << table_id << " hit " << stat.hit
+            << " miss " << stat.miss << " stale " << stat.stale << " evict "
+            << stat.evict;
+  }
+}
+
+void Communicator::InvalidateEmbeddingCache(
+    uint64_t table_id, const std::vector<uint64_t> &keys) {
+  if (!FLAGS_communicator_embedding_cache_invalidate_on_push) {
+    return;
+  }
+  std::shared_ptr<SparseEmbeddingCache> cache;
+  {
+    std::lock_guard<std::mutex> lock(embedding_cache_mutex_);
+    auto iter = embedding_caches_.find(table_id);
+    if (iter == embedding_caches_.end()) {
+      return;
+    }
+    cache = iter->second;
+  }
+  cache->invalidate(keys.data(), keys.size());
+}
+
+void Communicator::SetEmbeddingCacheVersion(uint64_t table_id,
+                                            uint64_t version) {
+  std::lock_guard<std::mutex> lock(embedding_cache_mutex_);
+  auto iter = embedding_caches_.find(table_id);
+  if (iter != embedding_caches_.end()) {
+    iter->second->set_version(version);
+  }
+}
+
+int32_t Communicator::PullSparseCached(uint64_t table_id, int fea_dim,
+                                       const std::vector<uint64_t> &keys,
+                                       const std::vector<float *> &values,
+                                       bool is_training) {
+  auto *cache = GetEmbeddingCache(table_id, fea_dim);
+  if (cache == nullptr) {
+    auto status = _worker_ptr->pull_sparse(
+        const_cast<float **>(values.data()), table_id, keys.data(),
+        keys.size(), is_training);
+    status.wait();
+    return status.get();
+  }
+  if (!is_training) {
+    // no gradient is pushed to end the steps
+    EmbeddingCacheNextStep(table_id);
+  }
+  std::vector<size_t> misses;
+  cache->lookup(keys.data(), values.data(), keys.size(), &misses);
+  if (misses.empty()) {
+    return 0;
+  }
+  std::vector<uint64_t> miss_keys(misses.size());
+  std::vector<float *> miss_values(misses.size());
+  for (size_t i = 0; i < misses.size(); ++i) {
+    miss_keys[i] = keys[misses[i]];
+    miss_values[i] = values[misses[i]];
+  }
+  auto status = _worker_ptr->pull_sparse(miss_values.data(), table_id,
+                                         miss_keys.data(), miss_keys.size(),
+                                         is_training);
+  status.wait();
+  auto ret = status.get();
+  if (ret == 0) {
+    cache->update(miss_keys.data(), miss_values.data(), miss_keys.size());
+  }
+  return ret;
+}
+
 void Communicator::RpcRecvSparse(const std::string &varname, int table_id,
                                  Scope *scope) {
   platform::RecordEvent record_event("Communicator->RpcRecvSparse");
@@ -616,11 +766,8 @@ void AsyncCommunicator::PullSparseToTensorSync(
       pull_result_ptr.push_back(output_data + output_len);
     }
   }
-  auto status =
-      _worker_ptr->pull_sparse(pull_result_ptr.data(), table_id,
-                               fea_keys.data(), fea_keys.size(), is_training);
-  status.wait();
-  auto ret = status.get();
+  auto ret = PullSparseCached(table_id, fea_dim, fea_keys, pull_result_ptr,
+                              is_training);
   if (ret != 0) {
     LOG(ERROR) << "fleet pull sparse failed, status[" << ret << "]";
     sleep(sleep_seconds_before_fail_exit_);
@@ -748,6 +895,8 @@ void AsyncCommunicator::PushSparseFromTensorAsync(
       this->Check(table_id), true,
       platform::errors::InvalidArgument(
           "can not find table: %s, please check your config", table_id));
+  EmbeddingCacheNextStep(table_id);
+  InvalidateEmbeddingCache(table_id, push_keys);
   auto status = _worker_ptr->push_sparse(table_id, push_keys.data(),
                                          (const float **)push_g_vec.data(),
                                          push_keys.size());
@@ -848,6 +997,11 @@ bool AsyncCommunicator::Check(const std::vector<std::string> &var_tables) {
   if (send_varname_to_ctx_.find(table_name) == send_varname_to_ctx_.end()) {
     return false;
   }
+  auto &ctx = send_varname_to_ctx_.at(table_name);
+  if (ctx.is_sparse && !ctx.is_tensor_table) {
+    // the sparse gradient of a batch is sent
+    EmbeddingCacheNextStep(ctx.table_id);
+  }
   if (table_name == STEP_COUNTER) {
     VLOG(3) << "send step_counter into queue";
     auto tmp_var = std::make_shared<Variable>();
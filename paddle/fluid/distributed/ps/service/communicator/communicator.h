@@ -20,6 +20,7 @@ limitations under the License. */
 #include <deque>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <numeric>
 #include <set>
 #include <string>
@@ -30,6 +31,7 @@ limitations under the License. */
 
 #include "gflags/gflags.h"
 #include "paddle/fluid/distributed/ps/service/communicator/communicator_common.h"
+#include "paddle/fluid/distributed/ps/service/communicator/sparse_embedding_cache.h"
 #include "paddle/fluid/framework/scope.h"
 #include "paddle/fluid/framework/variable.h"
 #include "paddle/fluid/framework/variable_helper.h"
@@ -42,6 +44,7 @@ limitations under the License. */
 #include "paddle/fluid/string/split.h"
 
 #include "paddle/fluid/distributed/ps/service/ps_client.h"
+#include "paddle/fluid/distributed/ps/service/sparse_push_codec.h"
 
 namespace paddle {
 namespace distributed {
@@ -270,6 +273,26 @@ class Communicator {
   // 7. send gloabl step
   virtual void SendGlobalStep(const CommContext &ctx, int batches,
                               Scope *send_scope);
+  // pulls keys into values, through the trainer-side cache of the table
+  // when FLAGS_communicator_embedding_cache_rows is set; the rows are
+  // fea_dim floats
+  int32_t PullSparseCached(uint64_t table_id, int fea_dim,
+                           const std::vector<uint64_t> &keys,
+                           const std::vector<float *> &values,
+                           bool is_training);
+  // ends a step for the staleness of the cached rows of the table, at every
+  // batch of gradients pushed to it
+  void EmbeddingCacheNextStep(uint64_t table_id);
+  // drops the cached rows of keys, whose gradients are pushed, when
+  // FLAGS_communicator_embedding_cache_invalidate_on_push is set
+  void InvalidateEmbeddingCache(uint64_t table_id,
+                                const std::vector<uint64_t> &keys);
+  // drops every cached row of the table filled under another version
+  void SetEmbeddingCacheVersion(uint64_t table_id, uint64_t version);
+  // adds the error a lossy sparse push codec left on each row at its last
+  // push to values, and keeps the error this push will leave
+  void FeedbackSparsePushError(int table_id, const std::vector<uint64_t> &keys,
+                               float *values, int64_t dim);
 
   virtual ~Communicator() {}
   virtual void RpcProfilerControl();
@@ -396,6 +419,16 @@ class Communicator {
   Scope *recv_scope_;  // should be global scope
   std::unique_ptr<Scope> xpu_temp_scope_;
   std::atomic<uint32_t> _async_call_num{0};
+
+  SparseEmbeddingCache *GetEmbeddingCache(uint64_t table_id, int fea_dim);
+  std::mutex embedding_cache_mutex_;
+  std::unordered_map<uint64_t, std::shared_ptr<SparseEmbeddingCache>>
+      embedding_caches_;
+
+  // per table, the part of the sparse gradient rows not sent yet
+  std::mutex sparse_push_feedback_mutex_;
+  std::unordered_map<int, std::unique_ptr<SparsePushErrorFeedback>>
+      sparse_push_feedbacks_;
 };
 
 class AsyncCommunicator : public Communicator {
@@ -0,0 +1,132 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/service/communicator/sparse_embedding_cache.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace paddle {
+namespace distributed {
+
+SparseEmbeddingCache::SparseEmbeddingCache(size_t capacity, int dim,
+                                           uint64_t max_staleness,
+                                           size_t stripe_num)
+    : _dim(dim),
+      _max_staleness(max_staleness),
+      _stripes(std::max<size_t>(stripe_num, 1)) {
+  _slot_num = std::max<size_t>(capacity / _stripes.size(), 1);
+  for (auto &stripe : _stripes) {
+    stripe.keys.resize(_slot_num);
+    stripe.steps.resize(_slot_num);
+    stripe.versions.resize(_slot_num);
+    stripe.referenced.resize(_slot_num, false);
+    stripe.valid.resize(_slot_num, false);
+    stripe.rows.resize(_slot_num * _dim);
+  }
+}
+
+void SparseEmbeddingCache::lookup(const uint64_t *keys, float *const *values,
+                                  size_t num, std::vector<size_t> *misses) {
+  uint64_t step = this->step();
+  uint64_t version = _version.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < num; ++i) {
+    Stripe &stripe = stripe_of(keys[i]);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto iter = stripe.index.find(keys[i]);
+    if (iter == stripe.index.end()) {
+      ++stripe.stat.miss;
+      misses->push_back(i);
+      continue;
+    }
+    uint32_t slot = iter->second;
+    if (!is_fresh(stripe, slot, step, version)) {
+      ++stripe.stat.stale;
+      misses->push_back(i);
+      continue;
+    }
+    ++stripe.stat.hit;
+    stripe.referenced[slot] = true;
+    memcpy(values[i], stripe.rows.data() + slot * _dim, sizeof(float) * _dim);
+  }
+}
+
+void SparseEmbeddingCache::update(const uint64_t *keys,
+                                  const float *const *values, size_t num) {
+  uint64_t step = this->step();
+  uint64_t version = _version.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < num; ++i) {
+    Stripe &stripe = stripe_of(keys[i]);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    uint32_t slot;
+    auto iter = stripe.index.find(keys[i]);
+    if (iter != stripe.index.end()) {
+      slot = iter->second;
+    } else {
+      slot = take_slot(&stripe, step, version);
+      stripe.index[keys[i]] = slot;
+      stripe.keys[slot] = keys[i];
+    }
+    stripe.steps[slot] = step;
+    stripe.versions[slot] = version;
+    stripe.referenced[slot] = false;
+    stripe.valid[slot] = true;
+    memcpy(stripe.rows.data() + slot * _dim, values[i], sizeof(float) * _dim);
+  }
+}
+
+void SparseEmbeddingCache::invalidate(const uint64_t *keys, size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    Stripe &stripe = stripe_of(keys[i]);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto iter = stripe.index.find(keys[i]);
+    if (iter != stripe.index.end()) {
+      stripe.valid[iter->second] = false;
+    }
+  }
+}
+
+uint32_t SparseEmbeddingCache::take_slot(Stripe *stripe, uint64_t step,
+                                         uint64_t version) {
+  // slots are never freed, so the first index.size() slots are in use
+  if (stripe->index.size() < _slot_num) {
+    return stripe->index.size();
+  }
+  while (true) {
+    uint32_t slot = stripe->hand;
+    stripe->hand = (stripe->hand + 1) % _slot_num;
+    if (stripe->referenced[slot] && is_fresh(*stripe, slot, step, version)) {
+      stripe->referenced[slot] = false;
+      continue;
+    }
+    ++stripe->stat.evict;
+    stripe->index.erase(stripe->keys[slot]);
+    return slot;
+  }
+}
+
+EmbeddingCacheStat SparseEmbeddingCache::get_stat() {
+  EmbeddingCacheStat res;
+  for (auto &stripe : _stripes) {
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    res.hit += stripe.stat.hit;
+    res.miss += stripe.stat.miss;
+    res.stale += stripe.stat.stale;
+    res.evict += stripe.stat.evict;
+  }
+  return res;
+}
+
+}  // namespace distributed
+}  // namespace paddle
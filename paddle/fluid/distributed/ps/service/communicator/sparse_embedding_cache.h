@@ -0,0 +1,98 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+struct EmbeddingCacheStat {
+  size_t hit = 0;
+  size_t miss = 0;
+  // rows found in the cache but too old or invalidated to be served
+  size_t stale = 0;
+  size_t evict = 0;
+};
+
+// Trainer-side cache of sparse table rows, so the hot ids of a skewed
+// workload are pulled from the servers once every few steps instead of at
+// every step. A row filled at step s is served until step
+// s + max_staleness, until invalidate drops it, e.g. when its gradient is
+// pushed, and only while the cache version is the one it was filled with;
+// set_version drops every row at once, e.g. after the table is loaded on
+// the servers. Rows live in fixed slots of stripe_num
+// independently locked stripes and are evicted by CLOCK.
+class SparseEmbeddingCache {
+ public:
+  SparseEmbeddingCache(size_t capacity, int dim, uint64_t max_staleness,
+                       size_t stripe_num = 16);
+
+  // copies the rows of keys that can be served to values, and appends the
+  // index of every other key to misses
+  void lookup(const uint64_t *keys, float *const *values, size_t num,
+              std::vector<size_t> *misses);
+  // (re)fills the rows of keys, as pulled at the current step
+  void update(const uint64_t *keys, const float *const *values, size_t num);
+  // drops the rows of keys, so they are pulled again
+  void invalidate(const uint64_t *keys, size_t num);
+
+  void next_step() { _step.fetch_add(1, std::memory_order_relaxed); }
+  uint64_t step() const { return _step.load(std::memory_order_relaxed); }
+  void set_version(uint64_t version) {
+    _version.store(version, std::memory_order_relaxed);
+  }
+  int dim() const { return _dim; }
+  EmbeddingCacheStat get_stat();
+
+ private:
+  struct Stripe {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, uint32_t> index;
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> steps;
+    std::vector<uint64_t> versions;
+    std::vector<bool> referenced;
+    std::vector<bool> valid;
+    std::vector<float> rows;
+    size_t hand = 0;
+    EmbeddingCacheStat stat;
+  };
+
+  Stripe &stripe_of(uint64_t key) {
+    return _stripes[((key * 0x9E3779B97F4A7C15ULL) >> 32) % _stripes.size()];
+  }
+  bool is_fresh(const Stripe &stripe, uint32_t slot, uint64_t step,
+                uint64_t version) const {
+    return stripe.valid[slot] && stripe.versions[slot] == version &&
+           step - stripe.steps[slot] <= _max_staleness;
+  }
+  uint32_t take_slot(Stripe *stripe, uint64_t step, uint64_t version);
+
+  int _dim;
+  size_t _slot_num;
+  uint64_t _max_staleness;
+  std::atomic<uint64_t> _step{0};
+  std::atomic<uint64_t> _version{0};
+  std::vector<Stripe> _stripes;
+};
+
+}  // namespace distributed
+}  // namespace paddle
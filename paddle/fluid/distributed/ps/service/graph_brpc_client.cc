@@ -301,6 +301,65 @@ std::future<int32_t> GraphBrpcClient::remove_graph_node(
   }
   return fut;
 }
+std::future<int32_t> GraphBrpcClient::sample_subgraph(
+    uint32_t table_id, const std::vector<uint64_t> &node_ids,
+    const std::vector<int> &fanouts, bool need_weight,
+    const std::vector<uint32_t> &edge_table_ids, uint32_t feat_table_id,
+    const std::vector<std::string> &feature_names, GraphSubgraph &res,
+    int server_index) {
+  if (server_index == -1) {
+    std::vector<int> seed_num(server_size, 0);
+    server_index = 0;
+    for (auto id : node_ids) {
+      int index = get_server_index_by_id(id);
+      if (++seed_num[index] > seed_num[server_index]) {
+        server_index = index;
+      }
+    }
+  }
+  DownpourBrpcClosure *closure = new DownpourBrpcClosure(1, [&](void *done) {
+    int ret = 0;
+    auto *closure = (DownpourBrpcClosure *)done;
+    if (closure->check_response(0, PS_GRAPH_SAMPLE_SUBGRAPH) != 0) {
+      ret = -1;
+    } else {
+      auto &res_io_buffer = closure->cntl(0)->response_attachment();
+      butil::IOBufBytesIterator io_buffer_itr(res_io_buffer);
+      size_t bytes_size = io_buffer_itr.bytes_left();
+      std::unique_ptr<char[]> buffer_wrapper(new char[bytes_size]);
+      char *buffer = buffer_wrapper.get();
+      io_buffer_itr.copy_and_forward((void *)(buffer), bytes_size);
+      res.recover_from_buffer(buffer);
+    }
+    closure->set_promise_value(ret);
+  });
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  closure->add_promise(promise);
+  std::future<int> fut = promise->get_future();
+  closure->request(0)->set_cmd_id(PS_GRAPH_SAMPLE_SUBGRAPH);
+  closure->request(0)->set_table_id(table_id);
+  closure->request(0)->set_client_id(_client_id);
+  closure->request(0)->add_params((char *)node_ids.data(),
+                                  sizeof(uint64_t) * node_ids.size());
+  closure->request(0)->add_params((char *)fanouts.data(),
+                                  sizeof(int) * fanouts.size());
+  closure->request(0)->add_params((char *)&need_weight, sizeof(bool));
+  closure->request(0)->add_params((char *)edge_table_ids.data(),
+                                  sizeof(uint32_t) * edge_table_ids.size());
+  if (!feature_names.empty()) {
+    closure->request(0)->add_params((char *)&feat_table_id, sizeof(uint32_t));
+    std::string joint_feature_name =
+        paddle::string::join_strings(feature_names, '\t');
+    closure->request(0)->add_params(joint_feature_name.c_str(),
+                                    joint_feature_name.size());
+  }
+  GraphPsService_Stub rpc_stub = getServiceStub(get_cmd_channel(server_index));
+  closure->cntl(0)->set_log_id(butil::gettimeofday_ms());
+  rpc_stub.service(closure->cntl(0), closure->request(0), closure->response(0),
+                   closure);
+  return fut;
+}
+
 // char* &buffer,int &actual_size
 std::future<int32_t> GraphBrpcClient::batch_sample_neighbors(
     uint32_t table_id, std::vector<uint64_t> node_ids, int sample_size,
@@ -27,6 +27,7 @@
 #include "paddle/fluid/distributed/ps/service/brpc_ps_client.h"
 #include "paddle/fluid/distributed/ps/service/graph_brpc_server.h"
 #include "paddle/fluid/distributed/ps/service/ps_client.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_subgraph.h"
 #include "paddle/fluid/distributed/ps/table/table.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/scope.h"
@@ -68,6 +69,20 @@ class GraphBrpcClient : public BrpcPsClient {
       std::vector<std::vector<float>>& res_weight, bool need_weight,
       int server_index = -1);
 
+  // sample fanouts[h] neighbors of every node of hop h, starting from
+  // node_ids, in one call: one server walks all hops and forwards only the
+  // nodes held by other servers. edge_table_ids optionally names the edge
+  // table of every hop (a metapath), table_id is used otherwise. With
+  // feature_names, the features of all sampled nodes in feat_table_id are
+  // returned too. By default the request goes to the server holding most of
+  // node_ids.
+  virtual std::future<int32_t> sample_subgraph(
+      uint32_t table_id, const std::vector<uint64_t>& node_ids,
+      const std::vector<int>& fanouts, bool need_weight,
+      const std::vector<uint32_t>& edge_table_ids, uint32_t feat_table_id,
+      const std::vector<std::string>& feature_names, GraphSubgraph& res,
+      int server_index = -1);
+
   virtual std::future<int32_t> pull_graph_list(uint32_t table_id,
                                                int server_index, int start,
                                                int size, int step,
@@ -20,6 +20,7 @@
 #include "butil/endpoint.h"
 #include "iomanip"
 #include "paddle/fluid/distributed/ps/service/brpc_ps_client.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_subgraph.h"
 #include "paddle/fluid/framework/archive.h"
 #include "paddle/fluid/platform/profiler.h"
 namespace paddle {
@@ -206,6 +207,8 @@ int32_t GraphBrpcService::initialize() {
       &GraphBrpcService::use_neighbors_sample_cache;
   _service_handler_map[PS_GRAPH_LOAD_GRAPH_SPLIT_CONFIG] =
       &GraphBrpcService::load_graph_split_config;
+  _service_handler_map[PS_GRAPH_SAMPLE_SUBGRAPH] =
+      &GraphBrpcService::graph_sample_subgraph;
   // shard初始化,server启动后才可从env获取到server_list的shard信息
   initialize_shard_info();
 
@@ -675,5 +678,299 @@ int32_t GraphBrpcService::load_graph_split_config(
   return 0;
 }
 
+// appends the neighbors packed by GraphTable::random_sample_neighbors
+static void unpack_sampled_neighbors(const char *buffer, int actual_size,
+                                     bool need_weight,
+                                     std::vector<uint64_t> *res,
+                                     std::vector<float> *res_weight) {
+  int start = 0;
+  while (start < actual_size) {
+    res->push_back(*(uint64_t *)(buffer + start));
+    start += GraphNode::id_size;
+    if (need_weight) {
+      res_weight->push_back(*(float *)(buffer + start));
+      start += GraphNode::weight_size;
+    }
+  }
+}
+
+int32_t GraphBrpcService::sample_neighbors_on_servers(
+    GraphTable *table, uint32_t table_id, const std::vector<uint64_t> &ids,
+    int sample_size, bool need_weight, std::vector<std::vector<uint64_t>> &res,
+    std::vector<std::vector<float>> &res_weight) {
+  res.assign(ids.size(), {});
+  res_weight.assign(need_weight ? ids.size() : 0, {});
+  size_t rank = get_rank();
+  std::vector<std::vector<uint64_t>> node_id_buckets(server_size);
+  std::vector<std::vector<int>> query_idx_buckets(server_size);
+  for (size_t query_idx = 0; query_idx < ids.size(); ++query_idx) {
+    int server_index = table->get_server_index_by_id(ids[query_idx]);
+    node_id_buckets[server_index].push_back(ids[query_idx]);
+    query_idx_buckets[server_index].push_back(query_idx);
+  }
+  std::vector<int> request2server;
+  for (size_t server_index = 0; server_index < server_size; ++server_index) {
+    if (server_index != rank && !node_id_buckets[server_index].empty()) {
+      request2server.push_back(server_index);
+    }
+  }
+  size_t remote_call_num = request2server.size();
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  std::future<int> fut = promise->get_future();
+  if (remote_call_num == 0) {
+    promise->set_value(0);
+  } else {
+    DownpourBrpcClosure *closure =
+        new DownpourBrpcClosure(remote_call_num, [&](void *done) {
+          int ret = 0;
+          auto *closure = (DownpourBrpcClosure *)done;
+          for (size_t request_idx = 0; request_idx < remote_call_num;
+               ++request_idx) {
+            if (closure->check_response(request_idx,
+                                        PS_GRAPH_SAMPLE_NEIGHBORS) != 0) {
+              ret = -1;
+              continue;
+            }
+            auto &res_io_buffer =
+                closure->cntl(request_idx)->response_attachment();
+            butil::IOBufBytesIterator io_buffer_itr(res_io_buffer);
+            size_t bytes_size = io_buffer_itr.bytes_left();
+            std::unique_ptr<char[]> buffer_wrapper(new char[bytes_size]);
+            char *buffer = buffer_wrapper.get();
+            io_buffer_itr.copy_and_forward((void *)(buffer), bytes_size);
+
+            size_t node_num = *(size_t *)buffer;
+            int *actual_sizes = (int *)(buffer + sizeof(size_t));
+            char *node_buffer =
+                buffer + sizeof(size_t) + sizeof(int) * node_num;
+            auto &query_idx = query_idx_buckets[request2server[request_idx]];
+            int offset = 0;
+            for (size_t node_idx = 0; node_idx < node_num; ++node_idx) {
+              int idx = query_idx[node_idx];
+              unpack_sampled_neighbors(
+                  node_buffer + offset, actual_sizes[node_idx], need_weight,
+                  &res[idx], need_weight ? &res_weight[idx] : nullptr);
+              offset += actual_sizes[node_idx];
+            }
+          }
+          closure->set_promise_value(ret);
+        });
+    closure->add_promise(promise);
+    for (size_t request_idx = 0; request_idx < remote_call_num;
+         ++request_idx) {
+      int server_index = request2server[request_idx];
+      closure->request(request_idx)->set_cmd_id(PS_GRAPH_SAMPLE_NEIGHBORS);
+      closure->request(request_idx)->set_table_id(table_id);
+      closure->request(request_idx)->set_client_id(rank);
+      closure->request(request_idx)
+          ->add_params((char *)node_id_buckets[server_index].data(),
+                       sizeof(uint64_t) * node_id_buckets[server_index].size());
+      closure->request(request_idx)
+          ->add_params((char *)&sample_size, sizeof(int));
+      closure->request(request_idx)
+          ->add_params((char *)&need_weight, sizeof(bool));
+      PsService_Stub rpc_stub(
+          ((GraphBrpcServer *)get_server())->get_cmd_channel(server_index));
+      closure->cntl(request_idx)->set_log_id(butil::gettimeofday_ms());
+      rpc_stub.service(closure->cntl(request_idx),
+                       closure->request(request_idx),
+                       closure->response(request_idx), closure);
+    }
+  }
+
+  // the local part runs on the table's thread pools while the remote
+  // calls are in flight
+  auto &local_ids = node_id_buckets[rank];
+  if (!local_ids.empty()) {
+    std::vector<std::shared_ptr<char>> buffers(local_ids.size());
+    std::vector<int> actual_sizes(local_ids.size(), 0);
+    table->random_sample_neighbors(local_ids.data(), sample_size, buffers,
+                                   actual_sizes, need_weight);
+    for (size_t node_idx = 0; node_idx < local_ids.size(); ++node_idx) {
+      int idx = query_idx_buckets[rank][node_idx];
+      unpack_sampled_neighbors(buffers[node_idx].get(), actual_sizes[node_idx],
+                               need_weight, &res[idx],
+                               need_weight ? &res_weight[idx] : nullptr);
+    }
+  }
+  return fut.get();
+}
+
+int32_t GraphBrpcService::get_node_feat_on_servers(
+    GraphTable *table, uint32_t table_id, const std::vector<uint64_t> &ids,
+    const std::vector<std::string> &feature_names,
+    std::vector<std::vector<std::string>> &res) {
+  res.assign(feature_names.size(), std::vector<std::string>(ids.size()));
+  size_t rank = get_rank();
+  std::vector<std::vector<uint64_t>> node_id_buckets(server_size);
+  std::vector<std::vector<int>> query_idx_buckets(server_size);
+  for (size_t query_idx = 0; query_idx < ids.size(); ++query_idx) {
+    int server_index = table->get_server_index_by_id(ids[query_idx]);
+    node_id_buckets[server_index].push_back(ids[query_idx]);
+    query_idx_buckets[server_index].push_back(query_idx);
+  }
+  std::vector<int> request2server;
+  for (size_t server_index = 0; server_index < server_size; ++server_index) {
+    if (server_index != rank && !node_id_buckets[server_index].empty()) {
+      request2server.push_back(server_index);
+    }
+  }
+  size_t remote_call_num = request2server.size();
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  std::future<int> fut = promise->get_future();
+  if (remote_call_num == 0) {
+    promise->set_value(0);
+  } else {
+    DownpourBrpcClosure *closure =
+        new DownpourBrpcClosure(remote_call_num, [&](void *done) {
+          int ret = 0;
+          auto *closure = (DownpourBrpcClosure *)done;
+          for (size_t request_idx = 0; request_idx < remote_call_num;
+               ++request_idx) {
+            if (closure->check_response(request_idx, PS_GRAPH_GET_NODE_FEAT) !=
+                0) {
+              ret = -1;
+              continue;
+            }
+            auto &res_io_buffer =
+                closure->cntl(request_idx)->response_attachment();
+            butil::IOBufBytesIterator io_buffer_itr(res_io_buffer);
+            size_t bytes_size = io_buffer_itr.bytes_left();
+            std::unique_ptr<char[]> buffer_wrapper(new char[bytes_size]);
+            char *buffer = buffer_wrapper.get();
+            io_buffer_itr.copy_and_forward((void *)(buffer), bytes_size);
+
+            auto &query_idx = query_idx_buckets[request2server[request_idx]];
+            for (size_t feat_idx = 0; feat_idx < feature_names.size();
+                 ++feat_idx) {
+              for (size_t node_idx = 0; node_idx < query_idx.size();
+                   ++node_idx) {
+                size_t feat_len = *(size_t *)(buffer);
+                buffer += sizeof(size_t);
+                res[feat_idx][query_idx[node_idx]].assign(buffer, feat_len);
+                buffer += feat_len;
+              }
+            }
+          }
+          closure->set_promise_value(ret);
+        });
+    closure->add_promise(promise);
+    std::string joint_feature_name =
+        paddle::string::join_strings(feature_names, '\t');
+    for (size_t request_idx = 0; request_idx < remote_call_num;
+         ++request_idx) {
+      int server_index = request2server[request_idx];
+      closure->request(request_idx)->set_cmd_id(PS_GRAPH_GET_NODE_FEAT);
+      closure->request(request_idx)->set_table_id(table_id);
+      closure->request(request_idx)->set_client_id(rank);
+      closure->request(request_idx)
+          ->add_params((char *)node_id_buckets[server_index].data(),
+                       sizeof(uint64_t) * node_id_buckets[server_index].size());
+      closure->request(request_idx)
+          ->add_params(joint_feature_name.c_str(), joint_feature_name.size());
+      PsService_Stub rpc_stub(
+          ((GraphBrpcServer *)get_server())->get_cmd_channel(server_index));
+      closure->cntl(request_idx)->set_log_id(butil::gettimeofday_ms());
+      rpc_stub.service(closure->cntl(request_idx),
+                       closure->request(request_idx),
+                       closure->response(request_idx), closure);
+    }
+  }
+
+  auto &local_ids = node_id_buckets[rank];
+  if (!local_ids.empty()) {
+    std::vector<std::vector<std::string>> local_res(
+        feature_names.size(), std::vector<std::string>(local_ids.size()));
+    table->get_node_feat(local_ids, feature_names, local_res);
+    for (size_t feat_idx = 0; feat_idx < feature_names.size(); ++feat_idx) {
+      for (size_t node_idx = 0; node_idx < local_ids.size(); ++node_idx) {
+        res[feat_idx][query_idx_buckets[rank][node_idx]] =
+            std::move(local_res[feat_idx][node_idx]);
+      }
+    }
+  }
+  return fut.get();
+}
+
+// params: seeds, fanout of every hop, need_weight, edge table id of every
+// hop (empty for the request table), and optionally the feature table id
+// and the feature names to return for all sampled nodes
+int32_t GraphBrpcService::graph_sample_subgraph(
+    Table *table, const PsRequestMessage &request, PsResponseMessage &response,
+    brpc::Controller *cntl) {
+  CHECK_TABLE_EXIST(table, request, response)
+  if (request.params_size() < 4) {
+    set_response_code(
+        response, -1,
+        "graph_sample_subgraph request requires at least 4 arguments");
+    return 0;
+  }
+  size_t node_num = request.params(0).size() / sizeof(uint64_t);
+  uint64_t *node_data = (uint64_t *)(request.params(0).c_str());
+  std::vector<uint64_t> seeds(node_data, node_data + node_num);
+  size_t hop_num = request.params(1).size() / sizeof(int);
+  int *fanout_data = (int *)(request.params(1).c_str());
+  std::vector<int> fanouts(fanout_data, fanout_data + hop_num);
+  bool need_weight = *(bool *)(request.params(2).c_str());
+
+  std::vector<uint32_t> hop_table_ids(hop_num, request.table_id());
+  size_t path_len = request.params(3).size() / sizeof(uint32_t);
+  uint32_t *path = (uint32_t *)(request.params(3).c_str());
+  for (size_t hop = 0; hop < path_len && hop < hop_num; ++hop) {
+    hop_table_ids[hop] = path[hop];
+  }
+  std::vector<GraphTable *> hop_tables;
+  for (auto table_id : hop_table_ids) {
+    hop_tables.push_back((GraphTable *)_server->table(table_id));
+    if (hop_tables.back() == NULL) {
+      std::string err_msg("graph_sample_subgraph: edge table not found:");
+      err_msg.append(std::to_string(table_id));
+      set_response_code(response, -1, err_msg.c_str());
+      return -1;
+    }
+  }
+
+  GraphSubgraph subgraph;
+  int32_t ret = subgraph.sample(
+      seeds, fanouts, need_weight,
+      [&](size_t hop, const std::vector<uint64_t> &frontier, int sample_size,
+          std::vector<std::vector<uint64_t>> &res,
+          std::vector<std::vector<float>> &res_weight) -> int32_t {
+        return sample_neighbors_on_servers(hop_tables[hop], hop_table_ids[hop],
+                                           frontier, sample_size, need_weight,
+                                           res, res_weight);
+      });
+  if (ret != 0) {
+    set_response_code(response, -1,
+                      "graph_sample_subgraph failed to sample neighbors");
+    return -1;
+  }
+
+  if (request.params_size() >= 6 && !request.params(5).empty()) {
+    uint32_t feat_table_id = *(uint32_t *)(request.params(4).c_str());
+    GraphTable *feat_table = (GraphTable *)_server->table(feat_table_id);
+    if (feat_table == NULL) {
+      std::string err_msg("graph_sample_subgraph: feature table not found:");
+      err_msg.append(std::to_string(feat_table_id));
+      set_response_code(response, -1, err_msg.c_str());
+      return -1;
+    }
+    std::vector<std::string> feature_names =
+        paddle::string::split_string<std::string>(request.params(5), "\t");
+    if (get_node_feat_on_servers(feat_table, feat_table_id, subgraph.nodes,
+                                 feature_names, subgraph.features) != 0) {
+      set_response_code(response, -1,
+                        "graph_sample_subgraph failed to get node features");
+      return -1;
+    }
+  }
+
+  int size = subgraph.get_size();
+  std::unique_ptr<char[]> buffer(new char[size]);
+  subgraph.to_buffer(buffer.get());
+  cntl->response_attachment().append(buffer.get(), size);
+  return 0;
+}
+
 }  // namespace distributed
 }  // namespace paddle
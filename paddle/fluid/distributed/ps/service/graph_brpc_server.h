@@ -130,7 +130,23 @@ class GraphBrpcService : public PsBaseService {
                                   PsResponseMessage &response,
                                   brpc::Controller *cntl);
 
+  int32_t graph_sample_subgraph(Table *table, const PsRequestMessage &request,
+                                PsResponseMessage &response,
+                                brpc::Controller *cntl);
+
  private:
+  // sample the neighbors of ids that this server holds locally and forward
+  // only the rest to the servers that hold them
+  int32_t sample_neighbors_on_servers(
+      GraphTable *table, uint32_t table_id, const std::vector<uint64_t> &ids,
+      int sample_size, bool need_weight,
+      std::vector<std::vector<uint64_t>> &res,
+      std::vector<std::vector<float>> &res_weight);
+  int32_t get_node_feat_on_servers(
+      GraphTable *table, uint32_t table_id, const std::vector<uint64_t> &ids,
+      const std::vector<std::string> &feature_names,
+      std::vector<std::vector<std::string>> &res);
+
   bool _is_initialize_shard_info;
   std::mutex _initialize_shard_mutex;
   std::unordered_map<int32_t, serviceHandlerFunc> _msg_handler_map;
@@ -204,6 +204,10 @@ class PSClient {
     return itr->second.get();
   }
 
+  // the SparsePushCodecType push_sparse_raw_gradient encodes the requests
+  // of table_id with, 0 (raw) unless the client packs them
+  virtual int32_t sparse_push_codec(size_t table_id) { return 0; }
+
   virtual size_t get_server_nums() = 0;
 
   virtual std::future<int32_t> push_dense_raw_gradient(
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "paddle/fluid/distributed/ps/service/ps_service/graph_py_service.h"
+#include <algorithm>
 #include <thread>  // NOLINT
 #include "butil/endpoint.h"
 #include "iomanip"
@@ -332,6 +333,36 @@ GraphPyClient::batch_sample_neighbors(std::string name,
   return res;
 }
 
+GraphSubgraph GraphPyClient::sample_subgraph(
+    std::vector<std::string> edge_types, std::vector<uint64_t> node_ids,
+    std::vector<int> fanouts, bool return_weight, std::string node_type,
+    std::vector<std::string> feature_names) {
+  GraphSubgraph res;
+  std::vector<uint32_t> edge_table_ids;
+  for (size_t hop = 0; hop < fanouts.size() && !edge_types.empty(); ++hop) {
+    auto& name = edge_types[std::min(hop, edge_types.size() - 1)];
+    if (this->table_id_map.count(name) == 0) {
+      return res;
+    }
+    edge_table_ids.push_back(this->table_id_map[name]);
+  }
+  if (edge_table_ids.empty()) {
+    return res;
+  }
+  uint32_t feat_table_id = 0;
+  if (!feature_names.empty()) {
+    if (this->table_id_map.count(node_type) == 0) {
+      return res;
+    }
+    feat_table_id = this->table_id_map[node_type];
+  }
+  auto status = worker_ptr->sample_subgraph(
+      edge_table_ids[0], node_ids, fanouts, return_weight, edge_table_ids,
+      feat_table_id, feature_names, res);
+  status.wait();
+  return res;
+}
+
 void GraphPyClient::use_neighbors_sample_cache(std::string name,
                                                size_t total_size_limit,
                                                size_t ttl) {
@@ -152,6 +152,13 @@ class GraphPyClient : public GraphPyService {
   batch_sample_neighbors(std::string name, std::vector<uint64_t> node_ids,
                          int sample_size, bool return_weight,
                          bool return_edges);
+  // edge_types[h] is the edge type of hop h, the last one is used for the
+  // remaining hops; feature_names of node_type are fetched if not empty
+  GraphSubgraph sample_subgraph(std::vector<std::string> edge_types,
+                                std::vector<uint64_t> node_ids,
+                                std::vector<int> fanouts, bool return_weight,
+                                std::string node_type,
+                                std::vector<std::string> feature_names);
   std::vector<uint64_t> random_sample_nodes(std::string name, int server_index,
                                             int sample_size);
   std::vector<std::vector<std::string>> get_node_feat(
@@ -0,0 +1,233 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/service/sparse_push_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include "glog/logging.h"
+#include "paddle/fluid/platform/float16.h"
+namespace paddle {
+namespace distributed {
+
+static size_t row_bytes(size_t dim, size_t exact_dim, int codec) {
+  size_t lossy_dim = dim - exact_dim;
+  switch (codec) {
+    case SPARSE_PUSH_PACKED_FP16:
+      return exact_dim * sizeof(float) + lossy_dim * sizeof(uint16_t);
+    case SPARSE_PUSH_PACKED_INT8:
+      return exact_dim * sizeof(float) + sizeof(float) +
+             lossy_dim * sizeof(int8_t);
+    default:
+      return dim * sizeof(float);
+  }
+}
+
+static float int8_scale(const float *row, size_t dim) {
+  float max_abs = 0;
+  for (size_t i = 0; i < dim; ++i) {
+    max_abs = std::max(max_abs, std::fabs(row[i]));
+  }
+  return max_abs / 127;
+}
+
+static int8_t int8_value(float x, float scale) {
+  if (scale == 0) {
+    return 0;
+  }
+  float q = std::round(x / scale);
+  return static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, q)));
+}
+
+void SparsePushCodec::quantize_row(const float *row, size_t dim,
+                                   size_t exact_dim, int codec, float *out) {
+  if (is_lossy(codec)) {
+    memcpy(out, row, exact_dim * sizeof(float));
+    row += exact_dim;
+    out += exact_dim;
+    dim -= exact_dim;
+  }
+  if (codec == SPARSE_PUSH_PACKED_FP16) {
+    for (size_t i = 0; i < dim; ++i) {
+      out[i] = static_cast<float>(platform::float16(row[i]));
+    }
+  } else if (codec == SPARSE_PUSH_PACKED_INT8) {
+    float scale = int8_scale(row, dim);
+    for (size_t i = 0; i < dim; ++i) {
+      out[i] = int8_value(row[i], scale) * scale;
+    }
+  } else {
+    memcpy(out, row, dim * sizeof(float));
+  }
+}
+
+void SparsePushCodec::encode(const uint64_t *keys, const float *const *rows,
+                             size_t num, size_t dim, size_t exact_dim,
+                             int codec, std::string *out) {
+  std::vector<uint32_t> order(num);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+  // at most 10 bytes per varint
+  size_t begin = out->size();
+  out->resize(begin + num * (10 + row_bytes(dim, exact_dim, codec)));
+  char *ptr = const_cast<char *>(out->data()) + begin;
+  uint64_t last = 0;
+  for (auto i : order) {
+    uint64_t delta = keys[i] - last;
+    last = keys[i];
+    while (delta >= 0x80) {
+      *ptr++ = static_cast<char>(delta | 0x80);
+      delta >>= 7;
+    }
+    *ptr++ = static_cast<char>(delta);
+  }
+  size_t lossy_dim = dim - exact_dim;
+  for (auto i : order) {
+    const float *row = rows[i];
+    if (is_lossy(codec)) {
+      memcpy(ptr, row, exact_dim * sizeof(float));
+      ptr += exact_dim * sizeof(float);
+      row += exact_dim;
+    }
+    if (codec == SPARSE_PUSH_PACKED_FP16) {
+      for (size_t j = 0; j < lossy_dim; ++j) {
+        uint16_t x = platform::float16(row[j]).x;
+        memcpy(ptr, &x, sizeof(uint16_t));
+        ptr += sizeof(uint16_t);
+      }
+    } else if (codec == SPARSE_PUSH_PACKED_INT8) {
+      float scale = int8_scale(row, lossy_dim);
+      memcpy(ptr, &scale, sizeof(float));
+      ptr += sizeof(float);
+      for (size_t j = 0; j < lossy_dim; ++j) {
+        *ptr++ = static_cast<char>(int8_value(row[j], scale));
+      }
+    } else {
+      memcpy(ptr, row, dim * sizeof(float));
+      ptr += dim * sizeof(float);
+    }
+  }
+  out->resize(ptr - out->data());
+}
+
+int32_t SparsePushCodec::decode(const char *data, size_t size, size_t num,
+                                size_t dim, size_t exact_dim, int codec,
+                                std::vector<uint64_t> *keys,
+                                std::vector<float> *values) {
+  if (exact_dim > dim) {
+    return -1;
+  }
+  const char *ptr = data;
+  const char *end = data + size;
+  keys->resize(num);
+  uint64_t last = 0;
+  for (size_t i = 0; i < num; ++i) {
+    uint64_t delta = 0;
+    for (int shift = 0;; shift += 7) {
+      if (ptr == end || shift > 63) {
+        return -1;
+      }
+      uint8_t byte = static_cast<uint8_t>(*ptr++);
+      delta |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        break;
+      }
+    }
+    last += delta;
+    (*keys)[i] = last;
+  }
+  if (static_cast<size_t>(end - ptr) !=
+      num * row_bytes(dim, exact_dim, codec)) {
+    return -1;
+  }
+  values->resize(num * dim);
+  float *out = values->data();
+  size_t lossy_dim = dim - exact_dim;
+  if (codec == SPARSE_PUSH_PACKED_FP16) {
+    for (size_t i = 0; i < num; ++i) {
+      memcpy(out, ptr, exact_dim * sizeof(float));
+      ptr += exact_dim * sizeof(float);
+      out += exact_dim;
+      for (size_t j = 0; j < lossy_dim; ++j) {
+        platform::float16 x;
+        memcpy(&x.x, ptr, sizeof(uint16_t));
+        ptr += sizeof(uint16_t);
+        *out++ = static_cast<float>(x);
+      }
+    }
+  } else if (codec == SPARSE_PUSH_PACKED_INT8) {
+    for (size_t i = 0; i < num; ++i) {
+      memcpy(out, ptr, exact_dim * sizeof(float));
+      ptr += exact_dim * sizeof(float);
+      out += exact_dim;
+      float scale;
+      memcpy(&scale, ptr, sizeof(float));
+      ptr += sizeof(float);
+      for (size_t j = 0; j < lossy_dim; ++j) {
+        *out++ = static_cast<int8_t>(*ptr++) * scale;
+      }
+    }
+  } else {
+    memcpy(out, ptr, num * dim * sizeof(float));
+  }
+  return 0;
+}
+
+void SparsePushErrorFeedback::feedback(const uint64_t *keys, size_t num,
+                                       float *values, size_t dim) {
+  std::vector<float> sent(dim);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < num; ++i) {
+    float *row = values + i * dim;
+    auto &residual = residuals_[keys[i]];
+    residual.pushed = true;
+    if (residual.values.size() != dim) {
+      residual.values.assign(dim, 0);
+    }
+    for (size_t j = 0; j < dim; ++j) {
+      row[j] += residual.values[j];
+    }
+    SparsePushCodec::quantize_row(row, dim, exact_dim_, codec_, sent.data());
+    for (size_t j = 0; j < dim; ++j) {
+      residual.values[j] = row[j] - sent[j];
+    }
+  }
+  if (residuals_.size() > max_rows_) {
+    evict();
+  }
+}
+
+void SparsePushErrorFeedback::evict() {
+  size_t before = residuals_.size();
+  for (auto it = residuals_.begin(); it != residuals_.end();) {
+    if (!it->second.pushed) {
+      it = residuals_.erase(it);
+    } else {
+      it->second.pushed = false;
+      ++it;
+    }
+  }
+  // a single push of more than max_rows rows
+  while (residuals_.size() > max_rows_) {
+    residuals_.erase(residuals_.begin());
+  }
+  VLOG(3) << "evicted " << before - residuals_.size()
+          << " sparse push residuals";
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,94 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+// Encodings of a PS_PUSH_SPARSE_TABLE request body. SPARSE_PUSH_RAW is the
+// plain |keys|values| layout, the packed ones sort the rows by key, write
+// the keys as varint deltas and the values as float32, float16 or int8
+// with one float32 scale per row. The lossy ones keep the first exact_dim
+// values of each row, the accessor's update_exact_dim, in float32.
+enum SparsePushCodecType {
+  SPARSE_PUSH_RAW = 0,
+  SPARSE_PUSH_PACKED_FP32 = 1,
+  SPARSE_PUSH_PACKED_FP16 = 2,
+  SPARSE_PUSH_PACKED_INT8 = 3,
+};
+
+class SparsePushCodec {
+ public:
+  // whether the codec loses precision, so senders may feed the error back
+  static bool is_lossy(int codec) {
+    return codec == SPARSE_PUSH_PACKED_FP16 || codec == SPARSE_PUSH_PACKED_INT8;
+  }
+
+  // the values the receiver decodes for row, written to out
+  static void quantize_row(const float *row, size_t dim, size_t exact_dim,
+                           int codec, float *out);
+
+  // appends the packed keys and rows to out, rows are dim floats each
+  static void encode(const uint64_t *keys, const float *const *rows,
+                     size_t num, size_t dim, size_t exact_dim, int codec,
+                     std::string *out);
+
+  // decodes num rows of dim floats; -1 if data is not a whole encoding
+  static int32_t decode(const char *data, size_t size, size_t num, size_t dim,
+                        size_t exact_dim, int codec,
+                        std::vector<uint64_t> *keys,
+                        std::vector<float> *values);
+};
+
+// The part of each row of a sparse gradient a lossy codec did not send,
+// added to the next push of the row, so that small updates are delayed
+// rather than lost. At most max_rows rows are kept, the rows not pushed
+// since the previous eviction are dropped first. Thread safe.
+class SparsePushErrorFeedback {
+ public:
+  SparsePushErrorFeedback(int codec, size_t exact_dim, size_t max_rows)
+      : codec_(codec), exact_dim_(exact_dim), max_rows_(max_rows) {}
+
+  // adds the residual of each row to values, num rows of dim floats, and
+  // keeps what quantizing the sums will leave out
+  void feedback(const uint64_t *keys, size_t num, float *values, size_t dim);
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return residuals_.size();
+  }
+
+ private:
+  struct Residual {
+    std::vector<float> values;
+    bool pushed = false;
+  };
+
+  void evict();
+
+  const int codec_;
+  const size_t exact_dim_;
+  const size_t max_rows_;
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, Residual> residuals_;
+};
+
+}  // namespace distributed
+}  // namespace paddle
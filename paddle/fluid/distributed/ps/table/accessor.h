@@ -15,6 +15,7 @@
 #pragma once
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <unordered_map>
 #include <vector>
 #include "paddle/fluid/distributed/common/afs_warpper.h"
@@ -79,6 +80,19 @@ class ValueAccessor {
   virtual size_t mf_size() { return 0; }
   virtual bool need_extend_mf(float* value) { return false; }
   virtual bool has_mf(size_t size) { return false; }
+  // value在表中可能以压缩形式存储, 将size长度的存储值展开为完整value,
+  // 返回展开后的长度
+  virtual size_t decompress(const float* stored, size_t size, float* value) {
+    memcpy(value, stored, size * sizeof(float));
+    return size;
+  }
+  // 压缩存储的value长度, 0表示不压缩
+  virtual size_t compress_dim() { return 0; }
+  // 将size长度的完整value压缩写入stored, 返回存储长度(不超过size)
+  virtual size_t compress(const float* value, size_t size, float* stored) {
+    memcpy(stored, value, size * sizeof(float));
+    return size;
+  }
   // pull value维度
   virtual size_t select_dim() = 0;
   // pull value各个维度的size
@@ -91,6 +105,8 @@ class ValueAccessor {
   virtual size_t update_dim_size(size_t dim) = 0;
   // push value各维度相加总size
   virtual size_t update_size() = 0;
+  // push value开头不是梯度的维度数(如slot/show/click), 有损的push编码原样发送
+  virtual size_t update_exact_dim() { return 0; }
   // fea total for dense
   virtual size_t fea_dim() { return _config.fea_dim(); }
   // converter for save
@@ -18,12 +18,20 @@
 #include <chrono>
 #include <set>
 #include <sstream>
+#include "gflags/gflags.h"
 #include "paddle/fluid/distributed/common/utils.h"
 #include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
 #include "paddle/fluid/framework/generator.h"
 #include "paddle/fluid/string/printf.h"
 #include "paddle/fluid/string/string_helper.h"
 
+DEFINE_bool(graph_table_use_csr, false,
+            "store the edges of local graph shards in CSR arrays with alias "
+            "tables instead of one edge blob and sampler per node");
+DEFINE_uint64(graph_sample_cache_bytes, 0,
+              "bytes of neighbor samples the sample cache may hold, 0 for no "
+              "limit besides the entry count");
+
 namespace paddle {
 namespace distributed {
 
@@ -77,9 +85,18 @@ int32_t GraphTable::remove_graph_node(std::vector<uint64_t> &id_list) {
   for (size_t i = 0; i < batch.size(); ++i) {
     if (!batch[i].size()) continue;
     tasks.push_back(_shards_task_pool[i]->enqueue([&batch, i, this]() -> int {
+      std::map<size_t, std::vector<uint64_t>> shard_ids;
       for (auto &p : batch[i]) {
         size_t index = p % this->shard_num - this->shard_start;
         this->shards[index]->delete_node(p);
+        shard_ids[index].push_back(p);
+      }
+      // the edges of the CSR shards are kept apart from the nodes
+      for (auto &ids : shard_ids) {
+        CsrGraphShard &csr = this->shards[ids.first]->get_csr();
+        if (csr.node_num() != 0) {
+          csr.remove_nodes(std::move(ids.second));
+        }
       }
       return 0;
     }));
@@ -94,6 +111,7 @@ void GraphShard::clear() {
   }
   bucket.clear();
   node_location.clear();
+  csr.clear();
 }
 
 GraphShard::~GraphShard() { clear(); }
@@ -282,6 +300,8 @@ int32_t GraphTable::load_edges(const std::string &path, bool reverse_edge) {
   bool is_weighted = false;
   int valid_count = 0;
   int extra_alloc_index = 0;
+  // edges of local shards, built into CsrGraphShard once all are read
+  std::vector<std::vector<CsrEdge>> csr_edges(use_csr ? shards.size() : 0);
   for (auto path : paths) {
     std::ifstream file(path);
     std::string line;
@@ -330,6 +350,12 @@ int32_t GraphTable::load_edges(const std::string &path, bool reverse_edge) {
       }
 
       size_t index = src_shard_id - shard_start;
+      if (use_csr) {
+        shards[index]->add_graph_node(src_id);
+        csr_edges[index].push_back({src_id, dst_id, weight});
+        valid_count++;
+        continue;
+      }
       shards[index]->add_graph_node(src_id)->build_edges(is_weighted);
       shards[index]->add_neighbor(src_id, dst_id, weight);
       valid_count++;
@@ -338,13 +364,34 @@ int32_t GraphTable::load_edges(const std::string &path, bool reverse_edge) {
   VLOG(0) << valid_count << "/" << count << " edges are loaded successfully in "
           << path;
 
+  if (use_csr) {
+    std::vector<std::future<int>> tasks;
+    for (size_t i = 0; i < shards.size(); i++) {
+      if (csr_edges[i].empty()) continue;
+      tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
+          [this, i, is_weighted, &csr_edges]() -> int {
+            CsrGraphShard &csr = shards[i]->get_csr();
+            std::vector<CsrEdge> edges;
+            csr.dump_edges(&edges);
+            edges.insert(edges.end(), csr_edges[i].begin(),
+                         csr_edges[i].end());
+            std::vector<CsrEdge>().swap(csr_edges[i]);
+            csr.build(&edges, is_weighted || csr.is_weighted());
+            return 0;
+          }));
+    }
+    for (size_t i = 0; i < tasks.size(); i++) tasks[i].get();
+  }
+
   std::vector<int> used(task_pool_size_, 0);
   // Build Sampler j
 
   for (auto &shard : shards) {
     auto bucket = shard->get_bucket();
     for (size_t i = 0; i < bucket.size(); i++) {
-      bucket[i]->build_sampler(sample_type);
+      if (!use_csr) {
+        bucket[i]->build_sampler(sample_type);
+      }
       used[get_thread_pool_index(bucket[i]->get_id())]++;
     }
   }
@@ -443,6 +490,13 @@ Node *GraphTable::find_node(uint64_t id) {
   Node *node = shards[index]->find_node(id);
   return node;
 }
+const CsrGraphShard *GraphTable::find_csr_shard(uint64_t id) {
+  size_t shard_id = id % shard_num;
+  if (!use_csr || shard_id >= shard_end || shard_id < shard_start) {
+    return nullptr;
+  }
+  return &shards[shard_id - shard_start]->get_csr();
+}
 uint32_t GraphTable::get_thread_pool_index(uint64_t node_id) {
   if (use_duplicate_nodes == false || extra_nodes_to_thread_index.size() == 0)
     return node_id % shard_num % shard_num_per_server % task_pool_size_;
@@ -545,6 +599,19 @@ int32_t GraphTable::random_sample_nodes(int sample_size,
   memcpy(pointer, res.data(), actual_size);
   return 0;
 }
+int32_t GraphTable::make_neighbor_sample_cache(size_t size_limit, size_t ttl) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (use_cache == false) {
+    // several stripes per task pool thread keep lock collisions rare
+    sample_cache.reset(
+        new GraphSampleCache<SampleKey, SampleResult, SampleResultBytes>(
+            size_limit, FLAGS_graph_sample_cache_bytes, ttl,
+            4 * task_pool_size_));
+    use_cache = true;
+  }
+  return 0;
+}
+
 int32_t GraphTable::random_sample_neighbors(
     uint64_t *node_ids, int sample_size,
     std::vector<std::shared_ptr<char>> &buffers, std::vector<int> &actual_sizes,
@@ -565,10 +632,8 @@ int32_t GraphTable::random_sample_neighbors(
     tasks.push_back(_shards_task_pool[i]->enqueue([&, i, this]() -> int {
       uint64_t node_id;
       std::vector<std::pair<SampleKey, SampleResult>> r;
-      LRUResponse response = LRUResponse::blocked;
       if (use_cache) {
-        response =
-            scaled_lru->query(i, id_list[i].data(), id_list[i].size(), r);
+        sample_cache->query(id_list[i].data(), id_list[i].size(), r);
       }
       int index = 0;
       uint32_t idx;
@@ -587,12 +652,17 @@ int32_t GraphTable::random_sample_neighbors(
           Node *node = find_node(node_id);
           idx = seq_id[i][k];
           int &actual_size = actual_sizes[idx];
-          if (node == nullptr) {
+          // local nodes keep their edges in the CSR shard when use_csr
+          const CsrGraphShard *csr = find_csr_shard(node_id);
+          int64_t row = csr == nullptr ? -1 : csr->find(node_id);
+          if (node == nullptr || (csr != nullptr && row < 0)) {
             actual_size = 0;
             continue;
           }
           std::shared_ptr<char> &buffer = buffers[idx];
-          std::vector<int> res = node->sample_k(sample_size, rng);
+          std::vector<int> res =
+              csr != nullptr ? csr->sample_k(row, sample_size, rng.get())
+                             : node->sample_k(sample_size, rng);
           actual_size =
               res.size() * (need_weight ? (Node::id_size + Node::weight_size)
                                         : Node::id_size);
@@ -600,7 +670,7 @@ int32_t GraphTable::random_sample_neighbors(
           uint64_t id;
           float weight;
           char *buffer_addr = new char[actual_size];
-          if (response == LRUResponse::ok) {
+          if (use_cache) {
             sample_keys.emplace_back(node_id, sample_size, need_weight);
             sample_res.emplace_back(actual_size, buffer_addr);
             buffer = sample_res.back().buffer;
@@ -608,11 +678,13 @@ int32_t GraphTable::random_sample_neighbors(
             buffer.reset(buffer_addr, char_del);
           }
           for (int &x : res) {
-            id = node->get_neighbor_id(x);
+            id = csr != nullptr ? csr->neighbor_id(row, x)
+                                : node->get_neighbor_id(x);
             memcpy(buffer_addr + offset, &id, Node::id_size);
             offset += Node::id_size;
             if (need_weight) {
-              weight = node->get_neighbor_weight(x);
+              weight = csr != nullptr ? csr->neighbor_weight(row, x)
+                                      : node->get_neighbor_weight(x);
               memcpy(buffer_addr + offset, &weight, Node::weight_size);
               offset += Node::weight_size;
             }
@@ -620,8 +692,8 @@ int32_t GraphTable::random_sample_neighbors(
         }
       }
       if (sample_res.size()) {
-        scaled_lru->insert(i, sample_keys.data(), sample_res.data(),
-                           sample_keys.size());
+        sample_cache->insert(sample_keys.data(), sample_res.data(),
+                             sample_keys.size());
       }
       return 0;
     }));
@@ -820,6 +892,7 @@ int32_t GraphTable::initialize() {
     shards.push_back(new GraphShard());
   }
   use_duplicate_nodes = false;
+  use_csr = FLAGS_graph_table_use_csr;
   for (int i = 0; i < task_pool_size_; i++) {
     extra_shards.push_back(new GraphShard());
   }
@@ -38,7 +38,9 @@
 #include <vector>
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr_shard.h"
 #include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_sample_cache.h"
 #include "paddle/fluid/string/string_helper.h"
 #include "paddle/pten/core/utils/rw_lock.h"
 
@@ -69,18 +71,21 @@ class GraphShard {
   std::unordered_map<uint64_t, int> &get_node_location() {
     return node_location;
   }
+  // edges of the shard's nodes when GraphTable uses CSR storage; the nodes
+  // are still in bucket, without edges, for the node APIs
+  CsrGraphShard &get_csr() { return csr; }
 
  private:
   std::unordered_map<uint64_t, int> node_location;
   std::vector<Node *> bucket;
+  CsrGraphShard csr;
 };
 
-enum LRUResponse { ok = 0, blocked = 1, err = 2 };
-
 struct SampleKey {
   uint64_t node_key;
   size_t sample_size;
   bool is_weighted;
+  SampleKey() : node_key(0), sample_size(0), is_weighted(false) {}
   SampleKey(uint64_t _node_key, size_t _sample_size, bool _is_weighted)
       : node_key(_node_key),
         sample_size(_sample_size),
@@ -95,6 +100,7 @@ class SampleResult {
  public:
   size_t actual_size;
   std::shared_ptr<char> buffer;
+  SampleResult() : actual_size(0) {}
   SampleResult(size_t _actual_size, std::shared_ptr<char> &_buffer)
       : actual_size(_actual_size), buffer(_buffer) {}
   SampleResult(size_t _actual_size, char *_buffer)
@@ -103,258 +109,16 @@ class SampleResult {
   ~SampleResult() {}
 };
 
-template <typename K, typename V>
-class LRUNode {
- public:
-  LRUNode(K _key, V _data, size_t _ttl) : key(_key), data(_data), ttl(_ttl) {
-    next = pre = NULL;
-  }
-  K key;
-  V data;
-  size_t ttl;
-  // time to live
-  LRUNode<K, V> *pre, *next;
-};
-template <typename K, typename V>
-class ScaledLRU;
-
-template <typename K, typename V>
-class RandomSampleLRU {
- public:
-  RandomSampleLRU(ScaledLRU<K, V> *_father) {
-    father = _father;
-    remove_count = 0;
-    node_size = 0;
-    node_head = node_end = NULL;
-    global_ttl = father->ttl;
-    total_diff = 0;
-  }
-
-  ~RandomSampleLRU() {
-    LRUNode<K, V> *p;
-    while (node_head != NULL) {
-      p = node_head->next;
-      delete node_head;
-      node_head = p;
-    }
-  }
-  LRUResponse query(K *keys, size_t length, std::vector<std::pair<K, V>> &res) {
-    if (pthread_rwlock_tryrdlock(&father->rwlock) != 0)
-      return LRUResponse::blocked;
-    // pthread_rwlock_rdlock(&father->rwlock);
-    int init_size = node_size - remove_count;
-    process_redundant(length * 3);
-
-    for (size_t i = 0; i < length; i++) {
-      auto iter = key_map.find(keys[i]);
-      if (iter != key_map.end()) {
-        res.emplace_back(keys[i], iter->second->data);
-        iter->second->ttl--;
-        if (iter->second->ttl == 0) {
-          remove(iter->second);
-          if (remove_count != 0) remove_count--;
-        } else {
-          move_to_tail(iter->second);
-        }
-      }
-    }
-    total_diff += node_size - remove_count - init_size;
-    if (total_diff >= 500 || total_diff < -500) {
-      father->handle_size_diff(total_diff);
-      total_diff = 0;
-    }
-    pthread_rwlock_unlock(&father->rwlock);
-    return LRUResponse::ok;
-  }
-  LRUResponse insert(K *keys, V *data, size_t length) {
-    if (pthread_rwlock_tryrdlock(&father->rwlock) != 0)
-      return LRUResponse::blocked;
-    // pthread_rwlock_rdlock(&father->rwlock);
-    int init_size = node_size - remove_count;
-    process_redundant(length * 3);
-    for (size_t i = 0; i < length; i++) {
-      auto iter = key_map.find(keys[i]);
-      if (iter != key_map.end()) {
-        move_to_tail(iter->second);
-        iter->second->ttl = global_ttl;
-        iter->second->data = data[i];
-      } else {
-        LRUNode<K, V> *temp = new LRUNode<K, V>(keys[i], data[i], global_ttl);
-        add_new(temp);
-      }
-    }
-    total_diff += node_size - remove_count - init_size;
-    if (total_diff >= 500 || total_diff < -500) {
-      father->handle_size_diff(total_diff);
-      total_diff = 0;
-    }
-
-    pthread_rwlock_unlock(&father->rwlock);
-    return LRUResponse::ok;
-  }
-  void remove(LRUNode<K, V> *node) {
-    fetch(node);
-    node_size--;
-    key_map.erase(node->key);
-    delete node;
-  }
-
-  void process_redundant(int process_size) {
-    size_t length = std::min(remove_count, process_size);
-    while (length--) {
-      remove(node_head);
-      remove_count--;
-    }
-    // std::cerr<<"after remove_count = "<<remove_count<<std::endl;
-  }
-
-  void move_to_tail(LRUNode<K, V> *node) {
-    fetch(node);
-    place_at_tail(node);
-  }
-
-  void add_new(LRUNode<K, V> *node) {
-    node->ttl = global_ttl;
-    place_at_tail(node);
-    node_size++;
-    key_map[node->key] = node;
-  }
-  void place_at_tail(LRUNode<K, V> *node) {
-    if (node_end == NULL) {
-      node_head = node_end = node;
-      node->next = node->pre = NULL;
-    } else {
-      node_end->next = node;
-      node->pre = node_end;
-      node->next = NULL;
-      node_end = node;
-    }
-  }
-
-  void fetch(LRUNode<K, V> *node) {
-    if (node->pre) {
-      node->pre->next = node->next;
-    } else {
-      node_head = node->next;
-    }
-    if (node->next) {
-      node->next->pre = node->pre;
-    } else {
-      node_end = node->pre;
-    }
-  }
-
- private:
-  std::unordered_map<K, LRUNode<K, V> *> key_map;
-  ScaledLRU<K, V> *father;
-  size_t global_ttl, size_limit;
-  int node_size, total_diff;
-  LRUNode<K, V> *node_head, *node_end;
-  friend class ScaledLRU<K, V>;
-  int remove_count;
-};
-
-template <typename K, typename V>
-class ScaledLRU {
- public:
-  ScaledLRU(size_t _shard_num, size_t size_limit, size_t _ttl)
-      : size_limit(size_limit), ttl(_ttl) {
-    shard_num = _shard_num;
-    pthread_rwlock_init(&rwlock, NULL);
-    stop = false;
-    thread_pool.reset(new ::ThreadPool(1));
-    global_count = 0;
-    lru_pool = std::vector<RandomSampleLRU<K, V>>(shard_num,
-                                                  RandomSampleLRU<K, V>(this));
-    shrink_job = std::thread([this]() -> void {
-      while (true) {
-        {
-          std::unique_lock<std::mutex> lock(mutex_);
-          cv_.wait_for(lock, std::chrono::milliseconds(20000));
-          if (stop) {
-            return;
-          }
-        }
-        auto status =
-            thread_pool->enqueue([this]() -> int { return shrink(); });
-        status.wait();
-      }
-    });
-    shrink_job.detach();
-  }
-  ~ScaledLRU() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    stop = true;
-    cv_.notify_one();
-  }
-  LRUResponse query(size_t index, K *keys, size_t length,
-                    std::vector<std::pair<K, V>> &res) {
-    return lru_pool[index].query(keys, length, res);
-  }
-  LRUResponse insert(size_t index, K *keys, V *data, size_t length) {
-    return lru_pool[index].insert(keys, data, length);
-  }
-  int shrink() {
-    int node_size = 0;
-    for (size_t i = 0; i < lru_pool.size(); i++) {
-      node_size += lru_pool[i].node_size - lru_pool[i].remove_count;
-    }
-
-    if (node_size <= size_t(1.1 * size_limit) + 1) return 0;
-    if (pthread_rwlock_wrlock(&rwlock) == 0) {
-      // VLOG(0)<"in shrink\n";
-      global_count = 0;
-      for (size_t i = 0; i < lru_pool.size(); i++) {
-        global_count += lru_pool[i].node_size - lru_pool[i].remove_count;
-      }
-      // VLOG(0)<<"global_count "<<global_count<<"\n";
-      if (global_count > size_limit) {
-        size_t remove = global_count - size_limit;
-        for (int i = 0; i < lru_pool.size(); i++) {
-          lru_pool[i].total_diff = 0;
-          lru_pool[i].remove_count +=
-              1.0 * (lru_pool[i].node_size - lru_pool[i].remove_count) /
-              global_count * remove;
-          // VLOG(0)<<i<<" "<<lru_pool[i].remove_count<<std::endl;
-        }
-      }
-      pthread_rwlock_unlock(&rwlock);
-      return 0;
-    }
-    return 0;
-  }
-
-  void handle_size_diff(int diff) {
-    if (diff != 0) {
-      __sync_fetch_and_add(&global_count, diff);
-      if (global_count > int(1.25 * size_limit)) {
-        // VLOG(0)<<"global_count too large "<<global_count<<" enter start
-        // shrink task\n";
-        thread_pool->enqueue([this]() -> int { return shrink(); });
-      }
-    }
-  }
-
-  size_t get_ttl() { return ttl; }
-
- private:
-  pthread_rwlock_t rwlock;
-  size_t shard_num;
-  int global_count;
-  size_t size_limit, total, hit;
-  size_t ttl;
-  bool stop;
-  std::thread shrink_job;
-  std::vector<RandomSampleLRU<K, V>> lru_pool;
-  mutable std::mutex mutex_;
-  std::condition_variable cv_;
-  std::shared_ptr<::ThreadPool> thread_pool;
-  friend class RandomSampleLRU<K, V>;
+struct SampleResultBytes {
+  size_t operator()(const SampleResult &r) const { return r.actual_size; }
 };
 
 class GraphTable : public SparseTable {
  public:
-  GraphTable() { use_cache = false; }
+  GraphTable() {
+    use_cache = false;
+    use_csr = false;
+  }
   virtual ~GraphTable();
   virtual int32_t pull_graph_list(int start, int size,
                                   std::unique_ptr<char[]> &buffer,
@@ -387,6 +151,8 @@ class GraphTable : public SparseTable {
 
   int32_t get_server_index_by_id(uint64_t id);
   Node *find_node(uint64_t id);
+  // CSR shard holding the edges of id, nullptr if id is not stored in CSR
+  const CsrGraphShard *find_csr_shard(uint64_t id);
 
   virtual int32_t pull_sparse(float *values,
                               const PullSparseValue &pull_value) {
@@ -422,17 +188,7 @@ class GraphTable : public SparseTable {
 
   size_t get_server_num() { return server_num; }
 
-  virtual int32_t make_neighbor_sample_cache(size_t size_limit, size_t ttl) {
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      if (use_cache == false) {
-        scaled_lru.reset(new ScaledLRU<SampleKey, SampleResult>(
-            task_pool_size_, size_limit, ttl));
-        use_cache = true;
-      }
-    }
-    return 0;
-  }
+  virtual int32_t make_neighbor_sample_cache(size_t size_limit, size_t ttl);
 
  protected:
   std::vector<GraphShard *> shards, extra_shards;
@@ -449,10 +205,12 @@ class GraphTable : public SparseTable {
 
   std::vector<std::shared_ptr<::ThreadPool>> _shards_task_pool;
   std::vector<std::shared_ptr<std::mt19937_64>> _shards_task_rng_pool;
-  std::shared_ptr<ScaledLRU<SampleKey, SampleResult>> scaled_lru;
+  std::shared_ptr<
+      GraphSampleCache<SampleKey, SampleResult, SampleResultBytes>>
+      sample_cache;
   std::unordered_set<uint64_t> extra_nodes;
   std::unordered_map<uint64_t, size_t> extra_nodes_to_thread_index;
-  bool use_cache, use_duplicate_nodes;
+  bool use_cache, use_duplicate_nodes, use_csr;
   mutable std::mutex mutex_;
 };
 }  // namespace distributed
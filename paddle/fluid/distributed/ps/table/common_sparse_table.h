@@ -134,9 +134,10 @@ class CommonSparseTable : public SparseTable {
   void SaveMetaToText(std::ostream* os, const CommonAccessorParameter& common,
                       const size_t shard_idx, const int64_t total);
 
-  int64_t SaveValueToText(std::ostream* os, std::shared_ptr<ValueBlock> block,
-                          std::shared_ptr<::ThreadPool> pool, const int mode,
-                          int shard_id);
+  virtual int64_t SaveValueToText(std::ostream* os,
+                                  std::shared_ptr<ValueBlock> block,
+                                  std::shared_ptr<::ThreadPool> pool,
+                                  const int mode, int shard_id);
 
   virtual void ProcessALine(const std::vector<std::string>& columns,
                             const Meta& meta, const int64_t id,
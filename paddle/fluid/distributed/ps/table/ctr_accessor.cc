@@ -14,7 +14,10 @@
 
 #include "paddle/fluid/distributed/ps/table/ctr_accessor.h"
 #include <gflags/gflags.h>
+#include <algorithm>
+#include <cmath>
 #include "glog/logging.h"
+#include "paddle/fluid/platform/float16.h"
 #include "paddle/fluid/string/string_helper.h"
 
 namespace paddle {
@@ -35,6 +38,29 @@ int CtrCommonAccessor::initialize() {
   common_feature_value.embedx_sgd_dim = _embedx_sgd_rule->dim();
   _show_click_decay_rate = _config.ctr_accessor_param().show_click_decay_rate();
 
+  _embedx_quant_bits = _config.ctr_accessor_param().embedx_quant_bits();
+  _embedx_quant_threshold =
+      _config.ctr_accessor_param().embedx_quant_threshold();
+  _compact_dim = 0;
+  if (_embedx_quant_bits == 8 || _embedx_quant_bits == 16) {
+    size_t packed_dim =
+        (common_feature_value.embedx_dim * _embedx_quant_bits / 8 +
+         sizeof(float) - 1) /
+        sizeof(float);
+    size_t compact_dim = common_feature_value.embedx_w_index() +
+                         common_feature_value.embedx_sgd_dim + 1 + packed_dim;
+    if (compact_dim < dim()) {
+      _compact_dim = compact_dim;
+    } else {
+      LOG(WARNING) << "CtrCommonAccessor embedx_dim "
+                   << common_feature_value.embedx_dim
+                   << " too small to gain from quantization, disabled";
+    }
+  } else if (_embedx_quant_bits != 0) {
+    LOG(WARNING) << "CtrCommonAccessor unsupported embedx_quant_bits "
+                 << _embedx_quant_bits << ", expect 0, 8 or 16";
+  }
+
   return 0;
 }
 
@@ -193,7 +219,79 @@ bool CtrCommonAccessor::need_extend_mf(float* value) {
 }
 
 bool CtrCommonAccessor::has_mf(size_t size) {
-  return size > common_feature_value.embedx_g2sum_index();
+  // full and quantized values both carry embedx
+  return size > common_feature_value.embedx_w_index();
+}
+
+// A cold value (show_click_score below embedx_quant_threshold) is stored as
+//   [slot .. embed_g2sum] [embedx_g2sum] [scale] [embedx_w packed]
+// where embedx_w is fp16, or int8 times the per-row scale. The sgd rules
+// always run on the expanded float value; the table keeps a value it writes
+// expanded and packs it again at shrink, so it is quantized once per shrink
+// instead of on every update.
+size_t CtrCommonAccessor::compress(const float* value, size_t size,
+                                   float* stored) {
+  auto& fv = common_feature_value;
+  if (_compact_dim == 0 || size != fv.dim() ||
+      show_click_score(value[fv.show_index()], value[fv.click_index()]) >=
+          _embedx_quant_threshold) {
+    memcpy(stored, value, size * sizeof(float));
+    return size;
+  }
+  size_t embedx_w_index = fv.embedx_w_index();
+  memcpy(stored, value, embedx_w_index * sizeof(float));
+  memcpy(stored + embedx_w_index, value + fv.embedx_g2sum_index(),
+         fv.embedx_sgd_dim * sizeof(float));
+  float* scale = stored + embedx_w_index + fv.embedx_sgd_dim;
+  char* packed = reinterpret_cast<char*>(scale + 1);
+  memset(packed, 0, (stored + _compact_dim - (scale + 1)) * sizeof(float));
+  const float* embedx_w = value + embedx_w_index;
+  if (_embedx_quant_bits == 16) {
+    *scale = 1.0;
+    for (int i = 0; i < fv.embedx_dim; ++i) {
+      platform::float16 half(embedx_w[i]);
+      memcpy(packed + i * sizeof(uint16_t), &half.x, sizeof(uint16_t));
+    }
+  } else {
+    float max_abs = 0;
+    for (int i = 0; i < fv.embedx_dim; ++i) {
+      max_abs = std::max(max_abs, std::fabs(embedx_w[i]));
+    }
+    *scale = max_abs > 0 ? max_abs / 127 : 1.0;
+    for (int i = 0; i < fv.embedx_dim; ++i) {
+      float q = std::round(embedx_w[i] / *scale);
+      packed[i] = static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, q)));
+    }
+  }
+  return _compact_dim;
+}
+
+size_t CtrCommonAccessor::decompress(const float* stored, size_t size,
+                                     float* value) {
+  auto& fv = common_feature_value;
+  if (_compact_dim == 0 || size != _compact_dim) {
+    memcpy(value, stored, size * sizeof(float));
+    return size;
+  }
+  size_t embedx_w_index = fv.embedx_w_index();
+  memcpy(value, stored, embedx_w_index * sizeof(float));
+  memcpy(value + fv.embedx_g2sum_index(), stored + embedx_w_index,
+         fv.embedx_sgd_dim * sizeof(float));
+  const float* scale = stored + embedx_w_index + fv.embedx_sgd_dim;
+  const char* packed = reinterpret_cast<const char*>(scale + 1);
+  float* embedx_w = value + embedx_w_index;
+  if (_embedx_quant_bits == 16) {
+    for (int i = 0; i < fv.embedx_dim; ++i) {
+      platform::float16 half;
+      memcpy(&half.x, packed + i * sizeof(uint16_t), sizeof(uint16_t));
+      embedx_w[i] = static_cast<float>(half);
+    }
+  } else {
+    for (int i = 0; i < fv.embedx_dim; ++i) {
+      embedx_w[i] = static_cast<int8_t>(packed[i]) * *scale;
+    }
+  }
+  return fv.dim();
 }
 
 // from CommonFeatureValue to CtrCommonPullValue
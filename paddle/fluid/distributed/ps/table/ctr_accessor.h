@@ -146,12 +146,20 @@ class CtrCommonAccessor : public ValueAccessor {
   virtual size_t update_dim_size(size_t dim);
   // push value各维度相加总size
   virtual size_t update_size();
+  // slot, show, click
+  size_t update_exact_dim() override {
+    return CtrCommonPushValue::embed_g_index();
+  }
   // 判断该value是否进行shrink
   virtual bool shrink(float* value);
   // 判断该value是否保存到ssd
   // virtual bool save_ssd(float* value);
   virtual bool need_extend_mf(float* value);
   virtual bool has_mf(size_t size);
+  // cold values keep embedx_w quantized, see ctr_accessor.cc for the layout
+  size_t decompress(const float* stored, size_t size, float* value) override;
+  size_t compress(const float* value, size_t size, float* stored) override;
+  size_t compress_dim() override { return _compact_dim; }
   // 判断该value是否在save阶段dump,
   // param作为参数用于标识save阶段，如downpour的xbox与batch_model
   // param = 0, save all feature
@@ -196,6 +204,9 @@ class CtrCommonAccessor : public ValueAccessor {
   // CtrCommonFeatureValue common_feature_value;
   float _show_click_decay_rate;
   int32_t _ssd_unseenday_threshold;
+  int32_t _embedx_quant_bits;
+  float _embedx_quant_threshold;
+  size_t _compact_dim;  // stored size of a quantized value, 0 means disabled
 
  public:  // TODO(zhaocaibei123): it should be private, but we make it public
           // for unit test
@@ -0,0 +1,548 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <glog/logging.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace paddle {
+namespace distributed {
+
+// A feature value stored in place inside the value slab of a
+// FlatSparseTableShard. The floats directly follow the 4-byte header, and
+// capacity is fixed by the shard, so resize() never allocates.
+class FlatFeatureValue {
+ public:
+  float* data() { return reinterpret_cast<float*>(this + 1); }
+  size_t size() { return _size; }
+  size_t capacity() { return _capacity; }
+  void resize(size_t size) {
+    CHECK(size <= _capacity) << "FlatFeatureValue resize to " << size
+                             << " exceeds capacity " << _capacity;
+    if (size > _size) {
+      memset(data() + _size, 0, (size - _size) * sizeof(float));
+    }
+    _size = static_cast<uint16_t>(size);
+  }
+  void shrink_to_fit() {}
+
+ private:
+  template <class KEY>
+  friend struct FlatSparseTableShard;
+
+  uint16_t _size;
+  uint16_t _capacity;
+};
+
+// Open-addressing sparse shard in the style of SwissTable. Control bytes are
+// grouped by 16 and matched with one SSE2 compare per probe, the slot array
+// only keeps (key, offset) pairs, and values live in a slab of fixed-width
+// chunks, so neither lookup nor insertion of a new feasign touches malloc
+// outside of chunk allocation. A chunk is freed once its last value is gone.
+// The interface mirrors SparseTableShard<KEY, FixedFeatureValue> so it can be
+// used as a drop-in shard_type; call init(value_dim) before the first insert.
+// An optional second, narrower slab holds values whose accessor stores them
+// compressed; resize_value() moves a value between the two.
+template <class KEY>
+struct alignas(64) FlatSparseTableShard {
+ public:
+  static const size_t kGroupWidth = 16;
+  static const int8_t kEmpty = -128;
+  static const int8_t kDeleted = -2;
+  static const size_t kSlabChunkBits = 14;
+  static const size_t kSlabChunkSlots = static_cast<size_t>(1)
+                                        << kSlabChunkBits;
+  // offsets with this bit set live in the compact slab
+  static const uint32_t kCompactBit = 0x80000000u;
+
+  struct Slot {
+    KEY key;
+    uint32_t offset;
+  };
+
+  struct iterator {
+    FlatSparseTableShard* shard;
+    size_t index;
+    friend bool operator==(const iterator& a, const iterator& b) {
+      return a.index == b.index;
+    }
+    friend bool operator!=(const iterator& a, const iterator& b) {
+      return a.index != b.index;
+    }
+    const KEY& key() const { return shard->_slots[index].key; }
+    FlatFeatureValue& value() const {
+      return *shard->slab_value(shard->_slots[index].offset);
+    }
+    iterator& operator++() {
+      index = shard->next_full(index + 1);
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator ret = *this;
+      ++*this;
+      return ret;
+    }
+  };
+
+  FlatSparseTableShard() {}
+  FlatSparseTableShard(const FlatSparseTableShard&) = delete;
+  ~FlatSparseTableShard() { clear(); }
+
+  void init(size_t value_dim, size_t compact_dim = 0) {
+    CHECK(_size == 0) << "FlatSparseTableShard::init on a non-empty shard";
+    CHECK(value_dim <= UINT16_MAX);
+    CHECK(compact_dim < value_dim);
+    _slabs[0].init(value_dim);
+    _slabs[1].init(compact_dim);
+  }
+  size_t value_dim() const { return _slabs[0].dim; }
+
+  bool empty() { return _size == 0; }
+  size_t size() { return _size; }
+  size_t capacity() { return _capacity; }
+
+  // bytes held by control bytes, slots and value slab
+  size_t memory_usage() {
+    return _capacity * (sizeof(int8_t) + sizeof(Slot)) +
+           _slabs[0].memory_usage() + _slabs[1].memory_usage();
+  }
+
+  void reserve(size_t n) {
+    size_t need = n + n / 7 + 1;
+    if (need > _capacity) {
+      rehash(need);
+    }
+  }
+
+  void clear() {
+    _ctrl.reset();
+    _slots.reset();
+    _slabs[0].clear();
+    _slabs[1].clear();
+    _capacity = 0;
+    _size = 0;
+    _growth_left = 0;
+  }
+
+  iterator begin() { return {this, next_full(0)}; }
+  iterator end() { return {this, _capacity}; }
+
+  iterator find(const KEY& key) { return find_with_hash(key, hash(key)); }
+
+  iterator find_with_hash(const KEY& key, size_t hash) {
+    if (_capacity == 0) {
+      return end();
+    }
+    size_t group_mask = (_capacity / kGroupWidth) - 1;
+    size_t group = h1(hash) & group_mask;
+    int8_t tag = h2(hash);
+    for (size_t step = 1;; ++step) {
+      size_t base = group * kGroupWidth;
+      uint32_t mask = match(&_ctrl[base], tag);
+      while (mask != 0) {
+        size_t i = base + __builtin_ctz(mask);
+        if (_slots[i].key == key) {
+          return {this, i};
+        }
+        mask &= mask - 1;
+      }
+      if (match(&_ctrl[base], kEmpty) != 0) {
+        return end();
+      }
+      group = (group + step) & group_mask;
+    }
+  }
+
+  // Pull the control group and slot line for key into cache; used to overlap
+  // the misses of several lookups.
+  void prefetch(size_t hash) {
+    if (_capacity == 0) {
+      return;
+    }
+    size_t base = (h1(hash) & ((_capacity / kGroupWidth) - 1)) * kGroupWidth;
+    __builtin_prefetch(&_ctrl[base]);
+    __builtin_prefetch(&_slots[base]);
+  }
+  void prefetch_value(iterator it) {
+    if (it.index != _capacity) {
+      __builtin_prefetch(slab_value(_slots[it.index].offset));
+    }
+  }
+
+  FlatFeatureValue& operator[](const KEY& key) {
+    return emplace(key).first.value();
+  }
+
+  std::pair<iterator, bool> emplace(const KEY& key) {
+    return emplace_in(key, false);
+  }
+  // Insert key with a value of size taken from the slab that fits it, so a
+  // new short value never passes through the full slab. An existing value
+  // is returned as it is.
+  std::pair<iterator, bool> emplace(const KEY& key, size_t size) {
+    auto ret = emplace_in(key, fits_compact(size));
+    if (ret.second) {
+      ret.first.value().resize(size);
+    }
+    return ret;
+  }
+
+  // Bulk insert of n keys known to be distinct and absent from the shard,
+  // such as the keys of a checkpoint file loaded into an empty shard: one
+  // reserve and no lookup per key. Value k gets sizes[k] floats copied from
+  // values + k * stride.
+  void insert_unique(const KEY* keys, size_t n, const uint16_t* sizes,
+                     const float* values, size_t stride) {
+    reserve(_size + n);
+    for (size_t k = 0; k < n; ++k) {
+      if (_growth_left == 0) {
+        rehash(_size * 2 > _capacity ? _capacity * 2 : _capacity);
+      }
+      size_t h = hash(keys[k]);
+      size_t i = find_insert_slot(h);
+      if (_ctrl[i] == kEmpty) {
+        --_growth_left;
+      }
+      _ctrl[i] = h2(h);
+      _slots[i].key = keys[k];
+      _slots[i].offset = acquire_value(fits_compact(sizes[k]));
+      ++_size;
+      FlatFeatureValue* value = slab_value(_slots[i].offset);
+      value->resize(sizes[k]);
+      memcpy(value->data(), values + k * stride, sizes[k] * sizeof(float));
+    }
+  }
+
+  // Resize the value at it. Values that fit the compact slab are kept there
+  // and move back to the full slab when they grow; the returned reference
+  // replaces any earlier one taken from it.value().
+  FlatFeatureValue& resize_value(iterator it, size_t size) {
+    uint32_t offset = _slots[it.index].offset;
+    bool compact = fits_compact(size);
+    if (compact == ((offset & kCompactBit) != 0)) {
+      FlatFeatureValue* value = slab_value(offset);
+      value->resize(size);
+      return *value;
+    }
+    uint32_t new_offset = acquire_value(compact);
+    FlatFeatureValue* old_value = slab_value(offset);
+    FlatFeatureValue* new_value = slab_value(new_offset);
+    new_value->resize(size);
+    memcpy(new_value->data(), old_value->data(),
+           std::min(size, old_value->size()) * sizeof(float));
+    release_value(offset);
+    _slots[it.index].offset = new_offset;
+    return *new_value;
+  }
+
+  iterator erase(iterator it) {
+    quick_erase(it);
+    return {this, next_full(it.index + 1)};
+  }
+  void quick_erase(iterator it) {
+    release_value(_slots[it.index].offset);
+    // a slot whose group still has an empty byte can never be passed by a
+    // probe, so it may become empty again instead of a tombstone
+    size_t base = it.index & ~(kGroupWidth - 1);
+    if (match(&_ctrl[base], kEmpty) != 0) {
+      _ctrl[it.index] = kEmpty;
+      ++_growth_left;
+    } else {
+      _ctrl[it.index] = kDeleted;
+    }
+    --_size;
+  }
+  size_t erase(const KEY& key) {
+    auto it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    quick_erase(it);
+    return 1;
+  }
+
+  size_t hash(const KEY& key) const {
+    // feasigns are often already hashed but std::hash is identity for
+    // integers, so mix the bits before splitting into group index and tag
+    uint64_t x = static_cast<uint64_t>(_hasher(key));
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+  }
+
+ private:
+  static size_t h1(size_t hash) { return hash >> 7; }
+  static int8_t h2(size_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+  bool fits_compact(size_t size) const {
+    return _slabs[1].dim != 0 && size <= _slabs[1].dim;
+  }
+
+  std::pair<iterator, bool> emplace_in(const KEY& key, bool compact) {
+    size_t h = hash(key);
+    auto it = find_with_hash(key, h);
+    if (it != end()) {
+      return {it, false};
+    }
+    if (_growth_left == 0) {
+      // drop tombstones in place if they dominate, grow otherwise
+      rehash(_size * 2 > _capacity ? _capacity * 2 : _capacity);
+    }
+    size_t i = find_insert_slot(h);
+    if (_ctrl[i] == kEmpty) {
+      --_growth_left;
+    }
+    _ctrl[i] = h2(h);
+    _slots[i].key = key;
+    _slots[i].offset = acquire_value(compact);
+    ++_size;
+    return {{this, i}, true};
+  }
+
+  static uint32_t match(const int8_t* group, int8_t tag) {
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+      mask |= static_cast<uint32_t>(group[i] == tag) << i;
+    }
+    return mask;
+#endif
+  }
+  // empty and deleted bytes are the only ones with the sign bit set
+  static uint32_t match_empty_or_deleted(const int8_t* group) {
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+      mask |= static_cast<uint32_t>(group[i] < 0) << i;
+    }
+    return mask;
+#endif
+  }
+
+  size_t find_insert_slot(size_t hash) {
+    size_t group_mask = (_capacity / kGroupWidth) - 1;
+    size_t group = h1(hash) & group_mask;
+    for (size_t step = 1;; ++step) {
+      size_t base = group * kGroupWidth;
+      uint32_t mask = match_empty_or_deleted(&_ctrl[base]);
+      if (mask != 0) {
+        return base + __builtin_ctz(mask);
+      }
+      group = (group + step) & group_mask;
+    }
+  }
+
+  size_t next_full(size_t index) {
+    while (index < _capacity && _ctrl[index] < 0) {
+      ++index;
+    }
+    return index;
+  }
+
+  void rehash(size_t min_capacity) {
+    size_t new_capacity = kGroupWidth;
+    while (new_capacity < min_capacity) {
+      new_capacity <<= 1;
+    }
+    std::unique_ptr<int8_t[]> old_ctrl = std::move(_ctrl);
+    std::unique_ptr<Slot[]> old_slots = std::move(_slots);
+    size_t old_capacity = _capacity;
+
+    _ctrl.reset(new int8_t[new_capacity]);
+    memset(_ctrl.get(), kEmpty, new_capacity);
+    _slots.reset(new Slot[new_capacity]);
+    _capacity = new_capacity;
+    _growth_left = new_capacity - new_capacity / 8 - _size;
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (old_ctrl[i] < 0) {
+        continue;
+      }
+      size_t h = hash(old_slots[i].key);
+      size_t pos = find_insert_slot(h);
+      _ctrl[pos] = h2(h);
+      _slots[pos] = old_slots[i];
+    }
+  }
+
+  // Fixed-width value slots in chunks of kSlabChunkSlots. The free slots of
+  // a chunk are threaded through their headers, and a chunk is freed when
+  // its last value goes. One emptied chunk is kept as a spare, so values
+  // moving in and out at a chunk boundary do not allocate every time.
+  struct Slab {
+    static const uint32_t kNoSlot = UINT32_MAX;
+    struct Chunk {
+      std::unique_ptr<char[]> data;
+      uint32_t live = 0;
+      uint32_t bumped = 0;  // slots handed out before any was freed
+      uint32_t free_head = kNoSlot;
+      bool in_partial = false;
+    };
+
+    size_t dim = 0;
+    size_t slot_bytes = 0;
+    std::vector<Chunk> chunks;
+    // chunks which may have a free slot, checked lazily on acquire
+    std::vector<uint32_t> partial;
+    // chunks whose memory has been freed, to be reused first
+    std::vector<uint32_t> released;
+    std::unique_ptr<char[]> spare;
+
+    void init(size_t value_dim) {
+      static_assert(sizeof(FlatFeatureValue) >= sizeof(uint32_t),
+                    "a free slot keeps the next one in its header");
+      dim = value_dim;
+      slot_bytes = sizeof(FlatFeatureValue) + value_dim * sizeof(float);
+    }
+    size_t memory_usage() const {
+      size_t chunk_num = chunks.size() - released.size() + (spare ? 1 : 0);
+      return chunk_num * kSlabChunkSlots * slot_bytes;
+    }
+    void clear() {
+      chunks.clear();
+      partial.clear();
+      released.clear();
+      spare.reset();
+    }
+
+    char* slot(uint32_t index) {
+      return chunks[index >> kSlabChunkBits].data.get() +
+             (index & (kSlabChunkSlots - 1)) * slot_bytes;
+    }
+
+    uint32_t acquire() {
+      while (!partial.empty()) {
+        Chunk& chunk = chunks[partial.back()];
+        if (chunk.data != nullptr && (chunk.free_head != kNoSlot ||
+                                      chunk.bumped < kSlabChunkSlots)) {
+          break;
+        }
+        chunk.in_partial = false;
+        partial.pop_back();
+      }
+      uint32_t id;
+      if (!partial.empty()) {
+        id = partial.back();
+      } else {
+        if (!released.empty()) {
+          id = released.back();
+          released.pop_back();
+        } else {
+          CHECK((chunks.size() + 1) * kSlabChunkSlots <= kCompactBit);
+          id = static_cast<uint32_t>(chunks.size());
+          chunks.emplace_back();
+        }
+        Chunk& chunk = chunks[id];
+        if (spare != nullptr) {
+          chunk.data = std::move(spare);
+        } else {
+          chunk.data.reset(new char[kSlabChunkSlots * slot_bytes]);
+        }
+        chunk.live = 0;
+        chunk.bumped = 0;
+        chunk.free_head = kNoSlot;
+        if (!chunk.in_partial) {
+          chunk.in_partial = true;
+          partial.push_back(id);
+        }
+      }
+      Chunk& chunk = chunks[id];
+      uint32_t index = id << kSlabChunkBits;
+      if (chunk.free_head != kNoSlot) {
+        index |= chunk.free_head;
+        memcpy(&chunk.free_head, slot(index), sizeof(uint32_t));
+      } else {
+        index |= chunk.bumped++;
+      }
+      ++chunk.live;
+      return index;
+    }
+
+    void release(uint32_t index) {
+      uint32_t id = index >> kSlabChunkBits;
+      Chunk& chunk = chunks[id];
+      if (--chunk.live == 0) {
+        if (spare == nullptr) {
+          spare = std::move(chunk.data);
+        } else {
+          chunk.data.reset();
+        }
+        released.push_back(id);
+        return;
+      }
+      memcpy(slot(index), &chunk.free_head, sizeof(uint32_t));
+      chunk.free_head = index & (kSlabChunkSlots - 1);
+      if (!chunk.in_partial) {
+        chunk.in_partial = true;
+        partial.push_back(id);
+      }
+    }
+  };
+
+  FlatFeatureValue* slab_value(uint32_t offset) {
+    return reinterpret_cast<FlatFeatureValue*>(
+        _slabs[offset >> 31].slot(offset & ~kCompactBit));
+  }
+
+  uint32_t acquire_value(bool compact) {
+    Slab& slab = _slabs[compact];
+    CHECK(slab.dim != 0) << "FlatSparseTableShard used before init";
+    uint32_t offset = slab.acquire();
+    if (compact) {
+      offset |= kCompactBit;
+    }
+    FlatFeatureValue* value = slab_value(offset);
+    value->_size = 0;
+    value->_capacity = static_cast<uint16_t>(slab.dim);
+    return offset;
+  }
+  void release_value(uint32_t offset) {
+    _slabs[offset >> 31].release(offset & ~kCompactBit);
+  }
+
+  std::unique_ptr<int8_t[]> _ctrl;
+  std::unique_ptr<Slot[]> _slots;
+  size_t _capacity = 0;
+  size_t _size = 0;
+  size_t _growth_left = 0;
+
+  // full width values and, when enabled, compressed ones
+  Slab _slabs[2];
+
+  std::hash<KEY> _hasher;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -14,80 +14,170 @@
 
 #pragma once
 
-#include <ThreadPool.h>
-#include <functional>
-#include <future>  // NOLINT
+#include <glog/logging.h>
+#include <stdint.h>
+#include <algorithm>
 #include <memory>
-#include <string>
+#include <mutex>  // NOLINT
 #include <unordered_map>
-#include <unordered_set>
-#include <utility>
 #include <vector>
 
 namespace paddle {
 namespace distributed {
 
-class ConcurrentSet {
- public:
-  ConcurrentSet() : pool_(new ::ThreadPool(1)) {}
-  ~ConcurrentSet() {}
-
-  std::future<void> Update(const std::vector<uint64_t>& rows) {
-    auto task = [this, rows] {
-      for (auto row : rows) {
-        set_.insert(row);
-      }
-    };
-    return pool_->enqueue(std::move(task));
-  }
-
-  std::future<void> GetAndClear(std::vector<uint64_t>* result) {
-    auto task = [this, &result] {
-      result->clear();
-      for (auto& id : set_) {
-        result->push_back(id);
-      }
-      set_.clear();
-    };
-    return pool_->enqueue(std::move(task));
-  }
-
- private:
-  std::unordered_set<uint64_t> set_;
-  std::unique_ptr<::ThreadPool> pool_{nullptr};
-};
-
+// Records the rows every trainer has not pulled since they were last pushed.
+// Rows are spread over independently locked shards. Each dirty row keeps one
+// bit per trainer, and each shard keeps, per trainer, the list of the rows
+// whose bit of the trainer is set. A push of a row already dirty for every
+// trainer costs one lookup whatever the trainer number is, and GetAndClear
+// only visits the rows of its trainer, shard by shard, without stopping
+// pushes to the other shards.
 class GeoRecorder {
  public:
-  explicit GeoRecorder(int trainer_num) : trainer_num_(trainer_num) {
-    trainer_rows_.reserve(trainer_num);
-    for (auto i = 0; i < trainer_num; ++i) {
-      trainer_rows_.emplace_back(new ConcurrentSet());
+  explicit GeoRecorder(int trainer_num, int shard_num = 64)
+      : trainer_num_(trainer_num),
+        words_((trainer_num + 63) / 64),
+        shard_num_(shard_num),
+        shards_(new Shard[shard_num]) {
+    CHECK_GT(trainer_num, 0);
+    CHECK_GT(shard_num, 0);
+    for (int i = 0; i < shard_num; ++i) {
+      shards_[i].pending.resize(trainer_num);
+    }
+    full_mask_.assign(words_, ~0ULL);
+    if (trainer_num % 64 != 0) {
+      full_mask_.back() = (1ULL << (trainer_num % 64)) - 1;
     }
   }
 
   ~GeoRecorder() = default;
 
   void Update(const std::vector<uint64_t>& update_rows) {
-    VLOG(3) << " row size: " << update_rows.size();
+    Update(update_rows.data(), update_rows.size());
+  }
 
-    std::vector<std::future<void>> fs;
-    for (auto& set : trainer_rows_) {
-      fs.push_back(set->Update(update_rows));
+  void Update(const uint64_t* rows, size_t num) {
+    VLOG(3) << " row size: " << num;
+
+    // bucket the rows by shard so every shard lock is taken once
+    std::vector<uint32_t> offsets(shard_num_ + 1, 0);
+    std::vector<uint32_t> shard_ids(num);
+    for (size_t i = 0; i < num; ++i) {
+      shard_ids[i] = ShardId(rows[i]);
+      ++offsets[shard_ids[i] + 1];
+    }
+    for (int i = 0; i < shard_num_; ++i) {
+      offsets[i + 1] += offsets[i];
     }
-    for (auto& f : fs) {
-      f.wait();
+    std::vector<uint64_t> bucketed(num);
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < num; ++i) {
+      bucketed[cursor[shard_ids[i]]++] = rows[i];
+    }
+
+    for (int i = 0; i < shard_num_; ++i) {
+      if (offsets[i] == offsets[i + 1]) {
+        continue;
+      }
+      Shard& shard = shards_[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (uint32_t j = offsets[i]; j < offsets[i + 1]; ++j) {
+        auto ret = shard.rows.emplace(bucketed[j], 0);
+        if (ret.second) {
+          ret.first->second = AcquireBits(&shard);
+        }
+        uint64_t* bits = shard.bits.data() + ret.first->second;
+        for (size_t w = 0; w < words_; ++w) {
+          // list the row for the trainers it was not dirty for
+          uint64_t added = full_mask_[w] & ~bits[w];
+          bits[w] = full_mask_[w];
+          while (added != 0) {
+            int b = __builtin_ctzll(added);
+            added &= added - 1;
+            shard.pending[w * 64 + b].push_back(bucketed[j]);
+          }
+        }
+      }
     }
   }
 
   void GetAndClear(uint32_t trainer_id, std::vector<uint64_t>* result) {
     VLOG(3) << "GetAndClear for trainer: " << trainer_id;
-    trainer_rows_.at(trainer_id)->GetAndClear(result).wait();
+    CHECK_LT(trainer_id, static_cast<uint32_t>(trainer_num_));
+    result->clear();
+    size_t word = trainer_id / 64;
+    uint64_t bit = 1ULL << (trainer_id % 64);
+    for (int i = 0; i < shard_num_; ++i) {
+      Shard& shard = shards_[i];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto& pending = shard.pending[trainer_id];
+      for (auto row : pending) {
+        auto it = shard.rows.find(row);
+        uint64_t* bits = shard.bits.data() + it->second;
+        result->push_back(row);
+        bits[word] &= ~bit;
+        if (IsClear(bits)) {
+          // every trainer has it, drop the row
+          shard.free_bits.push_back(it->second);
+          shard.rows.erase(it);
+        }
+      }
+      // keeps its capacity for the next pushes
+      pending.clear();
+    }
+  }
+
+  // rows still waiting for at least one trainer
+  size_t DirtyRowNum() {
+    size_t num = 0;
+    for (int i = 0; i < shard_num_; ++i) {
+      std::lock_guard<std::mutex> lock(shards_[i].mutex);
+      num += shards_[i].rows.size();
+    }
+    return num;
   }
 
  private:
+  struct Shard {
+    std::mutex mutex;
+    // row -> offset of its trainer bits in bits
+    std::unordered_map<uint64_t, size_t> rows;
+    std::vector<uint64_t> bits;
+    std::vector<size_t> free_bits;
+    // trainer -> the rows whose bit of the trainer is set
+    std::vector<std::vector<uint64_t>> pending;
+  };
+
+  uint32_t ShardId(uint64_t row) const {
+    return static_cast<uint32_t>(((row * 0x9e3779b97f4a7c15ULL) >> 32) %
+                                 shard_num_);
+  }
+
+  size_t AcquireBits(Shard* shard) {
+    if (!shard->free_bits.empty()) {
+      size_t offset = shard->free_bits.back();
+      shard->free_bits.pop_back();
+      return offset;
+    }
+    size_t offset = shard->bits.size();
+    shard->bits.resize(offset + words_);
+    return offset;
+  }
+
+  bool IsClear(const uint64_t* bits) const {
+    for (size_t i = 0; i < words_; ++i) {
+      if (bits[i] != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   const int trainer_num_;
-  std::vector<std::unique_ptr<ConcurrentSet>> trainer_rows_;
+  const size_t words_;
+  const int shard_num_;
+  std::unique_ptr<Shard[]> shards_;
+  std::vector<uint64_t> full_mask_;
 };
 
 }  // namespace distributed
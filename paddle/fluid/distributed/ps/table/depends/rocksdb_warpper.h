@@ -22,6 +22,8 @@
 #include <rocksdb/write_batch.h>
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace paddle {
 namespace distributed {
@@ -125,6 +127,27 @@ class RocksDBHandler {
     return 0;
   }
 
+  // one MultiGet for a batch of keys; found[i] tells whether values[i] holds
+  // the value of keys[i]
+  int multi_get(int id, const std::vector<std::pair<char*, int>>& keys,
+                std::vector<std::string>* values, std::vector<bool>* found) {
+    std::vector<rocksdb::Slice> slices;
+    slices.reserve(keys.size());
+    for (auto& key : keys) {
+      slices.emplace_back(key.first, key.second);
+    }
+    std::vector<rocksdb::ColumnFamilyHandle*> handles(keys.size(),
+                                                      _handles[id]);
+    std::vector<rocksdb::Status> status =
+        _db->MultiGet(rocksdb::ReadOptions(), handles, slices, values);
+    found->resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      (*found)[i] = status[i].ok();
+      assert(status[i].ok() || status[i].IsNotFound());
+    }
+    return 0;
+  }
+
   int del_data(int id, const char* key, int key_len) {
     rocksdb::WriteOptions options;
     options.disableWAL = true;
@@ -0,0 +1,194 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// Count-min sketch with four rows of saturating 8-bit counters. After
+// 10 * capacity increments every counter is halved, so old popularity
+// decays and the sketch follows shifts in the key distribution.
+class FrequencySketch {
+ public:
+  explicit FrequencySketch(size_t capacity) {
+    size_t width = 64;
+    while (width < capacity) {
+      width <<= 1;
+    }
+    _mask = width - 1;
+    _table.assign(kDepth * width, 0);
+    _sample_size = std::max<size_t>(10 * capacity, 64);
+  }
+
+  void increment(uint64_t key) {
+    bool added = false;
+    for (size_t i = 0; i < kDepth; ++i) {
+      uint8_t& counter = _table[i * (_mask + 1) + index(key, i)];
+      if (counter < UINT8_MAX) {
+        ++counter;
+        added = true;
+      }
+    }
+    if (added && ++_additions >= _sample_size) {
+      reset();
+    }
+  }
+
+  uint32_t estimate(uint64_t key) const {
+    uint32_t freq = UINT8_MAX;
+    for (size_t i = 0; i < kDepth; ++i) {
+      freq = std::min<uint32_t>(freq, _table[i * (_mask + 1) + index(key, i)]);
+    }
+    return freq;
+  }
+
+ private:
+  static const size_t kDepth = 4;
+
+  size_t index(uint64_t key, size_t row) const {
+    static const uint64_t seeds[kDepth] = {
+        0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+        0xcbf29ce484222325ULL};
+    uint64_t h = (key + seeds[row]) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<size_t>(h >> 32) & _mask;
+  }
+
+  void reset() {
+    for (auto& counter : _table) {
+      counter >>= 1;
+    }
+    _additions /= 2;
+  }
+
+  std::vector<uint8_t> _table;
+  size_t _mask;
+  size_t _sample_size;
+  size_t _additions = 0;
+};
+
+// W-TinyLFU replacement policy over keys only; the values stay wherever the
+// owner keeps them. New keys enter a small LRU window (1% of capacity); a key
+// leaving the window is admitted into the segmented-LRU main area only if the
+// sketch says it is more popular than the main area's victim, otherwise it
+// is the one evicted. Not thread safe, one instance per shard.
+template <class KEY>
+class WTinyLfuPolicy {
+ public:
+  explicit WTinyLfuPolicy(size_t capacity) : _sketch(capacity) {
+    _window_capacity = std::max<size_t>(capacity / 100, 1);
+    size_t main_capacity =
+        capacity > _window_capacity ? capacity - _window_capacity : 1;
+    _protected_capacity = main_capacity * 4 / 5;
+    _main_capacity = main_capacity;
+  }
+
+  size_t size() const { return _index.size(); }
+
+  // record a hit on a resident key
+  void touch(const KEY& key) {
+    _sketch.increment(static_cast<uint64_t>(key));
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+      return;
+    }
+    Entry& entry = it->second;
+    if (entry.segment == kProbation) {
+      move_to(&entry, kProtected);
+      if (_segments[kProtected].size() > _protected_capacity) {
+        auto demoted = _index.find(_segments[kProtected].back());
+        move_to(&demoted->second, kProbation);
+      }
+    } else {
+      _segments[entry.segment].splice(_segments[entry.segment].begin(),
+                                      _segments[entry.segment], entry.pos);
+    }
+  }
+
+  // record a key that just became resident; keys that must leave memory to
+  // respect the capacity are appended to evicted
+  void insert(const KEY& key, std::vector<KEY>* evicted) {
+    _sketch.increment(static_cast<uint64_t>(key));
+    if (_index.count(key) != 0) {
+      return;
+    }
+    _segments[kWindow].push_front(key);
+    _index[key] = {kWindow, _segments[kWindow].begin()};
+    if (_segments[kWindow].size() <= _window_capacity) {
+      return;
+    }
+
+    KEY candidate = _segments[kWindow].back();
+    Entry& candidate_entry = _index[candidate];
+    if (main_size() < _main_capacity) {
+      move_to(&candidate_entry, kProbation);
+      return;
+    }
+    Segment victim_segment =
+        _segments[kProbation].empty() ? kProtected : kProbation;
+    KEY victim = _segments[victim_segment].back();
+    if (_sketch.estimate(static_cast<uint64_t>(candidate)) >
+        _sketch.estimate(static_cast<uint64_t>(victim))) {
+      move_to(&candidate_entry, kProbation);
+      erase(victim);
+      evicted->push_back(victim);
+    } else {
+      erase(candidate);
+      evicted->push_back(candidate);
+    }
+  }
+
+  // forget a key that left memory by other means
+  void erase(const KEY& key) {
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+      return;
+    }
+    _segments[it->second.segment].erase(it->second.pos);
+    _index.erase(it);
+  }
+
+ private:
+  enum Segment { kWindow = 0, kProbation = 1, kProtected = 2 };
+  struct Entry {
+    Segment segment;
+    typename std::list<KEY>::iterator pos;
+  };
+
+  size_t main_size() const {
+    return _segments[kProbation].size() + _segments[kProtected].size();
+  }
+
+  void move_to(Entry* entry, Segment segment) {
+    _segments[segment].splice(_segments[segment].begin(),
+                              _segments[entry->segment], entry->pos);
+    entry->segment = segment;
+  }
+
+  FrequencySketch _sketch;
+  std::list<KEY> _segments[3];
+  std::unordered_map<KEY, Entry> _index;
+  size_t _window_capacity;
+  size_t _protected_capacity;
+  size_t _main_capacity;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,301 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr_shard.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <utility>
+namespace paddle {
+namespace distributed {
+
+// Up to this many picks a sample is drawn by rejecting repeated draws, with
+// a linear scan of the picks so far; larger samples use the O(degree) exact
+// methods directly.
+static const int kSmallSample = 64;
+// A weighted pick that draws only taken neighbors this many times in a row
+// finishes the sample with the exact method instead.
+static const int kMaxRejections = 16;
+
+void CsrGraphShard::clear() {
+  std::vector<uint64_t>().swap(_ids);
+  std::vector<uint64_t>().swap(_offsets);
+  std::vector<uint64_t>().swap(_neighbors);
+  std::vector<float>().swap(_weights);
+  std::vector<float>().swap(_alias_prob);
+  std::vector<uint32_t>().swap(_alias);
+}
+
+void CsrGraphShard::build(std::vector<CsrEdge> *edges, bool is_weighted) {
+  clear();
+  _is_weighted = is_weighted;
+  std::stable_sort(
+      edges->begin(), edges->end(),
+      [](const CsrEdge &a, const CsrEdge &b) { return a.src < b.src; });
+  size_t edge_num = edges->size();
+  _neighbors.resize(edge_num);
+  if (is_weighted) {
+    _weights.resize(edge_num);
+  }
+  _offsets.push_back(0);
+  for (size_t i = 0; i < edge_num; ++i) {
+    const CsrEdge &edge = (*edges)[i];
+    if (i == 0 || edge.src != (*edges)[i - 1].src) {
+      if (i != 0) {
+        _offsets.push_back(i);
+      }
+      _ids.push_back(edge.src);
+    }
+    _neighbors[i] = edge.dst;
+    if (is_weighted) {
+      _weights[i] = edge.weight;
+    }
+  }
+  if (edge_num != 0) {
+    _offsets.push_back(edge_num);
+  }
+  std::vector<CsrEdge>().swap(*edges);
+  _ids.shrink_to_fit();
+  _offsets.shrink_to_fit();
+
+  if (is_weighted) {
+    _alias_prob.resize(edge_num);
+    _alias.resize(edge_num);
+    for (size_t row = 0; row < _ids.size(); ++row) {
+      build_alias(row);
+    }
+  }
+}
+
+void CsrGraphShard::dump_edges(std::vector<CsrEdge> *edges) const {
+  edges->reserve(edges->size() + edge_num());
+  for (size_t row = 0; row < _ids.size(); ++row) {
+    for (int idx = 0; idx < degree(row); ++idx) {
+      edges->push_back({_ids[row], neighbor_id(row, idx),
+                        neighbor_weight(row, idx)});
+    }
+  }
+}
+
+void CsrGraphShard::remove_nodes(std::vector<uint64_t> ids) {
+  std::sort(ids.begin(), ids.end());
+  size_t kept_rows = 0, kept_edges = 0;
+  for (size_t row = 0; row < _ids.size(); ++row) {
+    if (std::binary_search(ids.begin(), ids.end(), _ids[row])) {
+      continue;
+    }
+    // alias indices are local to the row, so a row moves as it is
+    uint64_t begin = _offsets[row], end = _offsets[row + 1];
+    for (uint64_t i = begin; i < end; ++i, ++kept_edges) {
+      _neighbors[kept_edges] = _neighbors[i];
+      if (_is_weighted) {
+        _weights[kept_edges] = _weights[i];
+        _alias_prob[kept_edges] = _alias_prob[i];
+        _alias[kept_edges] = _alias[i];
+      }
+    }
+    _ids[kept_rows] = _ids[row];
+    _offsets[++kept_rows] = kept_edges;
+  }
+  if (kept_rows == _ids.size()) {
+    return;
+  }
+  _ids.resize(kept_rows);
+  _offsets.resize(kept_rows + 1);
+  _neighbors.resize(kept_edges);
+  if (_is_weighted) {
+    _weights.resize(kept_edges);
+    _alias_prob.resize(kept_edges);
+    _alias.resize(kept_edges);
+  }
+}
+
+size_t CsrGraphShard::memory_usage() const {
+  return _ids.capacity() * sizeof(uint64_t) +
+         _offsets.capacity() * sizeof(uint64_t) +
+         _neighbors.capacity() * sizeof(uint64_t) +
+         _weights.capacity() * sizeof(float) +
+         _alias_prob.capacity() * sizeof(float) +
+         _alias.capacity() * sizeof(uint32_t);
+}
+
+int64_t CsrGraphShard::find(uint64_t id) const {
+  auto it = std::lower_bound(_ids.begin(), _ids.end(), id);
+  if (it == _ids.end() || *it != id) {
+    return -1;
+  }
+  return it - _ids.begin();
+}
+
+// Vose's alias method: scale the weights to average 1, then repeatedly pair
+// a column below 1 with one above 1 that tops it up.
+void CsrGraphShard::build_alias(int64_t row) {
+  int n = degree(row);
+  uint64_t base = _offsets[row];
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += _weights[base + i];
+  }
+  std::vector<double> scaled(n);
+  std::vector<uint32_t> small, large;
+  for (int i = 0; i < n; ++i) {
+    scaled[i] = sum > 0 ? _weights[base + i] * n / sum : 1.0;
+    _alias[base + i] = i;
+    if (scaled[i] < 1.0) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+  while (!small.empty() && !large.empty()) {
+    uint32_t s = small.back();
+    uint32_t l = large.back();
+    small.pop_back();
+    large.pop_back();
+    _alias_prob[base + s] = scaled[s];
+    _alias[base + s] = l;
+    scaled[l] = scaled[l] + scaled[s] - 1.0;
+    if (scaled[l] < 1.0) {
+      small.push_back(l);
+    } else {
+      large.push_back(l);
+    }
+  }
+  // left over columns are full up to rounding error
+  for (auto i : small) {
+    _alias_prob[base + i] = 1.0;
+  }
+  for (auto i : large) {
+    _alias_prob[base + i] = 1.0;
+  }
+}
+
+std::vector<int> CsrGraphShard::sample_k(int64_t row, int k,
+                                         std::mt19937_64 *rng) const {
+  int n = degree(row);
+  if (k >= n) {
+    std::vector<int> sample_result(n);
+    std::iota(sample_result.begin(), sample_result.end(), 0);
+    return sample_result;
+  }
+  if (k <= 0) {
+    return std::vector<int>();
+  }
+  return _is_weighted ? sample_weighted(row, k, rng)
+                      : sample_uniform(row, k, rng);
+}
+
+std::vector<int> CsrGraphShard::sample_uniform(int64_t row, int k,
+                                               std::mt19937_64 *rng) const {
+  int n = degree(row);
+  std::vector<int> sample_result;
+  sample_result.reserve(k);
+  if (k <= kSmallSample && 2 * k <= n) {
+    std::uniform_int_distribution<int> distrib(0, n - 1);
+    while (static_cast<int>(sample_result.size()) < k) {
+      int x = distrib(*rng);
+      if (std::find(sample_result.begin(), sample_result.end(), x) ==
+          sample_result.end()) {
+        sample_result.push_back(x);
+      }
+    }
+    return sample_result;
+  }
+  // partial Fisher-Yates
+  thread_local std::vector<int> perm;
+  perm.resize(n);
+  std::iota(perm.begin(), perm.end(), 0);
+  for (int i = 0; i < k; ++i) {
+    std::uniform_int_distribution<int> distrib(i, n - 1);
+    std::swap(perm[i], perm[distrib(*rng)]);
+  }
+  sample_result.assign(perm.begin(), perm.begin() + k);
+  return sample_result;
+}
+
+// Drawing from the alias table and rejecting neighbors already taken picks
+// each next neighbor with probability proportional to the remaining weight,
+// the same distribution as WeightedSampler. The exact method only takes over
+// when rejections pile up, which happens when the taken neighbors hold most
+// of the weight.
+std::vector<int> CsrGraphShard::sample_weighted(int64_t row, int k,
+                                                std::mt19937_64 *rng) const {
+  int n = degree(row);
+  uint64_t base = _offsets[row];
+  std::vector<int> sample_result;
+  sample_result.reserve(k);
+  if (k > kSmallSample) {
+    sample_weighted_exact(row, k, rng, &sample_result);
+    return sample_result;
+  }
+  std::uniform_int_distribution<int> column(0, n - 1);
+  std::uniform_real_distribution<float> coin(0, 1.0);
+  while (static_cast<int>(sample_result.size()) < k) {
+    bool found = false;
+    for (int attempt = 0; attempt < kMaxRejections; ++attempt) {
+      int x = column(*rng);
+      if (coin(*rng) >= _alias_prob[base + x]) {
+        x = _alias[base + x];
+      }
+      if (std::find(sample_result.begin(), sample_result.end(), x) ==
+          sample_result.end()) {
+        sample_result.push_back(x);
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      sample_weighted_exact(row, k - sample_result.size(), rng,
+                            &sample_result);
+      break;
+    }
+  }
+  return sample_result;
+}
+
+// Efraimidis-Spirakis: the k largest keys log(u) / w are a weighted sample
+// without replacement.
+void CsrGraphShard::sample_weighted_exact(int64_t row, int k,
+                                          std::mt19937_64 *rng,
+                                          std::vector<int> *res) const {
+  int n = degree(row);
+  uint64_t base = _offsets[row];
+  std::vector<int> taken(*res);
+  std::sort(taken.begin(), taken.end());
+  thread_local std::vector<std::pair<double, int>> keys;
+  keys.clear();
+  std::uniform_real_distribution<double> distrib(0, 1.0);
+  for (int i = 0; i < n; ++i) {
+    if (std::binary_search(taken.begin(), taken.end(), i)) {
+      continue;
+    }
+    double w = _weights[base + i];
+    double key = w > 0 ? std::log(1.0 - distrib(*rng)) / w
+                       : -std::numeric_limits<double>::infinity();
+    keys.emplace_back(key, i);
+  }
+  k = std::min<int>(k, keys.size());
+  std::nth_element(keys.begin(), keys.begin() + k, keys.end(),
+                   [](const std::pair<double, int> &a,
+                      const std::pair<double, int> &b) {
+                     return a.first > b.first;
+                   });
+  for (int i = 0; i < k; ++i) {
+    res->push_back(keys[i].second);
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,92 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+struct CsrEdge {
+  uint64_t src;
+  uint64_t dst;
+  float weight;
+};
+
+// Edges of one graph shard in compressed sparse row form: sorted source ids,
+// the offset of each source's neighbors, and the neighbor ids and weights in
+// flat arrays. Each weighted row also has a Vose alias table, so a weighted
+// draw is O(1) instead of a walk down WeightedSampler's tree. The shard is
+// read only once built; sample_k may be called from many threads.
+class CsrGraphShard {
+ public:
+  CsrGraphShard() : _is_weighted(false) {}
+
+  // Replaces the content with edges, which are consumed. The edges of one
+  // source keep their relative order, so neighbor indices follow the load
+  // order as in GraphEdgeBlob.
+  void build(std::vector<CsrEdge> *edges, bool is_weighted);
+  // Appends the current edges to edges, to rebuild with more of them.
+  void dump_edges(std::vector<CsrEdge> *edges) const;
+  // Drops the edges of ids, so a removed node added again starts without
+  // them. O(edge_num), removals should be batched.
+  void remove_nodes(std::vector<uint64_t> ids);
+  void clear();
+
+  size_t node_num() const { return _ids.size(); }
+  size_t edge_num() const { return _neighbors.size(); }
+  bool is_weighted() const { return _is_weighted; }
+  size_t memory_usage() const;
+
+  // row of id, or -1 if id has no edges here
+  int64_t find(uint64_t id) const;
+  int degree(int64_t row) const {
+    return static_cast<int>(_offsets[row + 1] - _offsets[row]);
+  }
+  uint64_t neighbor_id(int64_t row, int idx) const {
+    return _neighbors[_offsets[row] + idx];
+  }
+  float neighbor_weight(int64_t row, int idx) const {
+    return _is_weighted ? _weights[_offsets[row] + idx] : 1.0;
+  }
+
+  // Same contract as Sampler::sample_k: min(k, degree) distinct neighbor
+  // indices of row, weighted rows drawn without replacement with
+  // probability proportional to the remaining weight.
+  std::vector<int> sample_k(int64_t row, int k, std::mt19937_64 *rng) const;
+
+ private:
+  void build_alias(int64_t row);
+  std::vector<int> sample_uniform(int64_t row, int k,
+                                  std::mt19937_64 *rng) const;
+  std::vector<int> sample_weighted(int64_t row, int k,
+                                   std::mt19937_64 *rng) const;
+  // exact weighted sampling of k more indices not in res, O(degree)
+  void sample_weighted_exact(int64_t row, int k, std::mt19937_64 *rng,
+                             std::vector<int> *res) const;
+
+  bool _is_weighted;
+  std::vector<uint64_t> _ids;
+  std::vector<uint64_t> _offsets;
+  std::vector<uint64_t> _neighbors;
+  std::vector<float> _weights;
+  // alias table, indexed like _neighbors; _alias holds row-local indices
+  std::vector<float> _alias_prob;
+  std::vector<uint32_t> _alias;
+};
+
+}  // namespace distributed
+}  // namespace paddle
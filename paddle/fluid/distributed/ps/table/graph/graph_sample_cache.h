@@ -0,0 +1,192 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+struct SampleCacheStat {
+  size_t hit = 0;
+  size_t miss = 0;
+  size_t evict = 0;
+  size_t expire = 0;
+  size_t reject = 0;
+  size_t entries = 0;
+  size_t bytes = 0;
+};
+
+// Cache of neighbor samples. Keys hash to one of stripe_num buckets, each
+// with its own lock, so threads serving different nodes rarely meet. A
+// bucket keeps its entries in a ring swept by a CLOCK hand: a hit only sets
+// the entry's reference bit, and eviction skips (and clears) referenced
+// entries, which approximates LRU without touching a list on every read.
+// An entry is returned ttl times and dropped on the read that uses it up.
+// Each bucket holds at most size_limit / stripe_num entries and, when
+// byte_limit is not 0, byte_limit / stripe_num bytes as told by
+// ValueBytes; values larger than an eighth of that are not admitted.
+template <typename K, typename V, typename ValueBytes>
+class GraphSampleCache {
+ public:
+  GraphSampleCache(size_t size_limit, size_t byte_limit, size_t ttl,
+                   size_t stripe_num)
+      : _ttl(std::max<size_t>(ttl, 1)),
+        _stripes(std::max<size_t>(stripe_num, 1)) {
+    _entry_limit = std::max<size_t>(size_limit / _stripes.size(), 1);
+    _byte_limit = byte_limit / _stripes.size();
+  }
+
+  // appends (key, value) for the keys that hit, in the order of keys
+  void query(const K *keys, size_t length, std::vector<std::pair<K, V>> &res) {
+    for (size_t i = 0; i < length; i++) {
+      Stripe &stripe = stripe_of(keys[i]);
+      std::lock_guard<std::mutex> lock(stripe.mutex);
+      auto iter = stripe.index.find(keys[i]);
+      if (iter == stripe.index.end()) {
+        stripe.stat.miss++;
+        continue;
+      }
+      stripe.stat.hit++;
+      Entry &entry = stripe.slots[iter->second];
+      res.emplace_back(keys[i], entry.value);
+      if (--entry.ttl == 0) {
+        stripe.stat.expire++;
+        erase(&stripe, iter->second);
+      } else {
+        entry.referenced = true;
+      }
+    }
+  }
+
+  // replaces the value and ttl of keys already cached
+  void insert(const K *keys, const V *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      size_t bytes = ValueBytes()(data[i]);
+      Stripe &stripe = stripe_of(keys[i]);
+      std::lock_guard<std::mutex> lock(stripe.mutex);
+      auto iter = stripe.index.find(keys[i]);
+      if (iter != stripe.index.end()) {
+        erase(&stripe, iter->second);
+      }
+      if (_byte_limit != 0 && bytes * 8 > _byte_limit) {
+        stripe.stat.reject++;
+        continue;
+      }
+      while (stripe.index.size() >= _entry_limit ||
+             (_byte_limit != 0 && stripe.stat.bytes + bytes > _byte_limit)) {
+        evict(&stripe);
+      }
+      uint32_t slot;
+      if (!stripe.free_slots.empty()) {
+        slot = stripe.free_slots.back();
+        stripe.free_slots.pop_back();
+      } else {
+        slot = stripe.slots.size();
+        stripe.slots.emplace_back();
+      }
+      Entry &entry = stripe.slots[slot];
+      entry.key = keys[i];
+      entry.value = data[i];
+      entry.ttl = _ttl;
+      entry.bytes = bytes;
+      entry.used = true;
+      entry.referenced = false;
+      stripe.index[keys[i]] = slot;
+      stripe.stat.bytes += bytes;
+    }
+  }
+
+  size_t get_ttl() const { return _ttl; }
+
+  SampleCacheStat get_stat() {
+    SampleCacheStat res;
+    for (auto &stripe : _stripes) {
+      std::lock_guard<std::mutex> lock(stripe.mutex);
+      res.hit += stripe.stat.hit;
+      res.miss += stripe.stat.miss;
+      res.evict += stripe.stat.evict;
+      res.expire += stripe.stat.expire;
+      res.reject += stripe.stat.reject;
+      res.entries += stripe.index.size();
+      res.bytes += stripe.stat.bytes;
+    }
+    return res;
+  }
+
+ private:
+  struct Entry {
+    K key;
+    V value;
+    size_t ttl = 0;
+    size_t bytes = 0;
+    bool used = false;
+    bool referenced = false;
+  };
+
+  struct Stripe {
+    std::mutex mutex;
+    std::unordered_map<K, uint32_t> index;
+    std::vector<Entry> slots;
+    std::vector<uint32_t> free_slots;
+    size_t hand = 0;
+    SampleCacheStat stat;
+  };
+
+  Stripe &stripe_of(const K &key) {
+    // std::hash of an integer is often the integer itself, mix it
+    uint64_t h = std::hash<K>()(key) * 0x9E3779B97F4A7C15ULL;
+    return _stripes[(h >> 32) % _stripes.size()];
+  }
+
+  void erase(Stripe *stripe, uint32_t slot) {
+    Entry &entry = stripe->slots[slot];
+    stripe->index.erase(entry.key);
+    stripe->stat.bytes -= entry.bytes;
+    entry.value = V();
+    entry.used = false;
+    stripe->free_slots.push_back(slot);
+  }
+
+  void evict(Stripe *stripe) {
+    while (true) {
+      uint32_t slot = stripe->hand;
+      stripe->hand = (stripe->hand + 1) % stripe->slots.size();
+      Entry &entry = stripe->slots[slot];
+      if (!entry.used) continue;
+      if (entry.referenced) {
+        entry.referenced = false;
+        continue;
+      }
+      stripe->stat.evict++;
+      erase(stripe, slot);
+      return;
+    }
+  }
+
+  size_t _ttl;
+  size_t _entry_limit;
+  size_t _byte_limit;
+  std::vector<Stripe> _stripes;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,206 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_subgraph.h"
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+namespace paddle {
+namespace distributed {
+
+int32_t GraphSubgraph::sample(const std::vector<uint64_t> &seeds,
+                              const std::vector<int> &fanouts,
+                              bool need_weight,
+                              const GraphHopSampleFunc &sample_func) {
+  clear();
+  std::unordered_map<uint64_t, int32_t> node_index;
+  auto index_of = [&](uint64_t id) -> int32_t {
+    auto iter = node_index.find(id);
+    if (iter != node_index.end()) {
+      return iter->second;
+    }
+    int32_t index = nodes.size();
+    node_index[id] = index;
+    nodes.push_back(id);
+    return index;
+  };
+
+  std::vector<uint64_t> frontier_ids(seeds);
+  std::vector<int32_t> frontier;
+  for (auto id : seeds) {
+    frontier.push_back(index_of(id));
+  }
+  for (size_t hop = 0; hop < fanouts.size(); ++hop) {
+    std::vector<std::vector<uint64_t>> res;
+    std::vector<std::vector<float>> res_weight;
+    int32_t ret =
+        sample_func(hop, frontier_ids, fanouts[hop], res, res_weight);
+    if (ret != 0) {
+      return ret;
+    }
+    res.resize(frontier_ids.size());
+    if (need_weight) {
+      res_weight.resize(frontier_ids.size());
+    }
+
+    std::vector<int64_t> hop_offsets(1, 0);
+    std::vector<int32_t> hop_neighbors;
+    std::vector<float> hop_weights;
+    // the next frontier are the distinct neighbors of this hop
+    std::vector<bool> in_next(nodes.size(), false);
+    std::vector<uint64_t> next_ids;
+    std::vector<int32_t> next;
+    for (size_t i = 0; i < res.size(); ++i) {
+      for (size_t j = 0; j < res[i].size(); ++j) {
+        int32_t index = index_of(res[i][j]);
+        hop_neighbors.push_back(index);
+        if (need_weight) {
+          hop_weights.push_back(j < res_weight[i].size() ? res_weight[i][j]
+                                                         : 1.0);
+        }
+        if (index >= static_cast<int32_t>(in_next.size())) {
+          in_next.resize(index + 1, false);
+        }
+        if (!in_next[index]) {
+          in_next[index] = true;
+          next_ids.push_back(res[i][j]);
+          next.push_back(index);
+        }
+      }
+      hop_offsets.push_back(hop_neighbors.size());
+    }
+    frontiers.push_back(std::move(frontier));
+    offsets.push_back(std::move(hop_offsets));
+    neighbors.push_back(std::move(hop_neighbors));
+    weights.push_back(std::move(hop_weights));
+    frontier = std::move(next);
+    frontier_ids = std::move(next_ids);
+  }
+  return 0;
+}
+
+void GraphSubgraph::clear() {
+  nodes.clear();
+  frontiers.clear();
+  offsets.clear();
+  neighbors.clear();
+  weights.clear();
+  features.clear();
+}
+
+template <typename T>
+static int vector_size(const std::vector<T> &v) {
+  return sizeof(size_t) + v.size() * sizeof(T);
+}
+
+template <typename T>
+static char *write_vector(char *buffer, const std::vector<T> &v) {
+  size_t num = v.size();
+  memcpy(buffer, &num, sizeof(size_t));
+  buffer += sizeof(size_t);
+  if (num != 0) {
+    memcpy(buffer, v.data(), num * sizeof(T));
+  }
+  return buffer + num * sizeof(T);
+}
+
+template <typename T>
+static const char *read_vector(const char *buffer, std::vector<T> *v) {
+  size_t num;
+  memcpy(&num, buffer, sizeof(size_t));
+  buffer += sizeof(size_t);
+  v->resize(num);
+  if (num != 0) {
+    memcpy(v->data(), buffer, num * sizeof(T));
+  }
+  return buffer + num * sizeof(T);
+}
+
+int GraphSubgraph::get_size() const {
+  int size = vector_size(nodes) + 2 * sizeof(size_t);  // hop_num, feat_num
+  for (size_t hop = 0; hop < hop_num(); ++hop) {
+    size += vector_size(frontiers[hop]) + vector_size(offsets[hop]) +
+            vector_size(neighbors[hop]) + vector_size(weights[hop]);
+  }
+  for (auto &feat : features) {
+    size += sizeof(size_t);
+    for (auto &value : feat) {
+      size += sizeof(size_t) + value.size();
+    }
+  }
+  return size;
+}
+
+void GraphSubgraph::to_buffer(char *buffer) const {
+  buffer = write_vector(buffer, nodes);
+  size_t num = hop_num();
+  memcpy(buffer, &num, sizeof(size_t));
+  buffer += sizeof(size_t);
+  for (size_t hop = 0; hop < num; ++hop) {
+    buffer = write_vector(buffer, frontiers[hop]);
+    buffer = write_vector(buffer, offsets[hop]);
+    buffer = write_vector(buffer, neighbors[hop]);
+    buffer = write_vector(buffer, weights[hop]);
+  }
+  num = features.size();
+  memcpy(buffer, &num, sizeof(size_t));
+  buffer += sizeof(size_t);
+  for (auto &feat : features) {
+    num = feat.size();
+    memcpy(buffer, &num, sizeof(size_t));
+    buffer += sizeof(size_t);
+    for (auto &value : feat) {
+      num = value.size();
+      memcpy(buffer, &num, sizeof(size_t));
+      buffer += sizeof(size_t);
+      memcpy(buffer, value.data(), num);
+      buffer += num;
+    }
+  }
+}
+
+void GraphSubgraph::recover_from_buffer(const char *buffer) {
+  clear();
+  buffer = read_vector(buffer, &nodes);
+  size_t num;
+  memcpy(&num, buffer, sizeof(size_t));
+  buffer += sizeof(size_t);
+  frontiers.resize(num);
+  offsets.resize(num);
+  neighbors.resize(num);
+  weights.resize(num);
+  for (size_t hop = 0; hop < num; ++hop) {
+    buffer = read_vector(buffer, &frontiers[hop]);
+    buffer = read_vector(buffer, &offsets[hop]);
+    buffer = read_vector(buffer, &neighbors[hop]);
+    buffer = read_vector(buffer, &weights[hop]);
+  }
+  memcpy(&num, buffer, sizeof(size_t));
+  buffer += sizeof(size_t);
+  features.resize(num);
+  for (auto &feat : features) {
+    memcpy(&num, buffer, sizeof(size_t));
+    buffer += sizeof(size_t);
+    feat.resize(num);
+    for (auto &value : feat) {
+      memcpy(&num, buffer, sizeof(size_t));
+      buffer += sizeof(size_t);
+      value.assign(buffer, num);
+      buffer += num;
+    }
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+// Samples the neighbors of frontier for one hop: res[i] and, when weights
+// are requested, res_weight[i] belong to frontier[i].
+typedef std::function<int32_t(
+    size_t hop, const std::vector<uint64_t> &frontier, int sample_size,
+    std::vector<std::vector<uint64_t>> &res,
+    std::vector<std::vector<float>> &res_weight)>
+    GraphHopSampleFunc;
+
+// Result of a multi-hop neighbor sampling, packed so the whole minibatch
+// travels in one response. All node references are indices into nodes.
+class GraphSubgraph {
+ public:
+  // Samples fanouts[h] neighbors of every frontier node in hop h. The
+  // frontier of hop 0 is seeds as given, the frontier of hop h + 1 the
+  // distinct neighbors sampled in hop h.
+  int32_t sample(const std::vector<uint64_t> &seeds,
+                 const std::vector<int> &fanouts, bool need_weight,
+                 const GraphHopSampleFunc &sample_func);
+  void clear();
+
+  size_t hop_num() const { return frontiers.size(); }
+  int get_size() const;
+  void to_buffer(char *buffer) const;
+  void recover_from_buffer(const char *buffer);
+
+  // distinct nodes, seeds first, then in the order they were sampled
+  std::vector<uint64_t> nodes;
+  // hop h: the neighbors of frontiers[h][i] are
+  // neighbors[h][offsets[h][i] .. offsets[h][i + 1]), with weights[h]
+  // alongside them if weights were requested
+  std::vector<std::vector<int32_t>> frontiers;
+  std::vector<std::vector<int64_t>> offsets;
+  std::vector<std::vector<int32_t>> neighbors;
+  std::vector<std::vector<float>> weights;
+  // features[f][i] is feature f of nodes[i], if features were requested
+  std::vector<std::vector<std::string>> features;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -12,7 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <fcntl.h>
 #include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
 #include <sstream>
 
 #include "paddle/fluid/distributed/common/cost_timer.h"
@@ -30,6 +36,162 @@ namespace distributed {
 bool FLAGS_pserver_create_value_when_push = true;
 int FLAGS_pserver_table_save_max_retry = 3;
 bool FLAGS_pserver_enable_create_feasign_randomly = false;
+int FLAGS_pserver_sparse_prefetch_distance = 8;
+
+namespace {
+
+// Software pipeline over the keys routed to one shard task. All hashes are
+// computed up front; control group and slot lines are prefetched 2 * distance
+// keys ahead, and distance keys ahead the key is looked up and its value
+// prefetched. find(i) returns that lookup unless the shard changed since.
+class ShardPrefetcher {
+ public:
+  ShardPrefetcher(MemorySparseTable::shard_type* shard,
+                  const std::vector<std::pair<uint64_t, int>>& keys,
+                  size_t distance)
+      : _shard(shard),
+        _keys(keys),
+        _distance(distance),
+        _hashes(keys.size()),
+        _lookups(distance == 0 ? 0 : keys.size()) {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      _hashes[i] = shard->hash(keys[i].first);
+    }
+    size_t warmup = std::min(2 * distance, keys.size());
+    for (size_t i = 0; i < warmup; ++i) {
+      shard->prefetch(_hashes[i]);
+    }
+    size_t lookahead = std::min(distance, keys.size());
+    for (size_t i = 0; i < lookahead; ++i) {
+      lookup(i);
+    }
+  }
+
+  // called right before the i-th key is looked up
+  void advance(size_t i) {
+    if (_distance == 0) {
+      return;
+    }
+    if (i + 2 * _distance < _keys.size()) {
+      _shard->prefetch(_hashes[i + 2 * _distance]);
+    }
+    if (i + _distance < _keys.size()) {
+      lookup(i + _distance);
+    }
+  }
+
+  // The i-th key in the shard. An insertion may rehash the shard or add a
+  // key looked up as missing, so the early lookup is only kept while the
+  // size and capacity of the shard are those it was done at.
+  MemorySparseTable::shard_type::iterator find(size_t i) {
+    if (_distance != 0) {
+      const Lookup& lookup = _lookups[i];
+      if (lookup.size == _shard->size() &&
+          lookup.capacity == _shard->capacity()) {
+        return lookup.it;
+      }
+    }
+    return _shard->find_with_hash(_keys[i].first, _hashes[i]);
+  }
+
+ private:
+  struct Lookup {
+    MemorySparseTable::shard_type::iterator it;
+    size_t size;
+    size_t capacity;
+  };
+
+  void lookup(size_t i) {
+    Lookup& lookup = _lookups[i];
+    lookup.it = _shard->find_with_hash(_keys[i].first, _hashes[i]);
+    lookup.size = _shard->size();
+    lookup.capacity = _shard->capacity();
+    _shard->prefetch_value(lookup.it);
+  }
+
+  MemorySparseTable::shard_type* _shard;
+  const std::vector<std::pair<uint64_t, int>>& _keys;
+  size_t _distance;
+  std::vector<size_t> _hashes;
+  std::vector<Lookup> _lookups;
+};
+
+// Layout of one binary shard file, every section 64-byte aligned:
+//   SparseCheckpointHeader
+//   uint64_t keys[key_num]                  ascending
+//   uint16_t sizes[key_num]                 used floats of each value
+//   float    values[key_num][value_dim]     zero padded to value_dim
+struct SparseCheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t value_dim;
+  uint32_t mf_dim;
+  uint32_t select_dim;
+  uint32_t update_dim;
+  uint32_t reserved;
+  uint64_t key_num;
+  uint64_t sizes_offset;
+  uint64_t values_offset;
+};
+
+const char kSparseCheckpointMagic[8] = {'P', 'D', 'S', 'P',
+                                        'A', 'R', 'S', 'E'};
+const uint32_t kSparseCheckpointVersion = 1;
+
+size_t align64(size_t n) { return (n + 63) & ~static_cast<size_t>(63); }
+
+bool write_all(FILE* fp, const void* data, size_t len) {
+  return len == 0 || fwrite(data, 1, len, fp) == len;
+}
+
+bool write_padding(FILE* fp, size_t written) {
+  static const char zeros[64] = {0};
+  return write_all(fp, zeros, align64(written) - written);
+}
+
+// The sections of a file of file_size bytes lie within it, in order, and
+// hold key_num records of value_dim floats.
+bool valid_checkpoint_layout(const SparseCheckpointHeader& header,
+                             uint64_t file_size, uint32_t value_dim) {
+  uint64_t keys_offset = align64(sizeof(header));
+  if (value_dim == 0 || header.values_offset > file_size ||
+      header.sizes_offset > header.values_offset ||
+      header.key_num > (file_size - header.values_offset) /
+                           (value_dim * sizeof(float))) {
+    return false;
+  }
+  // key_num is now below file_size / 4, nothing below can overflow
+  return keys_offset + header.key_num * sizeof(uint64_t) <=
+             header.sizes_offset &&
+         header.key_num * sizeof(uint16_t) <=
+             header.values_offset - header.sizes_offset;
+}
+
+// The binary checkpoint shares table_dir with the text one; its files, and
+// the .tmp files of an unfinished save, are not text shards.
+bool is_binary_checkpoint_file(const std::string& file) {
+  std::string suffix = PSERVER_BINARY_SAVE_SUFFIX;
+  for (const std::string& end : {suffix, suffix + ".tmp"}) {
+    if (file.size() >= end.size() &&
+        file.compare(file.size() - end.size(), end.size(), end) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<std::string> text_checkpoint_files(
+    const std::vector<std::string>& files) {
+  std::vector<std::string> text_files;
+  for (auto& file : files) {
+    if (!is_binary_checkpoint_file(file)) {
+      text_files.push_back(file);
+    }
+  }
+  return text_files;
+}
+
+}  // namespace
 
 int32_t MemorySparseTable::initialize() {
   _shards_task_pool.resize(_task_pool_size);
@@ -60,14 +222,34 @@ int32_t MemorySparseTable::initialize_value() {
           << " _real_local_shard_num: " << _real_local_shard_num;
 
   _local_shards.reset(new shard_type[_real_local_shard_num]);
+  size_t value_dim = _value_accesor->size() / sizeof(float);
+  for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    _local_shards[i].init(value_dim, _value_accesor->compress_dim());
+  }
 
   return 0;
 }
 
+FlatFeatureValue& MemorySparseTable::LoadValue(
+    shard_type* shard, uint64_t key, const char* str,
+    std::vector<float>* parse_buffer, std::vector<float>* stored_buffer) {
+  int parse_size = _value_accesor->parse_from_string(str, parse_buffer->data());
+  size_t size = _value_accesor->compress(parse_buffer->data(), parse_size,
+                                         stored_buffer->data());
+  // a key may already hold a value of another size, move it between slabs
+  // instead of resizing it in place
+  auto& value = shard->resize_value(shard->emplace(key, size).first, size);
+  memcpy(value.data(), stored_buffer->data(), size * sizeof(float));
+  return value;
+}
+
 int32_t MemorySparseTable::load(const std::string& path,
                                 const std::string& param) {
+  if (use_binary_checkpoint(path, param)) {
+    return load_local_fs_binary(path);
+  }
   std::string table_path = table_dir(path);
-  auto file_list = _afs_client.list(table_path);
+  auto file_list = text_checkpoint_files(_afs_client.list(table_path));
 
   std::sort(file_list.begin(), file_list.end());
   for (auto file : file_list) {
@@ -112,18 +294,17 @@ int32_t MemorySparseTable::load(const std::string& path,
       auto read_channel = _afs_client.open_r(channel_config, 0, &err_no);
       char* end = NULL;
       auto& shard = _local_shards[i];
+      std::vector<float> parse_buffer(feature_value_size);
+      std::vector<float> stored_buffer(feature_value_size);
       try {
         while (read_channel->read_line(line_data) == 0 &&
                line_data.size() > 1) {
           uint64_t key = std::strtoul(line_data.data(), &end, 10);
-          auto& value = shard[key];
-          value.resize(feature_value_size);
-          int parse_size =
-              _value_accesor->parse_from_string(++end, value.data());
-          value.resize(parse_size);
+          auto& value =
+              LoadValue(&shard, key, ++end, &parse_buffer, &stored_buffer);
 
           // for debug
-          for (int ii = 0; ii < parse_size; ++ii) {
+          for (size_t ii = 0; ii < value.size(); ++ii) {
             VLOG(2) << "MemorySparseTable::load key: " << key << " value " << ii
                     << ": " << value.data()[ii] << " local_shard: " << i;
           }
@@ -157,7 +338,8 @@ int32_t MemorySparseTable::load(const std::string& path,
 int32_t MemorySparseTable::load_local_fs(const std::string& path,
                                          const std::string& param) {
   std::string table_path = table_dir(path);
-  auto file_list = paddle::framework::localfs_list(table_path);
+  auto file_list =
+      text_checkpoint_files(paddle::framework::localfs_list(table_path));
 
   int load_param = atoi(param.c_str());
   auto expect_shard_num = _sparse_table_shard_num;
@@ -189,14 +371,12 @@ int32_t MemorySparseTable::load_local_fs(const std::string& path,
       std::ifstream file(file_list[file_start_idx + i]);
       char* end = NULL;
       auto& shard = _local_shards[i];
+      std::vector<float> parse_buffer(feature_value_size);
+      std::vector<float> stored_buffer(feature_value_size);
       try {
         while (std::getline(file, line_data) && line_data.size() > 1) {
           uint64_t key = std::strtoul(line_data.data(), &end, 10);
-          auto& value = shard[key];
-          value.resize(feature_value_size);
-          int parse_size =
-              _value_accesor->parse_from_string(++end, value.data());
-          value.resize(parse_size);
+          LoadValue(&shard, key, ++end, &parse_buffer, &stored_buffer);
         }
         file.close();
         if (err_no == -1) {
@@ -225,6 +405,12 @@ int32_t MemorySparseTable::load_local_fs(const std::string& path,
   return 0;
 }
 
+bool MemorySparseTable::use_binary_checkpoint(const std::string& path,
+                                              const std::string& param) {
+  return _config.binary_checkpoint() && atoi(param.c_str()) == 0 &&
+         paddle::framework::fs_select_internal(path) == 0;
+}
+
 int32_t MemorySparseTable::save(const std::string& dirname,
                                 const std::string& param) {
   VLOG(0) << "MemorySparseTable::save dirname: " << dirname;
@@ -233,6 +419,9 @@ int32_t MemorySparseTable::save(const std::string& dirname,
   std::string table_path = table_dir(dirname);
   _afs_client.remove(paddle::string::format_string(
       "%s/part-%03d-*", table_path.c_str(), _shard_idx));
+  if (use_binary_checkpoint(dirname, param)) {
+    return save_local_fs_binary(dirname, param, "binary");
+  }
   std::atomic<uint32_t> feasign_size_all{0};
 
   size_t file_start_idx = _avg_local_shard_num * _shard_idx;
@@ -259,6 +448,7 @@ int32_t MemorySparseTable::save(const std::string& dirname,
     int retry_num = 0;
     int err_no = 0;
     auto& shard = _local_shards[i];
+    std::vector<float> value_buffer(_value_accesor->size() / sizeof(float));
     do {
       err_no = 0;
       feasign_size = 0;
@@ -267,8 +457,10 @@ int32_t MemorySparseTable::save(const std::string& dirname,
           _afs_client.open_w(channel_config, 1024 * 1024 * 40, &err_no);
       for (auto it = shard.begin(); it != shard.end(); ++it) {
         if (_value_accesor->save(it.value().data(), save_param)) {
+          size_t value_size = _value_accesor->decompress(
+              it.value().data(), it.value().size(), value_buffer.data());
           std::string format_value = _value_accesor->parse_to_string(
-              it.value().data(), it.value().size());
+              value_buffer.data(), value_size);
           if (0 !=
               write_channel->write_line(paddle::string::format_string(
                   "%lu %s", it.key(), format_value.c_str()))) {
@@ -331,10 +523,13 @@ int32_t MemorySparseTable::save_local_fs(const std::string& dirname,
         file_start_idx + i);
     std::ofstream os;
     os.open(file_name);
+    std::vector<float> value_buffer(_value_accesor->size() / sizeof(float));
     for (auto it = shard.begin(); it != shard.end(); ++it) {
       if (_value_accesor->save(it.value().data(), save_param)) {
-        std::string format_value = _value_accesor->parse_to_string(
-            it.value().data(), it.value().size());
+        size_t value_size = _value_accesor->decompress(
+            it.value().data(), it.value().size(), value_buffer.data());
+        std::string format_value =
+            _value_accesor->parse_to_string(value_buffer.data(), value_size);
         std::string out_line = paddle::string::format_string(
             "%lu %s\n", it.key(), format_value.c_str());
         // VLOG(2) << out_line.c_str();
@@ -349,6 +544,214 @@ int32_t MemorySparseTable::save_local_fs(const std::string& dirname,
   return 0;
 }
 
+int32_t MemorySparseTable::save_local_fs_binary(const std::string& dirname,
+                                                const std::string& param,
+                                                const std::string& prefix) {
+  int save_param =
+      atoi(param.c_str());  // checkpoint:0  xbox delta:1  xbox base:2
+  std::string table_path = table_dir(dirname);
+  paddle::framework::localfs_mkdir(table_path);
+  size_t file_start_idx = _avg_local_shard_num * _shard_idx;
+
+  SparseCheckpointHeader header_tpl;
+  memset(&header_tpl, 0, sizeof(header_tpl));
+  memcpy(header_tpl.magic, kSparseCheckpointMagic, sizeof(header_tpl.magic));
+  header_tpl.version = kSparseCheckpointVersion;
+  header_tpl.value_dim = _value_accesor->size() / sizeof(float);
+  header_tpl.mf_dim = _value_accesor->mf_size() / sizeof(float);
+  header_tpl.select_dim = _value_accesor->select_size() / sizeof(float);
+  header_tpl.update_dim = _value_accesor->update_size() / sizeof(float);
+  const size_t value_dim = header_tpl.value_dim;
+
+  std::atomic<int> failed_num{0};
+  int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    auto& shard = _local_shards[i];
+    std::vector<std::pair<uint64_t, FlatFeatureValue*>> entries;
+    entries.reserve(shard.size());
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      if (_value_accesor->save(it.value().data(), save_param)) {
+        entries.emplace_back(it.key(), &it.value());
+      }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const std::pair<uint64_t, FlatFeatureValue*>& a,
+                 const std::pair<uint64_t, FlatFeatureValue*>& b) {
+                return a.first < b.first;
+              });
+
+    SparseCheckpointHeader header = header_tpl;
+    header.key_num = entries.size();
+    header.sizes_offset =
+        align64(align64(sizeof(header)) + entries.size() * sizeof(uint64_t));
+    header.values_offset =
+        align64(header.sizes_offset + entries.size() * sizeof(uint16_t));
+
+    std::vector<uint64_t> keys(entries.size());
+    std::vector<uint16_t> sizes(entries.size());
+    // values are saved expanded, so files do not depend on the compression
+    std::vector<float> value_buffer(value_dim);
+    for (size_t k = 0; k < entries.size(); ++k) {
+      keys[k] = entries[k].first;
+      sizes[k] = static_cast<uint16_t>(_value_accesor->decompress(
+          entries[k].second->data(), entries[k].second->size(),
+          value_buffer.data()));
+    }
+
+    std::string file_name = paddle::string::format_string(
+        "%s/part-%s-%03d-%05d%s", table_path.c_str(), prefix.c_str(),
+        _shard_idx, file_start_idx + i, PSERVER_BINARY_SAVE_SUFFIX);
+    std::string tmp_name = file_name + ".tmp";
+    FILE* fp = fopen(tmp_name.c_str(), "wb");
+    bool ok = fp != NULL;
+    ok = ok && write_all(fp, &header, sizeof(header)) &&
+         write_padding(fp, sizeof(header));
+    ok = ok && write_all(fp, keys.data(), keys.size() * sizeof(uint64_t)) &&
+         write_padding(fp, keys.size() * sizeof(uint64_t));
+    ok = ok && write_all(fp, sizes.data(), sizes.size() * sizeof(uint16_t)) &&
+         write_padding(fp, sizes.size() * sizeof(uint16_t));
+    // values go out through a bounded buffer of fixed-width records
+    const size_t batch_records = 4096;
+    std::vector<float> buffer(batch_records * value_dim);
+    for (size_t k = 0; ok && k < entries.size(); k += batch_records) {
+      size_t n = std::min(batch_records, entries.size() - k);
+      memset(buffer.data(), 0, n * value_dim * sizeof(float));
+      for (size_t r = 0; r < n; ++r) {
+        _value_accesor->decompress(entries[k + r].second->data(),
+                                   entries[k + r].second->size(),
+                                   buffer.data() + r * value_dim);
+      }
+      ok = write_all(fp, buffer.data(), n * value_dim * sizeof(float));
+    }
+    if (fp != NULL) {
+      ok = (fclose(fp) == 0) && ok;
+    }
+    if (ok && rename(tmp_name.c_str(), file_name.c_str()) == 0) {
+      LOG(INFO) << "MemorySparseTable save binary success, path:" << file_name
+                << " feasign_cnt: " << entries.size();
+    } else {
+      LOG(ERROR) << "MemorySparseTable save binary failed, path:"
+                 << file_name;
+      remove(tmp_name.c_str());
+      ++failed_num;
+    }
+  }
+  return failed_num == 0 ? 0 : -1;
+}
+
+int32_t MemorySparseTable::load_local_fs_binary(const std::string& path) {
+  std::string table_path = table_dir(path);
+  std::string suffix = PSERVER_BINARY_SAVE_SUFFIX;
+  std::vector<std::string> file_list;
+  for (auto& file : paddle::framework::localfs_list(table_path)) {
+    if (file.size() >= suffix.size() &&
+        file.compare(file.size() - suffix.size(), suffix.size(), suffix) ==
+            0) {
+      file_list.push_back(file);
+    }
+  }
+  std::sort(file_list.begin(), file_list.end());
+
+  auto expect_shard_num = _sparse_table_shard_num;
+  if (file_list.size() != expect_shard_num) {
+    LOG(WARNING) << "MemorySparseTable binary file_size:" << file_list.size()
+                 << " not equal to expect_shard_num:" << expect_shard_num;
+    return -1;
+  }
+
+  size_t file_start_idx = _shard_idx * _avg_local_shard_num;
+  const uint32_t value_dim = _value_accesor->size() / sizeof(float);
+  const uint32_t mf_dim = _value_accesor->mf_size() / sizeof(float);
+  const uint32_t select_dim = _value_accesor->select_size() / sizeof(float);
+  const uint32_t update_dim = _value_accesor->update_size() / sizeof(float);
+
+  std::atomic<int> failed_num{0};
+  int thread_num = _real_local_shard_num < 15 ? _real_local_shard_num : 15;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    const std::string& file_name = file_list[file_start_idx + i];
+    int fd = open(file_name.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(SparseCheckpointHeader)) {
+      LOG(ERROR) << "MemorySparseTable load binary failed to open "
+                 << file_name;
+      if (fd >= 0) {
+        close(fd);
+      }
+      ++failed_num;
+      continue;
+    }
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      LOG(ERROR) << "MemorySparseTable load binary failed to mmap "
+                 << file_name;
+      ++failed_num;
+      continue;
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    const char* base = reinterpret_cast<const char*>(addr);
+    const auto* header = reinterpret_cast<const SparseCheckpointHeader*>(base);
+    bool valid =
+        memcmp(header->magic, kSparseCheckpointMagic, sizeof(header->magic)) ==
+        0;
+    // a file saved with another embedx/select/update layout is rejected even
+    // when its value_dim happens to match
+    valid = valid && header->version == kSparseCheckpointVersion &&
+            header->value_dim == value_dim && header->mf_dim == mf_dim &&
+            header->select_dim == select_dim &&
+            header->update_dim == update_dim;
+    valid = valid && valid_checkpoint_layout(*header, st.st_size, value_dim);
+    const uint64_t* keys =
+        reinterpret_cast<const uint64_t*>(base + align64(sizeof(*header)));
+    const uint16_t* sizes =
+        reinterpret_cast<const uint16_t*>(base + header->sizes_offset);
+    // keys strictly ascending, so distinct, and values within value_dim
+    for (uint64_t k = 0; valid && k < header->key_num; ++k) {
+      valid = sizes[k] <= value_dim && (k == 0 || keys[k - 1] < keys[k]);
+    }
+    if (!valid) {
+      LOG(ERROR) << "MemorySparseTable load binary got a corrupted file or an "
+                 << "accessor layout mismatch, path:" << file_name
+                 << " value/mf/select/update dim: " << header->value_dim << "/"
+                 << header->mf_dim << "/" << header->select_dim << "/"
+                 << header->update_dim << " expect: " << value_dim << "/"
+                 << mf_dim << "/" << select_dim << "/" << update_dim;
+      munmap(addr, st.st_size);
+      ++failed_num;
+      continue;
+    }
+
+    const float* values =
+        reinterpret_cast<const float*>(base + header->values_offset);
+    auto& shard = _local_shards[i];
+    if (shard.empty()) {
+      shard.insert_unique(keys, header->key_num, sizes, values, value_dim);
+    } else {
+      // keys already in the shard are overwritten, as the text load does
+      shard.reserve(shard.size() + header->key_num);
+      for (uint64_t k = 0; k < header->key_num; ++k) {
+        auto& value = shard.resize_value(
+            shard.emplace(keys[k], sizes[k]).first, sizes[k]);
+        memcpy(value.data(), values + k * value_dim,
+               sizes[k] * sizeof(float));
+      }
+    }
+    munmap(addr, st.st_size);
+  }
+  if (failed_num != 0) {
+    return -1;
+  }
+  LOG(INFO) << "MemorySparseTable load binary success, path from "
+            << file_list[file_start_idx] << " to "
+            << file_list[file_start_idx + _real_local_shard_num - 1];
+  return 0;
+}
+
 int64_t MemorySparseTable::local_size() {
   int64_t local_size = 0;
   for (size_t i = 0; i < _real_local_shard_num; ++i) {
@@ -418,26 +821,28 @@ int32_t MemorySparseTable::pull_sparse(float* pull_values,
               float* data_buffer_ptr = data_buffer;
 
               auto& keys = task_keys[shard_id];
+              ShardPrefetcher prefetcher(
+                  &local_shard, keys, FLAGS_pserver_sparse_prefetch_distance);
               for (size_t i = 0; i < keys.size(); i++) {
                 uint64_t key = keys[i].first;
-                auto itr = local_shard.find(key);
+                prefetcher.advance(i);
+                auto itr = prefetcher.find(i);
                 size_t data_size = value_size - mf_value_size;
                 if (itr == local_shard.end()) {
                   // ++missed_keys;
                   if (FLAGS_pserver_create_value_when_push) {
                     memset(data_buffer, 0, sizeof(float) * data_size);
                   } else {
-                    auto& feature_value = local_shard[key];
-                    feature_value.resize(data_size);
+                    auto& feature_value =
+                        local_shard.emplace(key, data_size).first.value();
                     float* data_ptr = feature_value.data();
                     _value_accesor->create(&data_buffer_ptr, 1);
                     memcpy(data_ptr, data_buffer_ptr,
                            data_size * sizeof(float));
                   }
                 } else {
-                  data_size = itr.value().size();
-                  memcpy(data_buffer_ptr, itr.value().data(),
-                         data_size * sizeof(float));
+                  data_size = _value_accesor->decompress(
+                      itr.value().data(), itr.value().size(), data_buffer_ptr);
                 }
                 for (int mf_idx = data_size; mf_idx < value_size; ++mf_idx) {
                   data_buffer[mf_idx] = 0.0;
@@ -487,24 +892,25 @@ int32_t MemorySparseTable::push_sparse(const uint64_t* keys,
           auto& local_shard = _local_shards[shard_id];
           float data_buffer[value_col];  // NOLINT
           float* data_buffer_ptr = data_buffer;
+          ShardPrefetcher prefetcher(&local_shard, keys,
+                                     FLAGS_pserver_sparse_prefetch_distance);
           for (int i = 0; i < keys.size(); ++i) {
             uint64_t key = keys[i].first;
             uint64_t push_data_idx = keys[i].second;
+            prefetcher.advance(i);
             const float* update_data =
                 values + push_data_idx * update_value_col;
-            auto itr = local_shard.find(key);
+            auto itr = prefetcher.find(i);
             if (itr == local_shard.end()) {
               if (FLAGS_pserver_enable_create_feasign_randomly &&
                   !_value_accesor->create_value(1, update_data)) {
                 continue;
               }
               auto value_size = value_col - mf_value_col;
-              auto& feature_value = local_shard[key];
-              feature_value.resize(value_size);
+              itr = local_shard.emplace(key, value_size).first;
               _value_accesor->create(&data_buffer_ptr, 1);
-              memcpy(feature_value.data(), data_buffer_ptr,
+              memcpy(itr.value().data(), data_buffer_ptr,
                      value_size * sizeof(float));
-              itr = local_shard.find(key);
             }
 
             auto& feature_value = itr.value();
@@ -515,15 +921,23 @@ int32_t MemorySparseTable::push_sparse(const uint64_t* keys,
               _value_accesor->update(&value_data, &update_data, 1);
             } else {
               // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
-              memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+              value_size = _value_accesor->decompress(value_data, value_size,
+                                                      data_buffer_ptr);
               _value_accesor->update(&data_buffer_ptr, &update_data, 1);
 
-              if (_value_accesor->need_extend_mf(data_buffer)) {
-                feature_value.resize(value_col);
-                value_data = feature_value.data();
+              if (!_value_accesor->has_mf(value_size) &&
+                  _value_accesor->need_extend_mf(data_buffer)) {
+                value_data = local_shard.resize_value(itr, value_col).data();
                 _value_accesor->create(&value_data, 1);
+                memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+              } else if (_value_accesor->has_mf(value_size)) {
+                // 压缩存储的冷特征写入后以完整value存储, 避免每次update都
+                // 重新量化累积误差, 到shrink时再压缩
+                value_data = local_shard.resize_value(itr, value_col).data();
+                memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+              } else {
+                memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
               }
-              memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
             }
           }
           return 0;
@@ -564,23 +978,24 @@ int32_t MemorySparseTable::_push_sparse(const uint64_t* keys,
           auto& local_shard = _local_shards[shard_id];
           float data_buffer[value_col];  // NOLINT
           float* data_buffer_ptr = data_buffer;
+          ShardPrefetcher prefetcher(&local_shard, keys,
+                                     FLAGS_pserver_sparse_prefetch_distance);
           for (int i = 0; i < keys.size(); ++i) {
             uint64_t key = keys[i].first;
             uint64_t push_data_idx = keys[i].second;
+            prefetcher.advance(i);
             const float* update_data = values[push_data_idx];
-            auto itr = local_shard.find(key);
+            auto itr = prefetcher.find(i);
             if (itr == local_shard.end()) {
               if (FLAGS_pserver_enable_create_feasign_randomly &&
                   !_value_accesor->create_value(1, update_data)) {
                 continue;
               }
               auto value_size = value_col - mf_value_col;
-              auto& feature_value = local_shard[key];
-              feature_value.resize(value_size);
+              itr = local_shard.emplace(key, value_size).first;
               _value_accesor->create(&data_buffer_ptr, 1);
-              memcpy(feature_value.data(), data_buffer_ptr,
+              memcpy(itr.value().data(), data_buffer_ptr,
                      value_size * sizeof(float));
-              itr = local_shard.find(key);
             }
             auto& feature_value = itr.value();
             float* value_data = feature_value.data();
@@ -589,14 +1004,22 @@ int32_t MemorySparseTable::_push_sparse(const uint64_t* keys,
               _value_accesor->update(&value_data, &update_data, 1);
             } else {
               // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
-              memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+              value_size = _value_accesor->decompress(value_data, value_size,
+                                                      data_buffer_ptr);
               _value_accesor->update(&data_buffer_ptr, &update_data, 1);
-              if (_value_accesor->need_extend_mf(data_buffer)) {
-                feature_value.resize(value_col);
-                value_data = feature_value.data();
+              if (!_value_accesor->has_mf(value_size) &&
+                  _value_accesor->need_extend_mf(data_buffer)) {
+                value_data = local_shard.resize_value(itr, value_col).data();
                 _value_accesor->create(&value_data, 1);
+                memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+              } else if (_value_accesor->has_mf(value_size)) {
+                // 压缩存储的冷特征写入后以完整value存储, 避免每次update都
+                // 重新量化累积误差, 到shrink时再压缩
+                value_data = local_shard.resize_value(itr, value_col).data();
+                memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+              } else {
+                memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
               }
-              memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
             }
           }
           return 0;
@@ -614,15 +1037,32 @@ int32_t MemorySparseTable::flush() { return 0; }
 int32_t MemorySparseTable::shrink(const std::string& param) {
   VLOG(0) << "MemorySparseTable::shrink";
   // TODO(zhaocaibei123): implement with multi-thread
+  size_t value_col = _value_accesor->size() / sizeof(float);
+  std::vector<float> data_buffer(value_col);
+  std::vector<float> compress_buffer(value_col);
   for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
     // shrink
     auto& shard = _local_shards[shard_id];
     for (auto it = shard.begin(); it != shard.end();) {
       if (_value_accesor->shrink(it.value().data())) {
         it = shard.erase(it);
-      } else {
-        ++it;
+        continue;
+      }
+      // show/click decayed, features turning cold get compressed; values
+      // already compressed are left as they are
+      auto& value = it.value();
+      if (value.size() == value_col) {
+        size_t size = _value_accesor->decompress(value.data(), value.size(),
+                                                 data_buffer.data());
+        size = _value_accesor->compress(data_buffer.data(), size,
+                                        compress_buffer.data());
+        if (size != value.size()) {
+          auto& stored_value = shard.resize_value(it, size);
+          memcpy(stored_value.data(), compress_buffer.data(),
+                 size * sizeof(float));
+        }
       }
+      ++it;
     }
   }
   return 0;
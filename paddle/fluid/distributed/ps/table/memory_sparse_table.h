@@ -26,17 +26,18 @@
 #include "Eigen/Dense"
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
-#include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
+#include "paddle/fluid/distributed/ps/table/depends/flat_feature_value.h"
 #include "paddle/fluid/string/string_helper.h"
 
 #define PSERVER_SAVE_SUFFIX ".shard"
+#define PSERVER_BINARY_SAVE_SUFFIX ".bin"
 
 namespace paddle {
 namespace distributed {
 
 class MemorySparseTable : public SparseTable {
  public:
-  typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+  typedef FlatSparseTableShard<uint64_t> shard_type;
   MemorySparseTable() {}
   virtual ~MemorySparseTable() {}
 
@@ -60,6 +61,14 @@ class MemorySparseTable : public SparseTable {
   int32_t save_local_fs(const std::string& path, const std::string& param,
                         const std::string& prefix);
 
+  // binary per-shard checkpoint: sorted keys plus a fixed-width value block,
+  // loaded through mmap without text parsing. save and load use it for
+  // checkpoints on local paths when the table sets binary_checkpoint
+  int32_t load_local_fs_binary(const std::string& path);
+  int32_t save_local_fs_binary(const std::string& path,
+                               const std::string& param,
+                               const std::string& prefix);
+
   int64_t local_size();
   int64_t local_mf_size();
 
@@ -80,8 +89,15 @@ class MemorySparseTable : public SparseTable {
   virtual void clear();
 
  protected:
+  bool use_binary_checkpoint(const std::string& path,
+                             const std::string& param);
   virtual int32_t _push_sparse(const uint64_t* keys, const float** values,
                                size_t num);
+  // parse one text checkpoint value into shard, stored in the slab that
+  // fits its parsed (and, for cold features, compressed) size
+  FlatFeatureValue& LoadValue(shard_type* shard, uint64_t key,
+                              const char* str, std::vector<float>* parse_buffer,
+                              std::vector<float>* stored_buffer);
 
  protected:
   const int _task_pool_size = 24;
@@ -38,10 +38,7 @@ int32_t SparseGeoTable::pull_geo_param(const uint32_t trainer_id,
 
 int32_t SparseGeoTable::push_sparse(const uint64_t* keys, const float* values,
                                     size_t num) {
-  std::vector<uint64_t> ids;
-  ids.resize(num);
-  std::copy_n(keys, num, ids.begin());
-  geo_recorder->Update(ids);
+  geo_recorder->Update(keys, num);
   CommonSparseTable::push_sparse(keys, values, num);
   return 0;
 }
@@ -14,8 +14,12 @@
 
 #ifdef PADDLE_WITH_HETERPS
 #include "paddle/fluid/distributed/ps/table/ssd_sparse_table.h"
+#include <chrono>  // NOLINT
 
 DEFINE_string(rocksdb_path, "database", "path of sparse table rocksdb file");
+DEFINE_int64(ssd_sparse_table_hot_capacity, 0,
+             "max feasigns kept in memory per shard of SSDSparseTable, colder "
+             "ones are written back to rocksdb; 0 means unbounded");
 
 namespace paddle {
 namespace distributed {
@@ -58,9 +62,224 @@ int32_t SSDSparseTable::initialize() {
   initialize_recorder();
   _db = paddle::distributed::RocksDBHandler::GetInstance();
   _db->initialize(FLAGS_rocksdb_path, task_pool_size_);
+
+  _hot_policy.resize(task_pool_size_);
+  _evict_keys.resize(task_pool_size_);
+  _pending.resize(task_pool_size_);
+  for (int i = 0; i < task_pool_size_; ++i) {
+    _pending[i].reset(new PendingShard());
+    if (FLAGS_ssd_sparse_table_hot_capacity > 0) {
+      _hot_policy[i].reset(
+          new WTinyLfuPolicy<uint64_t>(FLAGS_ssd_sparse_table_hot_capacity));
+    }
+  }
+  _flush_pool.reset(new ::ThreadPool(1));
   return 0;
 }
 
+constexpr int SSDSparseTable::kDbExtraSize;
+
+void SSDSparseTable::SerializeValue(const VALUE* value, int value_size,
+                                    float* db_value) {
+  memcpy(db_value, value->data_.data(), sizeof(float) * value_size);
+  db_value[value_size] = value->count_;
+  db_value[value_size + 1] = value->unseen_days_;
+  db_value[value_size + 2] = value->is_entry_;
+  db_value[value_size + 3] = value->need_save_;
+}
+
+bool SSDSparseTable::DbNeedSave(const std::string& db_value, int value_size) {
+  if (db_value.size() < (value_size + kDbExtraSize) * sizeof(float)) {
+    return false;
+  }
+  return reinterpret_cast<const float*>(db_value.data())[value_size + 3] != 0;
+}
+
+VALUE* SSDSparseTable::RestoreValue(int shard_id, uint64_t feasign,
+                                    const std::string& db_value) {
+  auto& block = shard_values_[shard_id];
+  int value_size = block->value_length_;
+  const float* data = reinterpret_cast<const float*>(db_value.data());
+  VALUE* value = block->InitGet(feasign);
+  memcpy(value->data_.data(), data, value_size * sizeof(float));
+  // param, count, unseen_day
+  value->count_ = data[value_size];
+  value->unseen_days_ = data[value_size + 1];
+  value->is_entry_ = data[value_size + 2];
+  value->need_save_ = DbNeedSave(db_value, value_size);
+  return value;
+}
+
+void SSDSparseTable::FetchToMemory(int shard_id,
+                                   const std::vector<uint64_t>& feasigns) {
+  auto& block = shard_values_[shard_id];
+  auto& policy = _hot_policy[shard_id];
+  auto& pending = *_pending[shard_id];
+  auto* evicted = &_evict_keys[shard_id];
+
+  std::vector<uint64_t> db_feasigns;
+  for (auto feasign : feasigns) {
+    if (block->Find(feasign) != block->end()) {
+      ++_hot_hits;
+      if (policy) {
+        policy->touch(feasign);
+      }
+      continue;
+    }
+    ++_hot_misses;
+    {
+      // evicted but not yet written back, the buffered copy is the latest
+      std::lock_guard<std::mutex> lock(pending.mutex);
+      auto it = pending.values.find(feasign);
+      if (it != pending.values.end()) {
+        RestoreValue(shard_id, feasign, it->second.second);
+        pending.values.erase(it);
+        if (policy) {
+          policy->insert(feasign, evicted);
+        }
+        continue;
+      }
+    }
+    db_feasigns.push_back(feasign);
+  }
+  if (db_feasigns.empty()) {
+    return;
+  }
+
+  std::vector<std::pair<char*, int>> db_keys;
+  db_keys.reserve(db_feasigns.size());
+  for (auto& feasign : db_feasigns) {
+    db_keys.emplace_back(reinterpret_cast<char*>(&feasign), sizeof(uint64_t));
+  }
+  std::vector<std::string> db_values;
+  std::vector<bool> found;
+  _db->multi_get(shard_id, db_keys, &db_values, &found);
+  for (size_t i = 0; i < db_feasigns.size(); ++i) {
+    if (found[i]) {
+      ++_db_hits;
+      RestoreValue(shard_id, db_feasigns[i], db_values[i]);
+    } else {
+      block->InitGet(db_feasigns[i]);
+    }
+    if (policy) {
+      policy->insert(db_feasigns[i], evicted);
+    }
+  }
+}
+
+void SSDSparseTable::MakeResident(const uint64_t* keys, size_t num) {
+  std::vector<std::vector<uint64_t>> shard_keys(task_pool_size_);
+  for (size_t x = 0; x < num; ++x) {
+    shard_keys[keys[x] % task_pool_size_].push_back(keys[x]);
+  }
+  std::vector<std::future<int>> tasks(task_pool_size_);
+  for (int shard_id = 0; shard_id < task_pool_size_; ++shard_id) {
+    tasks[shard_id] = _shards_task_pool[shard_id]->enqueue(
+        [this, shard_id, &shard_keys]() -> int {
+          FetchToMemory(shard_id, shard_keys[shard_id]);
+          return 0;
+        });
+  }
+  for (size_t shard_id = 0; shard_id < tasks.size(); ++shard_id) {
+    tasks[shard_id].wait();
+  }
+}
+
+void SSDSparseTable::EvictOverflow(int shard_id) {
+  auto& keys = _evict_keys[shard_id];
+  if (keys.empty()) {
+    return;
+  }
+  auto& block = shard_values_[shard_id];
+  auto& pending = *_pending[shard_id];
+  int value_size = block->value_length_;
+  int db_size = kDbExtraSize + value_size;
+  uint64_t batch_id = ++_flush_batch_id;
+  auto batch =
+      std::make_shared<std::vector<std::pair<uint64_t, std::string>>>();
+  batch->reserve(keys.size());
+  {
+    std::lock_guard<std::mutex> lock(pending.mutex);
+    for (auto feasign : keys) {
+      auto iter = block->Find(feasign);
+      if (iter == block->end()) {
+        continue;
+      }
+      std::string data(db_size * sizeof(float), '\0');
+      SerializeValue(iter->second, value_size,
+                     reinterpret_cast<float*>(&data[0]));
+      pending.values[feasign] = {batch_id, data};
+      batch->emplace_back(feasign, std::move(data));
+      block->erase(feasign);
+    }
+  }
+  keys.clear();
+  if (batch->empty()) {
+    return;
+  }
+  _evictions += batch->size();
+  _pending_write_back += batch->size();
+
+  auto enqueue_time = std::chrono::steady_clock::now();
+  _flush_pool->enqueue([this, shard_id, batch_id, batch,
+                        enqueue_time]() -> int {
+    std::vector<std::pair<char*, int>> ssd_keys;
+    std::vector<std::pair<char*, int>> ssd_values;
+    ssd_keys.reserve(batch->size());
+    ssd_values.reserve(batch->size());
+    for (auto& kv : *batch) {
+      ssd_keys.emplace_back((char*)&kv.first, sizeof(uint64_t));  // NOLINT
+      ssd_values.emplace_back(const_cast<char*>(kv.second.data()),
+                              kv.second.size());
+    }
+    _db->put_batch(shard_id, ssd_keys, ssd_values, batch->size());
+
+    auto& pending = *_pending[shard_id];
+    {
+      std::lock_guard<std::mutex> lock(pending.mutex);
+      for (auto& kv : *batch) {
+        auto it = pending.values.find(kv.first);
+        if (it != pending.values.end() && it->second.first == batch_id) {
+          pending.values.erase(it);
+        }
+      }
+    }
+    _pending_write_back -= batch->size();
+    _flush_lag_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - enqueue_time)
+                        .count();
+    return 0;
+  });
+}
+
+int32_t SSDSparseTable::flush() {
+  std::vector<std::future<int>> tasks(task_pool_size_);
+  for (int shard_id = 0; shard_id < task_pool_size_; ++shard_id) {
+    tasks[shard_id] =
+        _shards_task_pool[shard_id]->enqueue([this, shard_id]() -> int {
+          EvictOverflow(shard_id);
+          return 0;
+        });
+  }
+  for (size_t shard_id = 0; shard_id < tasks.size(); ++shard_id) {
+    tasks[shard_id].wait();
+  }
+  // the write-back pool runs in order, so an empty task waits for the rest
+  _flush_pool->enqueue([]() -> int { return 0; }).wait();
+  return 0;
+}
+
+SSDSparseTable::TierStat SSDSparseTable::tier_stat() const {
+  TierStat stat;
+  stat.hot_hits = _hot_hits;
+  stat.hot_misses = _hot_misses;
+  stat.db_hits = _db_hits;
+  stat.evictions = _evictions;
+  stat.pending_write_back = _pending_write_back;
+  stat.flush_lag_us = _flush_lag_us;
+  return stat;
+}
+
 int32_t SSDSparseTable::pull_sparse(float* pull_values,
                                     const PullSparseValue& pull_value) {
   auto shard_num = task_pool_size_;
@@ -74,47 +293,24 @@ int32_t SSDSparseTable::pull_sparse(float* pull_values,
           std::vector<int> offsets;
           pull_value.Fission(shard_id, shard_num, &offsets);
 
+          std::vector<uint64_t> feasigns;
+          feasigns.reserve(offsets.size());
+          for (auto& offset : offsets) {
+            feasigns.push_back(pull_value.feasigns_[offset]);
+          }
+          FetchToMemory(shard_id, feasigns);
+
           for (auto& offset : offsets) {
             auto feasign = pull_value.feasigns_[offset];
-            auto frequencie = pull_value.frequencies_[offset];
-            float* embedding = nullptr;
-            auto iter = block->Find(feasign);
-            // in mem
-            if (iter == block->end()) {
-              embedding = iter->second->data_.data();
-              if (pull_value.is_training_) {
-                block->AttrUpdate(iter->second, frequencie);
-              }
-            } else {
-              // need create
-              std::string tmp_str("");
-              if (_db->get(shard_id, (char*)&feasign, sizeof(uint64_t),
-                           tmp_str) > 0) {
-                embedding = block->Init(feasign, true, frequencie);
-              } else {
-                // in db
-                int data_size = tmp_str.size() / sizeof(float);
-                int value_size = block->value_length_;
-                float* db_value = (float*)const_cast<char*>(tmp_str.c_str());
-                VALUE* value = block->InitGet(feasign);
-
-                // copy to mem
-                memcpy(value->data_.data(), db_value,
-                       value_size * sizeof(float));
-                embedding = db_value;
-
-                // param, count, unseen_day
-                value->count_ = db_value[value_size];
-                value->unseen_days_ = db_value[value_size + 1];
-                value->is_entry_ = db_value[value_size + 2];
-                if (pull_value.is_training_) {
-                  block->AttrUpdate(value, frequencie);
-                }
-              }
+            VALUE* value = block->GetValue(feasign);
+            if (pull_value.is_training_) {
+              block->AttrUpdate(value, pull_value.frequencies_[offset]);
             }
-            std::copy_n(embedding + param_offset_, param_dim_,
+            std::copy_n(value->data_.data() + param_offset_, param_dim_,
                         pull_values + param_dim_ * offset);
           }
+          // values are copied out, victims can leave memory now
+          EvictOverflow(shard_id);
           return 0;
         });
   }
@@ -144,37 +340,17 @@ int32_t SSDSparseTable::pull_sparse_ptr(char** pull_values,
           auto& block = shard_values_[shard_id];
           auto& offsets = offset_bucket[shard_id];
 
+          std::vector<uint64_t> feasigns;
+          feasigns.reserve(offsets.size());
           for (auto& offset : offsets) {
-            auto feasign = keys[offset];
-            auto iter = block->Find(feasign);
-            VALUE* value = nullptr;
-            // in mem
-            if (iter != block->end()) {
-              value = iter->second;
-            } else {
-              // need create
-              std::string tmp_str("");
-              if (_db->get(shard_id, (char*)&feasign, sizeof(uint64_t),
-                           tmp_str) > 0) {
-                value = block->InitGet(feasign);
-              } else {
-                // in db
-                int data_size = tmp_str.size() / sizeof(float);
-                int value_size = block->value_length_;
-                float* db_value = (float*)const_cast<char*>(tmp_str.c_str());
-                value = block->InitGet(feasign);
-
-                // copy to mem
-                memcpy(value->data_.data(), db_value,
-                       value_size * sizeof(float));
-
-                // param, count, unseen_day
-                value->count_ = db_value[value_size];
-                value->unseen_days_ = db_value[value_size + 1];
-                value->is_entry_ = db_value[value_size + 2];
-              }
-            }
-            pull_values[offset] = (char*)value;
+            feasigns.push_back(keys[offset]);
+          }
+          // no eviction here: the returned pointers are used by the caller
+          // until the next pull or update_table
+          FetchToMemory(shard_id, feasigns);
+
+          for (auto& offset : offsets) {
+            pull_values[offset] = (char*)block->GetValue(keys[offset]);
           }
           return 0;
         });
@@ -186,12 +362,27 @@ int32_t SSDSparseTable::pull_sparse_ptr(char** pull_values,
   return 0;
 }
 
+int32_t SSDSparseTable::_push_sparse(const uint64_t* keys,
+                                     const float* values, size_t num) {
+  // a feasign may have been written back between its pull and this push
+  MakeResident(keys, num);
+  return CommonSparseTable::_push_sparse(keys, values, num);
+}
+
+int32_t SSDSparseTable::_push_sparse(const uint64_t* keys,
+                                     const float** values, size_t num) {
+  MakeResident(keys, num);
+  return CommonSparseTable::_push_sparse(keys, values, num);
+}
+
 int32_t SSDSparseTable::shrink(const std::string& param) { return 0; }
 
 int32_t SSDSparseTable::update_table() {
+  // pending write-back batches must not land after the puts below
+  flush();
   int count = 0;
   int value_size = shard_values_[0]->value_length_;
-  int db_size = 3 + value_size;
+  int db_size = kDbExtraSize + value_size;
   float tmp_value[db_size];
 
   for (size_t i = 0; i < task_pool_size_; ++i) {
@@ -201,14 +392,14 @@ int32_t SSDSparseTable::update_table() {
       for (auto iter = table.begin(); iter != table.end();) {
         VALUE* value = iter->second;
         if (value->unseen_days_ >= 1) {
-          tmp_value[value_size] = value->count_;
-          tmp_value[value_size + 1] = value->unseen_days_;
-          tmp_value[value_size + 2] = value->is_entry_;
-          memcpy(tmp_value, value->data_.data(), sizeof(float) * value_size);
+          SerializeValue(value, value_size, tmp_value);
           _db->put(i, (char*)&(iter->first), sizeof(uint64_t), (char*)tmp_value,
                    db_size * sizeof(float));
           count++;
 
+          if (_hot_policy[i]) {
+            _hot_policy[i]->erase(iter->first);
+          }
           butil::return_object(iter->second);
           iter = table.erase(iter);
         } else {
@@ -218,7 +409,13 @@ int32_t SSDSparseTable::update_table() {
     }
     _db->flush(i);
   }
-  VLOG(1) << "Table>> update count: " << count;
+  auto stat = tier_stat();
+  VLOG(1) << "Table>> update count: " << count
+          << " hot_hits: " << stat.hot_hits
+          << " hot_misses: " << stat.hot_misses << " db_hits: " << stat.db_hits
+          << " evictions: " << stat.evictions
+          << " pending_write_back: " << stat.pending_write_back
+          << " flush_lag_us: " << stat.flush_lag_us;
   return 0;
 }
 
@@ -260,30 +457,51 @@ int64_t SSDSparseTable::SaveValueToText(std::ostream* os,
     }
   }
 
-  if (mode != 1) {
-    int value_size = block->value_length_;
-    auto* it = _db->get_iterator(shard_id);
-
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-      float* value = (float*)const_cast<char*>(it->value().data());
-      std::stringstream ss;
-      ss << *((uint64_t*)const_cast<char*>(it->key().data())) << "\t"
-         << value[value_size] << "\t" << value[value_size + 1] << "\t"
-         << value[value_size + 2] << "\t";
-      for (int i = 0; i < block->value_length_ - 1; i++) {
-        ss << std::to_string(value[i]) << ",";
-      }
-
-      ss << std::to_string(value[block->value_length_ - 1]);
-      ss << "\n";
-
-      os->write(ss.str().c_str(), sizeof(char) * ss.str().size());
+  // Like the rows in memory, a delta save only writes the rows of RocksDB
+  // trained since the last save. A row also in memory is saved from there,
+  // its copy in RocksDB is older.
+  int value_size = block->value_length_;
+  auto* it = _db->get_iterator(shard_id);
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    uint64_t id = *reinterpret_cast<const uint64_t*>(it->key().data());
+    if (block->Find(id) != block->end()) {
+      continue;
+    }
+    std::string db_value = it->value().ToString();
+    bool need_save = DbNeedSave(db_value, value_size);
+    if (mode == SaveMode::delta && !need_save) {
+      continue;
+    }
+    ++save_num;
+    const float* value = reinterpret_cast<const float*>(db_value.data());
+    std::stringstream ss;
+    ss << id << "\t" << value[value_size] << "\t" << value[value_size + 1]
+       << "\t" << value[value_size + 2] << "\t";
+    for (int i = 0; i < block->value_length_ - 1; i++) {
+      ss << std::to_string(value[i]) << ",";
+    }
+    ss << std::to_string(value[block->value_length_ - 1]);
+    ss << "\n";
+    os->write(ss.str().c_str(), sizeof(char) * ss.str().size());
+
+    if (need_save && (mode == SaveMode::base || mode == SaveMode::delta)) {
+      reinterpret_cast<float*>(&db_value[0])[value_size + 3] = 0;
+      _db->put(shard_id, it->key().data(), it->key().size(), db_value.data(),
+               db_value.size());
     }
   }
+  delete it;
 
   return save_num;
 }
 
+int32_t SSDSparseTable::save(const std::string& path,
+                             const std::string& param) {
+  // rows still in the write-back queue are neither in memory nor in RocksDB
+  flush();
+  return CommonSparseTable::save(path, param);
+}
+
 int32_t SSDSparseTable::load(const std::string& path,
                              const std::string& param) {
   rwlock_->WRLock();
@@ -305,7 +523,7 @@ int64_t SSDSparseTable::LoadFromText(
   std::string line;
 
   int value_size = shard_values_[0]->value_length_;
-  int db_size = 3 + value_size;
+  int db_size = kDbExtraSize + value_size;
   float tmp_value[db_size];
 
   while (std::getline(file, line)) {
@@ -342,16 +560,17 @@ int64_t SSDSparseTable::LoadFromText(
     VLOG(3) << "loading: " << id
             << "unseen day: " << value_instant->unseen_days_;
     if (value_instant->unseen_days_ >= 1) {
-      tmp_value[value_size] = value_instant->count_;
-      tmp_value[value_size + 1] = value_instant->unseen_days_;
-      tmp_value[value_size + 2] = value_instant->is_entry_;
-      memcpy(tmp_value, value_instant->data_.data(),
-             sizeof(float) * value_size);
+      SerializeValue(value_instant, value_size, tmp_value);
       _db->put(shard_id, (char*)&(id), sizeof(uint64_t), (char*)tmp_value,
                db_size * sizeof(float));
       block->erase(id);
+    } else if (_hot_policy[shard_id]) {
+      _hot_policy[shard_id]->insert(id, &_evict_keys[shard_id]);
     }
   }
+  for (int shard_id = 0; shard_id < local_shard_num; ++shard_id) {
+    EvictOverflow(shard_id);
+  }
 
   return 0;
 }
@@ -13,8 +13,12 @@
 // limitations under the License.
 
 #pragma once
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <unordered_map>
 #include "paddle/fluid/distributed/ps/table/common_sparse_table.h"
 #include "paddle/fluid/distributed/ps/table/depends/rocksdb_warpper.h"
+#include "paddle/fluid/distributed/ps/table/depends/tiny_lfu.h"
 #ifdef PADDLE_WITH_HETERPS
 namespace paddle {
 namespace distributed {
@@ -28,9 +32,12 @@ class SSDSparseTable : public CommonSparseTable {
   void SaveMetaToText(std::ostream* os, const CommonAccessorParameter& common,
                       const size_t shard_idx, const int64_t total);
 
-  int64_t SaveValueToText(std::ostream* os, std::shared_ptr<ValueBlock> block,
-                          std::shared_ptr<::ThreadPool> pool, const int mode,
-                          int shard_id);
+  // rows written back to RocksDB keep need_save_, so a delta save writes
+  // the trained ones wherever they are
+  virtual int64_t SaveValueToText(std::ostream* os,
+                                  std::shared_ptr<ValueBlock> block,
+                                  std::shared_ptr<::ThreadPool> pool,
+                                  const int mode, int shard_id) override;
 
   virtual int64_t LoadFromText(
       const std::string& valuepath, const std::string& metapath,
@@ -38,6 +45,8 @@ class SSDSparseTable : public CommonSparseTable {
       std::vector<std::shared_ptr<ValueBlock>>* blocks);
 
   virtual int32_t load(const std::string& path, const std::string& param);
+  virtual int32_t save(const std::string& path,
+                       const std::string& param) override;
 
   // exchange data
   virtual int32_t update_table();
@@ -47,13 +56,65 @@ class SSDSparseTable : public CommonSparseTable {
   virtual int32_t pull_sparse_ptr(char** pull_values, const uint64_t* keys,
                                   size_t num);
 
-  virtual int32_t flush() override { return 0; }
+  virtual int32_t flush() override;
   virtual int32_t shrink(const std::string& param) override;
   virtual void clear() override {}
 
+  // counters of the in-memory hot tier kept in front of RocksDB
+  struct TierStat {
+    uint64_t hot_hits;
+    uint64_t hot_misses;
+    uint64_t db_hits;
+    uint64_t evictions;
+    uint64_t pending_write_back;
+    uint64_t flush_lag_us;  // enqueue-to-durable time of the last batch
+  };
+  TierStat tier_stat() const;
+
+ protected:
+  virtual int32_t _push_sparse(const uint64_t* keys, const float* values,
+                               size_t num) override;
+  virtual int32_t _push_sparse(const uint64_t* keys, const float** values,
+                               size_t num) override;
+
  private:
+  // brings feasigns of one shard into memory, from the write-back buffer or
+  // with one RocksDB MultiGet, creating the ones found nowhere
+  void FetchToMemory(int shard_id, const std::vector<uint64_t>& feasigns);
+  void MakeResident(const uint64_t* keys, size_t num);
+  // moves the victims chosen by the admission policy to the write-back queue
+  void EvictOverflow(int shard_id);
+  // A RocksDB value is the floats of the value followed by count_,
+  // unseen_days_, is_entry_ and need_save_. Values written before need_save_
+  // was kept have no need_save_ and count as saved.
+  static constexpr int kDbExtraSize = 4;
+  static void SerializeValue(const VALUE* value, int value_size,
+                             float* db_value);
+  static bool DbNeedSave(const std::string& db_value, int value_size);
+  VALUE* RestoreValue(int shard_id, uint64_t feasign,
+                      const std::string& db_value);
+
+  struct PendingShard {
+    std::mutex mutex;
+    // feasign -> (write-back batch id, value serialized as in RocksDB)
+    std::unordered_map<uint64_t, std::pair<uint64_t, std::string>> values;
+  };
+
   RocksDBHandler* _db;
   int64_t _cache_tk_size;
+
+  std::vector<std::unique_ptr<WTinyLfuPolicy<uint64_t>>> _hot_policy;
+  std::vector<std::vector<uint64_t>> _evict_keys;
+  std::vector<std::unique_ptr<PendingShard>> _pending;
+  std::shared_ptr<::ThreadPool> _flush_pool;
+  std::atomic<uint64_t> _flush_batch_id{0};
+
+  std::atomic<uint64_t> _hot_hits{0};
+  std::atomic<uint64_t> _hot_misses{0};
+  std::atomic<uint64_t> _db_hits{0};
+  std::atomic<uint64_t> _evictions{0};
+  std::atomic<uint64_t> _pending_write_back{0};
+  std::atomic<uint64_t> _flush_lag_us{0};
 };
 
 }  // namespace ps
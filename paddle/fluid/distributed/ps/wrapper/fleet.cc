@@ -289,11 +289,8 @@ void FleetWrapper::PullSparseToTensorSync(const uint64_t table_id, int fea_dim,
     }
   }
   auto* communicator = Communicator::GetInstance();
-  auto status = communicator->_worker_ptr->pull_sparse(
-      pull_result_ptr.data(), table_id, fea_keys.data(), fea_keys.size(),
-      is_training);
-  status.wait();
-  auto ret = status.get();
+  auto ret = communicator->PullSparseCached(table_id, fea_dim, fea_keys,
+                                            pull_result_ptr, is_training);
   if (ret != 0) {
     LOG(ERROR) << "fleet pull sparse failed, status[" << ret << "]";
     sleep(sleep_seconds_before_fail_exit_);
@@ -555,6 +552,8 @@ void FleetWrapper::PushSparseFromTensorAsync(
       communicator->Check(table_id), true,
       platform::errors::InvalidArgument(
           "can not find table: %s, please check your config", table_id));
+  communicator->EmbeddingCacheNextStep(table_id);
+  communicator->InvalidateEmbeddingCache(table_id, push_keys);
   auto status = communicator->_worker_ptr->push_sparse(
       table_id, push_keys.data(), (const float**)push_g_vec.data(),
       push_keys.size());
@@ -0,0 +1,210 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/ps/service/brpc_ps_client.h"
+#include "paddle/fluid/distributed/ps/service/brpc_ps_server.h"
+#include "paddle/fluid/distributed/ps/service/env.h"
+#include "paddle/fluid/framework/program_desc.h"
+
+DECLARE_int32(pserver_pull_sparse_coalesce_us);
+
+namespace framework = paddle::framework;
+namespace distributed = paddle::distributed;
+
+void GetDownpourSparseTableProto(
+    ::paddle::distributed::TableParameter* sparse_table_proto) {
+  sparse_table_proto->set_table_id(0);
+  sparse_table_proto->set_table_class("CommonSparseTable");
+  sparse_table_proto->set_shard_num(256);
+  sparse_table_proto->set_type(::paddle::distributed::PS_SPARSE_TABLE);
+  ::paddle::distributed::TableAccessorParameter* accessor_proto =
+      sparse_table_proto->mutable_accessor();
+  ::paddle::distributed::CommonAccessorParameter* common_proto =
+      sparse_table_proto->mutable_common();
+
+  accessor_proto->set_accessor_class("CommMergeAccessor");
+  accessor_proto->set_fea_dim(0);
+  accessor_proto->set_embedx_dim(10);
+
+  common_proto->set_name("sgd");
+  common_proto->set_table_name("MergedDense");
+  common_proto->set_trainer_num(1);
+  common_proto->set_sync(false);
+  common_proto->set_entry("none");
+  common_proto->add_params("Param");
+  common_proto->add_dims(10);
+  common_proto->add_initializers("uniform_random&0&-1.0&1.0");
+  common_proto->add_params("LearningRate");
+  common_proto->add_dims(1);
+  common_proto->add_initializers("fill_constant&1.0");
+}
+
+void GetServerServiceProto(::paddle::distributed::PSParameter* fleet_desc) {
+  ::paddle::distributed::DownpourServerParameter* downpour_server_proto =
+      fleet_desc->mutable_server_param()->mutable_downpour_server_param();
+  ::paddle::distributed::ServerServiceParameter* server_service_proto =
+      downpour_server_proto->mutable_service_param();
+  server_service_proto->set_service_class("BrpcPsService");
+  server_service_proto->set_server_class("BrpcPsServer");
+  server_service_proto->set_client_class("BrpcPsClient");
+  server_service_proto->set_start_server_port(0);
+  server_service_proto->set_server_thread_num(12);
+  GetDownpourSparseTableProto(
+      downpour_server_proto->add_downpour_table_param());
+}
+
+/*-------------------------------------------------------------------------*/
+
+std::string ip_ = "127.0.0.1";
+uint32_t port_ = 4211;
+
+std::vector<std::string> host_sign_list_;
+
+std::shared_ptr<paddle::distributed::PSServer> pserver_ptr_;
+
+std::shared_ptr<paddle::distributed::PSClient> worker_ptr_;
+
+void RunServer() {
+  ::paddle::distributed::PSParameter server_proto;
+  GetServerServiceProto(&server_proto);
+
+  auto _ps_env = paddle::distributed::PaddlePSEnvironment();
+  _ps_env.set_ps_servers(&host_sign_list_, 1);
+  pserver_ptr_ = std::shared_ptr<paddle::distributed::PSServer>(
+      paddle::distributed::PSServerFactory::create(server_proto));
+  std::vector<framework::ProgramDesc> empty_vec;
+  framework::ProgramDesc empty_prog;
+  empty_vec.push_back(empty_prog);
+  pserver_ptr_->configure(server_proto, _ps_env, 0, empty_vec);
+  pserver_ptr_->start(ip_, port_);
+}
+
+void RunClient() {
+  ::paddle::distributed::PSParameter worker_proto;
+  GetDownpourSparseTableProto(worker_proto.mutable_worker_param()
+                                  ->mutable_downpour_worker_param()
+                                  ->add_downpour_table_param());
+  GetServerServiceProto(&worker_proto);
+  std::map<uint64_t, std::vector<paddle::distributed::Region>> dense_regions;
+  dense_regions.insert(
+      std::pair<uint64_t, std::vector<paddle::distributed::Region>>(0, {}));
+  paddle::distributed::PaddlePSEnvironment _ps_env;
+  _ps_env.set_ps_servers(&host_sign_list_, host_sign_list_.size());
+  worker_ptr_ = std::shared_ptr<paddle::distributed::PSClient>(
+      paddle::distributed::PSClientFactory::create(worker_proto));
+  worker_ptr_->configure(worker_proto, dense_regions, _ps_env, 0);
+}
+
+// Pulls batch_size keys drawn from a power law over key_num keys from
+// thread_num threads; returns the pull latencies in microseconds and
+// checks every pulled row against expected.
+std::vector<double> RunPulls(int thread_num, int pull_num, size_t batch_size,
+                             size_t key_num,
+                             const std::vector<float>& expected) {
+  std::vector<std::vector<double>> latencies(thread_num);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 rng(t);
+      std::uniform_real_distribution<double> uniform(0, 1);
+      std::vector<uint64_t> keys(batch_size);
+      std::vector<float> values(batch_size * 10);
+      std::vector<float*> value_ptrs(batch_size);
+      for (size_t i = 0; i < batch_size; ++i) {
+        value_ptrs[i] = values.data() + i * 10;
+      }
+      for (int n = 0; n < pull_num; ++n) {
+        for (auto& key : keys) {
+          key = static_cast<uint64_t>(std::pow(key_num, uniform(rng))) - 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto status = worker_ptr_->pull_sparse(value_ptrs.data(), 0,
+                                               keys.data(), batch_size, false);
+        ASSERT_EQ(status.get(), 0);
+        latencies[t].push_back(std::chrono::duration<double, std::micro>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count());
+        for (size_t i = 0; i < batch_size; ++i) {
+          for (size_t j = 0; j < 10; ++j) {
+            ASSERT_FLOAT_EQ(values[i * 10 + j], expected[keys[i] * 10 + j]);
+          }
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  std::vector<double> res;
+  for (auto& l : latencies) res.insert(res.end(), l.begin(), l.end());
+  return res;
+}
+
+void RunBrpcPullSparseCoalesce() {
+  setenv("http_proxy", "", 1);
+  setenv("https_proxy", "", 1);
+  auto ph_host = paddle::distributed::PSHost(ip_, port_, 0);
+  host_sign_list_.push_back(ph_host.serialize_to_string());
+
+  std::thread server_thread(RunServer);
+  sleep(1);
+  RunClient();
+
+  const size_t key_num = 100000;
+  std::vector<uint64_t> keys(key_num);
+  std::vector<float> expected(key_num * 10);
+  std::vector<float*> value_ptrs(key_num);
+  for (size_t i = 0; i < key_num; ++i) {
+    keys[i] = i;
+    value_ptrs[i] = expected.data() + i * 10;
+  }
+  auto init_status = worker_ptr_->pull_sparse(value_ptrs.data(), 0, keys.data(),
+                                              key_num, true);
+  ASSERT_EQ(init_status.get(), 0);
+
+  const int thread_num = 16, pull_num = 200;
+  const size_t batch_size = 512;
+  for (int coalesce_us : {0, 200}) {
+    FLAGS_pserver_pull_sparse_coalesce_us = coalesce_us;
+    auto start = std::chrono::steady_clock::now();
+    auto latencies =
+        RunPulls(thread_num, pull_num, batch_size, key_num, expected);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    std::sort(latencies.begin(), latencies.end());
+    LOG(INFO) << "pserver_pull_sparse_coalesce_us=" << coalesce_us << " "
+              << latencies.size() / seconds << " pulls/s, p50 "
+              << latencies[latencies.size() / 2] << " us, p99 "
+              << latencies[latencies.size() * 99 / 100] << " us";
+  }
+  FLAGS_pserver_pull_sparse_coalesce_us = 0;
+
+  LOG(INFO) << "Run stop_server";
+  worker_ptr_->stop_server();
+  LOG(INFO) << "Run finalize_worker";
+  worker_ptr_->finalize_worker();
+  server_thread.join();
+}
+
+TEST(RunBrpcPullSparseCoalesce, Run) { RunBrpcPullSparseCoalesce(); }
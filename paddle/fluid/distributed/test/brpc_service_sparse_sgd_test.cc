@@ -21,6 +21,7 @@ limitations under the License. */
 #include "paddle/fluid/distributed/ps/service/brpc_ps_client.h"
 #include "paddle/fluid/distributed/ps/service/brpc_ps_server.h"
 #include "paddle/fluid/distributed/ps/service/env.h"
+#include "paddle/fluid/distributed/ps/service/sparse_push_codec.h"
 #include "paddle/fluid/framework/program_desc.h"
 #include "paddle/fluid/operators/math/math_function.h"
 #include "paddle/fluid/platform/place.h"
@@ -63,8 +64,11 @@ void InitTensorsOnClient(framework::Scope* scope, platform::CPUPlace* place,
 }
 
 void GetDownpourSparseTableProto(
-    ::paddle::distributed::TableParameter* sparse_table_proto) {
-  sparse_table_proto->set_table_id(0);
+    ::paddle::distributed::TableParameter* sparse_table_proto,
+    uint64_t table_id = 0,
+    int sparse_push_codec = paddle::distributed::SPARSE_PUSH_RAW) {
+  sparse_table_proto->set_table_id(table_id);
+  sparse_table_proto->set_sparse_push_codec(sparse_push_codec);
   sparse_table_proto->set_table_class("CommonSparseTable");
   sparse_table_proto->set_shard_num(256);
   sparse_table_proto->set_type(::paddle::distributed::PS_SPARSE_TABLE);
@@ -108,6 +112,10 @@ void GetDownpourSparseTableProto(
   ::paddle::distributed::TableParameter* sparse_table_proto =
       downpour_server_proto->add_downpour_table_param();
   GetDownpourSparseTableProto(sparse_table_proto);
+  // table 1 is pushed packed as int8
+  GetDownpourSparseTableProto(
+      downpour_server_proto->add_downpour_table_param(), 1,
+      paddle::distributed::SPARSE_PUSH_PACKED_INT8);
   return server_fleet_desc;
 }
 
@@ -122,6 +130,10 @@ void GetDownpourSparseTableProto(
   ::paddle::distributed::TableParameter* worker_sparse_table_proto =
       downpour_worker_proto->add_downpour_table_param();
   GetDownpourSparseTableProto(worker_sparse_table_proto);
+  // table 1 is pushed packed as int8
+  GetDownpourSparseTableProto(
+      downpour_worker_proto->add_downpour_table_param(), 1,
+      paddle::distributed::SPARSE_PUSH_PACKED_INT8);
 
   ::paddle::distributed::ServerParameter* server_proto =
       worker_fleet_desc.mutable_server_param();
@@ -138,6 +150,10 @@ void GetDownpourSparseTableProto(
   ::paddle::distributed::TableParameter* server_sparse_table_proto =
       downpour_server_proto->add_downpour_table_param();
   GetDownpourSparseTableProto(server_sparse_table_proto);
+  // table 1 is pushed packed as int8
+  GetDownpourSparseTableProto(
+      downpour_server_proto->add_downpour_table_param(), 1,
+      paddle::distributed::SPARSE_PUSH_PACKED_INT8);
 
   return worker_fleet_desc;
 }
@@ -285,6 +301,40 @@ void RunBrpcPushSparse() {
     EXPECT_FLOAT_EQ(fea_temp_values[idx], fea_values[idx] - 1.0);
   }
 
+  /*-----------------------Test Push Packed Grad----------------------------*/
+
+  LOG(INFO) << "Run push_sparse_grad packed as int8";
+  EXPECT_EQ(worker_ptr_->sparse_push_codec(0),
+            paddle::distributed::SPARSE_PUSH_RAW);
+  EXPECT_EQ(worker_ptr_->sparse_push_codec(1),
+            paddle::distributed::SPARSE_PUSH_PACKED_INT8);
+  auto pull_packed_status = worker_ptr_->pull_sparse(
+      fea_value_ptr.data(), 1, fea_keys.data(), fea_keys.size(), true);
+  pull_packed_status.wait();
+  paddle::distributed::DownpourBrpcClosure* closure_push_packed =
+      new paddle::distributed::DownpourBrpcClosure(1, [&](void* done) {
+        int ret = 0;
+        auto* closure = (paddle::distributed::DownpourBrpcClosure*)done;
+        if (closure->check_response(
+                0, paddle::distributed::PS_PUSH_SPARSE_TABLE) != 0) {
+          ret = -1;
+        }
+        closure->set_promise_value(ret);
+      });
+  auto push_packed_status = worker_ptr_->push_sparse_raw_gradient(
+      1, fea_keys.data(), (const float**)push_g_vec.data(), fea_keys.size(),
+      closure_push_packed);
+  push_packed_status.wait();
+
+  pull_update_status = worker_ptr_->pull_sparse(
+      fea_temp_value_ptr.data(), 1, fea_keys.data(), fea_keys.size(), true);
+  pull_update_status.wait();
+
+  // a row of ones is exact in int8 with a per row scale
+  for (size_t idx = 0; idx < tensor->numel(); ++idx) {
+    EXPECT_FLOAT_EQ(fea_temp_values[idx], fea_values[idx] - 1.0);
+  }
+
   LOG(INFO) << "Run stop_server";
   worker_ptr_->stop_server();
   LOG(INFO) << "Run finalize_worker";
@@ -15,6 +15,7 @@ limitations under the License. */
 #include "paddle/fluid/distributed/ps/table/ctr_accessor.h"
 #include <cmath>
 #include <iostream>
+#include <vector>
 #include "gtest/gtest.h"
 #include "paddle/fluid/distributed/common/registerer.h"
 #include "paddle/fluid/distributed/ps.pb.h"
@@ -300,5 +301,49 @@ TEST(downpour_feature_value_accessor_test, test_string_related) {
     ASSERT_FLOAT_EQ(value[i], 0);
   }
 }
+
+TEST(downpour_feature_value_accessor_test, test_quantize) {
+  for (int bits : {8, 16}) {
+    TableAccessorParameter parameter = gen_param();
+    parameter.mutable_ctr_accessor_param()->set_embedx_quant_bits(bits);
+    parameter.mutable_ctr_accessor_param()->set_embedx_quant_threshold(10);
+    CtrCommonAccessor* acc = new CtrCommonAccessor();
+    ASSERT_EQ(acc->configure(parameter), 0);
+    ASSERT_EQ(acc->initialize(), 0);
+    auto& fv = acc->common_feature_value;
+    size_t dim = acc->dim();
+
+    std::vector<float> value(dim);
+    for (size_t i = 0; i < dim; ++i) {
+      value[i] = 0.01 * i - 0.05;
+    }
+    fv.show(value.data()) = 2;
+    fv.click(value.data()) = 1;
+
+    std::vector<float> stored(dim);
+    std::vector<float> restored(dim);
+    size_t stored_size = acc->compress(value.data(), dim, stored.data());
+    ASSERT_EQ(stored_size, acc->compress_dim());
+    ASSERT_LT(stored_size, dim);
+    ASSERT_TRUE(acc->has_mf(stored_size));
+    ASSERT_EQ(acc->decompress(stored.data(), stored_size, restored.data()),
+              dim);
+    float tolerance = bits == 8 ? 1e-3 : 1e-4;
+    for (size_t i = 0; i < dim; ++i) {
+      ASSERT_NEAR(restored[i], value[i], tolerance);
+    }
+
+    // hot values and values without embedx stay as they are
+    fv.show(value.data()) = 100;
+    fv.click(value.data()) = 50;
+    ASSERT_EQ(acc->compress(value.data(), dim, stored.data()), dim);
+    size_t no_mf_size = fv.embedx_w_index();
+    ASSERT_EQ(acc->compress(value.data(), no_mf_size, stored.data()),
+              no_mf_size);
+    ASSERT_EQ(acc->decompress(stored.data(), no_mf_size, restored.data()),
+              no_mf_size);
+    delete acc;
+  }
+}
 }  // namespace distributed
 }  // namespace paddle
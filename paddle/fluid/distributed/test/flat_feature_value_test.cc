@@ -0,0 +1,255 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/depends/flat_feature_value.h"
+#include <malloc.h>
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(FlatSparseTableShard, Basic) {
+  FlatSparseTableShard<uint64_t> shard;
+  shard.init(4);
+  uint64_t key = 1;
+  auto itr = shard.find(key);
+  ASSERT_TRUE(itr == shard.end());
+
+  std::vector<float> vec = {0.0, 0.1, 0.2, 0.3};
+  auto& feature_value = shard[key];
+  feature_value.resize(vec.size());
+  memcpy(feature_value.data(), vec.data(), vec.size() * sizeof(float));
+
+  itr = shard.find(key);
+  ASSERT_TRUE(itr != shard.end());
+  ASSERT_EQ(itr.key(), key);
+  ASSERT_EQ(itr.value().size(), vec.size());
+  float* value_data = itr.value().data();
+  ASSERT_FLOAT_EQ(value_data[0], 0.0);
+  ASSERT_FLOAT_EQ(value_data[1], 0.1);
+  ASSERT_FLOAT_EQ(value_data[2], 0.2);
+  ASSERT_FLOAT_EQ(value_data[3], 0.3);
+
+  // shrink then grow again zero-fills the tail like std::vector
+  itr.value().resize(2);
+  itr.value().resize(4);
+  ASSERT_FLOAT_EQ(shard.find(key).value().data()[3], 0.0);
+
+  ASSERT_EQ(shard.erase(key), 1u);
+  ASSERT_TRUE(shard.find(key) == shard.end());
+  ASSERT_TRUE(shard.empty());
+}
+
+TEST(FlatSparseTableShard, InsertEraseIterate) {
+  FlatSparseTableShard<uint64_t> shard;
+  shard.init(2);
+  std::unordered_map<uint64_t, float> expect;
+  std::mt19937_64 rng(0);
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t key = rng() % 50000;
+    if (rng() % 4 == 0) {
+      ASSERT_EQ(shard.erase(key), expect.erase(key));
+    } else {
+      auto& value = shard[key];
+      value.resize(2);
+      value.data()[0] = static_cast<float>(i);
+      expect[key] = static_cast<float>(i);
+    }
+  }
+  ASSERT_EQ(shard.size(), expect.size());
+  size_t visited = 0;
+  for (auto it = shard.begin(); it != shard.end(); ++it) {
+    ASSERT_EQ(expect.count(it.key()), 1u);
+    ASSERT_FLOAT_EQ(it.value().data()[0], expect[it.key()]);
+    ++visited;
+  }
+  ASSERT_EQ(visited, expect.size());
+
+  // erase while iterating, as MemorySparseTable::shrink does
+  for (auto it = shard.begin(); it != shard.end();) {
+    if (it.key() % 2 == 0) {
+      it = shard.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto& kv : expect) {
+    ASSERT_EQ(shard.find(kv.first) != shard.end(), kv.first % 2 == 1);
+  }
+}
+
+TEST(FlatSparseTableShard, CompactSlab) {
+  typedef FlatSparseTableShard<uint64_t> Shard;
+  Shard shard;
+  shard.init(8, 3);
+  const uint64_t key_num = 3 * Shard::kSlabChunkSlots;
+  shard.reserve(key_num);
+  for (uint64_t key = 0; key < key_num; ++key) {
+    auto& value = shard[key];
+    value.resize(8);
+    for (int i = 0; i < 8; ++i) {
+      value.data()[i] = key * 10 + i;
+    }
+  }
+  size_t full_usage = shard.memory_usage();
+  for (auto it = shard.begin(); it != shard.end(); ++it) {
+    auto& value = shard.resize_value(it, 3);
+    ASSERT_EQ(value.capacity(), 3u);
+  }
+  // the emptied chunks of the full slab are freed, but for one spare
+  ASSERT_LT(shard.memory_usage(), full_usage);
+  size_t compact_usage = shard.memory_usage();
+  for (uint64_t key = 0; key < key_num; ++key) {
+    auto it = shard.find(key);
+    ASSERT_EQ(it.value().size(), 3u);
+    ASSERT_FLOAT_EQ(it.value().data()[2], key * 10 + 2);
+  }
+
+  // a short new value goes straight to the compact slab
+  auto ret = shard.emplace(key_num, 2);
+  ASSERT_TRUE(ret.second);
+  ASSERT_EQ(ret.first.value().size(), 2u);
+  ASSERT_EQ(ret.first.value().capacity(), 3u);
+  ret = shard.emplace(key_num, 8);
+  ASSERT_FALSE(ret.second);
+  ASSERT_EQ(ret.first.value().size(), 2u);
+  ASSERT_EQ(shard.erase(key_num), 1u);
+
+  for (uint64_t key = 0; key < key_num; ++key) {
+    // growing moves the value back to the full slab
+    auto& value = shard.resize_value(shard.find(key), 8);
+    ASSERT_EQ(value.capacity(), 8u);
+    ASSERT_FLOAT_EQ(value.data()[1], key * 10 + 1);
+  }
+  ASSERT_EQ(shard.size(), key_num);
+  // back to the full chunks, and a spare for the compact slab
+  ASSERT_LT(shard.memory_usage(), full_usage + compact_usage);
+
+  // freed slots are reused before any new chunk
+  for (uint64_t key = 0; key < key_num; key += 2) {
+    shard.erase(key);
+  }
+  size_t usage = shard.memory_usage();
+  for (uint64_t key = 0; key < key_num; key += 2) {
+    shard[key].resize(8);
+  }
+  ASSERT_EQ(shard.memory_usage(), usage);
+}
+
+TEST(FlatSparseTableShard, InsertUnique) {
+  FlatSparseTableShard<uint64_t> shard;
+  shard.init(4, 2);
+  const size_t key_num = 1000;
+  std::vector<uint64_t> keys(key_num);
+  std::vector<uint16_t> sizes(key_num);
+  std::vector<float> values(key_num * 4);
+  for (size_t k = 0; k < key_num; ++k) {
+    keys[k] = k * 7;
+    sizes[k] = k % 2 == 0 ? 2 : 4;
+    for (size_t i = 0; i < 4; ++i) {
+      values[k * 4 + i] = k * 10 + i;
+    }
+  }
+  shard.insert_unique(keys.data(), key_num, sizes.data(), values.data(), 4);
+  ASSERT_EQ(shard.size(), key_num);
+  for (size_t k = 0; k < key_num; ++k) {
+    auto it = shard.find(keys[k]);
+    ASSERT_TRUE(it != shard.end());
+    ASSERT_EQ(it.value().size(), sizes[k]);
+    // short values go to the compact slab
+    ASSERT_EQ(it.value().capacity(), sizes[k]);
+    ASSERT_FLOAT_EQ(it.value().data()[sizes[k] - 1], k * 10 + sizes[k] - 1);
+  }
+  ASSERT_TRUE(shard.find(1) == shard.end());
+}
+
+// Compare against SparseTableShard<uint64_t, FixedFeatureValue> on random
+// 64-bit feasigns with a zipf-like access pattern, as seen in CTR traffic.
+TEST(BENCHMARK, FlatSparseTableShard) {
+  const size_t key_num = 1000000;
+  const size_t access_num = 4000000;
+  const size_t value_dim = 17;  // CtrCommonAccessor with embedx_dim 8
+  std::mt19937_64 rng(0);
+  std::vector<uint64_t> keys(key_num);
+  for (auto& key : keys) {
+    key = rng();
+  }
+  std::vector<double> cdf(key_num);
+  double sum = 0;
+  for (size_t i = 0; i < key_num; ++i) {
+    sum += 1.0 / std::pow(static_cast<double>(i + 1), 1.05);
+    cdf[i] = sum;
+  }
+  std::uniform_real_distribution<double> uniform(0, sum);
+  std::vector<uint64_t> access(access_num);
+  for (auto& key : access) {
+    size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) -
+                  cdf.begin();
+    key = keys[std::min(rank, key_num - 1)];
+  }
+
+  auto now = [] { return std::chrono::steady_clock::now(); };
+  auto seconds = [](std::chrono::steady_clock::time_point a,
+                    std::chrono::steady_clock::time_point b) {
+    return std::chrono::duration<double>(b - a).count();
+  };
+  float checksum = 0;
+
+  size_t heap_before = mallinfo().uordblks;
+  SparseTableShard<uint64_t, FixedFeatureValue> node_shard;
+  auto t0 = now();
+  for (auto key : keys) {
+    node_shard[key].resize(value_dim);
+  }
+  auto t1 = now();
+  for (auto key : access) {
+    checksum += node_shard.find(key).value().data()[0];
+  }
+  auto t2 = now();
+  size_t node_bytes = mallinfo().uordblks - heap_before;
+  LOG(INFO) << "SparseTableShard insert " << key_num / seconds(t0, t1)
+            << " keys/s, find " << access_num / seconds(t1, t2)
+            << " keys/s, " << static_cast<double>(node_bytes) / key_num
+            << " bytes/key";
+
+  FlatSparseTableShard<uint64_t> flat_shard;
+  flat_shard.init(value_dim);
+  t0 = now();
+  for (auto key : keys) {
+    flat_shard[key].resize(value_dim);
+  }
+  t1 = now();
+  for (auto key : access) {
+    checksum += flat_shard.find(key).value().data()[0];
+  }
+  t2 = now();
+  LOG(INFO) << "FlatSparseTableShard insert " << key_num / seconds(t0, t1)
+            << " keys/s, find " << access_num / seconds(t1, t2)
+            << " keys/s, "
+            << static_cast<double>(flat_shard.memory_usage()) / key_num
+            << " bytes/key";
+
+  ASSERT_EQ(node_shard.size(), flat_shard.size());
+  ASSERT_FLOAT_EQ(checksum, 0.0);
+}
+
+}  // namespace distributed
+}  // namespace paddle
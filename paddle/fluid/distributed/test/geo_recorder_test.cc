@@ -0,0 +1,124 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/depends/geo_recorder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <random>
+#include <thread>  // NOLINT
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+static std::vector<uint64_t> Sorted(std::vector<uint64_t> rows) {
+  std::sort(rows.begin(), rows.end());
+  return rows;
+}
+
+TEST(GeoRecorder, GetAndClear) {
+  GeoRecorder recorder(3);
+  std::vector<uint64_t> result;
+  recorder.Update({1, 2, 3, 2});
+  recorder.GetAndClear(0, &result);
+  ASSERT_EQ(Sorted(result), std::vector<uint64_t>({1, 2, 3}));
+  recorder.GetAndClear(0, &result);
+  ASSERT_TRUE(result.empty());
+
+  recorder.Update({3, 4});
+  recorder.GetAndClear(1, &result);
+  ASSERT_EQ(Sorted(result), std::vector<uint64_t>({1, 2, 3, 4}));
+  recorder.GetAndClear(2, &result);
+  ASSERT_EQ(Sorted(result), std::vector<uint64_t>({1, 2, 3, 4}));
+  // rows 1 and 2 reached every trainer and are dropped
+  ASSERT_EQ(recorder.DirtyRowNum(), 2u);
+  recorder.GetAndClear(0, &result);
+  ASSERT_EQ(Sorted(result), std::vector<uint64_t>({3, 4}));
+  ASSERT_EQ(recorder.DirtyRowNum(), 0u);
+}
+
+// Pushes from many threads race with pulls from every trainer; once all
+// pushes are done and drained, every trainer must have seen every row.
+TEST(BENCHMARK, GeoRecorderConcurrent) {
+  const int trainer_num = 130;
+  const int push_thread_num = 8;
+  const int batch_num = 200;
+  const size_t batch_size = 2000;
+  const uint64_t row_num = 100000;
+  GeoRecorder recorder(trainer_num);
+
+  std::vector<std::vector<char>> seen(trainer_num,
+                                      std::vector<char>(row_num, 0));
+  std::atomic<bool> pushing(true);
+  std::thread puller([&] {
+    std::vector<uint64_t> result;
+    int trainer_id = 0;
+    while (pushing.load()) {
+      recorder.GetAndClear(trainer_id, &result);
+      for (auto row : result) {
+        seen[trainer_id][row] = 1;
+      }
+      trainer_id = (trainer_id + 1) % trainer_num;
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pushers;
+  for (int t = 0; t < push_thread_num; ++t) {
+    pushers.emplace_back([&, t] {
+      std::mt19937_64 rng(t);
+      std::vector<uint64_t> rows(batch_size);
+      for (int b = 0; b < batch_num; ++b) {
+        for (auto& row : rows) {
+          row = rng() % row_num;
+        }
+        recorder.Update(rows);
+      }
+    });
+  }
+  for (auto& pusher : pushers) {
+    pusher.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  pushing = false;
+  puller.join();
+  LOG(INFO) << "GeoRecorder with " << trainer_num << " trainers and "
+            << push_thread_num << " push threads: "
+            << push_thread_num * batch_num * batch_size / seconds
+            << " rows/s";
+
+  std::vector<char> pushed(row_num, 0);
+  for (int t = 0; t < push_thread_num; ++t) {
+    std::mt19937_64 rng(t);
+    for (size_t i = 0; i < batch_num * batch_size; ++i) {
+      pushed[rng() % row_num] = 1;
+    }
+  }
+  std::vector<uint64_t> result;
+  for (int i = 0; i < trainer_num; ++i) {
+    recorder.GetAndClear(i, &result);
+    for (auto row : result) {
+      seen[i][row] = 1;
+    }
+    ASSERT_EQ(seen[i], pushed);
+  }
+  ASSERT_EQ(recorder.DirtyRowNum(), 0u);
+}
+
+}  // namespace distributed
+}  // namespace paddle
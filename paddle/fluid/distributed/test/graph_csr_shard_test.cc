@@ -0,0 +1,233 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr_shard.h"
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <random>
+#include <vector>
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+
+namespace paddle {
+namespace distributed {
+
+// probability of each index being in a sample of k drawn one at a time with
+// probability proportional to the remaining weight
+static void inclusion_probability(const std::vector<double> &weights, int k,
+                                  std::vector<bool> *taken, double prob,
+                                  std::vector<double> *res) {
+  if (k == 0) return;
+  double rest = 0;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    if (!(*taken)[i]) rest += weights[i];
+  }
+  for (size_t i = 0; i < weights.size(); ++i) {
+    if ((*taken)[i]) continue;
+    double p = prob * weights[i] / rest;
+    (*res)[i] += p;
+    (*taken)[i] = true;
+    inclusion_probability(weights, k - 1, taken, p, res);
+    (*taken)[i] = false;
+  }
+}
+
+static void check_weighted(const std::vector<double> &weights, int k) {
+  std::vector<CsrEdge> edges;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    edges.push_back({7, 100 + i, static_cast<float>(weights[i])});
+  }
+  CsrGraphShard csr;
+  csr.build(&edges, true);
+  ASSERT_EQ(csr.find(7), 0);
+
+  std::vector<double> expected(weights.size(), 0);
+  std::vector<bool> taken(weights.size(), false);
+  inclusion_probability(weights, k, &taken, 1.0, &expected);
+
+  const int trials = 200000;
+  std::mt19937_64 rng(0);
+  std::vector<double> hit(weights.size(), 0);
+  for (int t = 0; t < trials; ++t) {
+    auto res = csr.sample_k(0, k, &rng);
+    ASSERT_EQ(res.size(), static_cast<size_t>(k));
+    for (auto x : res) hit[x] += 1;
+    std::sort(res.begin(), res.end());
+    ASSERT_TRUE(std::unique(res.begin(), res.end()) == res.end());
+  }
+  for (size_t i = 0; i < weights.size(); ++i) {
+    ASSERT_NEAR(hit[i] / trials, expected[i], 0.01) << "index " << i;
+  }
+}
+
+TEST(CsrGraphShard, Build) {
+  std::vector<CsrEdge> edges = {
+      {5, 50, 1.0}, {3, 30, 2.0}, {5, 51, 3.0}, {3, 31, 4.0}, {9, 90, 5.0}};
+  CsrGraphShard csr;
+  csr.build(&edges, true);
+  ASSERT_TRUE(edges.empty());
+  ASSERT_EQ(csr.node_num(), 3u);
+  ASSERT_EQ(csr.edge_num(), 5u);
+  ASSERT_EQ(csr.find(4), -1);
+  int64_t row = csr.find(5);
+  ASSERT_GE(row, 0);
+  // neighbors keep the load order
+  ASSERT_EQ(csr.degree(row), 2);
+  ASSERT_EQ(csr.neighbor_id(row, 0), 50u);
+  ASSERT_EQ(csr.neighbor_id(row, 1), 51u);
+  ASSERT_EQ(csr.neighbor_weight(row, 1), 3.0);
+
+  // rebuilding from a dump with more edges keeps the old ones first
+  csr.dump_edges(&edges);
+  edges.push_back({5, 52, 6.0});
+  csr.build(&edges, true);
+  row = csr.find(5);
+  ASSERT_EQ(csr.degree(row), 3);
+  ASSERT_EQ(csr.neighbor_id(row, 2), 52u);
+  ASSERT_EQ(csr.neighbor_id(csr.find(3), 1), 31u);
+
+  csr.clear();
+  ASSERT_EQ(csr.node_num(), 0u);
+  ASSERT_EQ(csr.find(5), -1);
+}
+
+TEST(CsrGraphShard, RemoveNodes) {
+  std::vector<CsrEdge> edges = {{3, 30, 1.0}, {3, 31, 3.0}, {5, 50, 1.0},
+                                {5, 51, 2.0}, {9, 90, 5.0}, {9, 91, 0.0}};
+  CsrGraphShard csr;
+  csr.build(&edges, true);
+  csr.remove_nodes({5, 7});
+  ASSERT_EQ(csr.node_num(), 2u);
+  ASSERT_EQ(csr.edge_num(), 4u);
+  ASSERT_EQ(csr.find(5), -1);
+  int64_t row = csr.find(9);
+  ASSERT_EQ(csr.degree(row), 2);
+  ASSERT_EQ(csr.neighbor_id(row, 0), 90u);
+  // the alias table moved with the row: the zero weight is never drawn
+  std::mt19937_64 rng(0);
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(csr.sample_k(row, 1, &rng), std::vector<int>({0}));
+  }
+
+  // a removed node added again starts without its old edges
+  csr.dump_edges(&edges);
+  edges.push_back({5, 52, 1.0});
+  csr.build(&edges, true);
+  row = csr.find(5);
+  ASSERT_EQ(csr.degree(row), 1);
+  ASSERT_EQ(csr.neighbor_id(row, 0), 52u);
+  ASSERT_EQ(csr.degree(csr.find(3)), 2);
+}
+
+TEST(CsrGraphShard, UniformSample) {
+  std::vector<CsrEdge> edges;
+  for (uint64_t i = 0; i < 200; ++i) {
+    edges.push_back({1, i, 1.0});
+  }
+  CsrGraphShard csr;
+  csr.build(&edges, false);
+  std::mt19937_64 rng(0);
+  ASSERT_EQ(csr.sample_k(0, 500, &rng).size(), 200u);
+  for (int k : {1, 10, 64, 99, 150, 199}) {
+    auto res = csr.sample_k(0, k, &rng);
+    ASSERT_EQ(res.size(), static_cast<size_t>(k));
+    std::sort(res.begin(), res.end());
+    ASSERT_TRUE(std::unique(res.begin(), res.end()) == res.end());
+    ASSERT_GE(res.front(), 0);
+    ASSERT_LT(res.back(), 200);
+  }
+}
+
+TEST(CsrGraphShard, WeightedSample) {
+  check_weighted({1, 2, 3, 4, 10}, 1);
+  check_weighted({1, 2, 3, 4, 10}, 2);
+  // two neighbors hold nearly all the weight, so the third pick runs out of
+  // rejections and finishes with the exact method
+  check_weighted({1000, 1000, 0.01, 0.02, 0.03, 0.04, 0.05, 0.06}, 3);
+  // more picks than the rejection path handles
+  std::vector<double> weights(100);
+  for (size_t i = 0; i < weights.size(); ++i) weights[i] = i % 7 + 1;
+  std::vector<CsrEdge> edges;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    edges.push_back({1, i, static_cast<float>(weights[i])});
+  }
+  CsrGraphShard csr;
+  csr.build(&edges, true);
+  std::mt19937_64 rng(0);
+  auto res = csr.sample_k(0, 80, &rng);
+  ASSERT_EQ(res.size(), 80u);
+  std::sort(res.begin(), res.end());
+  ASSERT_TRUE(std::unique(res.begin(), res.end()) == res.end());
+}
+
+// Samples/s of a power law graph stored as one GraphNode with an edge blob
+// and WeightedSampler per node, against CsrGraphShard, and the bytes taken
+// by CsrGraphShard.
+TEST(BENCHMARK, CsrGraphShard) {
+  const int node_num = 100000;
+  const int sample_size = 10;
+  const int query_num = 1000000;
+  std::mt19937_64 gen(0);
+  std::vector<CsrEdge> edges;
+  std::vector<std::unique_ptr<GraphNode>> nodes;
+  for (int i = 0; i < node_num; ++i) {
+    // degree ~ 1 / x^2 on [1, 1000]
+    double u = std::uniform_real_distribution<double>(0, 1)(gen);
+    int degree = static_cast<int>(1.0 / (1.0 - u * 0.999));
+    nodes.emplace_back(new GraphNode(i));
+    nodes.back()->build_edges(true);
+    for (int j = 0; j < degree; ++j) {
+      uint64_t dst = gen() % node_num;
+      float weight = std::uniform_real_distribution<float>(0.1, 10)(gen);
+      nodes.back()->add_edge(dst, weight);
+      edges.push_back({static_cast<uint64_t>(i), dst, weight});
+    }
+    nodes.back()->build_sampler("weighted");
+  }
+  size_t edge_num = edges.size();
+  CsrGraphShard csr;
+  csr.build(&edges, true);
+
+  std::vector<uint64_t> queries(query_num);
+  for (auto &q : queries) q = gen() % node_num;
+
+  auto rng = std::make_shared<std::mt19937_64>(0);
+  size_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (auto q : queries) {
+    checksum += nodes[q]->sample_k(sample_size, rng).size();
+  }
+  double legacy_seconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+  start = std::chrono::steady_clock::now();
+  for (auto q : queries) {
+    checksum -= csr.sample_k(csr.find(q), sample_size, rng.get()).size();
+  }
+  double csr_seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  ASSERT_EQ(checksum, 0u);
+  LOG(INFO) << node_num << " nodes, " << edge_num << " edges, sample "
+            << sample_size;
+  LOG(INFO) << "GraphNode + WeightedSampler: "
+            << query_num / legacy_seconds << " samples/s";
+  LOG(INFO) << "CsrGraphShard: " << query_num / csr_seconds << " samples/s, "
+            << csr.memory_usage() << " bytes";
+}
+
+}  // namespace distributed
+}  // namespace paddle
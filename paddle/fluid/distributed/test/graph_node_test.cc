@@ -224,6 +224,32 @@ void testBatchSampleNeighboor(
   }
 }
 
+void testSampleSubgraph(
+    std::shared_ptr<paddle::distributed::GraphBrpcClient>& worker_ptr_) {
+  paddle::distributed::GraphSubgraph res;
+  std::vector<uint64_t> seeds = {37, 96, 10240001024};
+  auto pull_status =
+      worker_ptr_->sample_subgraph(0, seeds, {4, 4}, true, {}, 0, {}, res);
+  pull_status.wait();
+  ASSERT_EQ(res.hop_num(), 2);
+  for (size_t i = 0; i < seeds.size(); i++) {
+    ASSERT_EQ(res.nodes[res.frontiers[0][i]], seeds[i]);
+  }
+  std::vector<std::unordered_set<uint64_t>> expected = {
+      {112, 45, 145}, {111, 48, 247}, {}};
+  for (size_t i = 0; i < seeds.size(); i++) {
+    std::unordered_set<uint64_t> s;
+    for (int64_t j = res.offsets[0][i]; j < res.offsets[0][i + 1]; j++) {
+      s.insert(res.nodes[res.neighbors[0][j]]);
+    }
+    ASSERT_EQ(s, expected[i]);
+  }
+  ASSERT_EQ(res.weights[0].size(), res.neighbors[0].size());
+  // the sampled items have no edges of their own
+  ASSERT_EQ(res.frontiers[1].size(), 6);
+  ASSERT_EQ(res.neighbors[1].size(), 0);
+}
+
 void testCache();
 void testGraphToBuffer();
 
@@ -434,6 +460,7 @@ void RunBrpcPushSparse() {
   sleep(5);
   testSingleSampleNeighboor(worker_ptr_);
   testBatchSampleNeighboor(worker_ptr_);
+  testSampleSubgraph(worker_ptr_);
   pull_status = worker_ptr_->batch_sample_neighbors(
       0, std::vector<uint64_t>(1, 10240001024), 4, _vs, vs, true);
   pull_status.wait();
@@ -635,9 +662,10 @@ void RunBrpcPushSparse() {
 }
 
 void testCache() {
-  ::paddle::distributed::ScaledLRU<::paddle::distributed::SampleKey,
-                                   ::paddle::distributed::SampleResult>
-      st(1, 2, 4);
+  ::paddle::distributed::GraphSampleCache<
+      ::paddle::distributed::SampleKey, ::paddle::distributed::SampleResult,
+      ::paddle::distributed::SampleResultBytes>
+      st(2, 0, 4, 1);
   char* str = new char[7];
   strcpy(str, "54321");
   ::paddle::distributed::SampleResult* result =
@@ -646,25 +674,25 @@ void testCache() {
   std::vector<std::pair<::paddle::distributed::SampleKey,
                         paddle::distributed::SampleResult>>
       r;
-  st.query(0, &skey, 1, r);
+  st.query(&skey, 1, r);
   ASSERT_EQ((int)r.size(), 0);
 
-  st.insert(0, &skey, result, 1);
+  st.insert(&skey, result, 1);
   for (int i = 0; i < st.get_ttl(); i++) {
-    st.query(0, &skey, 1, r);
+    st.query(&skey, 1, r);
     ASSERT_EQ((int)r.size(), 1);
     char* p = (char*)r[0].second.buffer.get();
     for (int j = 0; j < r[0].second.actual_size; j++) ASSERT_EQ(p[j], str[j]);
     r.clear();
   }
-  st.query(0, &skey, 1, r);
+  st.query(&skey, 1, r);
   ASSERT_EQ((int)r.size(), 0);
   str = new char[10];
   strcpy(str, "54321678");
   result = new ::paddle::distributed::SampleResult(strlen(str), str);
-  st.insert(0, &skey, result, 1);
+  st.insert(&skey, result, 1);
   for (int i = 0; i < st.get_ttl() / 2; i++) {
-    st.query(0, &skey, 1, r);
+    st.query(&skey, 1, r);
     ASSERT_EQ((int)r.size(), 1);
     char* p = (char*)r[0].second.buffer.get();
     for (int j = 0; j < r[0].second.actual_size; j++) ASSERT_EQ(p[j], str[j]);
@@ -673,15 +701,15 @@ void testCache() {
   str = new char[18];
   strcpy(str, "343332d4321");
   result = new ::paddle::distributed::SampleResult(strlen(str), str);
-  st.insert(0, &skey, result, 1);
+  st.insert(&skey, result, 1);
   for (int i = 0; i < st.get_ttl(); i++) {
-    st.query(0, &skey, 1, r);
+    st.query(&skey, 1, r);
     ASSERT_EQ((int)r.size(), 1);
     char* p = (char*)r[0].second.buffer.get();
     for (int j = 0; j < r[0].second.actual_size; j++) ASSERT_EQ(p[j], str[j]);
     r.clear();
   }
-  st.query(0, &skey, 1, r);
+  st.query(&skey, 1, r);
   ASSERT_EQ((int)r.size(), 0);
 }
 void testGraphToBuffer() {
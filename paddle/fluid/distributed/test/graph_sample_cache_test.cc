@@ -0,0 +1,444 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_sample_cache.h"
+#include <ThreadPool.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+struct StringBytes {
+  size_t operator()(const std::string &s) const { return s.size(); }
+};
+typedef GraphSampleCache<uint64_t, std::string, StringBytes> StringCache;
+
+// ScaledLRU, the sample cache GraphTable used before GraphSampleCache, kept
+// as the baseline of the benchmark. Unchanged but for its shrink thread,
+// which is joined rather than detached so that the cache can be destroyed.
+namespace scaled_lru {
+
+enum LRUResponse { ok = 0, blocked = 1, err = 2 };
+
+template <typename K, typename V>
+class LRUNode {
+ public:
+  LRUNode(K _key, V _data, size_t _ttl) : key(_key), data(_data), ttl(_ttl) {
+    next = pre = NULL;
+  }
+  K key;
+  V data;
+  size_t ttl;
+  LRUNode<K, V> *pre, *next;
+};
+template <typename K, typename V>
+class ScaledLRU;
+
+template <typename K, typename V>
+class RandomSampleLRU {
+ public:
+  explicit RandomSampleLRU(ScaledLRU<K, V> *_father) {
+    father = _father;
+    remove_count = 0;
+    node_size = 0;
+    node_head = node_end = NULL;
+    global_ttl = father->ttl;
+    total_diff = 0;
+  }
+
+  ~RandomSampleLRU() {
+    LRUNode<K, V> *p;
+    while (node_head != NULL) {
+      p = node_head->next;
+      delete node_head;
+      node_head = p;
+    }
+  }
+  LRUResponse query(K *keys, size_t length,
+                    std::vector<std::pair<K, V>> &res) {  // NOLINT
+    if (pthread_rwlock_tryrdlock(&father->rwlock) != 0)
+      return LRUResponse::blocked;
+    int init_size = node_size - remove_count;
+    process_redundant(length * 3);
+
+    for (size_t i = 0; i < length; i++) {
+      auto iter = key_map.find(keys[i]);
+      if (iter != key_map.end()) {
+        res.emplace_back(keys[i], iter->second->data);
+        iter->second->ttl--;
+        if (iter->second->ttl == 0) {
+          remove(iter->second);
+          if (remove_count != 0) remove_count--;
+        } else {
+          move_to_tail(iter->second);
+        }
+      }
+    }
+    total_diff += node_size - remove_count - init_size;
+    if (total_diff >= 500 || total_diff < -500) {
+      father->handle_size_diff(total_diff);
+      total_diff = 0;
+    }
+    pthread_rwlock_unlock(&father->rwlock);
+    return LRUResponse::ok;
+  }
+  LRUResponse insert(K *keys, V *data, size_t length) {
+    if (pthread_rwlock_tryrdlock(&father->rwlock) != 0)
+      return LRUResponse::blocked;
+    int init_size = node_size - remove_count;
+    process_redundant(length * 3);
+    for (size_t i = 0; i < length; i++) {
+      auto iter = key_map.find(keys[i]);
+      if (iter != key_map.end()) {
+        move_to_tail(iter->second);
+        iter->second->ttl = global_ttl;
+        iter->second->data = data[i];
+      } else {
+        LRUNode<K, V> *temp = new LRUNode<K, V>(keys[i], data[i], global_ttl);
+        add_new(temp);
+      }
+    }
+    total_diff += node_size - remove_count - init_size;
+    if (total_diff >= 500 || total_diff < -500) {
+      father->handle_size_diff(total_diff);
+      total_diff = 0;
+    }
+
+    pthread_rwlock_unlock(&father->rwlock);
+    return LRUResponse::ok;
+  }
+  void remove(LRUNode<K, V> *node) {
+    fetch(node);
+    node_size--;
+    key_map.erase(node->key);
+    delete node;
+  }
+
+  void process_redundant(int process_size) {
+    size_t length = std::min(remove_count, process_size);
+    while (length--) {
+      remove(node_head);
+      remove_count--;
+    }
+  }
+
+  void move_to_tail(LRUNode<K, V> *node) {
+    fetch(node);
+    place_at_tail(node);
+  }
+
+  void add_new(LRUNode<K, V> *node) {
+    node->ttl = global_ttl;
+    place_at_tail(node);
+    node_size++;
+    key_map[node->key] = node;
+  }
+  void place_at_tail(LRUNode<K, V> *node) {
+    if (node_end == NULL) {
+      node_head = node_end = node;
+      node->next = node->pre = NULL;
+    } else {
+      node_end->next = node;
+      node->pre = node_end;
+      node->next = NULL;
+      node_end = node;
+    }
+  }
+
+  void fetch(LRUNode<K, V> *node) {
+    if (node->pre) {
+      node->pre->next = node->next;
+    } else {
+      node_head = node->next;
+    }
+    if (node->next) {
+      node->next->pre = node->pre;
+    } else {
+      node_end = node->pre;
+    }
+  }
+
+ private:
+  std::unordered_map<K, LRUNode<K, V> *> key_map;
+  ScaledLRU<K, V> *father;
+  size_t global_ttl;
+  int node_size, total_diff;
+  LRUNode<K, V> *node_head, *node_end;
+  friend class ScaledLRU<K, V>;
+  int remove_count;
+};
+
+template <typename K, typename V>
+class ScaledLRU {
+ public:
+  ScaledLRU(size_t _shard_num, size_t size_limit, size_t _ttl)
+      : size_limit(size_limit), ttl(_ttl) {
+    shard_num = _shard_num;
+    pthread_rwlock_init(&rwlock, NULL);
+    stop = false;
+    thread_pool.reset(new ::ThreadPool(1));
+    global_count = 0;
+    lru_pool = std::vector<RandomSampleLRU<K, V>>(shard_num,
+                                                  RandomSampleLRU<K, V>(this));
+    shrink_job = std::thread([this]() -> void {
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          cv_.wait_for(lock, std::chrono::milliseconds(20000));
+          if (stop) {
+            return;
+          }
+        }
+        auto status =
+            thread_pool->enqueue([this]() -> int { return shrink(); });
+        status.wait();
+      }
+    });
+  }
+  ~ScaledLRU() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop = true;
+      cv_.notify_one();
+    }
+    shrink_job.join();
+  }
+  LRUResponse query(size_t index, K *keys, size_t length,
+                    std::vector<std::pair<K, V>> &res) {  // NOLINT
+    return lru_pool[index].query(keys, length, res);
+  }
+  LRUResponse insert(size_t index, K *keys, V *data, size_t length) {
+    return lru_pool[index].insert(keys, data, length);
+  }
+  int shrink() {
+    int node_size = 0;
+    for (size_t i = 0; i < lru_pool.size(); i++) {
+      node_size += lru_pool[i].node_size - lru_pool[i].remove_count;
+    }
+
+    if (node_size <= static_cast<size_t>(1.1 * size_limit) + 1) return 0;
+    if (pthread_rwlock_wrlock(&rwlock) == 0) {
+      global_count = 0;
+      for (size_t i = 0; i < lru_pool.size(); i++) {
+        global_count += lru_pool[i].node_size - lru_pool[i].remove_count;
+      }
+      if (global_count > size_limit) {
+        size_t remove = global_count - size_limit;
+        for (size_t i = 0; i < lru_pool.size(); i++) {
+          lru_pool[i].total_diff = 0;
+          lru_pool[i].remove_count +=
+              1.0 * (lru_pool[i].node_size - lru_pool[i].remove_count) /
+              global_count * remove;
+        }
+      }
+      pthread_rwlock_unlock(&rwlock);
+      return 0;
+    }
+    return 0;
+  }
+
+  void handle_size_diff(int diff) {
+    if (diff != 0) {
+      __sync_fetch_and_add(&global_count, diff);
+      if (global_count > static_cast<int>(1.25 * size_limit)) {
+        thread_pool->enqueue([this]() -> int { return shrink(); });
+      }
+    }
+  }
+
+  size_t get_ttl() { return ttl; }
+
+ private:
+  pthread_rwlock_t rwlock;
+  size_t shard_num;
+  int global_count;
+  size_t size_limit;
+  size_t ttl;
+  bool stop;
+  std::thread shrink_job;
+  std::vector<RandomSampleLRU<K, V>> lru_pool;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::shared_ptr<::ThreadPool> thread_pool;
+  friend class RandomSampleLRU<K, V>;
+};
+
+}  // namespace scaled_lru
+
+
+TEST(GraphSampleCache, TTL) {
+  StringCache cache(16, 0, 3, 1);
+  uint64_t key = 6;
+  std::string value = "54321";
+  std::vector<std::pair<uint64_t, std::string>> r;
+  cache.query(&key, 1, r);
+  ASSERT_EQ(r.size(), 0u);
+  cache.insert(&key, &value, 1);
+  for (size_t i = 0; i < cache.get_ttl(); i++) {
+    cache.query(&key, 1, r);
+    ASSERT_EQ(r.size(), i + 1);
+    ASSERT_EQ(r.back().second, value);
+  }
+  // used up by the last read
+  cache.query(&key, 1, r);
+  ASSERT_EQ(r.size(), cache.get_ttl());
+  // inserting again replaces the value and restarts the ttl
+  cache.insert(&key, &value, 1);
+  cache.query(&key, 1, r);
+  value = "678";
+  cache.insert(&key, &value, 1);
+  r.clear();
+  for (size_t i = 0; i < cache.get_ttl(); i++) {
+    cache.query(&key, 1, r);
+  }
+  ASSERT_EQ(r.size(), cache.get_ttl());
+  ASSERT_EQ(r.back().second, "678");
+
+  auto stat = cache.get_stat();
+  ASSERT_EQ(stat.entries, 0u);
+  ASSERT_EQ(stat.expire, 2u);
+  ASSERT_EQ(stat.hit, 7u);
+  ASSERT_EQ(stat.miss, 2u);
+}
+
+TEST(GraphSampleCache, Clock) {
+  StringCache cache(4, 0, 100, 1);
+  std::vector<uint64_t> keys = {0, 1, 2, 3};
+  std::vector<std::string> values = {"a", "b", "c", "d"};
+  cache.insert(keys.data(), values.data(), keys.size());
+  std::vector<std::pair<uint64_t, std::string>> r;
+  // 0 and 2 are referenced, so 1 and then 3 are evicted
+  cache.query(&keys[0], 1, r);
+  cache.query(&keys[2], 1, r);
+  std::vector<uint64_t> new_keys = {4, 5};
+  cache.insert(new_keys.data(), values.data(), new_keys.size());
+  r.clear();
+  cache.query(keys.data(), keys.size(), r);
+  ASSERT_EQ(r.size(), 2u);
+  ASSERT_EQ(r[0].first, 0u);
+  ASSERT_EQ(r[1].first, 2u);
+  ASSERT_EQ(cache.get_stat().evict, 2u);
+  ASSERT_EQ(cache.get_stat().entries, 4u);
+}
+
+TEST(GraphSampleCache, ByteLimit) {
+  StringCache cache(1000, 80, 100, 1);
+  std::vector<uint64_t> keys = {1, 2, 3};
+  std::vector<std::string> values = {std::string(11, 'x'),
+                                     std::string(10, 'y'),
+                                     std::string(10, 'z')};
+  cache.insert(keys.data(), values.data(), keys.size());
+  auto stat = cache.get_stat();
+  // 11 bytes is more than an eighth of the budget
+  ASSERT_EQ(stat.reject, 1u);
+  ASSERT_EQ(stat.entries, 2u);
+  ASSERT_EQ(stat.bytes, 20u);
+  std::vector<uint64_t> more(10);
+  std::vector<std::string> more_values(10, std::string(10, 'w'));
+  for (size_t i = 0; i < more.size(); i++) more[i] = 100 + i;
+  cache.insert(more.data(), more_values.data(), more.size());
+  stat = cache.get_stat();
+  ASSERT_LE(stat.bytes, 80u);
+  ASSERT_EQ(stat.entries, 8u);
+}
+
+// Lookups/s and hit rate of sample requests whose nodes follow a power law,
+// missing lookups inserting a new sample, from several threads, for
+// GraphSampleCache and for the ScaledLRU it replaced. GraphTable ran each
+// ScaledLRU shard on a single task pool thread; a mutex per shard stands in
+// for that thread here.
+TEST(BENCHMARK, GraphSampleCache) {
+  const size_t node_num = 1000000;
+  const size_t cache_size = 100000;
+  const int lookup_num = 1000000;
+  const size_t ttl = 100;
+  const size_t shard_num = 24;
+  // inverse CDF of a Zipf-like law with exponent 1.1 on [1, node_num]
+  auto zipf = [node_num](std::mt19937_64 &rng) {
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    double a = 1.0 - 1.1;
+    double x = std::pow(1 + u * (std::pow(node_num, a) - 1), 1 / a);
+    return static_cast<uint64_t>(x) - 1;
+  };
+  // runs lookup(key) lookup_num times over thread_num threads, lookup
+  // returns whether it hit
+  auto run = [&](const std::string &name, int thread_num,
+                 const std::function<bool(uint64_t)> &lookup) {
+    std::atomic<int> hit{0};
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < thread_num; t++) {
+      threads.emplace_back([&, t] {
+        std::mt19937_64 rng(t);
+        int thread_hit = 0;
+        for (int i = 0; i < lookup_num / thread_num; i++) {
+          thread_hit += lookup(zipf(rng));
+        }
+        hit += thread_hit;
+      });
+    }
+    for (auto &t : threads) t.join();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    LOG(INFO) << name << " threads=" << thread_num << " "
+              << lookup_num / seconds << " lookups/s, hit rate "
+              << 1.0 * hit / (lookup_num / thread_num * thread_num);
+  };
+
+  const std::string sample(80, 's');
+  for (int thread_num : {1, 4, 16}) {
+    StringCache cache(cache_size, 0, ttl, 4 * shard_num);
+    run("GraphSampleCache", thread_num, [&](uint64_t key) {
+      std::vector<std::pair<uint64_t, std::string>> r;
+      cache.query(&key, 1, r);
+      if (r.empty()) cache.insert(&key, &sample, 1);
+      return !r.empty();
+    });
+
+    scaled_lru::ScaledLRU<uint64_t, std::string> lru(shard_num, cache_size,
+                                                     ttl);
+    std::vector<std::mutex> shard_mutex(shard_num);
+    run("ScaledLRU", thread_num, [&](uint64_t key) {
+      size_t index = key % shard_num;
+      std::lock_guard<std::mutex> lock(shard_mutex[index]);
+      std::vector<std::pair<uint64_t, std::string>> r;
+      lru.query(index, &key, 1, r);
+      if (r.empty()) {
+        std::string value = sample;
+        lru.insert(index, &key, &value, 1);
+      }
+      return !r.empty();
+    });
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
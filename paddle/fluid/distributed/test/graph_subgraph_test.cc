@@ -0,0 +1,96 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_subgraph.h"
+#include <map>
+#include <memory>
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+// 1 -> 2, 3; 2 -> 3, 4; 3 -> 1; 4 has no edges; weight = dst / 10
+static int32_t sample_all(const std::map<uint64_t, std::vector<uint64_t>> &g,
+                          std::vector<size_t> *frontier_sizes,
+                          const std::vector<uint64_t> &frontier,
+                          std::vector<std::vector<uint64_t>> &res,
+                          std::vector<std::vector<float>> &res_weight) {
+  frontier_sizes->push_back(frontier.size());
+  for (auto id : frontier) {
+    res.push_back({});
+    res_weight.push_back({});
+    auto iter = g.find(id);
+    if (iter == g.end()) continue;
+    for (auto dst : iter->second) {
+      res.back().push_back(dst);
+      res_weight.back().push_back(dst / 10.0);
+    }
+  }
+  return 0;
+}
+
+TEST(GraphSubgraph, Sample) {
+  std::map<uint64_t, std::vector<uint64_t>> g = {
+      {1, {2, 3}}, {2, {3, 4}}, {3, {1}}};
+  std::vector<size_t> frontier_sizes;
+  GraphSubgraph subgraph;
+  ASSERT_EQ(subgraph.sample(
+                {1, 2}, {2, 2, 2}, true,
+                [&](size_t hop, const std::vector<uint64_t> &frontier,
+                    int sample_size, std::vector<std::vector<uint64_t>> &res,
+                    std::vector<std::vector<float>> &res_weight) -> int32_t {
+                  return sample_all(g, &frontier_sizes, frontier, res,
+                                    res_weight);
+                }),
+            0);
+  ASSERT_EQ(subgraph.nodes, std::vector<uint64_t>({1, 2, 3, 4}));
+  ASSERT_EQ(subgraph.hop_num(), 3u);
+  // hop 0: 1 -> 2 3, 2 -> 3 4; hop 1 from {2, 3, 4}; hop 2 from {3, 4, 1}
+  ASSERT_EQ(frontier_sizes, std::vector<size_t>({2, 3, 3}));
+  ASSERT_EQ(subgraph.frontiers[0], std::vector<int32_t>({0, 1}));
+  ASSERT_EQ(subgraph.offsets[0], std::vector<int64_t>({0, 2, 4}));
+  ASSERT_EQ(subgraph.neighbors[0], std::vector<int32_t>({1, 2, 2, 3}));
+  ASSERT_EQ(subgraph.frontiers[1], std::vector<int32_t>({1, 2, 3}));
+  ASSERT_EQ(subgraph.offsets[1], std::vector<int64_t>({0, 2, 3, 3}));
+  ASSERT_EQ(subgraph.neighbors[1], std::vector<int32_t>({2, 3, 0}));
+  ASSERT_EQ(subgraph.frontiers[2], std::vector<int32_t>({2, 3, 0}));
+  ASSERT_FLOAT_EQ(subgraph.weights[0][3], 0.4);
+
+  subgraph.features = {{"a", "bb", "", "dddd"}};
+  std::unique_ptr<char[]> buffer(new char[subgraph.get_size()]);
+  subgraph.to_buffer(buffer.get());
+  GraphSubgraph recovered;
+  recovered.recover_from_buffer(buffer.get());
+  ASSERT_EQ(recovered.nodes, subgraph.nodes);
+  ASSERT_EQ(recovered.frontiers, subgraph.frontiers);
+  ASSERT_EQ(recovered.offsets, subgraph.offsets);
+  ASSERT_EQ(recovered.neighbors, subgraph.neighbors);
+  ASSERT_EQ(recovered.weights, subgraph.weights);
+  ASSERT_EQ(recovered.features, subgraph.features);
+
+  // a failing hop fails the whole sample
+  ASSERT_EQ(subgraph.sample(
+                {1}, {1, 1}, false,
+                [](size_t hop, const std::vector<uint64_t> &frontier,
+                   int sample_size, std::vector<std::vector<uint64_t>> &res,
+                   std::vector<std::vector<float>> &res_weight) -> int32_t {
+                  res.assign(frontier.size(), {7});
+                  return hop == 1 ? -1 : 0;
+                }),
+            -1);
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -14,7 +14,13 @@ limitations under the License. */
 
 #include <ThreadPool.h>
 
+#include <fcntl.h>
+#include <sys/resource.h>
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <random>
 #include <string>
 #include <thread>  // NOLINT
 
@@ -27,18 +33,8 @@ limitations under the License. */
 namespace paddle {
 namespace distributed {
 
-TEST(MemorySparseTable, SGD) {
-  int emb_dim = 8;
-  int trainers = 2;
-
-  TableParameter table_config;
-  table_config.set_table_class("MemorySparseTable");
-  table_config.set_shard_num(10);
-  FsClientParameter fs_config;
-  Table *table = new MemorySparseTable();
-  table->set_shard(0, 1);
-
-  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+static void InitCtrAccessorConfig(TableParameter *table_config) {
+  TableAccessorParameter *accessor_config = table_config->mutable_accessor();
   accessor_config->set_accessor_class("CtrCommonAccessor");
   accessor_config->set_fea_dim(11);
   accessor_config->set_embedx_dim(8);
@@ -65,6 +61,19 @@ TEST(MemorySparseTable, SGD) {
   naive_param->set_initial_range(0.3);
   naive_param->add_weight_bounds(-10.0);
   naive_param->add_weight_bounds(10.0);
+}
+
+TEST(MemorySparseTable, SGD) {
+  int emb_dim = 8;
+  int trainers = 2;
+
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(10);
+  FsClientParameter fs_config;
+  Table *table = new MemorySparseTable();
+  table->set_shard(0, 1);
+  InitCtrAccessorConfig(&table_config);
 
   auto ret = table->initialize(table_config, fs_config);
   ASSERT_EQ(ret, 0);
@@ -136,5 +145,189 @@ TEST(MemorySparseTable, SGD) {
   ctr_table->save_local_fs("./work/table.save", "0", "test");
 }
 
+extern int FLAGS_pserver_sparse_prefetch_distance;
+
+// Keys/second of pull_sparse and push_sparse on 100k-key batches over a
+// table with one million feasigns, with and without software prefetching.
+TEST(BENCHMARK, MemorySparseTablePullPush) {
+  const int emb_dim = 8;
+  const size_t key_num = 1000000;
+  const size_t batch_size = 100000;
+  const int rounds = 10;
+  const int shard_num = 24;
+
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(shard_num);
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new MemorySparseTable());
+  table->set_shard(0, 1);
+  InitCtrAccessorConfig(&table_config);
+  ASSERT_EQ(table->initialize(table_config, fs_config), 0);
+
+  std::mt19937_64 rng(0);
+  std::vector<uint64_t> all_keys(key_num);
+  for (auto &key : all_keys) {
+    key = rng();
+  }
+  std::vector<float> grads(key_num * (emb_dim + 4), 0.1);
+  table->push_sparse(all_keys.data(), grads.data(), key_num);
+
+  std::vector<uint64_t> batch(batch_size);
+  std::vector<uint32_t> fres(batch_size, 1);
+  std::vector<float> pull_values(batch_size * (emb_dim + 1));
+  auto pull_value = PullSparseValue(batch, fres, emb_dim);
+  size_t threads =
+      std::min<size_t>(shard_num, std::thread::hardware_concurrency());
+
+  for (int distance : {0, 8}) {
+    FLAGS_pserver_sparse_prefetch_distance = distance;
+    double pull_seconds = 0;
+    double push_seconds = 0;
+    for (int r = 0; r < rounds; ++r) {
+      for (auto &key : batch) {
+        key = all_keys[rng() % key_num];
+      }
+      auto t0 = std::chrono::steady_clock::now();
+      table->pull_sparse(pull_values.data(), pull_value);
+      auto t1 = std::chrono::steady_clock::now();
+      table->push_sparse(batch.data(), grads.data(), batch_size);
+      auto t2 = std::chrono::steady_clock::now();
+      pull_seconds += std::chrono::duration<double>(t1 - t0).count();
+      push_seconds += std::chrono::duration<double>(t2 - t1).count();
+    }
+    double total = static_cast<double>(batch_size) * rounds;
+    LOG(INFO) << "prefetch_distance " << distance << ": pull "
+              << total / pull_seconds / threads << " keys/s/core, push "
+              << total / push_seconds / threads << " keys/s/core";
+  }
+  FLAGS_pserver_sparse_prefetch_distance = 8;
+}
+
+TEST(MemorySparseTable, BinaryCheckpointConfig) {
+  const int emb_dim = 8;
+  const size_t key_num = 1000;
+
+  auto new_table = [](int embedx_dim) {
+    TableParameter table_config;
+    table_config.set_table_class("MemorySparseTable");
+    table_config.set_shard_num(4);
+    table_config.set_binary_checkpoint(true);
+    InitCtrAccessorConfig(&table_config);
+    table_config.mutable_accessor()->set_embedx_dim(embedx_dim);
+    FsClientParameter fs_config;
+    auto *table = new MemorySparseTable();
+    table->set_shard(0, 1);
+    table->initialize(table_config, fs_config);
+    return std::unique_ptr<MemorySparseTable>(table);
+  };
+
+  auto table = new_table(emb_dim);
+  std::vector<uint64_t> keys(key_num);
+  for (size_t i = 0; i < key_num; ++i) {
+    keys[i] = i * 7 + 1;
+  }
+  std::vector<float> grads(key_num * (emb_dim + 4), 1.0);
+  table->push_sparse(keys.data(), grads.data(), key_num);
+  ASSERT_EQ(table->save("./work/binary_ckpt", "0"), 0);
+
+  // checkpoints go through the binary files, the text load finds none
+  auto loaded = new_table(emb_dim);
+  ASSERT_EQ(loaded->load("./work/binary_ckpt", "0"), 0);
+  ASSERT_EQ(loaded->local_size(), table->local_size());
+  ASSERT_EQ(new_table(emb_dim)->load_local_fs("./work/binary_ckpt", "0"), -1);
+
+  // a table with another embedx layout rejects the files
+  ASSERT_EQ(new_table(emb_dim / 2)->load("./work/binary_ckpt", "0"), -1);
+}
+
+static long PeakRssKB() {  // NOLINT
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+// Save/load wall time of the text and binary checkpoints, saved to the same
+// directory. Raise key_num to 100000000 to reproduce the production-size
+// comparison.
+TEST(BENCHMARK, MemorySparseTableBinaryCheckpoint) {
+  const int emb_dim = 8;
+  const size_t key_num = 1000000;
+  const int shard_num = 24;
+
+  auto new_table = [&]() {
+    TableParameter table_config;
+    table_config.set_table_class("MemorySparseTable");
+    table_config.set_shard_num(shard_num);
+    InitCtrAccessorConfig(&table_config);
+    FsClientParameter fs_config;
+    auto *table = new MemorySparseTable();
+    table->set_shard(0, 1);
+    table->initialize(table_config, fs_config);
+    return std::unique_ptr<MemorySparseTable>(table);
+  };
+  auto seconds_since = [](std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+
+  auto table = new_table();
+  std::mt19937_64 rng(0);
+  std::vector<uint64_t> keys(key_num);
+  for (auto &key : keys) {
+    key = rng();
+  }
+  std::vector<float> grads(key_num * (emb_dim + 4), 1.0);
+  table->push_sparse(keys.data(), grads.data(), key_num);
+
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(table->save_local_fs("./work/ckpt", "0", "bench"), 0);
+  LOG(INFO) << "text save " << seconds_since(start) << "s";
+  start = std::chrono::steady_clock::now();
+  ASSERT_EQ(table->save_local_fs_binary("./work/ckpt", "0", "bench"), 0);
+  LOG(INFO) << "binary save " << seconds_since(start) << "s";
+
+  long rss = PeakRssKB();  // NOLINT
+  auto binary_table = new_table();
+  start = std::chrono::steady_clock::now();
+  ASSERT_EQ(binary_table->load_local_fs_binary("./work/ckpt"), 0);
+  LOG(INFO) << "binary load " << seconds_since(start)
+            << "s, peak rss +" << PeakRssKB() - rss << "KB";
+
+  rss = PeakRssKB();
+  auto text_table = new_table();
+  start = std::chrono::steady_clock::now();
+  ASSERT_EQ(text_table->load_local_fs("./work/ckpt", "0"), 0);
+  LOG(INFO) << "text load " << seconds_since(start) << "s, peak rss +"
+            << PeakRssKB() - rss << "KB";
+
+  ASSERT_EQ(binary_table->local_size(), table->local_size());
+  ASSERT_EQ(text_table->local_size(), table->local_size());
+  std::vector<uint32_t> fres(key_num, 1);
+  auto pull_value = PullSparseValue(keys, fres, emb_dim);
+  std::vector<float> expect(key_num * (emb_dim + 1));
+  std::vector<float> actual(key_num * (emb_dim + 1));
+  table->pull_sparse(expect.data(), pull_value);
+  binary_table->pull_sparse(actual.data(), pull_value);
+  for (size_t i = 0; i < expect.size(); ++i) {
+    ASSERT_FLOAT_EQ(expect[i], actual[i]);
+  }
+
+  // a corrupted file fails the load instead of aborting it; key_num and
+  // sizes_offset are at bytes 32 and 40 of the header
+  int fd = open("./work/ckpt/000/part-bench-000-00000.bin", O_RDWR);
+  ASSERT_GE(fd, 0);
+  uint64_t sizes_offset = 0;
+  ASSERT_EQ(pread(fd, &sizes_offset, sizeof(sizes_offset), 40), 8);
+  uint16_t bad_size = emb_dim + 100;
+  ASSERT_EQ(pwrite(fd, &bad_size, sizeof(bad_size), sizes_offset), 2);
+  ASSERT_EQ(new_table()->load_local_fs_binary("./work/ckpt"), -1);
+  uint64_t bad_key_num = UINT64_MAX / 2;
+  ASSERT_EQ(pwrite(fd, &bad_key_num, sizeof(bad_key_num), 32), 8);
+  ASSERT_EQ(new_table()->load_local_fs_binary("./work/ckpt"), -1);
+  close(fd);
+}
+
 }  // namespace distributed
 }  // namespace paddle
@@ -0,0 +1,78 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/depends/tiny_lfu.h"
+#include <cmath>
+#include <random>
+#include <unordered_set>
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(WTinyLfuPolicy, Capacity) {
+  WTinyLfuPolicy<uint64_t> policy(100);
+  std::unordered_set<uint64_t> resident;
+  std::vector<uint64_t> evicted;
+  for (uint64_t key = 0; key < 1000; ++key) {
+    policy.insert(key, &evicted);
+    resident.insert(key);
+    for (auto victim : evicted) {
+      ASSERT_EQ(resident.erase(victim), 1u);
+    }
+    evicted.clear();
+    ASSERT_LE(policy.size(), 100u);
+    ASSERT_EQ(policy.size(), resident.size());
+  }
+}
+
+// Hot keys seen many times must survive a one-pass scan of cold keys, which
+// would flush a plain LRU of the same size.
+TEST(WTinyLfuPolicy, ScanResistant) {
+  const size_t capacity = 1000;
+  WTinyLfuPolicy<uint64_t> policy(capacity);
+  std::unordered_set<uint64_t> resident;
+  std::vector<uint64_t> evicted;
+  auto access = [&](uint64_t key) {
+    if (resident.count(key)) {
+      policy.touch(key);
+      return true;
+    }
+    policy.insert(key, &evicted);
+    resident.insert(key);
+    for (auto victim : evicted) {
+      resident.erase(victim);
+    }
+    evicted.clear();
+    return false;
+  };
+
+  for (int round = 0; round < 5; ++round) {
+    for (uint64_t key = 0; key < capacity / 2; ++key) {
+      access(key);
+    }
+  }
+  for (uint64_t key = 1000000; key < 1000000 + 10 * capacity; ++key) {
+    access(key);
+  }
+  size_t hot_hits = 0;
+  for (uint64_t key = 0; key < capacity / 2; ++key) {
+    hot_hits += access(key);
+  }
+  ASSERT_GT(hot_hits, capacity * 2 / 5);
+}
+
+}  // namespace distributed
+}  // namespace paddle
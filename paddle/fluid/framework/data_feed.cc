@@ -19,9 +19,11 @@ limitations under the License. */
 
 #include "paddle/fluid/framework/data_feed.h"
 #ifdef _LINUX
+#include <fcntl.h>
 #include <stdio_ext.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #endif
 #include "io/fs.h"
 #include "paddle/fluid/platform/monitor.h"
@@ -29,6 +31,7 @@ limitations under the License. */
 
 USE_INT_STAT(STAT_total_feasign_num_in_mem);
 DECLARE_bool(enable_ins_parser_file);
+DECLARE_string(slotrecord_binary_cache_dir);
 namespace paddle {
 namespace framework {
 
@@ -51,6 +54,7 @@ class BufferedLineFileReader {
 
  public:
   typedef std::function<bool(const std::string&)> LineFunc;
+  typedef std::function<bool(const char*, size_t)> LineRefFunc;
 
  private:
   template <typename T>
@@ -98,6 +102,61 @@ class BufferedLineFileReader {
     return lines;
   }
 
+  // Lines are handed out in place inside the read buffer, with the newline
+  // replaced by '\0'. Only the tail of a line cut by the end of a chunk is
+  // moved to the buffer head, and the buffer grows for lines longer than it.
+  template <typename T>
+  int read_lines_inplace(T* reader, LineRefFunc func, int skip_lines) {
+    int lines = 0;
+    int ret = 0;
+    size_t used = 0;
+    total_len_ = 0;
+    error_line_ = 0;
+
+    SampleFunc spfunc = get_sample_func();
+    while (!is_error()) {
+      if (used == buff_size_) {
+        buff_size_ *= 2;
+        buff_ = reinterpret_cast<char*>(realloc(buff_, buff_size_ + 1));
+        CHECK(buff_ != nullptr);
+      }
+      ret = reader->read(buff_ + used, static_cast<int>(buff_size_ - used));
+      if (ret <= 0) {
+        break;
+      }
+      total_len_ += ret;
+      char* ptr = buff_;
+      char* end = buff_ + used + ret;
+      // the kept tail holds no newline, start the search after it
+      char* eol = reinterpret_cast<char*>(memchr(buff_ + used, '\n', ret));
+      while (eol != NULL) {
+        *eol = '\0';
+        ++lines;
+        if (lines > skip_lines && spfunc()) {
+          if (!func(ptr, eol - ptr)) {
+            ++error_line_;
+          }
+        }
+        ptr = eol + 1;
+        eol = reinterpret_cast<char*>(memchr(ptr, '\n', end - ptr));
+      }
+      used = end - ptr;
+      if (used > 0 && ptr != buff_) {
+        memmove(buff_, ptr, used);
+      }
+    }
+    if (!is_error() && used > 0) {
+      buff_[used] = '\0';
+      ++lines;
+      if (lines > skip_lines && spfunc()) {
+        if (!func(buff_, used)) {
+          ++error_line_;
+        }
+      }
+    }
+    return lines;
+  }
+
  public:
   BufferedLineFileReader()
       : random_engine_(std::random_device()()),
@@ -113,6 +172,10 @@ class BufferedLineFileReader {
     FILEReader reader(fp);
     return read_lines<FILEReader>(&reader, func, skip_lines);
   }
+  int read_file_inplace(FILE* fp, LineRefFunc func, int skip_lines) {
+    FILEReader reader(fp);
+    return read_lines_inplace<FILEReader>(&reader, func, skip_lines);
+  }
   uint64_t file_size(void) { return total_len_; }
   void set_sample_rate(float r) { sample_rate_ = r; }
   size_t get_sample_line() { return sample_line_; }
@@ -130,6 +193,7 @@ class BufferedLineFileReader {
 
  private:
   char* buff_ = nullptr;
+  size_t buff_size_ = MAX_FILE_BUFF_SIZE;
   uint64_t total_len_ = 0;
 
   std::default_random_engine random_engine_;
@@ -2207,19 +2271,463 @@ void SlotRecordInMemoryDataFeed::LoadIntoMemoryByLine(void) {
 #endif
 }
 
+#ifdef _LINUX
+namespace {
+
+// Binary cache of one parsed text file. The file is a header followed by
+// blocks of at most OBJPOOL_BLOCK_SIZE records, each stored column by
+// column so loading is a few memcpy per block:
+//   search_id[n] rank[n] cmatch[n] ins_id_len[n]
+//   uint64 offsets[n * (uint64 slots + 1)] float offsets[n * (float slots + 1)]
+//   uint64 values, float values, ins_id bytes
+// Every column starts 8 byte aligned. A cache is written to a temporary
+// name and renamed once complete, so a present file is always whole.
+const char kSlotRecordCacheMagic[8] = {'P', 'D', 'S', 'L', 'O', 'T', 'R', 'C'};
+const uint32_t kSlotRecordCacheVersion = 1;
+
+struct SlotRecordCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t uint64_slot_num;
+  uint32_t float_slot_num;
+  uint32_t reserved;
+  uint64_t cache_key;
+  uint64_t record_num;
+  uint64_t block_num;
+};
+
+struct SlotRecordCacheBlock {
+  uint64_t record_num;
+  uint64_t uint64_value_num;
+  uint64_t float_value_num;
+  uint64_t ins_id_bytes;
+};
+
+inline size_t AlignCacheColumn(size_t bytes) { return (bytes + 7) & ~7UL; }
+
+inline uint64_t HashCacheKey(const std::string& str) {
+  uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a, stable across builds
+  for (unsigned char c : str) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+class SlotRecordCacheWriter {
+ public:
+  ~SlotRecordCacheWriter() { Abort(); }
+
+  bool Open(const std::string& path, uint64_t cache_key, int uint64_slot_num,
+            int float_slot_num) {
+    path_ = path;
+    tmp_path_ = paddle::string::format_string("%s.tmp.%d", path.c_str(),
+                                              static_cast<int>(getpid()));
+    fp_ = fopen(tmp_path_.c_str(), "wb");
+    if (fp_ == nullptr) {
+      LOG(WARNING) << "cannot write slot record cache " << tmp_path_;
+      return false;
+    }
+    memset(&header_, 0, sizeof(header_));
+    memcpy(header_.magic, kSlotRecordCacheMagic, sizeof(header_.magic));
+    header_.version = kSlotRecordCacheVersion;
+    header_.uint64_slot_num = uint64_slot_num;
+    header_.float_slot_num = float_slot_num;
+    header_.cache_key = cache_key;
+    return Write(&header_, sizeof(header_));
+  }
+
+  bool Append(const SlotRecord* records, size_t num) {
+    if (fp_ == nullptr || num == 0) {
+      return fp_ != nullptr;
+    }
+    size_t uint64_width = header_.uint64_slot_num + 1;
+    size_t float_width = header_.float_slot_num + 1;
+    std::vector<uint64_t> search_ids(num);
+    std::vector<uint32_t> ranks(num);
+    std::vector<uint32_t> cmatchs(num);
+    std::vector<uint32_t> ins_id_lens(num);
+    std::vector<uint32_t> uint64_offsets(num * uint64_width, 0);
+    std::vector<uint32_t> float_offsets(num * float_width, 0);
+    SlotRecordCacheBlock block = {num, 0, 0, 0};
+    for (size_t i = 0; i < num; ++i) {
+      const SlotRecordObject* rec = records[i];
+      search_ids[i] = rec->search_id;
+      ranks[i] = rec->rank;
+      cmatchs[i] = rec->cmatch;
+      ins_id_lens[i] = static_cast<uint32_t>(rec->ins_id_.size());
+      if (!CopyOffsets(rec->slot_uint64_feasigns_.slot_offsets, uint64_width,
+                       &uint64_offsets[i * uint64_width]) ||
+          !CopyOffsets(rec->slot_float_feasigns_.slot_offsets, float_width,
+                       &float_offsets[i * float_width])) {
+        LOG(WARNING) << "slot record layout mismatch, drop cache " << path_;
+        Abort();
+        return false;
+      }
+      // the loader takes the last offset as the number of values
+      if (uint64_offsets[(i + 1) * uint64_width - 1] !=
+              rec->slot_uint64_feasigns_.slot_values.size() ||
+          float_offsets[(i + 1) * float_width - 1] !=
+              rec->slot_float_feasigns_.slot_values.size()) {
+        LOG(WARNING) << "slot record offsets mismatch, drop cache " << path_;
+        Abort();
+        return false;
+      }
+      block.uint64_value_num += rec->slot_uint64_feasigns_.slot_values.size();
+      block.float_value_num += rec->slot_float_feasigns_.slot_values.size();
+      block.ins_id_bytes += rec->ins_id_.size();
+    }
+    bool ok = Write(&block, sizeof(block)) &&
+              WriteColumn(search_ids.data(), num * sizeof(uint64_t)) &&
+              WriteColumn(ranks.data(), num * sizeof(uint32_t)) &&
+              WriteColumn(cmatchs.data(), num * sizeof(uint32_t)) &&
+              WriteColumn(ins_id_lens.data(), num * sizeof(uint32_t)) &&
+              WriteColumn(uint64_offsets.data(),
+                          uint64_offsets.size() * sizeof(uint32_t)) &&
+              WriteColumn(float_offsets.data(),
+                          float_offsets.size() * sizeof(uint32_t));
+    for (size_t i = 0; ok && i < num; ++i) {
+      auto& values = records[i]->slot_uint64_feasigns_.slot_values;
+      ok = Write(values.data(), values.size() * sizeof(uint64_t));
+    }
+    ok = ok && Pad(block.uint64_value_num * sizeof(uint64_t));
+    for (size_t i = 0; ok && i < num; ++i) {
+      auto& values = records[i]->slot_float_feasigns_.slot_values;
+      ok = Write(values.data(), values.size() * sizeof(float));
+    }
+    ok = ok && Pad(block.float_value_num * sizeof(float));
+    for (size_t i = 0; ok && i < num; ++i) {
+      auto& ins_id = records[i]->ins_id_;
+      ok = Write(ins_id.data(), ins_id.size());
+    }
+    ok = ok && Pad(block.ins_id_bytes);
+    if (!ok) {
+      Abort();
+      return false;
+    }
+    header_.record_num += num;
+    ++header_.block_num;
+    return true;
+  }
+
+  bool Close() {
+    if (fp_ == nullptr) {
+      return false;
+    }
+    bool ok = fseek(fp_, 0, SEEK_SET) == 0 && Write(&header_, sizeof(header_));
+    ok = (fclose(fp_) == 0) && ok;
+    fp_ = nullptr;
+    if (ok && rename(tmp_path_.c_str(), path_.c_str()) == 0) {
+      return true;
+    }
+    remove(tmp_path_.c_str());
+    return false;
+  }
+
+  void Abort() {
+    if (fp_ != nullptr) {
+      fclose(fp_);
+      fp_ = nullptr;
+      remove(tmp_path_.c_str());
+    }
+  }
+
+ private:
+  // records from a custom parser may leave unused slots without offsets
+  static bool CopyOffsets(const std::vector<uint32_t>& offsets, size_t width,
+                          uint32_t* out) {
+    if (offsets.empty()) {
+      return true;
+    }
+    if (offsets.size() != width) {
+      return false;
+    }
+    memcpy(out, offsets.data(), width * sizeof(uint32_t));
+    return true;
+  }
+  bool Write(const void* data, size_t bytes) {
+    return bytes == 0 || fwrite(data, 1, bytes, fp_) == bytes;
+  }
+  bool Pad(size_t bytes) {
+    static const char zeros[8] = {0};
+    return Write(zeros, AlignCacheColumn(bytes) - bytes);
+  }
+  bool WriteColumn(const void* data, size_t bytes) {
+    return Write(data, bytes) && Pad(bytes);
+  }
+
+  FILE* fp_ = nullptr;
+  std::string path_;
+  std::string tmp_path_;
+  SlotRecordCacheHeader header_;
+};
+
+}  // namespace
+
+// The cache file is named after the source path; everything that changes
+// the parsed result goes into the key checked when loading it. Files whose
+// version is unknown, remote ones or ones that cannot be stat'ed, are not
+// cached: an empty path is returned.
+std::string SlotRecordInMemoryDataFeed::GetBinaryCachePath(
+    const std::string& filename, uint64_t* cache_key) {
+  struct stat st;
+  if (fs_select_internal(filename) != 0 || stat(filename.c_str(), &st) != 0) {
+    return "";
+  }
+  std::ostringstream key;
+  key << filename << '|' << st.st_size << ':' << st.st_mtime << '|'
+      << pipe_command_ << '|' << parse_ins_id_ << parse_logkey_;
+  for (auto& info : all_slots_info_) {
+    key << '|' << info.slot << ':' << info.type << ':' << info.used_idx << ':'
+        << info.slot_value_idx;
+  }
+  for (auto& info : used_slots_info_) {
+    key << '|' << info.idx << ':' << info.slot_value_idx << ':' << info.slot
+        << ':' << info.type << ':' << info.dense << ':'
+        << info.total_dims_without_inductive << ':'
+        << info.inductive_shape_index;
+    for (auto dim : info.local_shape) {
+      key << ',' << dim;
+    }
+  }
+  *cache_key = HashCacheKey(key.str());
+  return paddle::string::format_string(
+      "%s/%016llx.slotrec", FLAGS_slotrecord_binary_cache_dir.c_str(),
+      static_cast<unsigned long long>(HashCacheKey(filename)));  // NOLINT
+}
+
+bool SlotRecordInMemoryDataFeed::LoadFromBinaryCache(const std::string& path,
+                                                     uint64_t cache_key,
+                                                     int* lines) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(SlotRecordCacheHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t file_size = st.st_size;
+  void* addr = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  madvise(addr, file_size, MADV_SEQUENTIAL);
+  const char* base = reinterpret_cast<const char*>(addr);
+  const char* end = base + file_size;
+  const SlotRecordCacheHeader* header =
+      reinterpret_cast<const SlotRecordCacheHeader*>(base);
+  if (memcmp(header->magic, kSlotRecordCacheMagic, sizeof(header->magic)) !=
+          0 ||
+      header->version != kSlotRecordCacheVersion ||
+      header->cache_key != cache_key ||
+      header->uint64_slot_num != static_cast<uint32_t>(uint64_use_slot_size_) ||
+      header->float_slot_num != static_cast<uint32_t>(float_use_slot_size_)) {
+    VLOG(3) << "stale slot record cache " << path;
+    munmap(addr, file_size);
+    return false;
+  }
+
+  size_t uint64_width = header->uint64_slot_num + 1;
+  size_t float_width = header->float_slot_num + 1;
+  struct BlockColumns {
+    size_t num;
+    uint64_t uint64_value_num;
+    uint64_t float_value_num;
+    uint64_t ins_id_bytes;
+    const uint64_t* search_ids;
+    const uint32_t* ranks;
+    const uint32_t* cmatchs;
+    const uint32_t* ins_id_lens;
+    const uint32_t* uint64_offsets;
+    const uint32_t* float_offsets;
+    const uint64_t* uint64_values;
+    const float* float_values;
+    const char* ins_ids;
+  };
+  // locate the columns of the block at ptr, false if the file is short
+  auto next_block = [&](const char** ptr, BlockColumns* cols) {
+    auto column = [ptr, end](size_t bytes) {
+      const char* col = *ptr;
+      size_t left = end - *ptr;
+      if (AlignCacheColumn(bytes) > left) {
+        return static_cast<const char*>(nullptr);
+      }
+      *ptr += AlignCacheColumn(bytes);
+      return col;
+    };
+    auto block = reinterpret_cast<const SlotRecordCacheBlock*>(
+        column(sizeof(SlotRecordCacheBlock)));
+    if (block == nullptr) {
+      return false;
+    }
+    // every record, value and byte takes room in the file, larger counts
+    // are corrupt and would overflow the column sizes below
+    if (block->record_num > file_size || block->uint64_value_num > file_size ||
+        block->float_value_num > file_size ||
+        block->ins_id_bytes > file_size) {
+      return false;
+    }
+    size_t num = block->record_num;
+    cols->num = num;
+    cols->uint64_value_num = block->uint64_value_num;
+    cols->float_value_num = block->float_value_num;
+    cols->ins_id_bytes = block->ins_id_bytes;
+    cols->search_ids =
+        reinterpret_cast<const uint64_t*>(column(num * sizeof(uint64_t)));
+    cols->ranks =
+        reinterpret_cast<const uint32_t*>(column(num * sizeof(uint32_t)));
+    cols->cmatchs =
+        reinterpret_cast<const uint32_t*>(column(num * sizeof(uint32_t)));
+    cols->ins_id_lens =
+        reinterpret_cast<const uint32_t*>(column(num * sizeof(uint32_t)));
+    cols->uint64_offsets = reinterpret_cast<const uint32_t*>(
+        column(num * uint64_width * sizeof(uint32_t)));
+    cols->float_offsets = reinterpret_cast<const uint32_t*>(
+        column(num * float_width * sizeof(uint32_t)));
+    cols->uint64_values = reinterpret_cast<const uint64_t*>(
+        column(block->uint64_value_num * sizeof(uint64_t)));
+    cols->float_values = reinterpret_cast<const float*>(
+        column(block->float_value_num * sizeof(float)));
+    cols->ins_ids = column(block->ins_id_bytes);
+    return cols->search_ids != nullptr && cols->ranks != nullptr &&
+           cols->cmatchs != nullptr && cols->ins_id_lens != nullptr &&
+           cols->uint64_offsets != nullptr && cols->float_offsets != nullptr &&
+           cols->uint64_values != nullptr && cols->float_values != nullptr &&
+           cols->ins_ids != nullptr;
+  };
+
+  // whether the offsets of num records, width each, start at 0, never
+  // decrease and add up to value_num
+  auto valid_offsets = [](const uint32_t* offsets, size_t num, size_t width,
+                          uint64_t value_num) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < num; ++i, offsets += width) {
+      if (offsets[0] != 0) {
+        return false;
+      }
+      for (size_t j = 1; j < width; ++j) {
+        if (offsets[j] < offsets[j - 1]) {
+          return false;
+        }
+      }
+      total += offsets[width - 1];
+    }
+    return total == value_num;
+  };
+  auto valid_block = [&](const BlockColumns& cols) {
+    uint64_t ins_id_bytes = 0;
+    for (size_t i = 0; i < cols.num; ++i) {
+      ins_id_bytes += cols.ins_id_lens[i];
+    }
+    return ins_id_bytes == cols.ins_id_bytes &&
+           valid_offsets(cols.uint64_offsets, cols.num, uint64_width,
+                         cols.uint64_value_num) &&
+           valid_offsets(cols.float_offsets, cols.num, float_width,
+                         cols.float_value_num);
+  };
+
+  // walk and check the whole file first, nothing is handed out from a
+  // broken cache
+  const char* ptr = base + sizeof(SlotRecordCacheHeader);
+  BlockColumns cols = {};
+  size_t record_num = 0;
+  bool valid = true;
+  for (uint64_t b = 0; valid && b < header->block_num; ++b) {
+    valid = next_block(&ptr, &cols) && valid_block(cols);
+    record_num += cols.num;
+  }
+  if (!valid || ptr != end || record_num != header->record_num) {
+    LOG(WARNING) << "broken slot record cache " << path << ", ignored";
+    munmap(addr, file_size);
+    return false;
+  }
+
+  // all the records are decoded before any is written to the channel, a
+  // load that does not finish leaves nothing behind to be read twice when
+  // the file is parsed instead
+  ptr = base + sizeof(SlotRecordCacheHeader);
+  std::vector<std::vector<SlotRecord>> blocks(header->block_num);
+  for (auto& record_vec : blocks) {
+    next_block(&ptr, &cols);
+    SlotRecordPool().get(&record_vec, cols.num);
+    for (size_t i = 0; i < cols.num; ++i) {
+      SlotRecord rec = record_vec[i];
+      rec->search_id = cols.search_ids[i];
+      rec->rank = cols.ranks[i];
+      rec->cmatch = cols.cmatchs[i];
+      rec->ins_id_.assign(cols.ins_ids, cols.ins_id_lens[i]);
+      cols.ins_ids += cols.ins_id_lens[i];
+
+      const uint32_t* offsets = cols.uint64_offsets + i * uint64_width;
+      uint32_t value_num = offsets[uint64_width - 1];
+      rec->slot_uint64_feasigns_.slot_offsets.assign(offsets,
+                                                     offsets + uint64_width);
+      rec->slot_uint64_feasigns_.slot_values.assign(
+          cols.uint64_values, cols.uint64_values + value_num);
+      cols.uint64_values += value_num;
+
+      offsets = cols.float_offsets + i * float_width;
+      value_num = offsets[float_width - 1];
+      rec->slot_float_feasigns_.slot_offsets.assign(offsets,
+                                                    offsets + float_width);
+      rec->slot_float_feasigns_.slot_values.assign(
+          cols.float_values, cols.float_values + value_num);
+      cols.float_values += value_num;
+    }
+  }
+  munmap(addr, file_size);
+  for (auto& record_vec : blocks) {
+    input_channel_->Write(std::move(record_vec));
+  }
+  *lines = static_cast<int>(record_num);
+  return true;
+}
+#endif
+
 void SlotRecordInMemoryDataFeed::LoadIntoMemoryByCommand(void) {
 #ifdef _LINUX
   std::string filename;
   BufferedLineFileReader line_reader;
   line_reader.set_sample_rate(sample_rate_);
 
+  // sampled loads are not repeatable, so they are never cached; of the
+  // others only local files are, see GetBinaryCachePath
+  bool use_cache = !FLAGS_slotrecord_binary_cache_dir.empty() &&
+                   std::abs(sample_rate_ - 1.0f) < 1e-5f;
+  if (use_cache) {
+    localfs_mkdir(FLAGS_slotrecord_binary_cache_dir);
+  }
+
   while (this->PickOneFile(&filename)) {
     VLOG(3) << "PickOneFile, filename=" << filename
             << ", thread_id=" << thread_id_;
     int lines = 0;
-    std::vector<SlotRecord> record_vec;
     platform::Timer timeline;
     timeline.Start();
+
+    SlotRecordCacheWriter cache_writer;
+    bool write_cache = false;
+    uint64_t cache_key = 0;
+    std::string cache_path =
+        use_cache ? GetBinaryCachePath(filename, &cache_key) : "";
+    if (!cache_path.empty()) {
+      if (LoadFromBinaryCache(cache_path, cache_key, &lines)) {
+        timeline.Pause();
+        VLOG(3) << "LoadIntoMemory() read cache of file=" << filename
+                << ", lines=" << lines
+                << ", cost time=" << timeline.ElapsedSec()
+                << " seconds, thread_id=" << thread_id_;
+        continue;
+      }
+      write_cache = cache_writer.Open(cache_path, cache_key,
+                                      uint64_use_slot_size_,
+                                      float_use_slot_size_);
+    }
+
+    std::vector<SlotRecord> record_vec;
     SlotRecordPool().get(&record_vec, OBJPOOL_BLOCK_SIZE);
     int offset = 0;
 
@@ -2229,9 +2737,10 @@ void SlotRecordInMemoryDataFeed::LoadIntoMemoryByCommand(void) {
       CHECK(this->fp_ != nullptr);
       __fsetlocking(&*(this->fp_), FSETLOCKING_BYCALLER);
 
-      lines = line_reader.read_file(
+      lines = line_reader.read_file_inplace(
           this->fp_.get(),
-          [this, &record_vec, &offset, &filename](const std::string& line) {
+          [this, &record_vec, &offset, &filename, &cache_writer,
+           &write_cache](const char* line, size_t len) {
             if (ParseOneInstance(line, &record_vec[offset])) {
               ++offset;
             } else {
@@ -2240,6 +2749,9 @@ void SlotRecordInMemoryDataFeed::LoadIntoMemoryByCommand(void) {
               return false;
             }
             if (offset >= OBJPOOL_BLOCK_SIZE) {
+              if (write_cache) {
+                write_cache = cache_writer.Append(&record_vec[0], offset);
+              }
               input_channel_->Write(std::move(record_vec));
               record_vec.clear();
               SlotRecordPool().get(&record_vec, OBJPOOL_BLOCK_SIZE);
@@ -2250,6 +2762,9 @@ void SlotRecordInMemoryDataFeed::LoadIntoMemoryByCommand(void) {
           lines);
     } while (line_reader.is_error());
     if (offset > 0) {
+      if (write_cache) {
+        write_cache = cache_writer.Append(&record_vec[0], offset);
+      }
       input_channel_->WriteMove(offset, &record_vec[0]);
       if (offset < OBJPOOL_BLOCK_SIZE) {
         SlotRecordPool().put(&record_vec[offset],
@@ -2258,6 +2773,9 @@ void SlotRecordInMemoryDataFeed::LoadIntoMemoryByCommand(void) {
     } else {
       SlotRecordPool().put(&record_vec);
     }
+    if (write_cache) {
+      cache_writer.Close();
+    }
     record_vec.clear();
     record_vec.shrink_to_fit();
     timeline.Pause();
@@ -2265,13 +2783,99 @@ void SlotRecordInMemoryDataFeed::LoadIntoMemoryByCommand(void) {
             << ", lines=" << lines
             << ", sample lines=" << line_reader.get_sample_line()
             << ", cost time=" << timeline.ElapsedSec()
-            << " seconds, thread_id=" << thread_id_;
+            << " seconds, thread_id=" << thread_id_ << ", speed="
+            << line_reader.file_size() / 1024.0 / 1024.0 /
+                   timeline.ElapsedSec()
+            << "MB/s";
   }
   VLOG(3) << "LoadIntoMemory() end, thread_id=" << thread_id_
           << ", total size: " << line_reader.file_size();
 #endif
 }
 
+static inline const char* skip_spaces(const char* str) {
+  while (*str == ' ' || *str == '\t') {
+    ++str;
+  }
+  return str;
+}
+
+static inline bool is_digit(char c) {
+  return static_cast<unsigned>(c - '0') < 10u;
+}
+
+// Hand-written number scanners for the slot text format. They take the
+// plain decimal forms the data generators write and leave anything else,
+// e.g. signs on ids, nan, or numbers too long to convert exactly, to libc.
+static inline uint64_t fast_strtoull(const char* str, char** endptr) {
+  const char* p = skip_spaces(str);
+  const char* begin = p;
+  uint64_t value = 0;
+  while (is_digit(*p) && p - begin < 19) {
+    value = value * 10 + (*p - '0');
+    ++p;
+  }
+  if (p == begin || is_digit(*p)) {
+    return strtoull(str, endptr, 10);
+  }
+  *endptr = const_cast<char*>(p);
+  return value;
+}
+
+static inline float fast_strtof(const char* str, char** endptr) {
+  // powers of ten that are exact in double
+  static const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+  const char* p = skip_spaces(str);
+  bool negative = false;
+  if (*p == '-' || *p == '+') {
+    negative = (*p == '-');
+    ++p;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  for (; is_digit(*p); ++p, ++digits) {
+    mantissa = mantissa * 10 + (*p - '0');
+  }
+  if (*p == '.') {
+    for (++p; is_digit(*p); ++p, ++digits, --exponent) {
+      mantissa = mantissa * 10 + (*p - '0');
+    }
+  }
+  // at most 15 digits keep the mantissa exact in a double
+  if (digits == 0 || digits > 15) {
+    return strtof(str, endptr);
+  }
+  if (*p == 'e' || *p == 'E') {
+    const char* q = p + 1;
+    bool negative_exponent = false;
+    if (*q == '-' || *q == '+') {
+      negative_exponent = (*q == '-');
+      ++q;
+    }
+    const char* exponent_begin = q;
+    int value = 0;
+    for (; is_digit(*q) && value < 1000; ++q) {
+      value = value * 10 + (*q - '0');
+    }
+    if (q == exponent_begin || is_digit(*q)) {
+      return strtof(str, endptr);
+    }
+    exponent += negative_exponent ? -value : value;
+    p = q;
+  }
+  if (exponent < -22 || exponent > 22) {
+    return strtof(str, endptr);
+  }
+  double value = static_cast<double>(mantissa);
+  value = exponent < 0 ? value / kPow10[-exponent] : value * kPow10[exponent];
+  *endptr = const_cast<char*>(p);
+  return static_cast<float>(negative ? -value : value);
+}
+
 static void parser_log_key(const std::string& log_key, uint64_t* search_id,
                            uint32_t* cmatch, uint32_t* rank) {
   std::string searchid_str = log_key.substr(16, 16);
@@ -2284,38 +2888,40 @@ static void parser_log_key(const std::string& log_key, uint64_t* search_id,
 
 bool SlotRecordInMemoryDataFeed::ParseOneInstance(const std::string& line,
                                                   SlotRecord* ins) {
+  return ParseOneInstance(line.c_str(), ins);
+}
+
+// Parses straight into the record's slot value pools. Records come from
+// SlotRecordPool with their vectors cleared but not shrunk, so once the
+// pool is warm a line is parsed without any allocation.
+bool SlotRecordInMemoryDataFeed::ParseOneInstance(const char* str,
+                                                  SlotRecord* ins) {
   SlotRecord& rec = (*ins);
-  // parse line
-  const char* str = line.c_str();
+  const char* cursor = str;
   char* endptr = const_cast<char*>(str);
-  int pos = 0;
-
-  thread_local std::vector<std::vector<float>> slot_float_feasigns;
-  thread_local std::vector<std::vector<uint64_t>> slot_uint64_feasigns;
-  slot_float_feasigns.resize(float_use_slot_size_);
-  slot_uint64_feasigns.resize(uint64_use_slot_size_);
 
-  if (parse_ins_id_) {
-    int num = strtol(&str[pos], &endptr, 10);
+  auto read_word = [&cursor](size_t* len) {
+    int num = strtol(cursor, const_cast<char**>(&cursor), 10);
     CHECK(num == 1);  // NOLINT
-    pos = endptr - str + 1;
+    cursor = skip_spaces(cursor);
+    *len = 0;
+    while (cursor[*len] != ' ' && cursor[*len] != '\0') {
+      ++(*len);
+    }
+    const char* word = cursor;
+    cursor += *len;
+    return word;
+  };
+  if (parse_ins_id_) {
     size_t len = 0;
-    while (str[pos + len] != ' ') {
-      ++len;
-    }
-    rec->ins_id_ = std::string(str + pos, len);
-    pos += len + 1;
+    const char* word = read_word(&len);
+    rec->ins_id_.assign(word, len);
   }
   if (parse_logkey_) {
-    int num = strtol(&str[pos], &endptr, 10);
-    CHECK(num == 1);  // NOLINT
-    pos = endptr - str + 1;
     size_t len = 0;
-    while (str[pos + len] != ' ') {
-      ++len;
-    }
+    const char* word = read_word(&len);
     // parse_logkey
-    std::string log_key = std::string(str + pos, len);
+    std::string log_key(word, len);
     uint64_t search_id;
     uint32_t cmatch;
     uint32_t rank;
@@ -2325,15 +2931,22 @@ bool SlotRecordInMemoryDataFeed::ParseOneInstance(const std::string& line,
     rec->search_id = search_id;
     rec->cmatch = cmatch;
     rec->rank = rank;
-    pos += len + 1;
   }
 
-  int float_total_slot_num = 0;
-  int uint64_total_slot_num = 0;
+  auto& float_feasigns = rec->slot_float_feasigns_;
+  auto& uint64_feasigns = rec->slot_uint64_feasigns_;
+  float_feasigns.clear(false);
+  uint64_feasigns.clear(false);
+  float_feasigns.slot_offsets.resize(float_use_slot_size_ + 1);
+  uint64_feasigns.slot_offsets.resize(uint64_use_slot_size_ + 1);
+  auto& float_values = float_feasigns.slot_values;
+  auto& uint64_values = uint64_feasigns.slot_values;
 
+  // slot_value_idx follows the slot order of the line, so every slot just
+  // records where its values start in the shared pool
   for (size_t i = 0; i < all_slots_info_.size(); ++i) {
     auto& info = all_slots_info_[i];
-    int num = strtol(&str[pos], &endptr, 10);
+    int num = static_cast<int>(fast_strtoull(cursor, &endptr));
     PADDLE_ENFORCE(num,
                    "The number of ids can not be zero, you need padding "
                    "it in data generator; or if there is something wrong with "
@@ -2342,45 +2955,43 @@ bool SlotRecordInMemoryDataFeed::ParseOneInstance(const std::string& line,
                    str);
     if (info.used_idx != -1) {
       if (info.type[0] == 'f') {  // float
-        auto& slot_fea = slot_float_feasigns[info.slot_value_idx];
-        slot_fea.clear();
+        float_feasigns.slot_offsets[info.slot_value_idx] =
+            static_cast<uint32_t>(float_values.size());
         for (int j = 0; j < num; ++j) {
-          float feasign = strtof(endptr, &endptr);
+          float feasign = fast_strtof(endptr, &endptr);
           if (fabs(feasign) < 1e-6 && !used_slots_info_[info.used_idx].dense) {
             continue;
           }
-          slot_fea.push_back(feasign);
-          ++float_total_slot_num;
+          float_values.push_back(feasign);
         }
       } else if (info.type[0] == 'u') {  // uint64
-        auto& slot_fea = slot_uint64_feasigns[info.slot_value_idx];
-        slot_fea.clear();
+        uint64_feasigns.slot_offsets[info.slot_value_idx] =
+            static_cast<uint32_t>(uint64_values.size());
         for (int j = 0; j < num; ++j) {
-          uint64_t feasign =
-              static_cast<uint64_t>(strtoull(endptr, &endptr, 10));
+          uint64_t feasign = fast_strtoull(endptr, &endptr);
           if (feasign == 0 && !used_slots_info_[info.used_idx].dense) {
             continue;
           }
-          slot_fea.push_back(feasign);
-          ++uint64_total_slot_num;
+          uint64_values.push_back(feasign);
         }
       }
-      pos = endptr - str;
+      cursor = endptr;
     } else {
-      for (int j = 0; j <= num; ++j) {
-        // pos = line.find_first_of(' ', pos + 1);
-        while (line[pos + 1] != ' ') {
-          pos++;
+      cursor = endptr;
+      for (int j = 0; j < num; ++j) {
+        cursor = skip_spaces(cursor);
+        while (*cursor != ' ' && *cursor != '\0') {
+          ++cursor;
         }
       }
     }
   }
-  rec->slot_float_feasigns_.add_slot_feasigns(slot_float_feasigns,
-                                              float_total_slot_num);
-  rec->slot_uint64_feasigns_.add_slot_feasigns(slot_uint64_feasigns,
-                                               uint64_total_slot_num);
+  float_feasigns.slot_offsets[float_use_slot_size_] =
+      static_cast<uint32_t>(float_values.size());
+  uint64_feasigns.slot_offsets[uint64_use_slot_size_] =
+      static_cast<uint32_t>(uint64_values.size());
 
-  return (uint64_total_slot_num > 0);
+  return (!uint64_values.empty());
 }
 
 void SlotRecordInMemoryDataFeed::PutToFeedVec(const SlotRecord* ins_vec,
@@ -46,6 +46,7 @@ DECLARE_int32(record_pool_max_size);
 DECLARE_int32(slotpool_thread_num);
 DECLARE_bool(enable_slotpool_wait_release);
 DECLARE_bool(enable_slotrecord_reset_shrink);
+DECLARE_string(slotrecord_binary_cache_dir);
 
 namespace paddle {
 namespace framework {
@@ -1131,6 +1132,13 @@ class SlotRecordInMemoryDataFeed : public InMemoryDataFeed<SlotRecord> {
     input_channel_ = static_cast<ChannelObject<SlotRecord>*>(channel);
   }
   bool ParseOneInstance(const std::string& line, SlotRecord* rec);
+  bool ParseOneInstance(const char* line, SlotRecord* rec);
+  // binary cache of parsed local files under
+  // FLAGS_slotrecord_binary_cache_dir, remote files are not cached
+  std::string GetBinaryCachePath(const std::string& filename,
+                                 uint64_t* cache_key);
+  bool LoadFromBinaryCache(const std::string& path, uint64_t cache_key,
+                           int* lines);
   virtual void PutToFeedVec(const SlotRecord* ins_vec, int num);
   float sample_rate_ = 1.0f;
   int use_slot_size_ = 0;
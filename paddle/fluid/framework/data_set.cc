@@ -20,6 +20,7 @@
 #include "paddle/fluid/framework/data_feed_factory.h"
 #include "paddle/fluid/framework/fleet/fleet_wrapper.h"
 #include "paddle/fluid/framework/io/fs.h"
+#include "paddle/fluid/framework/parallel_shuffle.h"
 #include "paddle/fluid/platform/monitor.h"
 #include "paddle/fluid/platform/timer.h"
 
@@ -544,7 +545,8 @@ void DatasetImpl<T>::LocalShuffle() {
   input_channel_->Close();
   std::vector<T> data;
   input_channel_->ReadAll(data);
-  std::shuffle(data.begin(), data.end(), fleet_ptr->LocalRandomEngine());
+  size_t record_num = data.size();
+  ParallelShuffle(&data, thread_num_, fleet_ptr->LocalRandomEngine()());
   input_channel_->Open();
   input_channel_->Write(std::move(data));
   data.clear();
@@ -553,7 +555,9 @@ void DatasetImpl<T>::LocalShuffle() {
 
   timeline.Pause();
   VLOG(3) << "DatasetImpl<T>::LocalShuffle() end, cost time="
-          << timeline.ElapsedSec() << " seconds";
+          << timeline.ElapsedSec() << " seconds, "
+          << record_num / std::max(timeline.ElapsedSec(), 1e-6)
+          << " records/s";
 }
 
 // do tdm sample
@@ -652,16 +656,14 @@ void MultiSlotDataset::GlobalShuffle(int thread_num) {
   input_channel_->Close();
   std::vector<Record> data;
   input_channel_->ReadAll(data);
-  std::shuffle(data.begin(), data.end(), fleet_ptr->LocalRandomEngine());
-  input_channel_->Open();
-  input_channel_->Write(std::move(data));
-  data.clear();
-  data.shrink_to_fit();
-
-  input_channel_->Close();
-  input_channel_->SetBlockSize(fleet_send_batch_size_);
+  size_t record_num = data.size();
+  if (thread_num == -1) {
+    thread_num = thread_num_;
+  }
+  thread_num = std::max(thread_num, 1);
+  ParallelShuffle(&data, thread_num, fleet_ptr->LocalRandomEngine()());
   VLOG(3) << "MultiSlotDataset::GlobalShuffle() input_channel_ size "
-          << input_channel_->Size();
+          << record_num;
 
   auto get_client_id = [this, fleet_ptr](const Record& data) -> size_t {
     if (!this->merge_by_insid_) {
@@ -672,69 +674,54 @@ void MultiSlotDataset::GlobalShuffle(int thread_num) {
     }
   };
 
-  auto global_shuffle_func = [this, get_client_id]() {
+  // Each thread buckets its slice of the records by trainer and sends a
+  // bucket once it holds fleet_send_batch_size_ records, so every message
+  // is a full batch instead of 1/trainer_num_ of one. At most trainer_num_
+  // messages are in flight per thread.
+  VLOG(3) << "start global shuffle threads, num = " << thread_num;
+  std::vector<std::vector<std::future<int32_t>>> total_status(thread_num);
+  auto send_func = [this, &total_status](int thread_id, size_t client_id,
+                                         std::vector<Record>* records) {
 #ifdef PADDLE_WITH_PSCORE
     auto fleet_ptr = distributed::FleetWrapper::GetInstance();
 #else
     auto fleet_ptr = framework::FleetWrapper::GetInstance();
 #endif
-    // auto fleet_ptr = framework::FleetWrapper::GetInstance();
-    std::vector<Record> data;
-    while (this->input_channel_->Read(data)) {
-      std::vector<paddle::framework::BinaryArchive> ars(this->trainer_num_);
-      for (auto& t : data) {
-        auto client_id = get_client_id(t);
-        ars[client_id] << t;
-      }
-      std::vector<std::future<int32_t>> total_status;
-      std::vector<int> send_index(this->trainer_num_);
-      for (int i = 0; i < this->trainer_num_; ++i) {
-        send_index[i] = i;
-      }
-      std::shuffle(send_index.begin(), send_index.end(),
-                   fleet_ptr->LocalRandomEngine());
-      for (int index = 0; index < this->trainer_num_; ++index) {
-        int i = send_index[index];
-        if (ars[i].Length() == 0) {
-          continue;
-        }
-        std::string msg(ars[i].Buffer(), ars[i].Length());
-        auto ret = fleet_ptr->SendClientToClientMsg(0, i, msg);
-        total_status.push_back(std::move(ret));
-      }
-      for (auto& t : total_status) {
+    auto& status = total_status[thread_id];
+    if (status.size() >= static_cast<size_t>(this->trainer_num_)) {
+      for (auto& t : status) {
         t.wait();
       }
-      ars.clear();
-      ars.shrink_to_fit();
-      data.clear();
-      data.shrink_to_fit();
-      // currently we find bottleneck is server not able to handle large data
-      // in time, so we can remove this sleep and set fleet_send_batch_size to
-      // 1024, and set server thread to 24.
-      if (fleet_send_sleep_seconds_ != 0) {
-        sleep(this->fleet_send_sleep_seconds_);
-      }
+      status.clear();
+    }
+    paddle::framework::BinaryArchive ar;
+    for (auto& t : *records) {
+      ar << t;
+    }
+    std::string msg(ar.Buffer(), ar.Length());
+    status.push_back(fleet_ptr->SendClientToClientMsg(0, client_id, msg));
+    // currently we find bottleneck is server not able to handle large data
+    // in time, so we can remove this sleep and set fleet_send_batch_size to
+    // 1024, and set server thread to 24.
+    if (fleet_send_sleep_seconds_ != 0) {
+      sleep(this->fleet_send_sleep_seconds_);
     }
   };
-
-  std::vector<std::thread> global_shuffle_threads;
-  if (thread_num == -1) {
-    thread_num = thread_num_;
-  }
-  VLOG(3) << "start global shuffle threads, num = " << thread_num;
-  for (int i = 0; i < thread_num; ++i) {
-    global_shuffle_threads.push_back(std::thread(global_shuffle_func));
-  }
-  for (std::thread& t : global_shuffle_threads) {
-    t.join();
+  ParallelPartition(&data, trainer_num_, thread_num, fleet_send_batch_size_,
+                    get_client_id, send_func);
+  for (auto& status : total_status) {
+    for (auto& t : status) {
+      t.wait();
+    }
   }
-  global_shuffle_threads.clear();
-  global_shuffle_threads.shrink_to_fit();
+  data.clear();
+  data.shrink_to_fit();
   input_channel_->Clear();
   timeline.Pause();
   VLOG(3) << "DatasetImpl<T>::GlobalShuffle() end, cost time="
-          << timeline.ElapsedSec() << " seconds";
+          << timeline.ElapsedSec() << " seconds, "
+          << record_num / std::max(timeline.ElapsedSec(), 1e-6)
+          << " records/s";
 }
 
 template <typename T>
@@ -1042,11 +1029,7 @@ int MultiSlotDataset::ReceiveFromClient(int msg_type, int client_id,
   // to make sure each channel get data equally, we just put data to
   // channel one by one.
   // int64_t index = fleet_ptr->LocalRandomEngine()() % channel_num_;
-  int64_t index = 0;
-  {
-    std::unique_lock<std::mutex> lk(global_index_mutex_);
-    index = global_index_++;
-  }
+  int64_t index = global_index_.fetch_add(1, std::memory_order_relaxed);
   index = index % channel_num_;
   VLOG(3) << "ramdom index=" << index;
   multi_output_channel_[index]->Write(std::move(data));
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <ThreadPool.h>
+#include <atomic>
 #include <fstream>
 #include <memory>
 #include <mutex>  // NOLINT
@@ -313,8 +314,7 @@ class DatasetImpl : public Dataset {
   bool slots_shuffle_fea_eval_ = false;
   bool gen_uni_feasigns_ = false;
   int preload_thread_num_;
-  std::mutex global_index_mutex_;
-  int64_t global_index_ = 0;
+  std::atomic<int64_t> global_index_{0};
   std::vector<std::shared_ptr<ThreadPool>> consume_task_pool_;
   std::vector<T> input_records_;  // only for paddleboxdatafeed
   bool enable_heterps_ = false;
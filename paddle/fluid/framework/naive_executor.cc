@@ -127,6 +127,21 @@ void NaiveExecutor::CleanFeedFetchOps() {
   ops_.swap(ops);
 }
 
+void NaiveExecutor::ShareKernelsFrom(const NaiveExecutor &other) {
+  if (ops_.size() != other.ops_.size()) {
+    VLOG(3) << "Skip sharing kernels between executors with "
+            << other.ops_.size() << " and " << ops_.size() << " ops";
+    return;
+  }
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    auto *op = dynamic_cast<OperatorWithKernel *>(ops_[i].get());
+    auto *other_op = dynamic_cast<OperatorWithKernel *>(other.ops_[i].get());
+    if (op && other_op && op->Type() == other_op->Type()) {
+      op->ShareKernelFrom(*other_op);
+    }
+  }
+}
+
 NaiveExecutor::~NaiveExecutor() {
 #ifdef PADDLE_WITH_MKLDNN
   // Clear mkl-dnn cache,
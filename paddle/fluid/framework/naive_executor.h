@@ -68,6 +68,10 @@ class NaiveExecutor {
 
   void ResetTrtOps(int num);
 
+  // Reuse the kernels chosen by the operators of other, an executor prepared
+  // with the same program, instead of choosing them again on the first Run.
+  void ShareKernelsFrom(const NaiveExecutor& other);
+
  protected:
   void CreateOps(const ProgramDesc& desc, int block_id,
                  bool with_feed_fetch_ops);
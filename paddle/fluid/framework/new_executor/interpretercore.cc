@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "paddle/fluid/framework/new_executor/interpretercore.h"
+#include <chrono>  // NOLINT
 #include <unordered_set>
 #include "paddle/fluid/framework/details/nan_inf_utils.h"
 #include "paddle/fluid/framework/details/share_tensor_buffer_functor.h"
@@ -30,6 +31,12 @@ PADDLE_DEFINE_EXPORTED_bool(new_executor_use_inplace, true,
 PADDLE_DEFINE_EXPORTED_bool(new_executor_use_local_scope, true,
                             "Use local_scope in new executor(especially used "
                             "in UT), can turn off for better performance");
+PADDLE_DEFINE_EXPORTED_bool(
+    new_executor_use_priority_schedule, false,
+    "Dispatch ready ops of the new executor by priority, the cost of the "
+    "longest path from the op to the end of the block, so that ops on the "
+    "critical path of wide graphs are started first. Op costs are measured "
+    "on previous runs.");
 
 DECLARE_bool(check_nan_inf);
 DECLARE_bool(benchmark);
@@ -187,6 +194,32 @@ void InterpreterCore::BuildOperatorDependences() {
       dependecy_count_[inst_id]++;
     }
   }
+
+  instr_cost_ = std::vector<std::atomic<int64_t>>(op_nums);
+  BuildInstructionPriority();
+}
+
+// The priority of an instruction is the cost of the longest path from it to
+// the end of the block, the instruction included. Costs are the run times
+// measured in previous steps, every instruction also counts 1ns so that an
+// unmeasured graph is ranked by path length. Downstream instructions always
+// have larger ids, so a reverse sweep sees them before their upstream.
+void InterpreterCore::BuildInstructionPriority() {
+  auto op_nums = vec_instruction_.size();
+  instr_priority_.resize(op_nums);
+  for (size_t i = op_nums; i-- > 0;) {
+    auto& next_instr = vec_instruction_[i].NextInstructions();
+    int64_t longest = 0;
+    for (auto* next_ids :
+         {&next_instr.DirectRunIds(), &next_instr.EventRunIds(),
+          &next_instr.SyncRunIds()}) {
+      for (auto next_id : *next_ids) {
+        longest = std::max(longest, instr_priority_[next_id]);
+      }
+    }
+    instr_priority_[i] =
+        longest + instr_cost_[i].load(std::memory_order_relaxed) + 1;
+  }
 }
 
 void InterpreterCore::Convert(
@@ -461,10 +494,21 @@ void InterpreterCore::ExecuteInstructionList(
 
   exception_holder_.Clear();
 
+  use_priority_schedule_ = FLAGS_new_executor_use_priority_schedule;
+  if (use_priority_schedule_) {
+    BuildInstructionPriority();
+  }
+
   for (size_t i = 0; i < dependecy_count_.size(); ++i) {
     if (dependecy_count_[i] == 0) {
-      async_work_queue_->AddTask(vec_instr.at(i).KernelType(),
-                                 [&, i] { RunInstructionAsync(i); });
+      if (use_priority_schedule_) {
+        async_work_queue_->AddTask(vec_instr.at(i).KernelType(),
+                                   [&, i] { RunInstructionAsync(i); },
+                                   instr_priority_[i]);
+      } else {
+        async_work_queue_->AddTask(vec_instr.at(i).KernelType(),
+                                   [&, i] { RunInstructionAsync(i); });
+      }
     }
   }
 
@@ -494,14 +538,24 @@ void InterpreterCore::RunNextInstructions(
   auto IsReady = [&](size_t next_id) {
     return atomic_deps[next_id]->fetch_sub(1, std::memory_order_relaxed) == 1;
   };
+  auto AddTask = [&](size_t next_id) {
+    if (use_priority_schedule_) {
+      async_work_queue_->AddTask(
+          vec_instruction_[next_id].KernelType(),
+          [&, next_id] { RunInstructionAsync(next_id); },
+          instr_priority_[next_id]);
+    } else {
+      async_work_queue_->AddTask(
+          vec_instruction_[next_id].KernelType(),
+          [&, next_id] { RunInstructionAsync(next_id); });
+    }
+  };
 
   if (instr.KernelType() == OpFuncType::kQueueAsync) {
     // move all sync_ops into other threads
     for (auto next_id : next_instr.SyncRunIds()) {
       if (IsReady(next_id)) {
-        async_work_queue_->AddTask(
-            vec_instruction_[next_id].KernelType(),
-            [&, next_id] { RunInstructionAsync(next_id); });
+        AddTask(next_id);
       }
     }
     // keep all async_ops running in current thread
@@ -519,9 +573,7 @@ void InterpreterCore::RunNextInstructions(
     // move async_ops into async_thread
     for (auto next_id : next_instr.EventRunIds()) {
       if (IsReady(next_id)) {
-        async_work_queue_->AddTask(
-            vec_instruction_[next_id].KernelType(),
-            [&, next_id] { RunInstructionAsync(next_id); });
+        AddTask(next_id);
       }
     }
     auto direct_run_ops = interpreter::merge_vector(next_instr.SyncRunIds(),
@@ -534,10 +586,13 @@ void InterpreterCore::RunNextInstructions(
           first_op = next_id;
           continue;
         }
+        // with priority schedule keep the most urgent one instead
+        if (use_priority_schedule_ &&
+            instr_priority_[next_id] > instr_priority_[first_op]) {
+          std::swap(first_op, next_id);
+        }
         // move rest ops into other threads
-        async_work_queue_->AddTask(
-            vec_instruction_[next_id].KernelType(),
-            [&, next_id] { RunInstructionAsync(next_id); });
+        AddTask(next_id);
       }
     }
     if (first_op != 0) reserved_next_ops->push(first_op);
@@ -556,7 +611,20 @@ void InterpreterCore::RunInstructionAsync(size_t instr_id) {
     interpreter::WaitEvent(instr_node, place_);
 
     try {
-      RunInstruction(instr_node);
+      if (use_priority_schedule_) {
+        auto start = std::chrono::steady_clock::now();
+        RunInstruction(instr_node);
+        int64_t cost = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        // smooth over steps, the first measurement is taken as is
+        auto& instr_cost = instr_cost_[instr_id];
+        int64_t last = instr_cost.load(std::memory_order_relaxed);
+        instr_cost.store(last == 0 ? cost : (last * 3 + cost) / 4,
+                         std::memory_order_relaxed);
+      } else {
+        RunInstruction(instr_node);
+      }
 
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
       RecordStreamForGC(instr_node);
@@ -86,6 +86,8 @@ class InterpreterCore {
 
   void BuildOperatorDependences();
 
+  void BuildInstructionPriority();
+
   void SetFeedVarsInplaceSkip(const std::vector<std::string>& feed_names);
 
   void ClearLoDTensorArrayInLocalScope();
@@ -105,6 +107,10 @@ class InterpreterCore {
   std::vector<Instruction> vec_instruction_;  // deconstruct before OpFuncNode
 
   std::vector<size_t> dependecy_count_;
+  // see FLAGS_new_executor_use_priority_schedule
+  bool use_priority_schedule_{false};
+  std::vector<int64_t> instr_priority_;
+  std::vector<std::atomic<int64_t>> instr_cost_;  // ns, 0 if not measured
   std::atomic<size_t> unfinished_op_numer_{0};
   std::vector<std::vector<size_t>> input_var2op_info_;
 
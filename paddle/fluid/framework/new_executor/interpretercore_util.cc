@@ -43,6 +43,17 @@ void AsyncWorkQueue::AddTask(const OpFuncType& op_func_type,
   }
 }
 
+void AsyncWorkQueue::AddTask(const OpFuncType& op_func_type,
+                             std::function<void()> fn, int64_t priority) {
+  if (FLAGS_new_executor_sequential_run) {
+    queue_group_->AddTaskWithPriority(
+        static_cast<size_t>(OpFuncType::kQueueAsync), std::move(fn), priority);
+  } else {
+    queue_group_->AddTaskWithPriority(static_cast<size_t>(op_func_type),
+                                      std::move(fn), priority);
+  }
+}
+
 using VariableIdMap = std::map<std::string, std::vector<int>>;
 
 AtomicVectorSizeT& AsyncWorkQueue::PrepareAtomicDeps(
@@ -81,6 +81,10 @@ class AsyncWorkQueue {
 
   void AddTask(const OpFuncType& op_func_type, std::function<void()> fn);
 
+  // Same as above, but tasks with a larger priority are run first.
+  void AddTask(const OpFuncType& op_func_type, std::function<void()> fn,
+               int64_t priority);
+
   void Cancel() { queue_group_->Cancel(); }
 
   AtomicVectorSizeT& AtomicDeps() { return atomic_deps_; }
@@ -7,12 +7,18 @@
 // Public License v. 2.0. If a copy of the MPL was not distributed
 // with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+// What changed by PaddlePaddle
+//   1. Every thread owns a PriorityRunQueue besides its RunQueue. Tasks
+//      added by AddTaskWithPriority go there, are popped before the FIFO
+//      tasks, and thieves take the victim's highest-priority task first.
+
 #pragma once
 
 #include <atomic>
 #include <cstdlib>
 #include <vector>
 #include "paddle/fluid/framework/new_executor/workqueue/event_count.h"
+#include "paddle/fluid/framework/new_executor/workqueue/priority_run_queue.h"
 #include "paddle/fluid/framework/new_executor/workqueue/run_queue.h"
 #include "paddle/fluid/framework/new_executor/workqueue/thread_environment.h"
 #include "paddle/fluid/platform/os_info.h"
@@ -73,6 +79,7 @@ class ThreadPoolTempl {
       // Empty them to prevent their destructor from asserting.
       for (size_t i = 0; i < thread_data_.size(); i++) {
         thread_data_[i].queue.Flush();
+        thread_data_[i].priority_queue.Flush();
       }
     }
     // Join threads explicitly (by destroying) to avoid destruction order within
@@ -136,6 +143,21 @@ class ThreadPoolTempl {
     }
   }
 
+  // Tasks with a larger priority run first. A worker thread of this pool
+  // pushes onto its own priority queue, other threads onto a random one;
+  // idle workers steal the highest-priority task of a victim.
+  void AddTaskWithPriority(std::function<void()> fn, int64_t priority) {
+    Task t = env_.CreateTask(std::move(fn));
+    PerThread* pt = GetPerThread();
+    uint64_t num_tasks = num_tasks_.fetch_add(1, std::memory_order_relaxed) + 1;
+    int queue_id = pt->pool == this ? pt->thread_id
+                                    : Rand(&pt->rand) % num_threads_;
+    thread_data_[queue_id].priority_queue.Push(std::move(t), priority);
+    if (num_tasks > num_threads_ - blocked_.load(std::memory_order_relaxed)) {
+      ec_.Notify(false);
+    }
+  }
+
   void Cancel() {
     cancelled_ = true;
     done_ = true;
@@ -222,10 +244,12 @@ class ThreadPoolTempl {
   };
 
   struct ThreadData {
-    constexpr ThreadData() : thread(), steal_partition(0), queue() {}
+    constexpr ThreadData()
+        : thread(), steal_partition(0), queue(), priority_queue() {}
     std::unique_ptr<Thread> thread;
     std::atomic<unsigned> steal_partition;
     Queue queue;
+    PriorityRunQueue<Task> priority_queue;
   };
 
   Environment env_;
@@ -247,7 +271,6 @@ class ThreadPoolTempl {
     pt->pool = this;
     pt->rand = GlobalThreadIdHash();
     pt->thread_id = thread_id;
-    Queue& q = thread_data_[thread_id].queue;
     EventCount::Waiter* waiter = ec_.GetWaiter(thread_id);
     // TODO(dvyukov,rmlarsen): The time spent in NonEmptyQueueIndex() is
     // proportional to num_threads_ and we assume that new work is scheduled at
@@ -263,10 +286,10 @@ class ThreadPoolTempl {
       // counter-productive for the types of I/O workloads the single thread
       // pools tend to be used for.
       while (!cancelled_) {
-        Task t = q.PopFront();
+        Task t = PopLocal(thread_id);
         for (int i = 0; i < spin_count && !t.f; i++) {
           if (!cancelled_.load(std::memory_order_relaxed)) {
-            t = q.PopFront();
+            t = PopLocal(thread_id);
           }
         }
         if (!t.f) {
@@ -281,7 +304,7 @@ class ThreadPoolTempl {
       }
     } else {
       while (!cancelled_) {
-        Task t = q.PopFront();
+        Task t = PopLocal(thread_id);
         if (!t.f) {
           t = LocalSteal();
           if (!t.f) {
@@ -312,6 +335,27 @@ class ThreadPoolTempl {
     }
   }
 
+  // Own tasks: the most urgent prioritized one, else the newest FIFO one.
+  Task PopLocal(int thread_id) {
+    ThreadData& td = thread_data_[thread_id];
+    Task t = td.priority_queue.Pop();
+    if (!t.f) {
+      t = td.queue.PopFront();
+    }
+    return t;
+  }
+
+  // Take the most urgent prioritized task of the victim, else its oldest
+  // FIFO one.
+  Task PopVictim(unsigned victim) {
+    ThreadData& td = thread_data_[victim];
+    Task t = td.priority_queue.Pop();
+    if (!t.f) {
+      t = td.queue.PopBack();
+    }
+    return t;
+  }
+
   // Steal tries to steal work from other worker threads in the range [start,
   // limit) in best-effort manner.
   Task Steal(unsigned start, unsigned limit) {
@@ -328,7 +372,7 @@ class ThreadPoolTempl {
 
     for (unsigned i = 0; i < size; i++) {
       assert(start + victim < limit);
-      Task t = thread_data_[start + victim].queue.PopBack();
+      Task t = PopVictim(start + victim);
       if (t.f) {
         return t;
       }
@@ -373,7 +417,7 @@ class ThreadPoolTempl {
     int victim = NonEmptyQueueIndex();
     if (victim != -1) {
       ec_.CancelWait();
-      *t = thread_data_[victim].queue.PopBack();
+      *t = PopVictim(victim);
       return true;
     }
     // Number of blocked threads is used as termination condition.
@@ -416,7 +460,8 @@ class ThreadPoolTempl {
     unsigned inc = all_coprimes_[size - 1][r % all_coprimes_[size - 1].size()];
     unsigned victim = r % size;
     for (unsigned i = 0; i < size; i++) {
-      if (!thread_data_[victim].queue.Empty()) {
+      if (!thread_data_[victim].queue.Empty() ||
+          !thread_data_[victim].priority_queue.Empty()) {
         return victim;
       }
       victim += inc;
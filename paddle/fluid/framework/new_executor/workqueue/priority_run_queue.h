@@ -0,0 +1,101 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// PriorityRunQueue is an unbounded queue of Work items ordered by a priority
+// given at push time. The owner thread and thieves both take the item with
+// the highest priority, so stolen work is the most urgent work rather than
+// the oldest. Items of equal priority come out in push order. All
+// operations are serialized by a SpinLock; the queue is meant for a handful
+// of coarse tasks (one per operator), where the lock is never the
+// bottleneck.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "paddle/fluid/memory/allocation/spin_lock.h"
+
+namespace paddle {
+namespace framework {
+
+template <typename Work>
+class PriorityRunQueue {
+ public:
+  PriorityRunQueue() : size_(0), seq_(0) {}
+
+  PriorityRunQueue(const PriorityRunQueue&) = delete;
+  void operator=(const PriorityRunQueue&) = delete;
+
+  void Push(Work w, int64_t priority) {
+    std::unique_lock<paddle::memory::SpinLock> lock(mutex_);
+    heap_.push_back(Elem{priority, seq_++, std::move(w)});
+    std::push_heap(heap_.begin(), heap_.end(), Less);
+    size_.store(heap_.size(), std::memory_order_relaxed);
+  }
+
+  // Pop removes and returns the item with the highest priority.
+  // If the queue is empty returns default-constructed Work.
+  Work Pop() {
+    if (Empty()) {
+      return Work();
+    }
+    std::unique_lock<paddle::memory::SpinLock> lock(mutex_);
+    if (heap_.empty()) {
+      return Work();
+    }
+    std::pop_heap(heap_.begin(), heap_.end(), Less);
+    Work w = std::move(heap_.back().w);
+    heap_.pop_back();
+    size_.store(heap_.size(), std::memory_order_relaxed);
+    return w;
+  }
+
+  // Delete all items, used when the owning pool is cancelled.
+  void Flush() {
+    std::unique_lock<paddle::memory::SpinLock> lock(mutex_);
+    heap_.clear();
+    size_.store(0, std::memory_order_relaxed);
+  }
+
+  // Empty and Size are racy without the lock, like RunQueue::Empty.
+  bool Empty() const { return Size() == 0; }
+
+  size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Elem {
+    int64_t priority;
+    uint64_t seq;
+    Work w;
+  };
+
+  static bool Less(const Elem& a, const Elem& b) {
+    if (a.priority != b.priority) {
+      return a.priority < b.priority;
+    }
+    return a.seq > b.seq;
+  }
+
+  paddle::memory::SpinLock mutex_;
+  std::vector<Elem> heap_;
+  std::atomic<size_t> size_;
+  uint64_t seq_;
+};
+
+}  // namespace framework
+}  // namespace paddle
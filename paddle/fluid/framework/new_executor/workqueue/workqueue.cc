@@ -60,6 +60,18 @@ class WorkQueueImpl : public WorkQueue {
     queue_->AddTask(std::move(fn));
   }
 
+  void AddTaskWithPriority(std::function<void()> fn,
+                           int64_t priority) override {
+    if (tracker_ != nullptr) {
+      fn = [
+        task = std::move(fn), raii = CounterGuard<TaskTracker>(tracker_)
+      ]() mutable {
+        task();
+      };
+    }
+    queue_->AddTaskWithPriority(std::move(fn), priority);
+  }
+
   void Cancel() override {
     queue_->Cancel();
     queue_->WaitThreadsExit();
@@ -83,6 +95,9 @@ class WorkQueueGroupImpl : public WorkQueueGroup {
 
   void AddTask(size_t queue_idx, std::function<void()> fn) override;
 
+  void AddTaskWithPriority(size_t queue_idx, std::function<void()> fn,
+                           int64_t priority) override;
+
   size_t QueueNumThreads(size_t queue_idx) const override;
 
   size_t QueueGroupNumThreads() const override;
@@ -156,6 +171,20 @@ void WorkQueueGroupImpl::AddTask(size_t queue_idx, std::function<void()> fn) {
   queues_[queue_idx]->AddTask(std::move(fn));
 }
 
+void WorkQueueGroupImpl::AddTaskWithPriority(size_t queue_idx,
+                                             std::function<void()> fn,
+                                             int64_t priority) {
+  assert(queue_idx < queues_.size());
+  if (queues_options_.at(queue_idx).track_task) {
+    fn = [
+      task = std::move(fn), raii = CounterGuard<TaskTracker>(tracker_)
+    ]() mutable {
+      task();
+    };
+  }
+  queues_[queue_idx]->AddTaskWithPriority(std::move(fn), priority);
+}
+
 size_t WorkQueueGroupImpl::QueueNumThreads(size_t queue_idx) const {
   assert(queue_idx < queues_.size());
   return queues_.at(queue_idx)->NumThreads();
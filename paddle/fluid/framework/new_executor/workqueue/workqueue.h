@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <functional>
 #include <memory>
 #include <vector>
@@ -65,6 +66,11 @@ class WorkQueue {
 
   virtual void AddTask(std::function<void()> fn) = 0;
 
+  // Tasks with a larger priority are picked first, both by the thread that
+  // owns them and by threads stealing from it.
+  virtual void AddTaskWithPriority(std::function<void()> fn,
+                                   int64_t priority) = 0;
+
   // See WorkQueueOptions.track_task for details
   // virtual void WaitQueueEmpty() = 0;
 
@@ -89,6 +95,9 @@ class WorkQueueGroup {
 
   virtual void AddTask(size_t queue_idx, std::function<void()> fn) = 0;
 
+  virtual void AddTaskWithPriority(size_t queue_idx, std::function<void()> fn,
+                                   int64_t priority) = 0;
+
   // See WorkQueueOptions.track_task for details
   // virtual void WaitQueueGroupEmpty() = 0;
 
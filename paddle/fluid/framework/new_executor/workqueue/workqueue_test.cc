@@ -14,6 +14,7 @@
 
 #include "paddle/fluid/framework/new_executor/workqueue/workqueue.h"
 #include <atomic>
+#include <vector>
 #include "glog/logging.h"
 #include "gtest/gtest.h"
 #include "paddle/fluid/framework/new_executor/workqueue/workqueue_utils.h"
@@ -151,3 +152,33 @@ TEST(WorkQueue, TestWorkQueueGroup) {
   queue_group.reset();
   EXPECT_EQ(events_waiter.WaitEvent(), paddle::framework::kQueueDestructEvent);
 }
+
+TEST(WorkQueue, TestAddTaskWithPriority) {
+  using paddle::framework::WorkQueueOptions;
+  using paddle::framework::WorkQueue;
+  using paddle::framework::CreateSingleThreadedWorkQueue;
+  using paddle::framework::EventsWaiter;
+  EventsWaiter events_waiter;
+  WorkQueueOptions options(/*num_threads*/ 1, /*allow_spinning*/ true,
+                           /*track_task*/ true, /*detached*/ true,
+                           &events_waiter);
+  auto work_queue = CreateSingleThreadedWorkQueue(options);
+  // keep the only thread busy until all tasks are queued
+  std::atomic<bool> running{false};
+  std::atomic<bool> start{false};
+  work_queue->AddTask([&running, &start]() {
+    running = true;
+    while (!start) {
+    }
+  });
+  while (!running) {
+  }
+  std::vector<int> order;
+  for (int priority : {1, 5, 3, 5, 2}) {
+    work_queue->AddTaskWithPriority(
+        [&order, priority]() { order.push_back(priority); }, priority);
+  }
+  start = true;
+  events_waiter.WaitEvent();
+  EXPECT_EQ(order, std::vector<int>({5, 5, 3, 2, 1}));
+}
@@ -1371,6 +1371,31 @@ pten::KernelKey OperatorWithKernel::ChoosePtenKernel(
   return pt_kernel_key;
 }
 
+void OperatorWithKernel::ShareKernelFrom(
+    const OperatorWithKernel& other) const {
+  PADDLE_ENFORCE_EQ(
+      type_, other.Type(),
+      platform::errors::InvalidArgument(
+          "Cannot share the kernel of operator %s with operator %s.",
+          other.Type(), type_));
+  if (other.kernel_type_.get() == nullptr) {
+    return;
+  }
+  // A pten kernel that is not run may still be replaced by the fallback
+  // logic of RunImpl, so it is chosen again by this op.
+  if (other.run_pten_kernel_) {
+    pt_kernel_signature_.reset(
+        new KernelSignature(*other.pt_kernel_signature_.get()));
+    pt_kernel_.reset(new pten::Kernel(*other.pt_kernel_.get()));
+    run_pten_kernel_ = true;
+  } else if (other.kernel_func_.get() != nullptr) {
+    kernel_func_.reset(new OpKernelFunc(*other.kernel_func_.get()));
+  } else {
+    return;
+  }
+  kernel_type_.reset(new OpKernelType(*other.kernel_type_.get()));
+}
+
 void OperatorWithKernel::ChooseKernel(const ExecutionContext& ctx) const {
   // check if op[type] has kernel registered.
   auto& all_op_kernels = AllOpKernels();
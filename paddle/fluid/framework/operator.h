@@ -631,6 +631,11 @@ class OperatorWithKernel : public OperatorBase {
 
   const OpKernelType* kernel_type() const { return kernel_type_.get(); }
 
+  // Reuse the kernel that other, an instance of the same op, chose on its
+  // first run, so that this op does not select it again. Nothing is done if
+  // other has not run yet.
+  void ShareKernelFrom(const OperatorWithKernel& other) const;
+
  private:
   void RunImpl(const Scope& scope, const platform::Place& place) const final;
   void RunImpl(const Scope& scope, const platform::Place& place,
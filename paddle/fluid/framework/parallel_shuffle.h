@@ -0,0 +1,141 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <random>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+namespace paddle {
+namespace framework {
+
+// Below this many records per thread the threads cost more than they save.
+constexpr size_t kParallelShuffleMinPerThread = 4096;
+
+// Uniform random permutation of data using thread_num threads. Every thread
+// scatters its slice of data into thread_num buckets chosen at random, then
+// thread b gathers bucket b from all threads into its final place in data
+// and shuffles it there. A random bucket assignment followed by a uniform
+// shuffle of each bucket gives every permutation the same probability, like
+// a single std::shuffle, while no step is serial or takes a lock.
+template <class T>
+void ParallelShuffle(std::vector<T>* data, int thread_num, uint64_t seed) {
+  size_t total = data->size();
+  thread_num = std::max(
+      1, std::min<int>(thread_num, total / kParallelShuffleMinPerThread));
+  if (thread_num == 1) {
+    std::mt19937_64 engine(seed);
+    std::shuffle(data->begin(), data->end(), engine);
+    return;
+  }
+
+  // buckets[t][b] holds the records thread t sent to bucket b
+  std::vector<std::vector<std::vector<T>>> buckets(thread_num);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937_64 engine(seed + t);
+      std::uniform_int_distribution<int> bucket_of(0, thread_num - 1);
+      size_t begin = total * t / thread_num;
+      size_t end = total * (t + 1) / thread_num;
+      auto& local = buckets[t];
+      local.resize(thread_num);
+      for (auto& bucket : local) {
+        bucket.reserve((end - begin) / thread_num * 5 / 4);
+      }
+      for (size_t i = begin; i < end; ++i) {
+        local[bucket_of(engine)].push_back(std::move((*data)[i]));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  threads.clear();
+
+  std::vector<size_t> offsets(thread_num + 1, 0);
+  for (int b = 0; b < thread_num; ++b) {
+    offsets[b + 1] = offsets[b];
+    for (int t = 0; t < thread_num; ++t) {
+      offsets[b + 1] += buckets[t][b].size();
+    }
+  }
+  for (int b = 0; b < thread_num; ++b) {
+    threads.emplace_back([&, b] {
+      auto out = data->begin() + offsets[b];
+      for (int t = 0; t < thread_num; ++t) {
+        auto& bucket = buckets[t][b];
+        out = std::move(bucket.begin(), bucket.end(), out);
+        std::vector<T>().swap(bucket);
+      }
+      std::mt19937_64 engine(seed + thread_num + b);
+      std::shuffle(data->begin() + offsets[b], out, engine);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+// Splits data among dest_num destinations using thread_num threads. Thread
+// t owns a contiguous slice of data and one buffer per destination, and
+// calls flush(t, dest, &buffer) each time a buffer reaches batch_size
+// records and once more for every non-empty buffer at the end, so the
+// caller sends a few large messages instead of many small ones. The final
+// flushes start at a different destination on every thread to keep the
+// threads from hitting the same receiver at once. dest_of(record) and flush
+// run concurrently on different threads; data is left moved-from.
+template <class T, class DestFunc, class FlushFunc>
+void ParallelPartition(std::vector<T>* data, int dest_num, int thread_num,
+                       size_t batch_size, DestFunc dest_of, FlushFunc flush) {
+  size_t total = data->size();
+  thread_num = std::max(1, std::min<int>(thread_num, total));
+  batch_size = std::max<size_t>(batch_size, 1);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      std::vector<std::vector<T>> buffers(dest_num);
+      size_t begin = total * t / thread_num;
+      size_t end = total * (t + 1) / thread_num;
+      for (size_t i = begin; i < end; ++i) {
+        size_t dest = dest_of((*data)[i]);
+        auto& buffer = buffers[dest];
+        if (buffer.empty()) {
+          buffer.reserve(batch_size);
+        }
+        buffer.push_back(std::move((*data)[i]));
+        if (buffer.size() >= batch_size) {
+          flush(t, dest, &buffer);
+          buffer.clear();
+        }
+      }
+      for (int i = 0; i < dest_num; ++i) {
+        int dest = (t + i) % dest_num;
+        if (!buffers[dest].empty()) {
+          flush(t, dest, &buffers[dest]);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,151 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/parallel_shuffle.h"
+#include <gtest/gtest.h>
+#include <xxhash.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <random>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/framework/archive.h"
+#include "paddle/fluid/framework/data_feed.h"
+#include "paddle/fluid/platform/timer.h"
+
+namespace paddle {
+namespace framework {
+
+TEST(ParallelShuffle, Permutation) {
+  const size_t num = kParallelShuffleMinPerThread * 8;
+  std::vector<size_t> data(num);
+  for (size_t i = 0; i < num; ++i) {
+    data[i] = i;
+  }
+  ParallelShuffle(&data, 4, 0);
+  std::vector<int> seen(num, 0);
+  // count records that stayed in the quarter they started in; a uniform
+  // permutation leaves about a quarter of them there
+  size_t same_quarter = 0;
+  for (size_t i = 0; i < num; ++i) {
+    ASSERT_LT(data[i], num);
+    ++seen[data[i]];
+    same_quarter += (i * 4 / num) == (data[i] * 4 / num);
+  }
+  for (size_t i = 0; i < num; ++i) {
+    ASSERT_EQ(seen[i], 1);
+  }
+  ASSERT_NEAR(static_cast<double>(same_quarter) / num, 0.25, 0.02);
+
+  // too little data for threads falls back to a single std::shuffle
+  std::vector<size_t> small = {1, 2, 3};
+  ParallelShuffle(&small, 8, 0);
+  std::sort(small.begin(), small.end());
+  ASSERT_EQ(small, std::vector<size_t>({1, 2, 3}));
+}
+
+TEST(ParallelPartition, Batches) {
+  const size_t num = 100000;
+  const int dest_num = 7;
+  const size_t batch_size = 1000;
+  std::vector<size_t> data(num);
+  for (size_t i = 0; i < num; ++i) {
+    data[i] = i;
+  }
+  std::mutex mutex;
+  std::vector<std::vector<size_t>> received(dest_num);
+  std::vector<size_t> flush_num(dest_num, 0);
+  ParallelPartition(&data, dest_num, 4, batch_size,
+                    [](size_t v) { return v % dest_num; },
+                    [&](int thread_id, size_t dest, std::vector<size_t>* buf) {
+                      ASSERT_LE(buf->size(), batch_size);
+                      std::lock_guard<std::mutex> lock(mutex);
+                      ++flush_num[dest];
+                      received[dest].insert(received[dest].end(),
+                                            buf->begin(), buf->end());
+                    });
+  size_t total = 0;
+  for (int dest = 0; dest < dest_num; ++dest) {
+    for (auto v : received[dest]) {
+      ASSERT_EQ(v % dest_num, static_cast<size_t>(dest));
+    }
+    total += received[dest].size();
+    // full batches plus at most one tail per thread
+    ASSERT_LE(flush_num[dest], received[dest].size() / batch_size + 4);
+  }
+  ASSERT_EQ(total, num);
+}
+
+// Records/s of the local shuffle and of the partition + serialize step of
+// the global shuffle, the part of GlobalShuffle that runs on the sending
+// trainer, across thread counts.
+TEST(BENCHMARK, ParallelShuffle) {
+  const size_t record_num = 1000000;
+  const int trainer_num = 16;
+  std::mt19937_64 rng(0);
+  std::vector<Record> records(record_num);
+  for (auto& rec : records) {
+    rec.ins_id_ = std::to_string(rng());
+    rec.uint64_feasigns_.resize(20);
+    for (auto& fea : rec.uint64_feasigns_) {
+      fea.sign().uint64_feasign_ = rng();
+      fea.slot() = rng() % 100;
+    }
+  }
+
+  platform::Timer timer;
+  timer.Start();
+  std::shuffle(records.begin(), records.end(), rng);
+  timer.Pause();
+  LOG(INFO) << "std::shuffle " << record_num / timer.ElapsedSec()
+            << " records/s";
+
+  for (int thread_num : {1, 2, 4, 8, 16}) {
+    timer.Reset();
+    timer.Start();
+    ParallelShuffle(&records, thread_num, rng());
+    timer.Pause();
+    LOG(INFO) << "ParallelShuffle threads=" << thread_num << " "
+              << record_num / timer.ElapsedSec() << " records/s";
+  }
+
+  for (int thread_num : {1, 2, 4, 8, 16}) {
+    std::vector<Record> data = records;
+    std::atomic<size_t> sent_bytes(0);
+    timer.Reset();
+    timer.Start();
+    ParallelPartition(
+        &data, trainer_num, thread_num, 1024,
+        [trainer_num](const Record& rec) {
+          return XXH64(rec.ins_id_.data(), rec.ins_id_.length(), 0) %
+                 trainer_num;
+        },
+        [&sent_bytes](int thread_id, size_t dest, std::vector<Record>* buf) {
+          BinaryArchive ar;
+          for (auto& rec : *buf) {
+            ar << rec;
+          }
+          sent_bytes += ar.Length();
+        });
+    timer.Pause();
+    LOG(INFO) << "ParallelPartition threads=" << thread_num << " "
+              << record_num / timer.ElapsedSec() << " records/s, "
+              << sent_bytes / timer.ElapsedSec() / 1e6 << " MB/s";
+  }
+}
+
+}  // namespace framework
+}  // namespace paddle
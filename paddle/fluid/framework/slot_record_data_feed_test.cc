@@ -0,0 +1,212 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <mutex>  // NOLINT
+#include <random>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/framework/data_feed.h"
+#include "paddle/fluid/framework/data_feed.pb.h"
+#include "paddle/fluid/framework/io/fs.h"
+#include "paddle/fluid/platform/timer.h"
+
+namespace paddle {
+namespace framework {
+
+// uint64 slots u0..u{n-1}, one unused uint64 slot and one float slot
+static DataFeedDesc MakeSlotRecordDesc(int uint64_slot_num) {
+  DataFeedDesc desc;
+  desc.set_name("SlotRecordInMemoryDataFeed");
+  desc.set_batch_size(32);
+  auto* multi_slot_desc = desc.mutable_multi_slot_desc();
+  for (int i = 0; i < uint64_slot_num; ++i) {
+    auto* slot = multi_slot_desc->add_slots();
+    slot->set_name("u" + std::to_string(i));
+    slot->set_type("uint64");
+    slot->set_is_used(true);
+  }
+  auto* unused = multi_slot_desc->add_slots();
+  unused->set_name("unused");
+  unused->set_type("uint64");
+  unused->set_is_used(false);
+  auto* dense = multi_slot_desc->add_slots();
+  dense->set_name("f0");
+  dense->set_type("float");
+  dense->set_is_used(true);
+  return desc;
+}
+
+static std::vector<SlotRecord> LoadRecords(const DataFeedDesc& desc,
+                                           const std::string& filename,
+                                           double* seconds) {
+  SlotRecordInMemoryDataFeed feed;
+  feed.Init(desc);
+  std::mutex mutex;
+  size_t file_idx = 0;
+  DataFeed* reader = &feed;
+  reader->SetFileListMutex(&mutex);
+  reader->SetFileListIndex(&file_idx);
+  reader->SetFileList({filename});
+  auto channel = MakeChannel<SlotRecord>();
+  reader->SetInputChannel(channel.get());
+
+  platform::Timer timer;
+  timer.Start();
+  reader->LoadIntoMemory();
+  timer.Pause();
+  *seconds = timer.ElapsedSec();
+
+  channel->Close();
+  std::vector<SlotRecord> records;
+  channel->ReadAll(records);
+  return records;
+}
+
+TEST(SlotRecordInMemoryDataFeed, ParseLine) {
+  const std::string filename = "slot_record_parse_test.txt";
+  {
+    std::ofstream os(filename);
+    os << "2 11 12 3 7 8 9 2 0.5 -1.25e1\n";
+    // the last line has no newline and a zero feasign to drop
+    os << "2 0 13 1 5 1 3";
+  }
+  double seconds = 0;
+  auto records = LoadRecords(MakeSlotRecordDesc(1), filename, &seconds);
+  ASSERT_EQ(records.size(), 2u);
+
+  size_t num = 0;
+  uint64_t* ids = records[0]->slot_uint64_feasigns_.get_values(0, &num);
+  ASSERT_EQ(std::vector<uint64_t>(ids, ids + num),
+            std::vector<uint64_t>({11, 12}));
+  float* floats = records[0]->slot_float_feasigns_.get_values(0, &num);
+  ASSERT_EQ(num, 2u);
+  ASSERT_FLOAT_EQ(floats[0], 0.5);
+  ASSERT_FLOAT_EQ(floats[1], -12.5);
+
+  ids = records[1]->slot_uint64_feasigns_.get_values(0, &num);
+  ASSERT_EQ(std::vector<uint64_t>(ids, ids + num), std::vector<uint64_t>({13}));
+  floats = records[1]->slot_float_feasigns_.get_values(0, &num);
+  ASSERT_EQ(num, 1u);
+  ASSERT_FLOAT_EQ(floats[0], 3);
+
+  SlotRecordPool().put(&records);
+  remove(filename.c_str());
+}
+
+TEST(SlotRecordInMemoryDataFeed, BinaryCache) {
+  const std::string filename = "slot_record_cache_test.txt";
+  const std::string cache_dir = "slot_record_cache_test_dir";
+  {
+    std::ofstream os(filename);
+    for (int i = 1; i <= 25000; ++i) {
+      os << "2 " << i << ' ' << i * 3 << " 1 9 1 " << i * 0.5 << '\n';
+    }
+  }
+  FLAGS_slotrecord_binary_cache_dir = cache_dir;
+  auto desc = MakeSlotRecordDesc(1);
+  double seconds = 0;
+  auto parsed = LoadRecords(desc, filename, &seconds);
+  ASSERT_EQ(localfs_list(cache_dir).size(), 1u);
+  auto cached = LoadRecords(desc, filename, &seconds);
+
+  // A cache whose first slot offset does not start at 0 is parsed again.
+  // It follows the header, the block header and the 10000 search ids,
+  // ranks, cmatchs and ins_id lengths of the first block.
+  {
+    std::fstream cache(localfs_list(cache_dir)[0],
+                       std::ios::in | std::ios::out | std::ios::binary);
+    cache.seekp(48 + 32 + 10000 * 8 + 3 * 10000 * 4);
+    uint32_t offset = 5;
+    cache.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+  }
+  auto reparsed = LoadRecords(desc, filename, &seconds);
+  FLAGS_slotrecord_binary_cache_dir = "";
+  ASSERT_EQ(reparsed.size(), parsed.size());
+  ASSERT_EQ(reparsed[0]->slot_uint64_feasigns_.slot_offsets,
+            parsed[0]->slot_uint64_feasigns_.slot_offsets);
+  SlotRecordPool().put(&reparsed);
+
+  ASSERT_EQ(parsed.size(), 25000u);
+  ASSERT_EQ(cached.size(), parsed.size());
+  for (size_t i = 0; i < parsed.size(); ++i) {
+    auto& expect = parsed[i]->slot_uint64_feasigns_;
+    auto& actual = cached[i]->slot_uint64_feasigns_;
+    ASSERT_EQ(actual.slot_values, expect.slot_values);
+    ASSERT_EQ(actual.slot_offsets, expect.slot_offsets);
+    ASSERT_EQ(cached[i]->slot_float_feasigns_.slot_values,
+              parsed[i]->slot_float_feasigns_.slot_values);
+  }
+  SlotRecordPool().put(&parsed);
+  SlotRecordPool().put(&cached);
+  remove(filename.c_str());
+  localfs_remove(cache_dir);
+}
+
+// Lines shaped like CTR logs: 100 sparse slots with a few 64-bit feasigns
+// each plus a float slot.
+TEST(BENCHMARK, SlotRecordLoadIntoMemory) {
+  const std::string filename = "slot_record_bench.txt";
+  const int uint64_slot_num = 100;
+  const int line_num = 100000;
+  {
+    std::ofstream os(filename);
+    std::mt19937_64 rng(0);
+    for (int i = 0; i < line_num; ++i) {
+      for (int s = 0; s < uint64_slot_num; ++s) {
+        int num = 1 + rng() % 4;
+        os << num;
+        for (int j = 0; j < num; ++j) {
+          os << ' ' << rng();
+        }
+        os << ' ';
+      }
+      os << "1 1 3 " << (rng() % 1000) / 7.0 << ' ' << 0.25 << ' '
+         << (rng() % 10) << '\n';
+    }
+  }
+  struct stat st;
+  ASSERT_EQ(stat(filename.c_str(), &st), 0);
+
+  double seconds = 0;
+  auto records =
+      LoadRecords(MakeSlotRecordDesc(uint64_slot_num), filename, &seconds);
+  ASSERT_EQ(records.size(), static_cast<size_t>(line_num));
+  LOG(INFO) << "SlotRecordInMemoryDataFeed loaded " << line_num
+            << " lines at " << st.st_size / 1024.0 / 1024.0 / seconds
+            << " MB/s per thread";
+  SlotRecordPool().put(&records);
+
+  const std::string cache_dir = "slot_record_bench_cache";
+  FLAGS_slotrecord_binary_cache_dir = cache_dir;
+  auto desc = MakeSlotRecordDesc(uint64_slot_num);
+  records = LoadRecords(desc, filename, &seconds);
+  SlotRecordPool().put(&records);
+  records = LoadRecords(desc, filename, &seconds);
+  FLAGS_slotrecord_binary_cache_dir = "";
+  ASSERT_EQ(records.size(), static_cast<size_t>(line_num));
+  LOG(INFO) << "SlotRecordInMemoryDataFeed loaded the binary cache at "
+            << st.st_size / 1024.0 / 1024.0 / seconds
+            << " text MB/s per thread";
+
+  SlotRecordPool().put(&records);
+  remove(filename.c_str());
+  localfs_remove(cache_dir);
+}
+
+}  // namespace framework
+}  // namespace paddle
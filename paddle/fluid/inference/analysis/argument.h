@@ -60,6 +60,9 @@ struct Argument {
   using unique_ptr_t = std::unique_ptr<void, std::function<void(void*)>>;
   using fusion_statis_t = std::unordered_map<std::string, int>;
   using input_shape_t = std::map<std::string, std::vector<int>>;
+  // name of a tensor -> its offset and size in bytes in the memory arena
+  using memory_arena_plan_t =
+      std::unordered_map<std::string, std::pair<size_t, size_t>>;
 
   bool Has(const std::string& key) const { return valid_fields_.count(key); }
   // If we set the model using config.SetModelBuffer,
@@ -264,6 +267,15 @@ struct Argument {
   // optimization relays on the sort algorithm.
   DECL_ARGUMENT_FIELD(memory_optim_sort_kind, MemoryOptimSortKind, int);
 
+  // Pack the intermediate tensors into one arena instead of renaming them,
+  // planned for the max shapes of the shape info file if any.
+  DECL_ARGUMENT_FIELD(static_memory_plan, StaticMemoryPlan, bool);
+  DECL_ARGUMENT_FIELD(static_memory_plan_shape_path,
+                      StaticMemoryPlanShapePath, std::string);
+  // The arena planned by the memory optimize pass.
+  DECL_ARGUMENT_FIELD(memory_arena_plan, MemoryArenaPlan, memory_arena_plan_t);
+  DECL_ARGUMENT_FIELD(memory_arena_size, MemoryArenaSize, size_t);
+
   // The program transformed by IR analysis phase.
   DECL_ARGUMENT_UNIQUE_FIELD(ir_analyzed_program, IrAnalyzedProgram,
                              framework::proto::ProgramDesc);
@@ -14,11 +14,14 @@
 
 #include "paddle/fluid/inference/analysis/passes/memory_optimize_pass.h"
 
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <utility>
 
 #include "glog/logging.h"
 #include "paddle/fluid/framework/ir/graph_helper.h"
+#include "paddle/fluid/inference/utils/io_utils.h"
 #include "paddle/fluid/platform/enforce.h"
 
 namespace paddle {
@@ -90,7 +93,8 @@ void MemoryOptimizePass::CollectLifeCycle(
 }
 
 void MemoryOptimizePass::CollectVarMemorySize(
-    Graph* graph, space_table_t* space_table) const {
+    Graph* graph, space_table_t* space_table,
+    const std::map<std::string, std::vector<int32_t>>* known_shapes) const {
   const int fake_batch_size = 1;
 
   auto valid_var = [&](framework::ir::Node* node) -> bool {
@@ -149,12 +153,21 @@ void MemoryOptimizePass::CollectVarMemorySize(
       // Parameters will not be reused.
       if (node->Var()->Persistable()) continue;
       auto shape = node->Var()->GetShape();
+      if (known_shapes) {
+        auto iter = known_shapes->find(node->Var()->Name());
+        if (iter != known_shapes->end()) {
+          shape.assign(iter->second.begin(), iter->second.end());
+        } else if (std::any_of(shape.begin(), shape.end(),
+                               [](int64_t v) { return v < 0; })) {
+          continue;
+        }
+      }
       for (auto& v : shape) {
         if (v < 0) v = fake_batch_size;
       }
 
-      int size = std::accumulate(shape.begin(), shape.end(), 1,
-                                 std::multiplies<int>());
+      int64_t size = std::accumulate(shape.begin(), shape.end(), int64_t(1),
+                                     std::multiplies<int64_t>());
       (*space_table)[node->Var()->Name()] =
           size * paddle::framework::SizeOfType(node->Var()->GetDataType());
     }
@@ -218,6 +231,90 @@ void MakeSimpleReusePlan(
   }
 }
 
+// The inputs and outputs of the model: the tensors no op writes, or only
+// feed does, and the ones no op reads, or only fetch does. Without feed and
+// fetch ops they are written before and read after a run, out of the
+// lifetimes the graph shows, so they must not share memory with anything.
+std::unordered_set<std::string> CollectModelIOVars(Graph* graph) {
+  std::unordered_set<std::string> io_vars;
+  auto only_by = [](const std::vector<Node*>& ops, const std::string& type) {
+    return std::all_of(ops.begin(), ops.end(), [&type](Node* op) {
+      return op->IsOp() && op->Op()->Type() == type;
+    });
+  };
+  for (auto* node : graph->Nodes()) {
+    if (!node->IsVar() || node->Var() == nullptr ||
+        node->Var()->Persistable()) {
+      continue;
+    }
+    if (only_by(node->inputs, "feed") || only_by(node->outputs, "fetch")) {
+      io_vars.insert(node->Name());
+    }
+  }
+  return io_vars;
+}
+
+// Assign every tensor an offset in one arena, so that the tensors whose
+// lifetimes overlap never share bytes. The tensors are placed from the
+// largest down, each in the smallest gap left between the already placed
+// tensors it lives with, or after all of them. Returns the arena size.
+size_t MakeStaticArenaPlan(
+    const std::unordered_map<std::string, std::pair<int, int>>& lifecycles,
+    const std::unordered_map<std::string, size_t>& space_table,
+    Argument::memory_arena_plan_t* arena_plan) {
+  // Keep every tensor aligned as the allocators do.
+  const size_t alignment = 256;
+  auto align = [alignment](size_t x) {
+    return (x + alignment - 1) / alignment * alignment;
+  };
+  std::vector<MemNode> mem_nodes;
+  for (auto& data : lifecycles) {
+    if (!space_table.count(data.first)) continue;
+    MemNode temp_node;
+    temp_node.name = data.first;
+    temp_node.size = align(space_table.at(data.first));
+    temp_node.cluster = -1;
+    temp_node.lifetime = data.second;
+    mem_nodes.push_back(temp_node);
+  }
+  std::sort(mem_nodes.begin(), mem_nodes.end(),
+            [](const MemNode& a, const MemNode& b) {
+              return a.size > b.size || (a.size == b.size && a.name < b.name);
+            });
+
+  size_t arena_size = 0;
+  // (offset, index in mem_nodes) of the placed tensors
+  std::vector<std::pair<size_t, size_t>> placed;
+  for (size_t i = 0; i < mem_nodes.size(); i++) {
+    auto& node = mem_nodes[i];
+    std::vector<std::pair<size_t, size_t>> alive;
+    for (auto& p : placed) {
+      auto& other = mem_nodes[p.second].lifetime;
+      if (other.second >= node.lifetime.first &&
+          node.lifetime.second >= other.first) {
+        alive.push_back(p);
+      }
+    }
+    std::sort(alive.begin(), alive.end());
+    size_t best_offset = 0, best_gap = std::numeric_limits<size_t>::max();
+    size_t gap_begin = 0;
+    for (auto& p : alive) {
+      if (p.first >= gap_begin + node.size && p.first - gap_begin < best_gap) {
+        best_gap = p.first - gap_begin;
+        best_offset = gap_begin;
+      }
+      gap_begin = std::max(gap_begin, p.first + mem_nodes[p.second].size);
+    }
+    if (best_gap == std::numeric_limits<size_t>::max()) {
+      best_offset = gap_begin;
+    }
+    placed.emplace_back(best_offset, i);
+    (*arena_plan)[node.name] = std::make_pair(best_offset, node.size);
+    arena_size = std::max(arena_size, best_offset + node.size);
+  }
+  return arena_size;
+}
+
 // NOTE The optimized opdesc doesn't match ir::Graph.
 void UpdateOpDescsByReuse(
     Graph* graph,
@@ -303,7 +400,9 @@ void MemoryOptimizePass::RunImpl(Argument* argument) {
   // name of var and the value in the table represents the current name of var.
   // 3. Perform reuse plan: Replace all var's name in the model according to the
   // mapping table.
-  if (!argument->enable_memory_optim()) return;
+  bool static_memory_plan =
+      argument->static_memory_plan_valid() && argument->static_memory_plan();
+  if (!argument->enable_memory_optim() && !static_memory_plan) return;
   // Because of pass is a singleton, graph can not be member
   // variables，otherwise，errors will be caused under multithreading
   // conditions.
@@ -316,6 +415,39 @@ void MemoryOptimizePass::RunImpl(Argument* argument) {
   std::unordered_map<std::string, int> cluster_size;
 
   CollectLifeCycle(graph, &lifecycles, sort_kind);
+  if (static_memory_plan) {
+    std::map<std::string, std::vector<int32_t>> min_shape, max_shape,
+        opt_shape;
+    if (argument->static_memory_plan_shape_path_valid() &&
+        !argument->static_memory_plan_shape_path().empty()) {
+      inference::DeserializeShapeRangeInfo(
+          argument->static_memory_plan_shape_path(), &min_shape, &max_shape,
+          &opt_shape);
+    }
+    CollectVarMemorySize(graph, &space_table, &max_shape);
+    for (auto& name : CollectModelIOVars(graph)) {
+      space_table.erase(name);
+    }
+    Argument::memory_arena_plan_t arena_plan;
+    size_t arena_size =
+        MakeStaticArenaPlan(lifecycles, space_table, &arena_plan);
+    // What the same tensors take without reuse and with the reuse plan.
+    MakeSimpleReusePlan(lifecycles, space_table, &node2cluster, &cluster_size);
+    size_t total_size = 0, reuse_size = 0;
+    for (auto& item : arena_plan) {
+      total_size += space_table.at(item.first);
+    }
+    for (auto& cluster : cluster_size) {
+      reuse_size += cluster.second;
+    }
+    LOG(INFO) << "Static memory plan: " << arena_plan.size()
+              << " tensors in an arena of " << arena_size
+              << " bytes, reuse plan " << reuse_size << " bytes, no reuse "
+              << total_size << " bytes";
+    argument->SetMemoryArenaPlan(arena_plan);
+    argument->SetMemoryArenaSize(arena_size);
+    return;
+  }
   CollectVarMemorySize(graph, &space_table);
   MakeSimpleReusePlan(lifecycles, space_table, &node2cluster, &cluster_size);
   UpdateOpDescsByReuse(graph, node2cluster, sort_kind);
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #pragma once
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -44,6 +45,11 @@ namespace analysis {
 * name of var and the value in the table represents the current name of var.
 * 3. Perform reuse plan: Replace all var's name in the model according to the
 * mapping table.
+*
+* With the static memory plan, step 2 instead assigns every tensor an offset
+* in one arena, so that tensors with overlapping lifetimes never share bytes,
+* and step 3 is skipped: the predictor binds the tensors into the arena. The
+* inputs and outputs of the model are left out of the arena.
 */
 class MemoryOptimizePass : public AnalysisPass {
  public:
@@ -61,8 +67,13 @@ class MemoryOptimizePass : public AnalysisPass {
       std::unordered_map<std::string, lifecycle_t> *lifecycles,
       int sort_kind) const;
 
-  void CollectVarMemorySize(framework::ir::Graph *graph,
-                            space_table_t *space_table) const;
+  // If known_shapes is set, the tensors with dynamic dims are sized by it
+  // and the ones missing from it are left out, instead of taking the batch
+  // size as 1.
+  void CollectVarMemorySize(
+      framework::ir::Graph *graph, space_table_t *space_table,
+      const std::map<std::string, std::vector<int32_t>> *known_shapes =
+          nullptr) const;
 
  public:
   std::string repr() const override;
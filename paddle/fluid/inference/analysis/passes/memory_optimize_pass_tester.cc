@@ -0,0 +1,63 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/inference/analysis/passes/memory_optimize_pass.h"
+
+#include <gtest/gtest.h>
+
+#include "paddle/fluid/framework/ir/pass_tester_helper.h"
+
+namespace paddle {
+namespace inference {
+namespace analysis {
+
+// The input x is only read by the last op. Without feed and fetch ops it is
+// written before the run, so it must not share memory with a or b, which
+// the graph shows as dead by the time x is first read.
+TEST(MemoryOptimizePass, static_plan_keeps_late_input) {
+  framework::ir::Layers layers;
+  auto* x = layers.data("x", {1, 1024});
+  auto* y = layers.data("y", {1, 1024});
+  auto* a = layers.data("a", {1, 1024});
+  auto* b = layers.data("b", {1, 1024});
+  auto* c = layers.data("c", {1, 1024});
+  auto* out = layers.data("out", {1, 1024});
+  layers.relu(y, a);
+  layers.relu(a, b);
+  layers.relu(b, c);
+  layers.elementwise_add(c, x, out);
+
+  Argument argument;
+  argument.SetMainGraph(new framework::ir::Graph(layers.main_program()));
+  argument.SetEnableMemoryOptim(false);
+  argument.SetStaticMemoryPlan(true);
+  MemoryOptimizePass pass;
+  pass.Run(&argument);
+
+  auto& plan = argument.memory_arena_plan();
+  for (auto* io : {x, y, out}) {
+    EXPECT_EQ(plan.count(io->Name()), 0UL) << io->Name();
+  }
+  ASSERT_EQ(plan.count("a"), 1UL);
+  ASSERT_EQ(plan.count("b"), 1UL);
+  ASSERT_EQ(plan.count("c"), 1UL);
+  // a and b, b and c live together; a and c may share
+  EXPECT_NE(plan.at("a").first, plan.at("b").first);
+  EXPECT_NE(plan.at("b").first, plan.at("c").first);
+  EXPECT_LE(argument.memory_arena_size(), 3 * plan.at("a").second);
+}
+
+}  // namespace analysis
+}  // namespace inference
+}  // namespace paddle
@@ -177,6 +177,8 @@ AnalysisConfig::AnalysisConfig(const AnalysisConfig &other) {
   CP_MEMBER(memory_pool_init_size_mb_);
 
   CP_MEMBER(enable_memory_optim_);
+  CP_MEMBER(static_memory_plan_);
+  CP_MEMBER(static_memory_plan_shape_path_);
   // TensorRT related.
   CP_MEMBER(use_tensorrt_);
   CP_MEMBER(tensorrt_workspace_size_);
@@ -556,9 +558,9 @@ void AnalysisConfig::Update() {
 
 #ifdef PADDLE_WITH_MKLDNN
   // Do not optimize when mkldnn is on
-  if (enable_memory_optim_ && !use_mkldnn_) {
+  if ((enable_memory_optim_ || static_memory_plan_) && !use_mkldnn_) {
 #else
-  if (enable_memory_optim_) {
+  if (enable_memory_optim_ || static_memory_plan_) {
 #endif
     pass_builder()->AppendAnalysisPass("memory_optimize_pass");
   }
@@ -642,6 +644,8 @@ std::string AnalysisConfig::SerializeInfoCache() {
   ss << trt_dla_core_;
 
   ss << enable_memory_optim_;
+  ss << static_memory_plan_;
+  ss << static_memory_plan_shape_path_;
 
   ss << use_mkldnn_;
   ss << mkldnn_cache_capacity_;
@@ -725,6 +729,13 @@ bool AnalysisConfig::enable_memory_optim() const {
   return enable_memory_optim_;
 }
 
+void AnalysisConfig::EnableStaticMemoryPlan(
+    const std::string &shape_range_info_path) {
+  static_memory_plan_ = true;
+  static_memory_plan_shape_path_ = shape_range_info_path;
+  Update();
+}
+
 void AnalysisConfig::SetModelBuffer(const char *prog_buffer,
                                     size_t prog_buffer_size,
                                     const char *param_buffer,
@@ -893,6 +904,11 @@ std::string AnalysisConfig::Summary() {
   os.InsertRow({"ir_optim", enable_ir_optim_ ? "true" : "false"});
   os.InsertRow({"ir_debug", ir_debug_ ? "true" : "false"});
   os.InsertRow({"memory_optim", enable_memory_optim_ ? "true" : "false"});
+  if (static_memory_plan_) {
+    os.InsertRow({"static_memory_plan", static_memory_plan_shape_path_.empty()
+                                            ? "true"
+                                            : static_memory_plan_shape_path_});
+  }
   os.InsertRow({"enable_profile", with_profile_ ? "true" : "false"});
   os.InsertRow({"enable_log", with_glog_info_ ? "true" : "false"});
   os.InsertRow({"collect_shape_range_info",
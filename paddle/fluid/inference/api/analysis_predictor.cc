@@ -191,6 +191,7 @@ bool AnalysisPredictor::Init(
 
   // Get the feed_target_names and fetch_target_names
   PrepareFeedFetch();
+  PrepareMemoryArena();
 
   return true;
 }
@@ -230,6 +231,12 @@ bool AnalysisPredictor::PrepareProgram(
     // the analysis pass(op fuse, graph analysis, trt subgraph, mkldnn etc) will
     // not be executed.
     OptimizeInferenceProgram();
+    if (argument_.memory_arena_plan_valid()) {
+      memory_arena_plan_ =
+          std::make_shared<const Argument::memory_arena_plan_t>(
+              argument_.memory_arena_plan());
+      memory_arena_size_ = argument_.memory_arena_size();
+    }
   } else {
     // If the program is passed from external, no need to optimize it, this
     // logic is used in the clone scenario.
@@ -240,6 +247,33 @@ bool AnalysisPredictor::PrepareProgram(
 
   return true;
 }
+
+void AnalysisPredictor::PrepareMemoryArena() {
+  if (!memory_arena_plan_ || memory_arena_size_ == 0) return;
+  memory_arena_ = memory::AllocShared(place_, memory_arena_size_);
+  auto *base = static_cast<char *>(memory_arena_->ptr());
+  for (auto &item : *memory_arena_plan_) {
+    // The pass leaves the inputs and outputs out of the plan already, they
+    // are written and read outside of Run and have to keep their memory.
+    if (feed_names_.count(item.first) ||
+        std::any_of(idx2fetches_.begin(), idx2fetches_.end(),
+                    [&item](const std::pair<const size_t, std::string> &f) {
+                      return f.second == item.first;
+                    })) {
+      continue;
+    }
+    auto *var = sub_scope_->FindLocalVar(item.first);
+    if (var == nullptr || !var->IsType<framework::LoDTensor>()) continue;
+    // The holder only points into the arena, which outlives the tensor. A
+    // tensor which outgrows it gets its own allocation from mutable_data.
+    var->GetMutable<framework::LoDTensor>()->ResetHolder(
+        std::make_shared<memory::Allocation>(base + item.second.first,
+                                             item.second.second, place_));
+  }
+  VLOG(3) << "Bind " << memory_arena_plan_->size()
+          << " tensors into an arena of " << memory_arena_size_ << " bytes";
+}
+
 bool AnalysisPredictor::CreateExecutor() {
   if (config_.use_gpu()) {
     PADDLE_ENFORCE_EQ(config_.use_xpu(), false,
@@ -357,7 +391,11 @@ static void DisablePrepareDataOpt(
 }
 
 bool AnalysisPredictor::PrepareExecutor() {
-  DisablePrepareDataOpt(inference_program_, 0, false);
+  // The program of a clone is shared with, and already marked by, the
+  // predictor it is cloned from.
+  if (!status_is_cloned_) {
+    DisablePrepareDataOpt(inference_program_, 0, false);
+  }
 
   executor_->Prepare(sub_scope_, *inference_program_, 0,
                      config_.use_feed_fetch_ops_);
@@ -450,6 +488,7 @@ bool AnalysisPredictor::Run(const std::vector<PaddleTensor> &inputs,
   // Run the inference program
   // if share variables, we need not create variables
   executor_->Run();
+  kernels_chosen_.store(true, std::memory_order_release);
 
   // get fetch variable
   if (!GetFetch(output_data, scope)) {
@@ -576,6 +615,9 @@ void AnalysisPredictor::PrepareArgument() {
   argument_.SetGPUDeviceId(config_.gpu_device_id());
   argument_.SetEnableAnalysisOptim(config_.enable_ir_optim_);
   argument_.SetEnableMemoryOptim(config_.enable_memory_optim());
+  argument_.SetStaticMemoryPlan(config_.static_memory_plan_enabled());
+  argument_.SetStaticMemoryPlanShapePath(
+      config_.static_memory_plan_shape_path_);
   argument_.SetModelFromMemory(config_.model_from_memory_);
   // Analyze inference_program
   argument_.SetPredictorID(predictor_id_);
@@ -1024,6 +1066,7 @@ bool AnalysisPredictor::ZeroCopyRun() {
 #endif
 
   executor_->Run();
+  kernels_chosen_.store(true, std::memory_order_release);
 
   if (config_.shape_range_info_collected()) {
     CollectShapeRangeInfo();
@@ -1350,7 +1393,12 @@ AnalysisPredictor::~AnalysisPredictor() {
 std::unique_ptr<PaddlePredictor> AnalysisPredictor::Clone() {
   std::lock_guard<std::mutex> lk(clone_mutex_);
   auto *x = new AnalysisPredictor(config_);
+  x->memory_arena_plan_ = memory_arena_plan_;
+  x->memory_arena_size_ = memory_arena_size_;
   x->Init(scope_, inference_program_);
+  if (kernels_chosen_.load(std::memory_order_acquire)) {
+    x->executor_->ShareKernelsFrom(*executor_);
+  }
   x->executor_->ResetTrtOps(++x->clone_num_);
   return std::unique_ptr<PaddlePredictor>(x);
 }
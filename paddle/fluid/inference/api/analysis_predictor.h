@@ -14,6 +14,7 @@
 
 #pragma once
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -25,6 +26,7 @@
 #include "paddle/fluid/inference/api/details/reset_tensor_array.h"
 #include "paddle/fluid/inference/api/helper.h"
 #include "paddle/fluid/inference/api/paddle_inference_api.h"
+#include "paddle/fluid/memory/malloc.h"
 #include "paddle/fluid/platform/device/gpu/gpu_types.h"
 #include "paddle/fluid/platform/float16.h"
 #include "paddle/fluid/string/printf.h"
@@ -226,6 +228,9 @@ class AnalysisPredictor : public PaddlePredictor {
   Argument &analysis_argument() { return argument_; }
   ///
   /// \brief Clone to get the new predictor. thread safe.
+  /// The clone shares the parameters and the optimized program with this
+  /// predictor and only owns its activations. Once this predictor has run,
+  /// the clone also reuses the kernels its operators chose.
   ///
   /// \return get a new predictor
   ///
@@ -292,6 +297,13 @@ class AnalysisPredictor : public PaddlePredictor {
   /// \return Whether the function executed successfully
   ///
   bool PrepareExecutor();
+  ///
+  /// \brief Bind the intermediate tensors of the static memory plan into an
+  /// arena of this predictor, so that running them does not allocate. The
+  /// feed and fetch targets are never bound, so it runs after
+  /// PrepareFeedFetch.
+  ///
+  void PrepareMemoryArena();
 
   ///
   /// \brief Load model program.
@@ -399,6 +411,11 @@ class AnalysisPredictor : public PaddlePredictor {
   std::shared_ptr<framework::Scope> scope_;
   framework::Scope *sub_scope_{nullptr};
   std::shared_ptr<framework::ProgramDesc> inference_program_;
+  // The static memory plan is shared with the clones, which each bind their
+  // own tensors into their own arena.
+  std::shared_ptr<const Argument::memory_arena_plan_t> memory_arena_plan_;
+  size_t memory_arena_size_{0};
+  std::shared_ptr<memory::Allocation> memory_arena_;
   framework::OpCompatibleMap op_compatible_map_;
   std::vector<framework::OpDesc *> feeds_;
   std::map<std::string, size_t> feed_names_;
@@ -433,6 +450,9 @@ class AnalysisPredictor : public PaddlePredictor {
  private:
   // Some status here that help to determine the status inside the predictor.
   bool status_is_cloned_{false};
+  // Whether the operators of executor_ have chosen their kernels, i.e. the
+  // predictor has run at least once.
+  std::atomic<bool> kernels_chosen_{false};
 
   std::map<std::string, std::vector<std::vector<int32_t>>> shape_info_;
   int clone_num_{1};
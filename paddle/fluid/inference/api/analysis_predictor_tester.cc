@@ -15,6 +15,8 @@
 #include "paddle/fluid/inference/api/analysis_predictor.h"
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>  // NOLINT
 #include <thread>  // NOLINT
 #include "paddle/fluid/framework/ir/pass.h"
 #include "paddle/fluid/framework/tensor.h"
@@ -25,6 +27,10 @@
 #include "paddle/fluid/inference/utils/io_utils.h"
 #include "paddle/fluid/platform/cpu_info.h"
 
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
 DEFINE_string(dirname, "", "dirname to tests.");
 
 namespace paddle {
@@ -264,6 +270,68 @@ TEST(AnalysisPredictor, Clone) {
   }
 }
 
+// Startup time and resident memory of clones as the number of threads
+// grows. The clones share the parameters, the program and the kernels chosen
+// by the first run of the main predictor, and must compute the same outputs.
+#ifndef _WIN32
+TEST(BENCHMARK, AnalysisPredictorClone) {
+  AnalysisConfig config;
+  config.SetModel(FLAGS_dirname);
+  config.DisableGpu();
+  config.SwitchIrOptim(true);
+
+  auto max_rss_kb = [] {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+  };
+
+  int64_t data[4] = {1, 2, 3, 4};
+  PaddleTensor tensor;
+  tensor.shape = std::vector<int>({4, 1});
+  tensor.data.Reset(data, sizeof(data));
+  tensor.dtype = PaddleDType::INT64;
+  std::vector<PaddleTensor> inputs(4, tensor);
+
+  auto start = std::chrono::steady_clock::now();
+  auto main_predictor = CreatePaddlePredictor(config);
+  std::vector<PaddleTensor> expected;
+  ASSERT_TRUE(main_predictor->Run(inputs, &expected));
+  LOG(INFO) << "main predictor: "
+            << std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " ms to create and run once, max rss " << max_rss_kb()
+            << " KB";
+
+  for (int num_threads : {1, 2, 4, 8}) {
+    auto rss_before = max_rss_kb();
+    std::vector<std::unique_ptr<PaddlePredictor>> predictors(num_threads);
+    std::vector<double> startup_ms(num_threads);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back([&, i] {
+        auto start = std::chrono::steady_clock::now();
+        predictors[i] = main_predictor->Clone();
+        std::vector<PaddleTensor> outputs;
+        ASSERT_TRUE(predictors[i]->Run(inputs, &outputs));
+        startup_ms[i] = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+        inference::CompareResult(outputs, expected);
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    LOG(INFO) << num_threads << " threads: "
+              << *std::max_element(startup_ms.begin(), startup_ms.end())
+              << " ms to clone and run once, max rss grew "
+              << max_rss_kb() - rss_before << " KB";
+  }
+}
+#endif
+
 // This function is not released yet, will fail on some machine.
 // TODO(Superjomn) Turn on it latter.
 /*
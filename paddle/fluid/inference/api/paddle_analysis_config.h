@@ -690,6 +690,28 @@ struct PD_INFER_DECL AnalysisConfig {
   ///
   bool enable_memory_optim() const;
 
+  ///
+  /// \brief Turn on the static memory plan, for models run with fixed
+  /// shapes. Instead of renaming variables to reuse each other, all the
+  /// intermediate tensors of known shapes are packed into one arena, which
+  /// is allocated when the predictor is created, so that the tensors do not
+  /// allocate while running. Tensors of unknown shapes, or which outgrow
+  /// their planned size, are still allocated at runtime.
+  ///
+  /// \param shape_range_info_path The shape info file collected by
+  /// CollectShapeRangeInfo(), whose max shapes are planned for. If empty,
+  /// only the tensors whose shapes are fully static in the model are
+  /// planned.
+  ///
+  void EnableStaticMemoryPlan(const std::string& shape_range_info_path = "");
+  ///
+  /// \brief A boolean state telling whether the static memory plan is
+  /// enabled.
+  ///
+  /// \return bool Whether the static memory plan is enabled.
+  ///
+  bool static_memory_plan_enabled() const { return static_memory_plan_; }
+
   ///
   /// \brief Turn on profiling report.
   /// If not turned on, no profiling report will be generated.
@@ -820,6 +842,8 @@ struct PD_INFER_DECL AnalysisConfig {
 
   // memory reuse related.
   bool enable_memory_optim_{false};
+  bool static_memory_plan_{false};
+  std::string static_memory_plan_shape_path_;
 
   bool use_mkldnn_{false};
   std::unordered_set<std::string> mkldnn_enabled_op_types_;
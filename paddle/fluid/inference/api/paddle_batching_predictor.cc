@@ -0,0 +1,401 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/inference/api/paddle_batching_predictor.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <utility>
+
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/float16.h"
+
+namespace paddle_infer {
+namespace services {
+
+using paddle::PaddleTensor;
+using float16 = paddle::platform::float16;
+
+namespace {
+
+size_t Numel(const std::vector<int>& shape) {
+  size_t numel = 1;
+  for (auto dim : shape) {
+    numel *= dim;
+  }
+  return numel;
+}
+
+// The batch size of an input: the number of its sequences if it has LoD, or
+// its first dimension otherwise.
+int SampleNum(const PaddleTensor& tensor) {
+  if (!tensor.lod.empty()) {
+    return tensor.lod[0].empty() ? 0 : tensor.lod[0].size() - 1;
+  }
+  return tensor.shape.empty() ? 0 : tensor.shape[0];
+}
+
+bool CanConcat(const PaddleTensor& x, const PaddleTensor& y) {
+  return x.dtype == y.dtype && x.lod.size() == y.lod.size() &&
+         x.shape.size() == y.shape.size() &&
+         std::equal(x.shape.begin() + 1, x.shape.end(), y.shape.begin() + 1);
+}
+
+void CopyFromCpu(Tensor* dst, paddle::PaddleDType dtype, const void* src) {
+  switch (dtype) {
+    case DataType::FLOAT32:
+      dst->CopyFromCpu(static_cast<const float*>(src));
+      break;
+    case DataType::INT64:
+      dst->CopyFromCpu(static_cast<const int64_t*>(src));
+      break;
+    case DataType::INT32:
+      dst->CopyFromCpu(static_cast<const int32_t*>(src));
+      break;
+    case DataType::UINT8:
+      dst->CopyFromCpu(static_cast<const uint8_t*>(src));
+      break;
+    case DataType::INT8:
+      dst->CopyFromCpu(static_cast<const int8_t*>(src));
+      break;
+    case DataType::FLOAT16:
+      dst->CopyFromCpu(static_cast<const float16*>(src));
+      break;
+    default:
+      PADDLE_THROW(paddle::platform::errors::Unimplemented(
+          "Unsupported data type %d of input %s.", static_cast<int>(dtype),
+          dst->name()));
+  }
+}
+
+void CopyToCpu(const Tensor& src, void* dst) {
+  switch (src.type()) {
+    case DataType::FLOAT32:
+      src.CopyToCpu(static_cast<float*>(dst));
+      break;
+    case DataType::INT64:
+      src.CopyToCpu(static_cast<int64_t*>(dst));
+      break;
+    case DataType::INT32:
+      src.CopyToCpu(static_cast<int32_t*>(dst));
+      break;
+    case DataType::UINT8:
+      src.CopyToCpu(static_cast<uint8_t*>(dst));
+      break;
+    case DataType::INT8:
+      src.CopyToCpu(static_cast<int8_t*>(dst));
+      break;
+    case DataType::FLOAT16:
+      src.CopyToCpu(static_cast<float16*>(dst));
+      break;
+    default:
+      PADDLE_THROW(paddle::platform::errors::Unimplemented(
+          "Unsupported data type %d of output %s.",
+          static_cast<int>(src.type()), src.name()));
+  }
+}
+
+// Appends the LoD of x to the LoD of a batch, shifting its offsets past the
+// ones already in the batch.
+void AppendLoD(const std::vector<std::vector<size_t>>& x,
+               std::vector<std::vector<size_t>>* lod) {
+  for (size_t level = 0; level < x.size(); ++level) {
+    auto& batch_level = (*lod)[level];
+    size_t shift = batch_level.back() - x[level].front();
+    for (size_t i = 1; i < x[level].size(); ++i) {
+      batch_level.push_back(x[level][i] + shift);
+    }
+  }
+}
+
+// Cuts the samples [begin, end) out of an output: the sequences of its
+// first LoD level together with their nested levels and rows if by_lod is
+// set, or the rows of its first dimension otherwise.
+PaddleTensor SliceOutput(const PaddleTensor& output, size_t begin, size_t end,
+                         bool by_lod) {
+  PaddleTensor res;
+  res.name = output.name;
+  res.dtype = output.dtype;
+  for (size_t l = 0; by_lod && l < output.lod.size(); ++l) {
+    auto& level = output.lod[l];
+    std::vector<size_t> sliced(level.begin() + begin,
+                               level.begin() + end + 1);
+    for (auto& offset : sliced) {
+      offset -= level[begin];
+    }
+    res.lod.push_back(std::move(sliced));
+    size_t next_begin = level[begin];
+    end = level[end];
+    begin = next_begin;
+  }
+  res.shape = output.shape;
+  res.shape[0] = end - begin;
+  size_t row_bytes = output.shape[0] == 0
+                         ? 0
+                         : output.data.length() / output.shape[0];
+  res.data.Resize((end - begin) * row_bytes);
+  memcpy(res.data.data(),
+         static_cast<const char*>(output.data.data()) + begin * row_bytes,
+         res.data.length());
+  return res;
+}
+
+}  // namespace
+
+BatchingPredictor::BatchingPredictor(const Config& config,
+                                     const BatchingOptions& options)
+    : options_(options) {
+  PADDLE_ENFORCE_GE(options_.max_batch_size, 1,
+                    paddle::platform::errors::InvalidArgument(
+                        "The max batch size should be greater than 0, but "
+                        "it's (%d)",
+                        options_.max_batch_size));
+  PADDLE_ENFORCE_GE(options_.num_workers, 1,
+                    paddle::platform::errors::InvalidArgument(
+                        "The number of workers should be greater than 0, "
+                        "but it's (%d)",
+                        options_.num_workers));
+  predictors_.emplace_back(new Predictor(config));
+  for (int i = 1; i < options_.num_workers; ++i) {
+    predictors_.push_back(predictors_.front()->Clone());
+  }
+  input_names_ = predictors_.front()->GetInputNames();
+  output_names_ = predictors_.front()->GetOutputNames();
+  for (auto& predictor : predictors_) {
+    workers_.emplace_back(&BatchingPredictor::WorkerLoop, this,
+                          predictor.get());
+  }
+}
+
+BatchingPredictor::~BatchingPredictor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::future<std::vector<PaddleTensor>> BatchingPredictor::Run(
+    std::vector<PaddleTensor> inputs) {
+  std::unique_ptr<Request> request(new Request);
+  auto future = request->promise.get_future();
+  try {
+    CheckInputs(&inputs, request.get());
+  } catch (...) {
+    request->promise.set_exception(std::current_exception());
+    return future;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    request->arrival = std::chrono::steady_clock::now();
+    queue_.push_back(std::move(request));
+  }
+  // a worker which is running a batch may be waiting for the collector to
+  // finish, so all of them are woken up
+  cv_.notify_all();
+  return future;
+}
+
+void BatchingPredictor::CheckInputs(std::vector<PaddleTensor>* inputs,
+                                    Request* request) const {
+  PADDLE_ENFORCE_EQ(inputs->size(), input_names_.size(),
+                    paddle::platform::errors::InvalidArgument(
+                        "The model has %d inputs, but %d are given.",
+                        input_names_.size(), inputs->size()));
+  bool named =
+      std::all_of(inputs->begin(), inputs->end(),
+                  [](const PaddleTensor& x) { return !x.name.empty(); });
+  request->inputs.resize(inputs->size());
+  // as many inputs as the model has, none given twice, so none is missing
+  std::vector<bool> given(inputs->size(), false);
+  for (size_t i = 0; i < inputs->size(); ++i) {
+    PaddleTensor& input = (*inputs)[i];
+    size_t idx = i;
+    if (named) {
+      idx = std::find(input_names_.begin(), input_names_.end(), input.name) -
+            input_names_.begin();
+      PADDLE_ENFORCE_LT(idx, input_names_.size(),
+                        paddle::platform::errors::NotFound(
+                            "The model has no input %s.", input.name));
+      PADDLE_ENFORCE_EQ(given[idx], false,
+                        paddle::platform::errors::InvalidArgument(
+                            "The input %s is given twice.", input.name));
+    }
+    given[idx] = true;
+    PADDLE_ENFORCE_EQ(
+        input.data.length(),
+        Numel(input.shape) * paddle::PaddleDtypeSize(input.dtype),
+        paddle::platform::errors::InvalidArgument(
+            "The data of input %s does not match its shape and dtype.",
+            input_names_[idx]));
+    PADDLE_ENFORCE_EQ(input.shape.empty(), false,
+                      paddle::platform::errors::InvalidArgument(
+                          "The input %s should have a batch dimension.",
+                          input_names_[idx]));
+    int samples = SampleNum(input);
+    PADDLE_ENFORCE_GT(samples, 0,
+                      paddle::platform::errors::InvalidArgument(
+                          "The input %s holds no sample.", input_names_[idx]));
+    PADDLE_ENFORCE_EQ(request->samples == 0 || request->samples == samples,
+                      true, paddle::platform::errors::InvalidArgument(
+                                "The inputs of a request hold %d and %d "
+                                "samples, they should be the same.",
+                                request->samples, samples));
+    request->samples = samples;
+    request->inputs[idx] = std::move(input);
+  }
+}
+
+void BatchingPredictor::WorkerLoop(Predictor* predictor) {
+  while (true) {
+    auto batch = TakeBatch();
+    if (batch.empty()) {
+      return;
+    }
+    RunBatch(predictor, &batch);
+  }
+}
+
+std::vector<std::unique_ptr<BatchingPredictor::Request>>
+BatchingPredictor::TakeBatch() {
+  std::vector<std::unique_ptr<Request>> batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return stop_ || (!collecting_ && !queue_.empty()); });
+  if (queue_.empty()) {
+    return batch;
+  }
+  collecting_ = true;
+  // the oldest request may have waited for another batch to finish
+  auto deadline = queue_.front()->arrival +
+                  std::chrono::microseconds(options_.max_delay_us);
+  int samples = 0;
+  while (true) {
+    if (queue_.empty()) {
+      if (stop_ ||
+          !cv_.wait_until(lock, deadline,
+                          [this] { return stop_ || !queue_.empty(); }) ||
+          queue_.empty()) {
+        break;
+      }
+    }
+    auto& next = queue_.front();
+    if (!batch.empty()) {
+      if (samples + next->samples > options_.max_batch_size) {
+        break;
+      }
+      bool can_concat = true;
+      for (size_t i = 0; i < next->inputs.size(); ++i) {
+        can_concat =
+            can_concat && CanConcat(batch[0]->inputs[i], next->inputs[i]);
+      }
+      if (!can_concat) {
+        break;
+      }
+    }
+    samples += next->samples;
+    batch.push_back(std::move(next));
+    queue_.pop_front();
+    if (samples >= options_.max_batch_size) {
+      break;
+    }
+  }
+  collecting_ = false;
+  lock.unlock();
+  cv_.notify_all();
+  return batch;
+}
+
+void BatchingPredictor::RunBatch(Predictor* predictor,
+                                 std::vector<std::unique_ptr<Request>>* batch) {
+  std::vector<std::vector<PaddleTensor>> results(batch->size());
+  try {
+    int samples = 0;
+    for (auto& request : *batch) {
+      samples += request->samples;
+    }
+    for (size_t i = 0; i < input_names_.size(); ++i) {
+      const PaddleTensor& first = batch->front()->inputs[i];
+      std::vector<int> shape = first.shape;
+      std::vector<std::vector<size_t>> lod(first.lod.size(),
+                                           std::vector<size_t>(1, 0));
+      size_t bytes = 0;
+      for (auto& request : *batch) {
+        bytes += request->inputs[i].data.length();
+      }
+      std::vector<char> data(bytes);
+      char* cursor = data.data();
+      shape[0] = 0;
+      for (auto& request : *batch) {
+        const PaddleTensor& input = request->inputs[i];
+        memcpy(cursor, input.data.data(), input.data.length());
+        cursor += input.data.length();
+        shape[0] += input.shape[0];
+        AppendLoD(input.lod, &lod);
+      }
+      auto handle = predictor->GetInputHandle(input_names_[i]);
+      handle->Reshape(shape);
+      CopyFromCpu(handle.get(), first.dtype, data.data());
+      if (!lod.empty()) {
+        handle->SetLoD(lod);
+      }
+    }
+
+    PADDLE_ENFORCE_EQ(predictor->Run(), true,
+                      paddle::platform::errors::PreconditionNotMet(
+                          "Failed to run a batch of %d requests.",
+                          batch->size()));
+
+    for (auto& name : output_names_) {
+      auto handle = predictor->GetOutputHandle(name);
+      PaddleTensor output;
+      output.name = name;
+      output.shape = handle->shape();
+      output.lod = handle->lod();
+      output.dtype = handle->type();
+      output.data.Resize(Numel(output.shape) *
+                         paddle::PaddleDtypeSize(output.dtype));
+      CopyToCpu(*handle, output.data.data());
+
+      bool by_lod = !output.lod.empty() &&
+                    output.lod[0].size() == static_cast<size_t>(samples) + 1;
+      bool by_row = !by_lod && !output.shape.empty() &&
+                    output.shape[0] == samples;
+      size_t begin = 0;
+      for (size_t r = 0; r < batch->size(); ++r) {
+        size_t end = begin + (*batch)[r]->samples;
+        if (by_lod || by_row) {
+          results[r].push_back(SliceOutput(output, begin, end, by_lod));
+        } else {
+          results[r].push_back(output);
+        }
+        begin = end;
+      }
+    }
+  } catch (...) {
+    for (auto& request : *batch) {
+      request->promise.set_exception(std::current_exception());
+    }
+    return;
+  }
+  for (size_t r = 0; r < batch->size(); ++r) {
+    (*batch)[r]->promise.set_value(std::move(results[r]));
+  }
+}
+
+}  // namespace services
+}  // namespace paddle_infer
@@ -0,0 +1,124 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <future>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "paddle/fluid/inference/api/paddle_inference_api.h"
+
+namespace paddle_infer {
+namespace services {
+
+///
+/// \struct BatchingOptions
+///
+/// \brief The options of a BatchingPredictor.
+///
+struct PD_INFER_DECL BatchingOptions {
+  /// The number of samples a batch is closed at. A request larger than it
+  /// is run alone.
+  int max_batch_size{32};
+  /// How long the first request of a batch waits for more requests, from
+  /// the time it was queued, in microseconds.
+  int max_delay_us{1000};
+  /// The number of predictors, the first one and its clones, running
+  /// batches concurrently.
+  int num_workers{1};
+};
+
+///
+/// \class BatchingPredictor
+///
+/// \brief BatchingPredictor serves small requests from many threads with
+/// larger batches, to make better use of the CPU kernels.
+///
+/// Requests are queued, and a worker concatenates the inputs of the queued
+/// requests along the batch dimension until max_batch_size samples are
+/// collected or the first request has waited max_delay_us. The batch is run
+/// once, and every output is split back to the requests it was made of.
+///
+/// The batch dimension of a dense input is its first dimension, and that of
+/// an input with LoD is the number of its sequences, i.e. its first LoD
+/// level. An output is split by its first LoD level if it has one, or by
+/// its first dimension if that equals the batch size. Any other output is
+/// given whole to every request. Only requests whose inputs agree in dtype,
+/// LoD level and every dimension but the first one are batched together.
+///
+class PD_INFER_DECL BatchingPredictor {
+ public:
+  BatchingPredictor() = delete;
+  BatchingPredictor(const BatchingPredictor&) = delete;
+  BatchingPredictor& operator=(const BatchingPredictor&) = delete;
+
+  BatchingPredictor(const Config& config, const BatchingOptions& options);
+  ~BatchingPredictor();
+
+  ///
+  /// \brief Queue a request. Thread safe.
+  ///
+  /// \param[in] inputs The inputs of the request, on CPU, either named after
+  /// the inputs of the model or given in the order of GetInputNames().
+  /// \return The outputs of the request, in the order of GetOutputNames().
+  /// The future holds an exception if the request or its batch failed.
+  ///
+  std::future<std::vector<paddle::PaddleTensor>> Run(
+      std::vector<paddle::PaddleTensor> inputs);
+
+  std::vector<std::string> GetInputNames() const { return input_names_; }
+  std::vector<std::string> GetOutputNames() const { return output_names_; }
+
+ private:
+  struct Request {
+    std::vector<paddle::PaddleTensor> inputs;
+    // the batch size of the request
+    int samples{0};
+    std::chrono::steady_clock::time_point arrival;
+    std::promise<std::vector<paddle::PaddleTensor>> promise;
+  };
+
+  // Moves the inputs into the request in the order of the model inputs,
+  // throws if they are not a valid request.
+  void CheckInputs(std::vector<paddle::PaddleTensor>* inputs,
+                   Request* request) const;
+
+  void WorkerLoop(Predictor* predictor);
+  std::vector<std::unique_ptr<Request>> TakeBatch();
+  void RunBatch(Predictor* predictor,
+                std::vector<std::unique_ptr<Request>>* batch);
+
+  BatchingOptions options_;
+  std::vector<std::string> input_names_;
+  std::vector<std::string> output_names_;
+  std::vector<std::unique_ptr<Predictor>> predictors_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::unique_ptr<Request>> queue_;
+  // only one worker collects a batch at a time, the others run theirs
+  bool collecting_{false};
+  bool stop_{false};
+};
+
+}  // namespace services
+}  // namespace paddle_infer
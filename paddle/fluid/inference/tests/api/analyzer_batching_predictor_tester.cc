@@ -0,0 +1,167 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <future>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "paddle/fluid/inference/api/paddle_batching_predictor.h"
+#include "paddle/fluid/inference/tests/api/tester_helper.h"
+
+namespace paddle {
+namespace inference {
+
+using paddle_infer::services::BatchingOptions;
+using paddle_infer::services::BatchingPredictor;
+
+// Every line of the text classification data is one request holding a
+// single sequence of word ids.
+void SetInput(std::vector<std::vector<PaddleTensor>> *inputs,
+              size_t max_num = 1000) {
+  std::ifstream file(FLAGS_infer_data);
+  std::string line;
+  while (inputs->size() < max_num && std::getline(file, line)) {
+    std::vector<int64_t> data;
+    split_to_int64(line, ' ', &data);
+    PaddleTensor tensor;
+    tensor.dtype = PaddleDType::INT64;
+    tensor.lod.assign({{0, data.size()}});
+    tensor.shape = {static_cast<int>(data.size()), 1};
+    tensor.data.Resize(data.size() * sizeof(int64_t));
+    memcpy(tensor.data.data(), data.data(), data.size() * sizeof(int64_t));
+    inputs->push_back({tensor});
+  }
+  LOG(INFO) << "total number of requests: " << inputs->size();
+}
+
+void SetConfig(AnalysisConfig *cfg) {
+  cfg->SetModel(FLAGS_infer_model);
+  cfg->DisableGpu();
+  cfg->SwitchIrOptim();
+  cfg->SetCpuMathLibraryNumThreads(FLAGS_cpu_num_threads);
+}
+
+// Batched outputs must be the ones of running every request alone.
+TEST(Analyzer_Batching_Predictor, compare) {
+  AnalysisConfig cfg;
+  SetConfig(&cfg);
+  std::vector<std::vector<PaddleTensor>> inputs;
+  SetInput(&inputs, 200);
+
+  auto predictor = CreatePaddlePredictor(cfg);
+  std::vector<std::vector<PaddleTensor>> ref_outputs(inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    ASSERT_TRUE(predictor->Run(inputs[i], &ref_outputs[i]));
+  }
+
+  BatchingOptions options;
+  options.max_batch_size = 16;
+  options.num_workers = 2;
+  BatchingPredictor batching_predictor(cfg, options);
+  std::vector<std::future<std::vector<PaddleTensor>>> futures(inputs.size());
+  std::vector<std::thread> threads;
+  const size_t num_threads = 8;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      for (size_t i = t; i < inputs.size(); i += num_threads) {
+        futures[i] = batching_predictor.Run(inputs[i]);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    auto outputs = futures[i].get();
+    ASSERT_EQ(outputs.front().shape[0], 1);
+    CompareResult(outputs, ref_outputs[i]);
+  }
+}
+
+// Invalid requests fail their futures without reaching a batch.
+TEST(Analyzer_Batching_Predictor, invalid_requests) {
+  AnalysisConfig cfg;
+  SetConfig(&cfg);
+  std::vector<std::vector<PaddleTensor>> inputs;
+  SetInput(&inputs, 1);
+  BatchingPredictor batching_predictor(cfg, BatchingOptions());
+
+  auto unknown = inputs[0];
+  unknown[0].name = "no_such_input";
+  EXPECT_THROW(batching_predictor.Run(unknown).get(), std::exception);
+  auto twice = inputs[0];
+  twice.push_back(twice[0]);
+  EXPECT_THROW(batching_predictor.Run(twice).get(), std::exception);
+  EXPECT_EQ(batching_predictor.Run(inputs[0]).get().front().shape[0], 1);
+}
+
+// Throughput and latency of requests sent at a fixed rate, with batches of
+// at most one request and of up to 32 requests.
+TEST(Analyzer_Batching_Predictor, profile) {
+  AnalysisConfig cfg;
+  SetConfig(&cfg);
+  std::vector<std::vector<PaddleTensor>> inputs;
+  SetInput(&inputs);
+
+  for (int max_batch_size : {1, 32}) {
+    BatchingOptions options;
+    options.max_batch_size = max_batch_size;
+    options.max_delay_us = 2000;
+    options.num_workers = FLAGS_num_threads;
+    BatchingPredictor batching_predictor(cfg, options);
+    for (int rate : {500, 2000, 8000}) {
+      using Clock = std::chrono::steady_clock;
+      const size_t num_requests = 4 * inputs.size();
+      std::vector<std::future<std::vector<PaddleTensor>>> futures(
+          num_requests);
+      std::vector<Clock::time_point> sent(num_requests);
+      std::atomic<size_t> num_sent{0};
+      auto start = Clock::now();
+      std::thread sender([&] {
+        for (size_t i = 0; i < num_requests; ++i) {
+          std::this_thread::sleep_until(
+              start + std::chrono::microseconds(i * 1000000 / rate));
+          sent[i] = Clock::now();
+          futures[i] = batching_predictor.Run(inputs[i % inputs.size()]);
+          num_sent.store(i + 1, std::memory_order_release);
+        }
+      });
+      // requests finish about in the order they are sent
+      std::vector<double> latencies;
+      for (size_t i = 0; i < num_requests; ++i) {
+        while (num_sent.load(std::memory_order_acquire) <= i) {
+          std::this_thread::yield();
+        }
+        futures[i].get();
+        latencies.push_back(std::chrono::duration<double, std::milli>(
+                                Clock::now() - sent[i])
+                                .count());
+      }
+      sender.join();
+      double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+      std::sort(latencies.begin(), latencies.end());
+      LOG(INFO) << "max_batch_size " << max_batch_size << ", " << rate
+                << " requests/s sent: " << num_requests / seconds
+                << " requests/s served, p50 "
+                << latencies[latencies.size() / 2] << " ms, p99 "
+                << latencies[latencies.size() * 99 / 100] << " ms";
+    }
+  }
+}
+
+}  // namespace inference
+}  // namespace paddle
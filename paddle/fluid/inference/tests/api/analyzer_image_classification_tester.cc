@@ -102,6 +102,35 @@ TEST(Analyzer_resnet50, compare) { compare(); }
 TEST(Analyzer_resnet50, compare_mkldnn) { compare(true /* use_mkldnn */); }
 #endif
 
+// Compare the outputs with and without the static memory plan, which is
+// made for the shapes collected from a first run. The pass logs the size of
+// the arena against the ones of the reuse plan and of no reuse at all.
+TEST(Analyzer_resnet50, compare_static_memory_plan) {
+  std::vector<std::vector<PaddleTensor>> input_slots_all;
+  SetInput(&input_slots_all);
+  const std::string shape_range = "resnet50_shape_range.pbtxt";
+  std::vector<std::string> outputs_name;
+  {
+    AnalysisConfig cfg;
+    SetConfig(&cfg);
+    cfg.SwitchUseFeedFetchOps(false);
+    cfg.CollectShapeRangeInfo(shape_range);
+    auto predictor = CreatePaddlePredictor<AnalysisConfig>(cfg);
+    ConvertPaddleTensorToZeroCopyTensor(predictor.get(), input_slots_all[0]);
+    ASSERT_TRUE(predictor->ZeroCopyRun());
+    outputs_name = predictor->GetOutputNames();
+  }
+
+  AnalysisConfig cfg, planned_cfg;
+  SetConfig(&cfg);
+  SetConfig(&planned_cfg);
+  planned_cfg.EnableStaticMemoryPlan(shape_range);
+  CompareAnalysisAndZeroCopy(
+      reinterpret_cast<PaddlePredictor::Config *>(&cfg),
+      reinterpret_cast<PaddlePredictor::Config *>(&planned_cfg),
+      input_slots_all, outputs_name);
+}
+
 // Compare Deterministic result
 TEST(Analyzer_resnet50, compare_determine) {
   AnalysisConfig cfg;
@@ -0,0 +1,170 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/allocation_trace.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstring>
+
+#include "paddle/fluid/memory/allocation/spin_lock.h"
+#include "paddle/fluid/platform/enforce.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+static constexpr char kTraceMagic[8] = {'P', 'D', 'A', 'L', 'L', 'O', 'C', 'T'};
+static constexpr uint32_t kTraceVersion = 1;
+static constexpr size_t kThreadBufferSize = 4096;
+
+struct AllocationTraceRecorder::ThreadBuffer {
+  explicit ThreadBuffer(AllocationTraceRecorder *recorder)
+      : recorder_(recorder) {
+    events_.reserve(kThreadBufferSize);
+    std::lock_guard<std::mutex> guard(recorder_->mutex_);
+    recorder_->buffers_.insert(this);
+  }
+
+  ~ThreadBuffer() {
+    std::lock_guard<std::mutex> guard(recorder_->mutex_);
+    recorder_->buffers_.erase(this);
+    if (recorder_->file_.is_open()) {
+      std::lock_guard<SpinLock> buffer_guard(spinlock_);
+      recorder_->Write(events_);
+    }
+  }
+
+  AllocationTraceRecorder *recorder_;
+  std::vector<AllocationTraceEvent> events_;
+  SpinLock spinlock_;  // against Stop() from other threads
+};
+
+AllocationTraceRecorder &AllocationTraceRecorder::Instance() {
+  // Never deleted, as the buffers of the threads which exit later refer to
+  // it, but stopped at exit.
+  static auto *recorder = new AllocationTraceRecorder();
+  static struct Stopper {
+    ~Stopper() { recorder->Stop(); }
+  } stopper;
+  return *recorder;
+}
+
+void AllocationTraceRecorder::Start(const std::string &path) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  PADDLE_ENFORCE_EQ(file_.is_open(), false,
+                    platform::errors::PreconditionNotMet(
+                        "The allocation trace recorder is recording already."));
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  PADDLE_ENFORCE_EQ(file_.is_open(), true,
+                    platform::errors::Unavailable(
+                        "Cannot open the allocation trace file %s.", path));
+  uint32_t event_size = sizeof(AllocationTraceEvent);
+  file_.write(kTraceMagic, sizeof(kTraceMagic));
+  file_.write(reinterpret_cast<const char *>(&kTraceVersion),
+              sizeof(kTraceVersion));
+  file_.write(reinterpret_cast<const char *>(&event_size), sizeof(event_size));
+  // events left by a former recording
+  for (auto *buffer : buffers_) {
+    std::lock_guard<SpinLock> buffer_guard(buffer->spinlock_);
+    buffer->events_.clear();
+  }
+  VLOG(1) << "Record the allocations to " << path;
+  recording_ = true;
+}
+
+void AllocationTraceRecorder::Stop() {
+  recording_ = false;
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (!file_.is_open()) return;
+  for (auto *buffer : buffers_) {
+    std::lock_guard<SpinLock> buffer_guard(buffer->spinlock_);
+    Write(buffer->events_);
+    buffer->events_.clear();
+  }
+  file_.close();
+}
+
+void AllocationTraceRecorder::Record(const platform::Place &place,
+                                     uint64_t stream, const void *ptr,
+                                     size_t size, bool is_free) {
+  if (!IsRecording()) return;
+  thread_local ThreadBuffer buffer(this);
+
+  AllocationTraceEvent event;
+  std::memset(&event, 0, sizeof(event));
+  event.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count();
+  event.ptr = reinterpret_cast<uint64_t>(ptr);
+  event.size = size;
+  event.stream = stream;
+  event.place_type = static_cast<int8_t>(place.GetType());
+  event.device_id = place.GetDeviceId();
+  event.is_free = is_free;
+
+  std::vector<AllocationTraceEvent> events;
+  {
+    std::lock_guard<SpinLock> guard(buffer.spinlock_);
+    buffer.events_.push_back(event);
+    if (buffer.events_.size() < kThreadBufferSize) return;
+    events.swap(buffer.events_);
+    buffer.events_.reserve(kThreadBufferSize);
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  Write(events);
+}
+
+void AllocationTraceRecorder::Write(
+    const std::vector<AllocationTraceEvent> &events) {
+  if (file_.is_open()) {
+    file_.write(reinterpret_cast<const char *>(events.data()),
+                events.size() * sizeof(AllocationTraceEvent));
+  }
+}
+
+std::vector<AllocationTraceEvent> ReadAllocationTrace(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  PADDLE_ENFORCE_EQ(file.is_open(), true,
+                    platform::errors::Unavailable(
+                        "Cannot open the allocation trace file %s.", path));
+  char magic[sizeof(kTraceMagic)];
+  uint32_t version = 0, event_size = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char *>(&version), sizeof(version));
+  file.read(reinterpret_cast<char *>(&event_size), sizeof(event_size));
+  PADDLE_ENFORCE_EQ(
+      file.good() && std::memcmp(magic, kTraceMagic, sizeof(magic)) == 0 &&
+          version == kTraceVersion &&
+          event_size == sizeof(AllocationTraceEvent),
+      true, platform::errors::InvalidArgument(
+                "%s is not an allocation trace file of version %d.", path,
+                kTraceVersion));
+
+  std::vector<AllocationTraceEvent> events;
+  AllocationTraceEvent event;
+  while (file.read(reinterpret_cast<char *>(&event), sizeof(event))) {
+    events.push_back(event);
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const AllocationTraceEvent &a,
+                      const AllocationTraceEvent &b) {
+                     return a.timestamp_ns < b.timestamp_ns;
+                   });
+  return events;
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
@@ -0,0 +1,90 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "paddle/fluid/platform/macros.h"
+#include "paddle/fluid/platform/place.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+// An allocation or a free, as written to an allocation trace file.
+struct AllocationTraceEvent {
+  uint64_t timestamp_ns;  // of the steady clock
+  uint64_t ptr;           // identifies the allocation until it is freed
+  uint64_t size;
+  uint64_t stream;  // 0 if the allocator is not for a stream
+  int8_t place_type;  // pten::AllocationType
+  int8_t device_id;
+  uint8_t is_free;
+  uint8_t padding[5];
+};
+
+static_assert(sizeof(AllocationTraceEvent) == 40,
+              "AllocationTraceEvent is written to files as it is");
+
+/**
+ * AllocationTraceRecorder writes the allocations and frees passed to it to
+ * a binary trace file, which the allocation_trace_replay tool replays with
+ * each allocator.
+ *
+ * The events are buffered per thread, and a thread writes its buffer when
+ * it is full and when the thread exits. Stop() writes the buffers of all
+ * the threads, and is called at exit. The events are not in the order of
+ * their timestamps in the file, ReadAllocationTrace() sorts them.
+ */
+class AllocationTraceRecorder {
+ public:
+  static AllocationTraceRecorder &Instance();
+
+  void Start(const std::string &path);
+  void Stop();
+
+  bool IsRecording() const {
+    return recording_.load(std::memory_order_relaxed);
+  }
+
+  void Record(const platform::Place &place, uint64_t stream, const void *ptr,
+              size_t size, bool is_free);
+
+ private:
+  AllocationTraceRecorder() = default;
+
+  struct ThreadBuffer;
+
+  void Write(const std::vector<AllocationTraceEvent> &events);
+
+  std::atomic<bool> recording_{false};
+  std::mutex mutex_;  // guards file_ and buffers_
+  std::ofstream file_;
+  std::unordered_set<ThreadBuffer *> buffers_;
+
+  DISABLE_COPY_AND_ASSIGN(AllocationTraceRecorder);
+};
+
+// Read the events of a trace file, sorted by their timestamps.
+std::vector<AllocationTraceEvent> ReadAllocationTrace(const std::string &path);
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
@@ -0,0 +1,314 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays an allocation trace, recorded with FLAGS_allocation_trace_file,
+// with each allocator on CPU memory, and reports the events per second, the
+// peak of the memory the allocator reserved, and how much of the peak was
+// unused even when the most of it was allocated. The events of each place and
+// stream are replayed separately, as different allocators serve them.
+//
+//   allocation_trace_replay --trace_file=allocations.trace
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/memory/allocation/allocation_trace.h"
+#include "paddle/fluid/memory/allocation/auto_growth_best_fit_allocator.h"
+#include "paddle/fluid/memory/allocation/best_fit_allocator.h"
+#include "paddle/fluid/memory/allocation/buffered_allocator.h"
+#include "paddle/fluid/memory/allocation/cpu_allocator.h"
+#include "paddle/fluid/memory/detail/buddy_allocator.h"
+#include "paddle/fluid/memory/detail/system_allocator.h"
+#include "paddle/fluid/platform/cpu_info.h"
+
+DEFINE_string(trace_file, "", "The allocation trace file to replay.");
+DEFINE_uint64(alignment, 256, "The alignment of auto_growth.");
+DEFINE_uint64(chunk_size_in_mb, 0,
+              "The chunk size of auto_growth. 0 means no larger than the "
+              "allocation which needs the chunk.");
+DEFINE_uint64(best_fit_pool_in_mb, 0,
+              "The memory pool of best_fit. 0 means twice the peak of the "
+              "allocated memory of the trace.");
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+// The memory the allocators hold, and the memory allocated from them.
+struct MemoryUsage {
+  size_t reserved{0};
+  size_t allocated{0};
+  size_t peak_reserved{0};
+  // the most allocated while reserved is at its peak
+  size_t allocated_at_peak{0};
+};
+
+// Allocates CPU memory, counted as reserved by the allocator on top.
+class CountingAllocator : public Allocator {
+ public:
+  explicit CountingAllocator(MemoryUsage *usage)
+      : underlying_allocator_(std::make_shared<CPUAllocator>()),
+        usage_(usage) {}
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+ protected:
+  pten::Allocation *AllocateImpl(size_t size) override {
+    auto *allocation = underlying_allocator_->Allocate(size).release();
+    usage_->reserved += allocation->size();
+    return allocation;
+  }
+
+  void FreeImpl(pten::Allocation *allocation) override {
+    usage_->reserved -= allocation->size();
+    underlying_allocator_->Free(allocation);
+  }
+
+ private:
+  std::shared_ptr<Allocator> underlying_allocator_;
+  MemoryUsage *usage_;
+};
+
+class CountingSystemAllocator : public detail::SystemAllocator {
+ public:
+  explicit CountingSystemAllocator(MemoryUsage *usage) : usage_(usage) {}
+
+  void *Alloc(size_t *index, size_t size) override {
+    void *p = cpu_allocator_.Alloc(index, size);
+    if (p != nullptr) usage_->reserved += size;
+    return p;
+  }
+
+  void Free(void *p, size_t size, size_t index) override {
+    usage_->reserved -= size;
+    cpu_allocator_.Free(p, size, index);
+  }
+
+  bool UseGpu() const override { return false; }
+
+ private:
+  detail::CPUAllocator cpu_allocator_;
+  MemoryUsage *usage_;
+};
+
+// The buddy allocator which NaiveBestFitAllocator uses for CPUPlace. It is
+// made here, since NaiveBestFitAllocator uses a global one.
+class BuddyAllocatorAdapter : public Allocator {
+ public:
+  explicit BuddyAllocatorAdapter(MemoryUsage *usage)
+      : buddy_allocator_(std::unique_ptr<detail::SystemAllocator>(
+                             new CountingSystemAllocator(usage)),
+                         platform::CpuMinChunkSize(),
+                         platform::CpuMaxChunkSize()) {}
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+ protected:
+  pten::Allocation *AllocateImpl(size_t size) override {
+    void *ptr = buddy_allocator_.Alloc(size);
+    if (ptr == nullptr) {
+      PADDLE_THROW_BAD_ALLOC(platform::errors::ResourceExhausted(
+          "Cannot allocate %d bytes from the buddy allocator.", size));
+    }
+    return new Allocation(ptr, size, platform::CPUPlace());
+  }
+
+  void FreeImpl(pten::Allocation *allocation) override {
+    buddy_allocator_.Free(allocation->ptr());
+    delete allocation;
+  }
+
+ private:
+  detail::BuddyAllocator buddy_allocator_;
+};
+
+// BestFitAllocator which owns its memory pool.
+class PoolBestFitAllocator : public BestFitAllocator {
+ public:
+  PoolBestFitAllocator(std::shared_ptr<Allocator> pool_allocator,
+                       AllocationPtr pool)
+      : BestFitAllocator(pool.get()),
+        pool_allocator_(std::move(pool_allocator)),
+        pool_(std::move(pool)) {}
+
+ private:
+  std::shared_ptr<Allocator> pool_allocator_;
+  AllocationPtr pool_;
+};
+
+struct ReplayResult {
+  double events_per_second{0};
+  MemoryUsage usage;
+  size_t failures{0};
+};
+
+static ReplayResult Replay(
+    const std::vector<const AllocationTraceEvent *> &events,
+    const std::function<std::shared_ptr<Allocator>(MemoryUsage *)> &create) {
+  ReplayResult result;
+  auto &usage = result.usage;
+  auto allocator = create(&usage);
+  // the allocations and their requested sizes
+  std::unordered_map<uint64_t, std::pair<AllocationPtr, size_t>> allocations;
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto *event : events) {
+    if (event->is_free) {
+      auto it = allocations.find(event->ptr);
+      if (it == allocations.end()) continue;
+      usage.allocated -= it->second.second;
+      allocations.erase(it);
+    } else {
+      try {
+        auto allocation = allocator->Allocate(event->size);
+        // an allocation whose free is missing is replaced
+        auto &entry = allocations[event->ptr];
+        usage.allocated += event->size - entry.second;
+        entry = std::make_pair(std::move(allocation), event->size);
+      } catch (BadAlloc &) {
+        ++result.failures;
+        continue;
+      }
+      if (usage.reserved > usage.peak_reserved) {
+        usage.peak_reserved = usage.reserved;
+        usage.allocated_at_peak = usage.allocated;
+      } else if (usage.reserved == usage.peak_reserved) {
+        usage.allocated_at_peak =
+            std::max(usage.allocated_at_peak, usage.allocated);
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  result.events_per_second = events.size() / seconds;
+  return result;
+}
+
+// The peak of the bytes allocated by the events, which frees of unknown
+// allocations do not decrease.
+static size_t PeakAllocated(
+    const std::vector<const AllocationTraceEvent *> &events) {
+  std::unordered_map<uint64_t, size_t> sizes;
+  size_t allocated = 0, peak = 0;
+  for (auto *event : events) {
+    if (event->is_free) {
+      auto it = sizes.find(event->ptr);
+      if (it == sizes.end()) continue;
+      allocated -= it->second;
+      sizes.erase(it);
+    } else {
+      sizes[event->ptr] = event->size;
+      allocated += event->size;
+      peak = std::max(peak, allocated);
+    }
+  }
+  return peak;
+}
+
+static void ReplayAll(const std::vector<const AllocationTraceEvent *> &events) {
+  size_t peak_allocated = PeakAllocated(events);
+  size_t pool_size = FLAGS_best_fit_pool_in_mb > 0
+                         ? FLAGS_best_fit_pool_in_mb << 20
+                         : std::max<size_t>(2 * peak_allocated, 1 << 20);
+  std::cout << events.size() << " events, " << (peak_allocated >> 20)
+            << " MB allocated at peak" << std::endl;
+
+  std::vector<std::pair<
+      std::string, std::function<std::shared_ptr<Allocator>(MemoryUsage *)>>>
+      allocators = {
+          {"naive_best_fit",
+           [](MemoryUsage *usage) {
+             return std::make_shared<BuddyAllocatorAdapter>(usage);
+           }},
+          {"auto_growth",
+           [](MemoryUsage *usage) {
+             return std::make_shared<AutoGrowthBestFitAllocator>(
+                 std::make_shared<CountingAllocator>(usage), FLAGS_alignment,
+                 FLAGS_chunk_size_in_mb << 20);
+           }},
+          {"best_fit",
+           [pool_size](MemoryUsage *usage) {
+             auto counting_allocator =
+                 std::make_shared<CountingAllocator>(usage);
+             auto pool = counting_allocator->Allocate(pool_size);
+             return std::make_shared<PoolBestFitAllocator>(counting_allocator,
+                                                           std::move(pool));
+           }},
+          {"buffered", [](MemoryUsage *usage) {
+             return std::make_shared<BufferedAllocator>(
+                 std::make_shared<CountingAllocator>(usage));
+           }}};
+
+  for (auto &pair : allocators) {
+    auto result = Replay(events, pair.second);
+    auto &usage = result.usage;
+    double fragmentation =
+        usage.peak_reserved == 0
+            ? 0.0
+            : 1.0 - static_cast<double>(usage.allocated_at_peak) /
+                        usage.peak_reserved;
+    std::cout << "  " << std::left << std::setw(16) << pair.first
+              << std::right << std::setw(12) << std::setprecision(4)
+              << result.events_per_second << " events/s, peak reserved "
+              << std::setw(8) << (usage.peak_reserved >> 20)
+              << " MB, at least " << std::setw(6) << std::setprecision(3)
+              << fragmentation * 100 << "% of it unused";
+    if (result.failures > 0) {
+      std::cout << ", " << result.failures << " allocations failed";
+    }
+    std::cout << std::endl;
+  }
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
+
+int main(int argc, char *argv[]) {
+  ::GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  using paddle::memory::allocation::AllocationTraceEvent;
+
+  auto events = paddle::memory::allocation::ReadAllocationTrace(
+      FLAGS_trace_file);
+  // the events of each place and stream
+  std::map<std::tuple<int, int, uint64_t>,
+           std::vector<const AllocationTraceEvent *>>
+      groups;
+  for (auto &event : events) {
+    groups[std::make_tuple(event.place_type, event.device_id, event.stream)]
+        .push_back(&event);
+  }
+  for (auto &group : groups) {
+    paddle::platform::Place place(
+        static_cast<pten::AllocationType>(std::get<0>(group.first)),
+        std::get<1>(group.first));
+    std::cout << place << ", stream " << std::hex << std::get<2>(group.first)
+              << std::dec << ": ";
+    paddle::memory::allocation::ReplayAll(group.second);
+  }
+  return 0;
+}
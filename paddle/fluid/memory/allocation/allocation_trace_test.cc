@@ -0,0 +1,93 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/allocation_trace.h"
+
+#include <fstream>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/memory/allocation/cpu_allocator.h"
+#include "paddle/fluid/memory/allocation/trace_recording_allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+TEST(AllocationTrace, record_and_read) {
+  const std::string path = "allocation_trace_test.trace";
+  auto &recorder = AllocationTraceRecorder::Instance();
+  recorder.Start(path);
+
+  platform::CPUPlace place;
+  auto allocator = std::make_shared<TraceRecordingAllocator>(
+      std::make_shared<CPUAllocator>(), place, 7);
+  // freed by another thread
+  auto shared_allocation = allocator->Allocate(100);
+  const size_t num_threads = 4;
+  // more than a buffer of a thread holds
+  const size_t num_allocations = 5000;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      if (t == 0) shared_allocation.reset();
+      std::vector<AllocationPtr> allocations;
+      for (size_t i = 0; i < num_allocations; ++i) {
+        allocations.emplace_back(allocator->Allocate(i + 1));
+        if (i % 2 == 1) allocations[i - 1].reset();
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  recorder.Stop();
+  allocator->Allocate(1);  // not recorded
+
+  auto events = ReadAllocationTrace(path);
+  ASSERT_EQ(events.size(), 2 * (num_threads * num_allocations + 1));
+  std::unordered_map<uint64_t, uint64_t> sizes;
+  for (size_t i = 0; i < events.size(); ++i) {
+    auto &event = events[i];
+    if (i > 0) ASSERT_GE(event.timestamp_ns, events[i - 1].timestamp_ns);
+    ASSERT_EQ(event.place_type, static_cast<int8_t>(place.GetType()));
+    ASSERT_EQ(event.stream, 7UL);
+    if (event.is_free) {
+      // an allocation is freed after it is allocated
+      auto it = sizes.find(event.ptr);
+      ASSERT_NE(it, sizes.end());
+      ASSERT_EQ(it->second, event.size);
+      sizes.erase(it);
+    } else {
+      ASSERT_TRUE(sizes.emplace(event.ptr, event.size).second);
+    }
+  }
+  ASSERT_TRUE(sizes.empty());
+
+  // recorded again
+  recorder.Start(path);
+  allocator->Allocate(1);
+  recorder.Stop();
+  ASSERT_EQ(ReadAllocationTrace(path).size(), 2UL);
+}
+
+TEST(AllocationTrace, not_a_trace) {
+  const std::string path = "allocation_trace_test.not_a_trace";
+  std::ofstream(path) << "not a trace";
+  ASSERT_THROW(ReadAllocationTrace(path), platform::EnforceNotMet);
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
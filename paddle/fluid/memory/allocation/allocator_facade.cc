@@ -17,11 +17,14 @@
 #include "gflags/gflags.h"
 #include "paddle/fluid/memory/allocation/aligned_allocator.h"
 #include "paddle/fluid/memory/allocation/allocator.h"
+#include "paddle/fluid/memory/allocation/allocation_trace.h"
 #include "paddle/fluid/memory/allocation/allocator_strategy.h"
 #include "paddle/fluid/memory/allocation/auto_growth_best_fit_allocator.h"
 #include "paddle/fluid/memory/allocation/cpu_allocator.h"
 #include "paddle/fluid/memory/allocation/naive_best_fit_allocator.h"
 #include "paddle/fluid/memory/allocation/retry_allocator.h"
+#include "paddle/fluid/memory/allocation/thread_caching_cpu_allocator.h"
+#include "paddle/fluid/memory/allocation/trace_recording_allocator.h"
 #include "paddle/fluid/platform/enforce.h"
 #include "paddle/fluid/platform/place.h"
 
@@ -80,6 +83,13 @@ PADDLE_DEFINE_EXPORTED_bool(use_virtual_memory_auto_growth, false,
 PADDLE_DEFINE_EXPORTED_bool(use_stream_safe_cuda_allocator, false,
                             "Enable StreamSafeCUDAAllocator");
 
+PADDLE_DEFINE_EXPORTED_string(
+    allocation_trace_file, "",
+    "The file to record the allocations and frees of all the places to, "
+    "which the allocation_trace_replay tool replays with each allocator. "
+    "No allocation is recorded if empty. It only works when set before the "
+    "first allocation.");
+
 DECLARE_string(allocator_strategy);
 
 namespace paddle {
@@ -252,6 +262,40 @@ class AllocatorFacadePrivate {
         break;
       }
 
+      case AllocatorStrategy::kThreadCaching: {
+        InitThreadCachingCPUAllocator();
+#if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
+        PADDLE_ENFORCE_EQ(
+            FLAGS_use_stream_safe_cuda_allocator, false,
+            paddle::platform::errors::Unimplemented(
+                "StreamSafeCUDAAllocator is only implemented for auto_growth "
+                "strategy, not support thread_caching strategy"));
+
+        allow_free_idle_chunk_ = allow_free_idle_chunk;
+        for (int dev_id = 0; dev_id < platform::GetGPUDeviceCount(); ++dev_id) {
+          InitAutoGrowthCUDAAllocator(platform::CUDAPlace(dev_id),
+                                      allow_free_idle_chunk_);
+        }
+        InitNaiveBestFitCUDAPinnedAllocator();
+#endif
+#ifdef PADDLE_WITH_XPU
+        for (int dev_id = 0; dev_id < platform::GetXPUDeviceCount(); ++dev_id) {
+          InitNaiveBestFitXPUAllocator(platform::XPUPlace(dev_id));
+        }
+#endif
+#ifdef PADDLE_WITH_IPU
+        for (int dev_id = 0; dev_id < platform::GetIPUDeviceCount(); ++dev_id) {
+          InitNaiveBestFitIPUAllocator(platform::IPUPlace(dev_id));
+        }
+#endif
+#ifdef PADDLE_WITH_MLU
+        for (int dev_id = 0; dev_id < platform::GetMLUDeviceCount(); ++dev_id) {
+          InitNaiveBestFitMLUAllocator(platform::MLUPlace(dev_id));
+        }
+#endif
+        break;
+      }
+
       default: {
         PADDLE_THROW(platform::errors::InvalidArgument(
             "Unsupported allocator strategy: %d", static_cast<int>(strategy_)));
@@ -264,6 +308,10 @@ class AllocatorFacadePrivate {
       WrapCUDARetryAllocator(FLAGS_gpu_allocator_retry_time);
     }
 
+    if (!FLAGS_allocation_trace_file.empty()) {
+      WrapTraceRecordingAllocator();
+    }
+
     CheckAllocThreadSafe();
   }
 
@@ -430,6 +478,11 @@ class AllocatorFacadePrivate {
         std::make_shared<NaiveBestFitAllocator>(platform::CPUPlace());
   }
 
+  void InitThreadCachingCPUAllocator() {
+    allocators_[platform::CPUPlace()] =
+        std::make_shared<ThreadCachingCPUAllocator>();
+  }
+
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
   void InitNaiveBestFitCUDAPinnedAllocator() {
     allocators_[platform::CUDAPinnedPlace()] =
@@ -449,6 +502,10 @@ class AllocatorFacadePrivate {
       InitAutoGrowthCUDAAllocator(p, stream);
       WrapStreamSafeCUDAAllocator(p, stream);
       WrapCUDARetryAllocator(p, stream, FLAGS_gpu_allocator_retry_time);
+      if (!FLAGS_allocation_trace_file.empty()) {
+        cuda_allocators_[p][stream] = std::make_shared<TraceRecordingAllocator>(
+            cuda_allocators_[p][stream], p, reinterpret_cast<uint64_t>(stream));
+      }
     }
   }
 
@@ -775,6 +832,17 @@ class AllocatorFacadePrivate {
     }
   }
 
+  void WrapTraceRecordingAllocator() {
+    auto& recorder = AllocationTraceRecorder::Instance();
+    if (!recorder.IsRecording()) {
+      recorder.Start(FLAGS_allocation_trace_file);
+    }
+    for (auto& pair : allocators_) {
+      pair.second =
+          std::make_shared<TraceRecordingAllocator>(pair.second, pair.first);
+    }
+  }
+
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
   // a standalone CUDA allocator to support multi-stream GC in new executor
   CUDAAllocatorMap cuda_allocators_;
@@ -14,6 +14,10 @@
 
 #include "paddle/fluid/memory/allocation/auto_growth_best_fit_allocator.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include <algorithm>
 #include <mutex>  // NOLINT
 #include "paddle/fluid/memory/allocation/aligned_allocator.h"
@@ -33,133 +37,273 @@ PADDLE_DEFINE_EXPORTED_READONLY_bool(
     "chunk would be freed when out of memory occurs. This flag "
     "only works when FLAGS_allocator_strategy=auto_growth.");
 
+PADDLE_DEFINE_EXPORTED_uint64(
+    auto_growth_lock_shards, 1,
+    "The number of size ranges, from 1 to 8, whose allocations are served "
+    "from separate chunks under separate locks. Sizes below 64KB are in "
+    "the first range and each next range is 16 times larger. More shards "
+    "let threads allocating different sizes run concurrently, but memory "
+    "cached by one range can not be used by the others. This flag takes "
+    "effect on the allocators created after it is set, and only works when "
+    "FLAGS_allocator_strategy=auto_growth.");
+
 namespace paddle {
 namespace memory {
 namespace allocation {
 
+#ifdef _MSC_VER
+static inline size_t LowestBit(uint64_t x) {
+  unsigned long index;  // NOLINT
+  _BitScanForward64(&index, x);
+  return index;
+}
+
+static inline size_t HighestBit(uint64_t x) {
+  unsigned long index;  // NOLINT
+  _BitScanReverse64(&index, x);
+  return index;
+}
+#else
+static inline size_t LowestBit(uint64_t x) { return __builtin_ctzll(x); }
+
+static inline size_t HighestBit(uint64_t x) { return 63 - __builtin_clzll(x); }
+#endif
+
 AutoGrowthBestFitAllocator::AutoGrowthBestFitAllocator(
     const std::shared_ptr<Allocator> &underlying_allocator, size_t alignment,
     size_t chunk_size, bool allow_free_idle_chunk)
     : underlying_allocator_(underlying_allocator),
       alignment_(alignment),
       chunk_size_(std::max(AlignedSize(chunk_size, alignment), alignment)),
-      allow_free_idle_chunk_(allow_free_idle_chunk) {}
+      allow_free_idle_chunk_(allow_free_idle_chunk) {
+  PADDLE_ENFORCE_EQ(
+      FLAGS_auto_growth_lock_shards >= 1 &&
+          FLAGS_auto_growth_lock_shards <= kMaxShards,
+      true, platform::errors::InvalidArgument(
+                "FLAGS_auto_growth_lock_shards should be in [1, %d], but "
+                "received %d.",
+                kMaxShards, FLAGS_auto_growth_lock_shards));
+  for (size_t i = 0; i < FLAGS_auto_growth_lock_shards; ++i) {
+    shards_.emplace_back(new Shard());
+  }
+}
+
+AutoGrowthBestFitAllocator::Chunk::~Chunk() {
+  for (auto *block = blocks_; block != nullptr;) {
+    auto *next = block->next_;
+    delete block;
+    block = next;
+  }
+}
+
+void AutoGrowthBestFitAllocator::Mapping(size_t size, size_t *fl, size_t *sl) {
+  if (size < kSLCount) {
+    *fl = 0;
+    *sl = size;
+  } else {
+    size_t log2 = HighestBit(size);
+    *fl = log2 - kSLBits + 1;
+    *sl = (size >> (log2 - kSLBits)) - kSLCount;
+  }
+}
+
+size_t AutoGrowthBestFitAllocator::ShardOf(size_t size) const {
+  size_t shard = 0;
+  for (size_t limit = 64 << 10; shard + 1 < shards_.size() && size >= limit;
+       limit <<= 4) {
+    ++shard;
+  }
+  return shard;
+}
+
+void AutoGrowthBestFitAllocator::Shard::InsertFreeBlock(Block *block) {
+  size_t fl, sl;
+  Mapping(block->size_, &fl, &sl);
+  auto *&head = free_blocks_[fl][sl];
+  block->is_free_ = true;
+  block->prev_free_ = nullptr;
+  block->next_free_ = head;
+  if (head != nullptr) head->prev_free_ = block;
+  head = block;
+  sl_bitmaps_[fl] |= 1U << sl;
+  fl_bitmap_ |= 1ULL << fl;
+}
+
+void AutoGrowthBestFitAllocator::Shard::RemoveFreeBlock(Block *block) {
+  size_t fl, sl;
+  Mapping(block->size_, &fl, &sl);
+  if (block->next_free_ != nullptr) {
+    block->next_free_->prev_free_ = block->prev_free_;
+  }
+  if (block->prev_free_ != nullptr) {
+    block->prev_free_->next_free_ = block->next_free_;
+  } else {
+    free_blocks_[fl][sl] = block->next_free_;
+    if (block->next_free_ == nullptr) {
+      sl_bitmaps_[fl] &= ~(1U << sl);
+      if (sl_bitmaps_[fl] == 0) fl_bitmap_ &= ~(1ULL << fl);
+    }
+  }
+  block->prev_free_ = block->next_free_ = nullptr;
+}
+
+AutoGrowthBestFitAllocator::Block *
+AutoGrowthBestFitAllocator::Shard::FindFreeBlock(size_t size) {
+  size_t fl, sl;
+  Mapping(size, &fl, &sl);
+  auto *block = free_blocks_[fl][sl];
+  for (size_t i = 0; block != nullptr && i < kMaxBinScan; ++i) {
+    if (block->size_ >= size) return block;
+    block = block->next_free_;
+  }
+
+  uint32_t sl_bitmap = sl_bitmaps_[fl] & (~0U << (sl + 1));
+  if (sl_bitmap != 0) {
+    return free_blocks_[fl][LowestBit(sl_bitmap)];
+  }
+  uint64_t fl_bitmap = fl_bitmap_ & (~0ULL << (fl + 1));
+  if (fl_bitmap != 0) {
+    fl = LowestBit(fl_bitmap);
+    return free_blocks_[fl][LowestBit(sl_bitmaps_[fl])];
+  }
+
+  for (; block != nullptr; block = block->next_free_) {
+    if (block->size_ >= size) return block;
+  }
+  return nullptr;
+}
 
 pten::Allocation *AutoGrowthBestFitAllocator::AllocateImpl(
     size_t unaligned_size) {
   size_t size = AlignedSize(unaligned_size, alignment_);
   VLOG(10) << "Allocate " << unaligned_size << " bytes, aligned to " << size;
 
-  std::lock_guard<SpinLock> guard(spinlock_);
-  auto iter = free_blocks_.lower_bound(std::make_pair(size, nullptr));
-  BlockIt block_it;
-  if (iter != free_blocks_.end()) {
-    block_it = iter->second;
-    free_blocks_.erase(iter);
-    auto *chunk = block_it->chunk_;
-    size_t remaining_size = block_it->size_ - size;
+  auto *shard = shards_[ShardOf(size)].get();
+  std::unique_lock<SpinLock> guard(shard->spinlock_);
+  auto *block = shard->FindFreeBlock(size);
+  if (block != nullptr) {
+    shard->RemoveFreeBlock(block);
+    size_t remaining_size = block->size_ - size;
     VLOG(10) << "Allocate " << size << " bytes from chunk size "
-             << block_it->size_ << ", remaining " << remaining_size;
+             << block->size_ << ", remaining " << remaining_size;
     if (remaining_size == 0) {
-      block_it->is_free_ = false;
+      block->is_free_ = false;
     } else {
-      auto remaining_free_block = chunk->blocks_.insert(
-          block_it, Block(block_it->ptr_, remaining_size, true, chunk));
-      free_blocks_.emplace(std::make_pair(remaining_size, block_it->ptr_),
-                           remaining_free_block);
-      block_it->ptr_ =
-          reinterpret_cast<uint8_t *>(block_it->ptr_) + remaining_size;
-      block_it->size_ = size;
-      block_it->is_free_ = false;
+      auto *allocated_block =
+          new Block(reinterpret_cast<uint8_t *>(block->ptr_) + remaining_size,
+                    size, false, block->chunk_);
+      allocated_block->prev_ = block;
+      allocated_block->next_ = block->next_;
+      if (block->next_ != nullptr) block->next_->prev_ = allocated_block;
+      block->next_ = allocated_block;
+      block->size_ = remaining_size;
+      shard->InsertFreeBlock(block);
+      block = allocated_block;
     }
   } else {
+    // The other shards are locked one at a time, so that no two threads
+    // wait for the locks held by each other.
     if (FLAGS_free_when_no_cache_hit) {
+      guard.unlock();
       FreeIdleChunks();
+      guard.lock();
     }
     size_t realloc_size = std::max(size, chunk_size_);
 
+    DecoratedAllocationPtr allocation;
     try {
-      chunks_.emplace_back(static_unique_ptr_cast<Allocation>(
-          underlying_allocator_->Allocate(realloc_size)));
+      allocation = static_unique_ptr_cast<Allocation>(
+          underlying_allocator_->Allocate(realloc_size));
     } catch (BadAlloc &ex) {
       if (FLAGS_free_when_no_cache_hit) throw ex;
+      guard.unlock();
       FreeIdleChunks();
-      chunks_.emplace_back(static_unique_ptr_cast<Allocation>(
-          underlying_allocator_->Allocate(realloc_size)));
+      guard.lock();
+      allocation = static_unique_ptr_cast<Allocation>(
+          underlying_allocator_->Allocate(realloc_size));
     }
 
-    auto *chunk = &(*chunks_.rbegin());
+    shard->chunks_.emplace_back(std::move(allocation), shard);
+    auto *chunk = &shard->chunks_.back();
     realloc_size = chunk->allocation_->size();
     uint8_t *p = reinterpret_cast<uint8_t *>(chunk->allocation_->ptr());
-    auto &blocks = chunk->blocks_;
 
     size_t remaining_size = realloc_size - size;
+    block = new Block(p + remaining_size, size, false, chunk);
+    chunk->blocks_ = block;
     if (remaining_size > 0) {
-      blocks.emplace_back(p, remaining_size, true, chunk);
-      free_blocks_.emplace(std::make_pair(remaining_size, p), --(blocks.end()));
+      auto *free_block = new Block(p, remaining_size, true, chunk);
+      free_block->next_ = block;
+      block->prev_ = free_block;
+      chunk->blocks_ = free_block;
+      shard->InsertFreeBlock(free_block);
     }
-    blocks.emplace_back(p + remaining_size, size, false, chunk);
-    block_it = --(blocks.end());
     VLOG(2) << "Not found and reallocate " << realloc_size << "("
             << static_cast<void *>(p) << "), and remaining " << remaining_size;
   }
-  VLOG(10) << "Alloc " << block_it->size_ << " bytes, ptr = " << block_it->ptr_;
-  return new BlockAllocation(block_it);
+  shard->allocated_bytes_ += block->size_;
+  VLOG(10) << "Alloc " << block->size_ << " bytes, ptr = " << block->ptr_;
+  return new BlockAllocation(block);
 }
 
 void AutoGrowthBestFitAllocator::FreeImpl(pten::Allocation *allocation) {
   VLOG(10) << "Free " << allocation->size()
            << " bytes, ptr = " << allocation->ptr();
-  std::lock_guard<SpinLock> guard(spinlock_);
-  auto block_it = static_cast<BlockAllocation *>(allocation)->block_it_;
-  auto &blocks = block_it->chunk_->blocks_;
-
-  block_it->is_free_ = true;
-
-  if (block_it != blocks.begin()) {
-    auto prev_it = block_it;
-    --prev_it;
+  auto *block = static_cast<BlockAllocation *>(allocation)->block_;
+  auto *shard = block->chunk_->shard_;
+  std::lock_guard<SpinLock> guard(shard->spinlock_);
+  shard->allocated_bytes_ -= block->size_;
 
-    if (prev_it->is_free_) {
-      free_blocks_.erase(std::make_pair(prev_it->size_, prev_it->ptr_));
-      prev_it->size_ += block_it->size_;
-      blocks.erase(block_it);
-      block_it = prev_it;
-    }
+  auto *prev = block->prev_;
+  if (prev != nullptr && prev->is_free_) {
+    shard->RemoveFreeBlock(prev);
+    prev->size_ += block->size_;
+    prev->next_ = block->next_;
+    if (block->next_ != nullptr) block->next_->prev_ = prev;
+    delete block;
+    block = prev;
   }
 
-  auto next_it = block_it;
-  ++next_it;
-
-  if (next_it != blocks.end() && next_it->is_free_) {
-    free_blocks_.erase(std::make_pair(next_it->size_, next_it->ptr_));
-    block_it->size_ += next_it->size_;
-    blocks.erase(next_it);
+  auto *next = block->next_;
+  if (next != nullptr && next->is_free_) {
+    shard->RemoveFreeBlock(next);
+    block->size_ += next->size_;
+    block->next_ = next->next_;
+    if (next->next_ != nullptr) next->next_->prev_ = block;
+    delete next;
   }
 
-  free_blocks_.emplace(std::make_pair(block_it->size_, block_it->ptr_),
-                       block_it);
+  shard->InsertFreeBlock(block);
 
   delete allocation;
 
   if (FLAGS_free_idle_chunk) {
-    FreeIdleChunks();
+    FreeIdleChunks(shard);
   }
 }
 
 uint64_t AutoGrowthBestFitAllocator::FreeIdleChunks() {
+  uint64_t bytes = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<SpinLock> guard(shard->spinlock_);
+    bytes += FreeIdleChunks(shard.get());
+  }
+  return bytes;
+}
+
+uint64_t AutoGrowthBestFitAllocator::FreeIdleChunks(Shard *shard) {
   if (!allow_free_idle_chunk_) {
     return 0;
   }
   uint64_t bytes = 0;
-  for (auto chunk_it = chunks_.begin(); chunk_it != chunks_.end();) {
-    auto &blocks = chunk_it->blocks_;
-    if (blocks.size() == 1 && blocks.begin()->is_free_) {
-      auto &block = *blocks.begin();
-      VLOG(2) << "Free chunk with size " << block.size_;
-      bytes += block.size_;
-      free_blocks_.erase(std::make_pair(block.size_, block.ptr_));
-      chunk_it = chunks_.erase(chunk_it);
+  auto &chunks = shard->chunks_;
+  for (auto chunk_it = chunks.begin(); chunk_it != chunks.end();) {
+    auto *block = chunk_it->blocks_;
+    if (block->is_free_ && block->next_ == nullptr) {
+      VLOG(2) << "Free chunk with size " << block->size_;
+      bytes += block->size_;
+      shard->RemoveFreeBlock(block);
+      chunk_it = chunks.erase(chunk_it);
     } else {
       ++chunk_it;
     }
@@ -167,6 +311,30 @@ uint64_t AutoGrowthBestFitAllocator::FreeIdleChunks() {
   return bytes;
 }
 
+AutoGrowthBestFitAllocator::Stats AutoGrowthBestFitAllocator::GetStats() {
+  Stats stats;
+  for (auto &shard : shards_) {
+    std::lock_guard<SpinLock> guard(shard->spinlock_);
+    for (auto &chunk : shard->chunks_) {
+      stats.reserved_bytes += chunk.allocation_->size();
+    }
+    stats.allocated_bytes += shard->allocated_bytes_;
+    stats.chunks += shard->chunks_.size();
+    for (size_t fl = 0; fl < kFLCount; ++fl) {
+      for (size_t sl = 0; sl < kSLCount; ++sl) {
+        for (auto *block = shard->free_blocks_[fl][sl]; block != nullptr;
+             block = block->next_free_) {
+          stats.free_bytes += block->size_;
+          stats.largest_free_block =
+              std::max(stats.largest_free_block, block->size_);
+          ++stats.free_blocks;
+        }
+      }
+    }
+  }
+  return stats;
+}
+
 }  // namespace allocation
 }  // namespace memory
 }  // namespace paddle
@@ -15,10 +15,10 @@
 #pragma once
 
 #include <list>
-#include <map>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <utility>
+#include <vector>
 
 #include "paddle/fluid/memory/allocation/allocator.h"
 #include "paddle/fluid/memory/allocation/spin_lock.h"
@@ -27,6 +27,23 @@ namespace paddle {
 namespace memory {
 namespace allocation {
 
+/**
+ * AutoGrowthBestFitAllocator splits chunks taken from the underlying
+ * allocator into blocks, and merges a freed block with its free neighbours.
+ *
+ * - Free blocks are indexed by segregated size bins, 16 per power of two,
+ *   with bitmaps of the non-empty bins (as in TLSF). The blocks of a bin
+ *   larger than the one of the requested size all fit, and the smallest
+ *   such bin is found in constant time. The first few blocks of the bin of
+ *   the requested size are tried before, and the rest of them only before
+ *   the memory grows.
+ * - The blocks of a chunk are linked in address order, and a freed block
+ *   is merged with its neighbours in constant time. The block records live
+ *   in host memory, since the chunks may be device memory.
+ * - With FLAGS_auto_growth_lock_shards > 1, sizes are split into that many
+ *   ranges, each with its own chunks, bins and lock, so that allocations
+ *   of different sizes do not wait for each other.
+ */
 class AutoGrowthBestFitAllocator : public Allocator {
  public:
   AutoGrowthBestFitAllocator(
@@ -35,6 +52,25 @@ class AutoGrowthBestFitAllocator : public Allocator {
 
   bool IsAllocThreadSafe() const override { return true; }
 
+  struct Stats {
+    size_t reserved_bytes{0};   // bytes of the chunks
+    size_t allocated_bytes{0};  // bytes of the allocated blocks
+    size_t free_bytes{0};
+    size_t largest_free_block{0};
+    size_t free_blocks{0};
+    size_t chunks{0};
+
+    // The part of the free bytes which are not in the largest free block,
+    // 0 when all the free bytes are in one block.
+    double Fragmentation() const {
+      return free_bytes == 0
+                 ? 0.0
+                 : 1.0 - static_cast<double>(largest_free_block) / free_bytes;
+    }
+  };
+
+  Stats GetStats();
+
  protected:
   pten::Allocation *AllocateImpl(size_t size) override;
 
@@ -46,12 +82,14 @@ class AutoGrowthBestFitAllocator : public Allocator {
   }
 
  private:
-  uint64_t FreeIdleChunks();
-
-  template <typename T>
-  using List = std::list<T>;
+  static constexpr size_t kSLBits = 4;
+  static constexpr size_t kSLCount = 1 << kSLBits;
+  static constexpr size_t kFLCount = 64 - kSLBits + 1;
+  static constexpr size_t kMaxBinScan = 8;
+  static constexpr size_t kMaxShards = 8;
 
   struct Chunk;
+  struct Shard;
 
   struct Block {
     Block(void *ptr, size_t size, bool is_free, Chunk *chunk)
@@ -61,35 +99,64 @@ class AutoGrowthBestFitAllocator : public Allocator {
     size_t size_;
     bool is_free_;
     Chunk *chunk_;  // which chunk it is from
+
+    // the neighbours in the chunk, in address order
+    Block *prev_{nullptr};
+    Block *next_{nullptr};
+    // the neighbours in the bin, if free
+    Block *prev_free_{nullptr};
+    Block *next_free_{nullptr};
   };
 
   struct Chunk {
-    explicit Chunk(DecoratedAllocationPtr allocation)
-        : allocation_(std::move(allocation)) {}
+    Chunk(DecoratedAllocationPtr allocation, Shard *shard)
+        : allocation_(std::move(allocation)), shard_(shard) {}
+    ~Chunk();
 
     DecoratedAllocationPtr allocation_;
-    List<Block> blocks_;
+    Shard *shard_;
+    Block *blocks_{nullptr};  // the first block
+  };
+
+  struct Shard {
+    void InsertFreeBlock(Block *block);
+    void RemoveFreeBlock(Block *block);
+    Block *FindFreeBlock(size_t size);
+
+    std::list<Chunk> chunks_;
+    // the free blocks of bin (fl, sl) are listed from free_blocks_[fl][sl]
+    Block *free_blocks_[kFLCount][kSLCount] = {};
+    uint64_t fl_bitmap_{0};
+    uint32_t sl_bitmaps_[kFLCount] = {};
+    size_t allocated_bytes_{0};
+
+    SpinLock spinlock_;
   };
 
   struct BlockAllocation : public Allocation {
-    explicit BlockAllocation(const List<Block>::iterator &it)
-        : Allocation(it->ptr_, it->chunk_->allocation_->base_ptr(), it->size_,
-                     it->chunk_->allocation_->place()),
-          block_it_(it) {}
+    explicit BlockAllocation(Block *block)
+        : Allocation(block->ptr_, block->chunk_->allocation_->base_ptr(),
+                     block->size_, block->chunk_->allocation_->place()),
+          block_(block) {}
 
-    List<Block>::iterator block_it_;
+    Block *block_;
   };
 
-  using BlockIt = List<Block>::iterator;
+  static void Mapping(size_t size, size_t *fl, size_t *sl);
+
+  size_t ShardOf(size_t size) const;
+
+  // Free the idle chunks of all the shards. The caller must not hold the
+  // lock of any shard.
+  uint64_t FreeIdleChunks();
+  // Free the idle chunks of shard, whose lock the caller holds.
+  uint64_t FreeIdleChunks(Shard *shard);
 
   std::shared_ptr<Allocator> underlying_allocator_;
-  std::map<std::pair<size_t, void *>, BlockIt> free_blocks_;
-  std::list<Chunk> chunks_;
+  std::vector<std::unique_ptr<Shard>> shards_;
   size_t alignment_;
   size_t chunk_size_;
   bool allow_free_idle_chunk_;
-
-  SpinLock spinlock_;
 };
 
 }  // namespace allocation
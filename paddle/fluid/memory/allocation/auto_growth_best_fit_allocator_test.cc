@@ -12,7 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>  // NOLINT
 
 #include "paddle/fluid/memory/allocation/aligned_allocator.h"
 #include "paddle/fluid/memory/allocation/auto_growth_best_fit_allocator.h"
@@ -21,6 +26,7 @@
 
 DECLARE_bool(free_idle_chunk);
 DECLARE_bool(free_when_no_cache_hit);
+DECLARE_uint64(auto_growth_lock_shards);
 
 namespace paddle {
 namespace memory {
@@ -43,7 +49,7 @@ class RecordedAllocator : public Allocator {
   size_t AllocatedSize() const { return allocated_size_; }
 
  private:
-  size_t allocated_size_{0};
+  std::atomic<size_t> allocated_size_{0};
 };
 
 static void TestFreeIdleChunk(bool free_idle_chunk,
@@ -171,6 +177,129 @@ TEST(test_auto_growth_allocator, test_free_when_no_cache_hit) {
   TestFreeWhenNoCacheHit(true);
 }
 
+// Random allocations of many sizes from a few threads, each filled with a
+// byte of its own and checked when freed, so that overlapping blocks fail.
+static void RunRandomTrace(Allocator *allocator, size_t num_threads,
+                           size_t num_iterations, bool check) {
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([=] {
+      std::mt19937 rng(t);
+      std::vector<std::pair<AllocationPtr, uint8_t>> alive(64);
+      for (size_t i = 0; i < num_iterations; ++i) {
+        auto &slot = alive[rng() % alive.size()];
+        if (check && slot.first) {
+          auto *p = reinterpret_cast<uint8_t *>(slot.first->ptr());
+          for (size_t j = 0; j < slot.first->size(); j += 61) {
+            ASSERT_EQ(p[j], slot.second);
+          }
+        }
+        // mostly small tensors, sometimes large ones
+        size_t size = rng() % 8 == 0 ? rng() % (1 << 20) + 1
+                                     : rng() % (16 << 10) + 1;
+        slot.first = allocator->Allocate(size);
+        slot.second = static_cast<uint8_t>(i);
+        if (check) {
+          std::memset(slot.first->ptr(), slot.second, slot.first->size());
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+}
+
+TEST(test_auto_growth_allocator, test_random_trace) {
+  FLAGS_free_idle_chunk = false;
+  FLAGS_free_when_no_cache_hit = false;
+  for (size_t shards : {1, 4}) {
+    FLAGS_auto_growth_lock_shards = shards;
+    auto recorded_allocator = std::make_shared<RecordedAllocator>();
+    auto ag_allocator = std::make_shared<AutoGrowthBestFitAllocator>(
+        recorded_allocator, 64, 1 << 20);
+    RunRandomTrace(ag_allocator.get(), 4, 10000, true);
+
+    // All the blocks are free and merged into one per chunk.
+    auto stats = ag_allocator->GetStats();
+    ASSERT_EQ(stats.allocated_bytes, 0UL);
+    ASSERT_EQ(stats.free_bytes, stats.reserved_bytes);
+    ASSERT_EQ(stats.reserved_bytes, recorded_allocator->AllocatedSize());
+    ASSERT_EQ(stats.free_blocks, stats.chunks);
+
+    {
+      auto allocation = ag_allocator->Allocate(1000);
+      stats = ag_allocator->GetStats();
+      ASSERT_EQ(stats.allocated_bytes, 1024UL);
+      ASSERT_EQ(stats.free_bytes + 1024, stats.reserved_bytes);
+    }
+
+    ASSERT_EQ(ag_allocator->Release(platform::CPUPlace()),
+              stats.reserved_bytes);
+    ASSERT_EQ(recorded_allocator->AllocatedSize(), 0UL);
+    stats = ag_allocator->GetStats();
+    ASSERT_EQ(stats.chunks, 0UL);
+    ASSERT_EQ(stats.Fragmentation(), 0.0);
+  }
+  FLAGS_auto_growth_lock_shards = 1;
+}
+
+TEST(test_auto_growth_allocator, test_best_fit) {
+  FLAGS_free_idle_chunk = false;
+  FLAGS_free_when_no_cache_hit = false;
+  auto recorded_allocator = std::make_shared<RecordedAllocator>();
+  auto ag_allocator = std::make_shared<AutoGrowthBestFitAllocator>(
+      recorded_allocator, 256, 1 << 20);
+
+  // Free blocks of 8960 and 8704 bytes, in the same bin, with allocated
+  // blocks between them. The smaller one is the first of the bin.
+  std::vector<AllocationPtr> allocations;
+  for (size_t size : {8960, 256, 8704, 256}) {
+    allocations.emplace_back(ag_allocator->Allocate(size));
+  }
+  void *ptr = allocations[0]->ptr();
+  allocations[0].reset();
+  allocations[2].reset();
+  size_t remaining_size = (1 << 20) - 8960 - 8704 - 512;
+  auto stats = ag_allocator->GetStats();
+  ASSERT_EQ(stats.free_blocks, 3UL);
+  ASSERT_EQ(stats.largest_free_block, remaining_size);
+  ASSERT_GT(stats.Fragmentation(), 0.0);
+
+  // The remaining of the chunk is in a larger bin, but a block of the bin
+  // of the size fits.
+  ASSERT_EQ(ag_allocator->Allocate(8960)->ptr(), ptr);
+
+  // No block of the bin fits, so the remaining of the chunk is split.
+  auto allocation = ag_allocator->Allocate(9216);
+  stats = ag_allocator->GetStats();
+  ASSERT_EQ(stats.chunks, 1UL);
+  ASSERT_EQ(stats.largest_free_block, remaining_size - 9216);
+}
+
+// Allocations per second with one lock and with a lock per size range.
+TEST(BENCHMARK, AutoGrowthBestFitAllocator) {
+  FLAGS_free_idle_chunk = false;
+  FLAGS_free_when_no_cache_hit = false;
+  for (size_t num_threads : {1, 2, 4, 8}) {
+    for (size_t shards : {1, 4}) {
+      FLAGS_auto_growth_lock_shards = shards;
+      auto ag_allocator = std::make_shared<AutoGrowthBestFitAllocator>(
+          std::make_shared<RecordedAllocator>(), 256, 64 << 20);
+      const size_t num_iterations = 100000;
+      auto start = std::chrono::steady_clock::now();
+      RunRandomTrace(ag_allocator.get(), num_threads, num_iterations, false);
+      double seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+      auto stats = ag_allocator->GetStats();
+      LOG(INFO) << num_threads << " threads, " << shards << " shards: "
+                << num_threads * num_iterations / seconds
+                << " allocs/s, reserved " << (stats.reserved_bytes >> 20)
+                << " MB";
+    }
+  }
+  FLAGS_auto_growth_lock_shards = 1;
+}
+
 }  // namespace allocation
 }  // namespace memory
 }  // namespace paddle
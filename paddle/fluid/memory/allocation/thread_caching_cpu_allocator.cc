@@ -0,0 +1,519 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/thread_caching_cpu_allocator.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <mutex>   // NOLINT
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) && defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "paddle/fluid/memory/allocation/spin_lock.h"
+#include "paddle/fluid/platform/enforce.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+constexpr size_t ThreadCachingCPUAllocator::kAlignment;
+constexpr size_t ThreadCachingCPUAllocator::kMinClassSize;
+constexpr size_t ThreadCachingCPUAllocator::kMaxClassSize;
+constexpr size_t ThreadCachingCPUAllocator::kNumClasses;
+
+namespace {
+
+// The bytes a thread caches at most, over all the size classes.
+constexpr size_t kMaxThreadCacheBytes = 32UL << 20;
+// The bytes of one size class a thread caches at most, and the most blocks.
+constexpr size_t kMaxThreadClassBytes = 8UL << 20;
+constexpr size_t kMaxThreadClassBlocks = 512;
+// The bytes and the most blocks moved at once between a thread cache and
+// the central pool.
+constexpr size_t kBatchBytes = 1UL << 20;
+constexpr size_t kMaxBatchBlocks = 64;
+// Central blocks unused for this long are given back to the system.
+constexpr int64_t kTrimIntervalNs = 1000 * 1000 * 1000;
+
+void* AlignedAlloc(size_t size) {
+  void* p = nullptr;
+#ifdef _WIN32
+  p = _aligned_malloc(size, ThreadCachingCPUAllocator::kAlignment);
+#else
+  if (posix_memalign(&p, ThreadCachingCPUAllocator::kAlignment, size) != 0) {
+    p = nullptr;
+  }
+#endif
+  return p;
+}
+
+void AlignedFree(void* p) {
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+inline size_t FloorLog2(size_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return sizeof(unsigned long long) * 8 - 1 -  // NOLINT
+         __builtin_clzll(static_cast<unsigned long long>(x));  // NOLINT
+#else
+  size_t res = 0;
+  while (x >>= 1) ++res;
+  return res;
+#endif
+}
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// A list of free blocks, linked through their first bytes.
+struct FreeList {
+  void* head{nullptr};
+  void* tail{nullptr};
+  size_t count{0};
+
+  static void*& Next(void* block) { return *reinterpret_cast<void**>(block); }
+
+  void Push(void* block) {
+    Next(block) = head;
+    head = block;
+    if (tail == nullptr) tail = block;
+    ++count;
+  }
+
+  void* Pop() {
+    void* block = head;
+    head = Next(block);
+    if (head == nullptr) tail = nullptr;
+    --count;
+    return block;
+  }
+
+  // Moves the first n blocks of this list to the front of other.
+  void MoveTo(FreeList* other, size_t n) {
+    if (n == 0) return;
+    if (n >= count) {
+      n = count;
+      Next(tail) = other->head;
+      if (other->tail == nullptr) other->tail = tail;
+      other->head = head;
+      other->count += n;
+      head = tail = nullptr;
+      count = 0;
+      return;
+    }
+    void* last = head;
+    for (size_t i = 1; i < n; ++i) last = Next(last);
+    void* rest = Next(last);
+    Next(last) = other->head;
+    if (other->tail == nullptr) other->tail = last;
+    other->head = head;
+    other->count += n;
+    head = rest;
+    count -= n;
+  }
+};
+
+inline size_t BatchBlocks(size_t size) {
+  return std::max<size_t>(1, std::min(kMaxBatchBlocks, kBatchBytes / size));
+}
+
+inline size_t MaxThreadBlocks(size_t size) {
+  return std::max<size_t>(
+      2, std::min(kMaxThreadClassBlocks, kMaxThreadClassBytes / size));
+}
+
+}  // namespace
+
+class ThreadCachingCPUAllocator::Pool
+    : public std::enable_shared_from_this<Pool> {
+ public:
+  ~Pool() { FreeCentral(); }
+
+  void* Allocate(size_t size_class);
+  void Free(void* block, size_t size_class);
+  uint64_t Release();
+
+  size_t CentralCachedBytes() const {
+    return central_bytes_.load(std::memory_order_relaxed);
+  }
+  size_t ReservedBytes() const {
+    return reserved_bytes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct ThreadCache {
+    // Taken by the thread for every allocation and free, and by the thread
+    // trimming the cache when it is idle.
+    SpinLock lock;
+    std::array<FreeList, kNumClasses> lists;
+    // The fewest blocks every list had since the last trim, which the thread
+    // did not need in that time.
+    std::array<size_t, kNumClasses> low_water{};
+    size_t bytes{0};
+    uint64_t trim_epoch{0};
+  };
+
+  struct CentralList {
+    SpinLock lock;
+    FreeList list;
+    size_t low_water{0};
+  };
+
+  // The caches of a thread, one per pool, given back when the thread exits.
+  struct ThreadCaches {
+    ~ThreadCaches();
+    std::vector<std::pair<std::shared_ptr<Pool>, std::unique_ptr<ThreadCache>>>
+        caches;
+  };
+
+  // nullptr once the caches of the thread are destroyed.
+  ThreadCache* LocalCache();
+  // Moves n blocks of the class from the cache to the central pool.
+  void Spill(ThreadCache* cache, size_t size_class, size_t n);
+  // Moves blocks of the class from the central pool to the cache.
+  void Fill(ThreadCache* cache, size_t size_class);
+  // Gives the blocks the thread did not need since the last trim to the
+  // central pool.
+  void Scavenge(ThreadCache* cache);
+  // Gives the whole caches of the threads idle since the last trim to the
+  // central pool.
+  void ScavengeIdle();
+  void MaybeTrim();
+  uint64_t FreeCentral(bool only_idle = false);
+
+  std::array<CentralList, kNumClasses> central_;
+  std::atomic<size_t> central_bytes_{0};
+  std::atomic<size_t> reserved_bytes_{0};
+  // The caches of the live threads.
+  std::mutex caches_mutex_;
+  std::vector<ThreadCache*> caches_;
+  std::atomic<uint64_t> trim_epoch_{0};
+  std::atomic<int64_t> next_trim_ns_{NowNs() + kTrimIntervalNs};
+  std::mutex trim_mutex_;
+};
+
+namespace {
+thread_local bool thread_caches_destroyed = false;
+}  // namespace
+
+ThreadCachingCPUAllocator::Pool::ThreadCaches::~ThreadCaches() {
+  thread_caches_destroyed = true;
+  for (auto& item : caches) {
+    auto* cache = item.second.get();
+    {
+      auto& pool = *item.first;
+      std::lock_guard<std::mutex> guard(pool.caches_mutex_);
+      pool.caches_.erase(
+          std::find(pool.caches_.begin(), pool.caches_.end(), cache));
+    }
+    for (size_t c = 0; c < kNumClasses; ++c) {
+      item.first->Spill(cache, c, cache->lists[c].count);
+    }
+  }
+}
+
+ThreadCachingCPUAllocator::Pool::ThreadCache*
+ThreadCachingCPUAllocator::Pool::LocalCache() {
+  if (thread_caches_destroyed) return nullptr;
+  static thread_local ThreadCaches thread_caches;
+  static thread_local Pool* last_pool = nullptr;
+  static thread_local ThreadCache* last_cache = nullptr;
+  // A pool lives as long as any thread caches blocks of it, so that the
+  // address of a pool is never reused while it is in the caches.
+  if (last_pool == this) return last_cache;
+  auto& caches = thread_caches.caches;
+  auto it = std::find_if(caches.begin(), caches.end(),
+                         [this](const std::pair<std::shared_ptr<Pool>,
+                                                std::unique_ptr<ThreadCache>>&
+                                    item) { return item.first.get() == this; });
+  if (it == caches.end()) {
+    caches.emplace_back(shared_from_this(), new ThreadCache());
+    caches.back().second->trim_epoch =
+        trim_epoch_.load(std::memory_order_relaxed);
+    it = caches.end() - 1;
+    std::lock_guard<std::mutex> guard(caches_mutex_);
+    caches_.push_back(it->second.get());
+  }
+  last_pool = this;
+  last_cache = it->second.get();
+  return last_cache;
+}
+
+void* ThreadCachingCPUAllocator::Pool::Allocate(size_t size_class) {
+  auto* cache = LocalCache();
+  if (LIKELY(cache != nullptr)) {
+    std::lock_guard<SpinLock> cache_guard(cache->lock);
+    if (UNLIKELY(cache->trim_epoch !=
+                 trim_epoch_.load(std::memory_order_relaxed))) {
+      Scavenge(cache);
+    }
+    auto& list = cache->lists[size_class];
+    if (list.count == 0) Fill(cache, size_class);
+    if (list.count > 0) {
+      cache->bytes -= ClassSize(size_class);
+      void* block = list.Pop();
+      cache->low_water[size_class] =
+          std::min(cache->low_water[size_class], list.count);
+      return block;
+    }
+  } else {
+    auto& central = central_[size_class];
+    std::lock_guard<SpinLock> guard(central.lock);
+    if (central.list.count > 0) {
+      central_bytes_.fetch_sub(ClassSize(size_class),
+                               std::memory_order_relaxed);
+      void* block = central.list.Pop();
+      central.low_water = std::min(central.low_water, central.list.count);
+      return block;
+    }
+  }
+
+  MaybeTrim();
+  size_t size = ClassSize(size_class);
+  void* block = AlignedAlloc(size);
+  if (block == nullptr) {
+    Release();
+    block = AlignedAlloc(size);
+  }
+  PADDLE_ENFORCE_NOT_NULL(
+      block, platform::errors::ResourceExhausted(
+                 "Fail to alloc CPU memory of %ld size.", size));
+  reserved_bytes_.fetch_add(size, std::memory_order_relaxed);
+  return block;
+}
+
+void ThreadCachingCPUAllocator::Pool::Free(void* block, size_t size_class) {
+  size_t size = ClassSize(size_class);
+  auto* cache = LocalCache();
+  if (UNLIKELY(cache == nullptr)) {
+    auto& central = central_[size_class];
+    std::lock_guard<SpinLock> guard(central.lock);
+    central.list.Push(block);
+    central_bytes_.fetch_add(size, std::memory_order_relaxed);
+    return;
+  }
+  std::lock_guard<SpinLock> cache_guard(cache->lock);
+  if (UNLIKELY(cache->trim_epoch !=
+               trim_epoch_.load(std::memory_order_relaxed))) {
+    Scavenge(cache);
+  }
+  auto& list = cache->lists[size_class];
+  list.Push(block);
+  cache->bytes += size;
+  if (list.count > MaxThreadBlocks(size)) {
+    Spill(cache, size_class, list.count / 2);
+  }
+  if (cache->bytes > kMaxThreadCacheBytes) {
+    for (size_t c = 0; c < kNumClasses; ++c) {
+      Spill(cache, c, (cache->lists[c].count + 1) / 2);
+    }
+  }
+}
+
+void ThreadCachingCPUAllocator::Pool::Spill(ThreadCache* cache,
+                                            size_t size_class, size_t n) {
+  auto& list = cache->lists[size_class];
+  n = std::min(n, list.count);
+  if (n == 0) return;
+  size_t bytes = n * ClassSize(size_class);
+  {
+    auto& central = central_[size_class];
+    std::lock_guard<SpinLock> guard(central.lock);
+    list.MoveTo(&central.list, n);
+  }
+  cache->bytes -= bytes;
+  cache->low_water[size_class] =
+      std::min(cache->low_water[size_class], list.count);
+  central_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  MaybeTrim();
+}
+
+void ThreadCachingCPUAllocator::Pool::Fill(ThreadCache* cache,
+                                           size_t size_class) {
+  size_t size = ClassSize(size_class);
+  auto& list = cache->lists[size_class];
+  size_t n = 0;
+  {
+    auto& central = central_[size_class];
+    std::lock_guard<SpinLock> guard(central.lock);
+    n = std::min(BatchBlocks(size), central.list.count);
+    central.list.MoveTo(&list, n);
+    central.low_water = std::min(central.low_water, central.list.count);
+  }
+  cache->bytes += n * size;
+  central_bytes_.fetch_sub(n * size, std::memory_order_relaxed);
+}
+
+void ThreadCachingCPUAllocator::Pool::Scavenge(ThreadCache* cache) {
+  for (size_t c = 0; c < kNumClasses; ++c) {
+    Spill(cache, c, cache->low_water[c]);
+    cache->low_water[c] = cache->lists[c].count;
+  }
+  cache->trim_epoch = trim_epoch_.load(std::memory_order_relaxed);
+}
+
+void ThreadCachingCPUAllocator::Pool::ScavengeIdle() {
+  uint64_t epoch = trim_epoch_.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> guard(caches_mutex_);
+  for (auto* cache : caches_) {
+    // A cache in use, such as the one of the calling thread, is not idle.
+    if (!cache->lock.try_lock()) continue;
+    if (cache->trim_epoch != epoch) {
+      for (size_t c = 0; c < kNumClasses; ++c) {
+        auto& list = cache->lists[c];
+        size_t n = list.count;
+        if (n == 0) continue;
+        {
+          auto& central = central_[c];
+          std::lock_guard<SpinLock> central_guard(central.lock);
+          list.MoveTo(&central.list, n);
+        }
+        central_bytes_.fetch_add(n * ClassSize(c), std::memory_order_relaxed);
+        cache->low_water[c] = 0;
+      }
+      cache->bytes = 0;
+    }
+    cache->lock.unlock();
+  }
+}
+
+void ThreadCachingCPUAllocator::Pool::MaybeTrim() {
+  int64_t now = NowNs();
+  if (now < next_trim_ns_.load(std::memory_order_relaxed)) return;
+  std::unique_lock<std::mutex> lock(trim_mutex_, std::try_to_lock);
+  if (!lock.owns_lock() ||
+      now < next_trim_ns_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  next_trim_ns_.store(now + kTrimIntervalNs, std::memory_order_relaxed);
+  uint64_t bytes = FreeCentral(/*only_idle=*/true);
+  ScavengeIdle();
+  // Every thread gives what it did not need to the central pool, which is
+  // given back by the next trim if nobody takes it.
+  trim_epoch_.fetch_add(1, std::memory_order_relaxed);
+  VLOG(10) << "Trim " << bytes << " bytes of idle CPU memory";
+}
+
+uint64_t ThreadCachingCPUAllocator::Pool::FreeCentral(bool only_idle) {
+  uint64_t bytes = 0;
+  for (size_t c = 0; c < kNumClasses; ++c) {
+    FreeList blocks;
+    {
+      auto& central = central_[c];
+      std::lock_guard<SpinLock> guard(central.lock);
+      size_t n = only_idle ? central.low_water : central.list.count;
+      central.list.MoveTo(&blocks, n);
+      central.low_water = central.list.count;
+    }
+    size_t size = ClassSize(c);
+    bytes += blocks.count * size;
+    central_bytes_.fetch_sub(blocks.count * size, std::memory_order_relaxed);
+    reserved_bytes_.fetch_sub(blocks.count * size, std::memory_order_relaxed);
+    while (blocks.count > 0) AlignedFree(blocks.Pop());
+  }
+  return bytes;
+}
+
+uint64_t ThreadCachingCPUAllocator::Pool::Release() {
+  auto* cache = LocalCache();
+  if (cache != nullptr) {
+    std::lock_guard<SpinLock> cache_guard(cache->lock);
+    for (size_t c = 0; c < kNumClasses; ++c) {
+      Spill(cache, c, cache->lists[c].count);
+    }
+  }
+  uint64_t bytes = FreeCentral();
+#if defined(__linux__) && defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+  return bytes;
+}
+
+ThreadCachingCPUAllocator::ThreadCachingCPUAllocator()
+    : pool_(std::make_shared<Pool>()) {}
+
+ThreadCachingCPUAllocator::~ThreadCachingCPUAllocator() = default;
+
+size_t ThreadCachingCPUAllocator::SizeClassOf(size_t size) {
+  if (size <= kMinClassSize) return 0;
+  // size is in (2^lg, 2^(lg+1)], which has four classes
+  size_t lg = FloorLog2(size - 1);
+  size_t step = static_cast<size_t>(1) << (lg - 2);
+  size_t index = (size - (static_cast<size_t>(1) << lg) + step - 1) / step;
+  return (lg - 8) * 4 + index;
+}
+
+size_t ThreadCachingCPUAllocator::ClassSize(size_t size_class) {
+  if (size_class == 0) return kMinClassSize;
+  size_t lg = 8 + (size_class - 1) / 4;
+  size_t index = (size_class - 1) % 4 + 1;
+  return (static_cast<size_t>(1) << lg) +
+         index * (static_cast<size_t>(1) << (lg - 2));
+}
+
+size_t ThreadCachingCPUAllocator::CentralCachedBytes() const {
+  return pool_->CentralCachedBytes();
+}
+
+size_t ThreadCachingCPUAllocator::ReservedBytes() const {
+  return pool_->ReservedBytes();
+}
+
+pten::Allocation* ThreadCachingCPUAllocator::AllocateImpl(size_t size) {
+  if (size > kMaxClassSize) {
+    void* p = AlignedAlloc(size);
+    PADDLE_ENFORCE_NOT_NULL(
+        p, platform::errors::ResourceExhausted(
+               "Fail to alloc CPU memory of %ld size.", size));
+    return new Allocation(p, size, platform::CPUPlace());
+  }
+  size_t size_class = SizeClassOf(size);
+  return new Allocation(pool_->Allocate(size_class), ClassSize(size_class),
+                        platform::CPUPlace());
+}
+
+void ThreadCachingCPUAllocator::FreeImpl(pten::Allocation* allocation) {
+  // The size of an allocation is the size of its class.
+  size_t size = allocation->size();
+  if (size > kMaxClassSize) {
+    AlignedFree(allocation->ptr());
+  } else {
+    pool_->Free(allocation->ptr(), SizeClassOf(size));
+  }
+  delete allocation;
+}
+
+uint64_t ThreadCachingCPUAllocator::ReleaseImpl(
+    const platform::Place& place) {
+  return pool_->Release();
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
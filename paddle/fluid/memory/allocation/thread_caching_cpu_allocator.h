@@ -0,0 +1,82 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+
+#include "paddle/fluid/memory/allocation/allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+/**
+ * ThreadCachingCPUAllocator serves CPU allocations from free lists of size
+ * classes, cached per thread, so that most allocations and frees take no
+ * lock but the uncontended one of their thread cache.
+ *
+ * - Sizes are rounded up to size classes, four per power of two from
+ *   kMinClassSize to kMaxClassSize. Larger allocations go to the system
+ *   allocator directly.
+ * - A block is freed to the cache of the freeing thread, whichever thread
+ *   allocated it. A thread whose cache is too large moves a batch of blocks
+ *   of the class to the central pool, and a thread whose cache is empty
+ *   takes a batch from it. The central pool has a lock per size class.
+ * - Every trim interval, each thread moves the blocks it did not need in
+ *   the last interval to the central pool, and the blocks which stayed
+ *   unused in the central pool for a whole interval are given back to the
+ *   system. The whole cache of a thread which neither allocated nor freed
+ *   in the last interval is moved by the thread trimming, so an idle thread
+ *   does not keep memory. Trims happen while any thread allocates or frees.
+ *   The cache of an exiting thread goes to the central pool.
+ * - Release() gives back the blocks of the central pool and of the cache of
+ *   the calling thread.
+ */
+class ThreadCachingCPUAllocator : public Allocator {
+ public:
+  static constexpr size_t kAlignment = 64;
+  static constexpr size_t kMinClassSize = 256;
+  static constexpr size_t kMaxClassSize = 32UL << 20;
+  static constexpr size_t kNumClasses = 69;
+
+  ThreadCachingCPUAllocator();
+  ~ThreadCachingCPUAllocator();
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+  // The size class of size, which must not be larger than kMaxClassSize.
+  static size_t SizeClassOf(size_t size);
+  static size_t ClassSize(size_t size_class);
+
+  // The bytes of the free blocks held by the central pool.
+  size_t CentralCachedBytes() const;
+  // The bytes of the size class blocks taken from the system and not given
+  // back, allocated or cached.
+  size_t ReservedBytes() const;
+
+  class Pool;
+
+ protected:
+  pten::Allocation* AllocateImpl(size_t size) override;
+  void FreeImpl(pten::Allocation* allocation) override;
+  uint64_t ReleaseImpl(const platform::Place& place) override;
+
+ private:
+  std::shared_ptr<Pool> pool_;
+};
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
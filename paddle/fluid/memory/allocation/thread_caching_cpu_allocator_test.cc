@@ -0,0 +1,195 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/thread_caching_cpu_allocator.h"
+
+#include <chrono>  // NOLINT
+#include <condition_variable>
+#include <cstring>
+#include <mutex>  // NOLINT
+#include <random>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/memory/allocation/naive_best_fit_allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+using TCAllocator = ThreadCachingCPUAllocator;
+
+TEST(ThreadCachingCPUAllocator, size_classes) {
+  EXPECT_EQ(TCAllocator::ClassSize(0), TCAllocator::kMinClassSize);
+  EXPECT_EQ(TCAllocator::ClassSize(TCAllocator::kNumClasses - 1),
+            TCAllocator::kMaxClassSize);
+  for (size_t c = 0; c < TCAllocator::kNumClasses; ++c) {
+    EXPECT_EQ(TCAllocator::SizeClassOf(TCAllocator::ClassSize(c)), c);
+    if (c > 0) {
+      EXPECT_GT(TCAllocator::ClassSize(c), TCAllocator::ClassSize(c - 1));
+    }
+  }
+  for (size_t size = 1; size <= TCAllocator::kMaxClassSize;
+       size += size / 7 + 1) {
+    size_t class_size = TCAllocator::ClassSize(TCAllocator::SizeClassOf(size));
+    EXPECT_GE(class_size, size);
+    // at most a quarter, or the smallest class, is wasted
+    EXPECT_LE(class_size,
+              std::max(size + size / 4, TCAllocator::kMinClassSize));
+  }
+}
+
+TEST(ThreadCachingCPUAllocator, allocate_and_free) {
+  TCAllocator allocator;
+  std::vector<AllocationPtr> allocations;
+  for (size_t size :
+       {1UL, 100UL, 256UL, 257UL, 4096UL, 100000UL, 1UL << 20,
+        TCAllocator::kMaxClassSize, TCAllocator::kMaxClassSize + 1}) {
+    auto allocation = allocator.Allocate(size);
+    ASSERT_NE(allocation->ptr(), nullptr);
+    ASSERT_GE(allocation->size(), size);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(allocation->ptr()) %
+                  TCAllocator::kAlignment,
+              0UL);
+    std::memset(allocation->ptr(), 0xff, size);
+    allocations.emplace_back(std::move(allocation));
+  }
+  allocations.clear();
+
+  // A freed block is reused by the next allocation of its class.
+  void* ptr = allocator.Allocate(1000)->ptr();
+  EXPECT_EQ(allocator.Allocate(1000)->ptr(), ptr);
+}
+
+TEST(ThreadCachingCPUAllocator, free_in_other_threads) {
+  TCAllocator allocator;
+  const size_t num_threads = 4;
+  const size_t num_allocations = 10000;
+  std::vector<std::vector<AllocationPtr>> allocations(num_threads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      for (size_t i = 0; i < num_allocations; ++i) {
+        allocations[t].emplace_back(allocator.Allocate(rng() % 65536 + 1));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  threads.clear();
+  // every thread frees what the next one allocated, then exits
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back(
+        [&, t] { allocations[(t + 1) % num_threads].clear(); });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // The caches of the exited threads are in the central pool.
+  EXPECT_GT(allocator.CentralCachedBytes(), 0UL);
+  EXPECT_GT(allocator.Release(platform::CPUPlace()), 0UL);
+  EXPECT_EQ(allocator.CentralCachedBytes(), 0UL);
+}
+
+TEST(ThreadCachingCPUAllocator, trim_idle_thread) {
+  TCAllocator allocator;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool cached = false, done = false;
+  // the thread caches 4MB, then neither allocates nor frees
+  std::thread idle([&] {
+    {
+      std::vector<AllocationPtr> allocations;
+      for (int i = 0; i < 64; ++i) {
+        allocations.emplace_back(allocator.Allocate(64UL << 10));
+      }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    cached = true;
+    cv.notify_all();
+    cv.wait(lock, [&] { return done; });
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return cached; });
+  }
+  EXPECT_GE(allocator.ReservedBytes(), 4UL << 20);
+  EXPECT_EQ(allocator.CentralCachedBytes(), 0UL);
+
+  // This thread keeps allocating less than 1MB, so the idle cache is
+  // trimmed within a few trim intervals.
+  auto start = std::chrono::steady_clock::now();
+  while (allocator.ReservedBytes() >= 1UL << 20 &&
+         std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+    std::vector<AllocationPtr> allocations;
+    for (int i = 0; i < 600; ++i) {
+      allocations.emplace_back(allocator.Allocate(256));
+    }
+    allocations.clear();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_LT(allocator.ReservedBytes(), 1UL << 20);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  cv.notify_all();
+  idle.join();
+}
+
+// Allocations per second of the thread caching allocator and of the buddy
+// allocator, which CPU allocations go to with the other strategies, and the
+// bytes the thread caching allocator still holds once the threads exit.
+TEST(BENCHMARK, ThreadCachingCPUAllocator) {
+  auto Run = [](Allocator* allocator, size_t num_threads) {
+    const size_t num_iterations = 20000;
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < num_threads; ++t) {
+      threads.emplace_back([=] {
+        // tensors of a few sizes, some alive for a while
+        std::mt19937 rng(t);
+        std::vector<AllocationPtr> alive(16);
+        for (size_t i = 0; i < num_iterations; ++i) {
+          size_t size = 256UL << (rng() % 12);
+          alive[rng() % alive.size()] = allocator->Allocate(size);
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    return num_threads * num_iterations / seconds;
+  };
+
+  for (size_t num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+    TCAllocator thread_caching;
+    double thread_caching_rate = Run(&thread_caching, num_threads);
+    size_t thread_caching_reserved = thread_caching.ReservedBytes();
+    thread_caching.Release(platform::CPUPlace());
+
+    platform::CPUPlace place;
+    NaiveBestFitAllocator buddy(place);
+    double buddy_rate = Run(&buddy, num_threads);
+    LOG(INFO) << num_threads << " threads: thread_caching "
+              << thread_caching_rate << " allocs/s, "
+              << thread_caching_reserved / (1 << 20) << " MB reserved; buddy "
+              << buddy_rate << " allocs/s";
+  }
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
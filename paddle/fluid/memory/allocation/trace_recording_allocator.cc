@@ -0,0 +1,39 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/trace_recording_allocator.h"
+
+#include "paddle/fluid/memory/allocation/allocation_trace.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+pten::Allocation *TraceRecordingAllocator::AllocateImpl(size_t size) {
+  auto *allocation = underlying_allocator_->Allocate(size).release();
+  AllocationTraceRecorder::Instance().Record(place_, stream_,
+                                             allocation->ptr(), size, false);
+  return allocation;
+}
+
+void TraceRecordingAllocator::FreeImpl(pten::Allocation *allocation) {
+  // recorded before the memory can be allocated again
+  AllocationTraceRecorder::Instance().Record(
+      place_, stream_, allocation->ptr(), allocation->size(), true);
+  underlying_allocator_->Free(allocation);
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
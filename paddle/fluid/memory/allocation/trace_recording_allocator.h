@@ -0,0 +1,62 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "paddle/fluid/memory/allocation/allocator.h"
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/place.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+// TraceRecordingAllocator passes the allocations and frees of the
+// underlying allocator to AllocationTraceRecorder.
+class TraceRecordingAllocator : public Allocator {
+ public:
+  TraceRecordingAllocator(std::shared_ptr<Allocator> allocator,
+                          const platform::Place &place, uint64_t stream = 0)
+      : underlying_allocator_(std::move(allocator)),
+        place_(place),
+        stream_(stream) {
+    PADDLE_ENFORCE_NOT_NULL(
+        underlying_allocator_,
+        platform::errors::InvalidArgument(
+            "Underlying allocator of TraceRecordingAllocator is NULL"));
+  }
+
+  bool IsAllocThreadSafe() const override {
+    return underlying_allocator_->IsAllocThreadSafe();
+  }
+
+ protected:
+  pten::Allocation *AllocateImpl(size_t size) override;
+  void FreeImpl(pten::Allocation *allocation) override;
+  uint64_t ReleaseImpl(const platform::Place &place) override {
+    return underlying_allocator_->Release(place);
+  }
+
+ private:
+  std::shared_ptr<Allocator> underlying_allocator_;
+  platform::Place place_;
+  uint64_t stream_;
+};
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
@@ -12,10 +12,16 @@ limitations under the License. */
 #include <utf8proc.h>
 
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <codecvt>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>  // NOLINT
 #include <numeric>
 #include <string>
 #include <unordered_map>
@@ -94,91 +100,264 @@ wchar_t BasicTokenizer::do_lower_case(wchar_t ch) const {
 }
 
 void BasicTokenizer::Tokenize(const string& text, vector<wstring>* res) const {
-  std::wstring unicode_text;
-  bool status = framework::ConvertStrToWstr(text, &unicode_text);
-  if (!status) {
+  wstring chars;
+  vector<size_t> token_ends;
+  if (!Tokenize(text, &chars, &token_ends)) {
     // String is converted into wstring failedly.
     return;
   }
-  std::wstring cache_text = L"";
-  auto PushCacheText = [&]() {
-    if (cache_text != L"") {
-      res->emplace_back(cache_text);
-      cache_text = L"";
+  size_t begin = 0;
+  for (auto end : token_ends) {
+    res->emplace_back(chars.substr(begin, end - begin));
+    begin = end;
+  }
+}
+
+namespace {
+
+// How a character splits the text.
+enum class CharKind : uint8_t { kSkip, kWord, kSingle, kSpace };
+
+inline CharKind KindOf(wchar_t ch) {
+  if (IsChineseChar(ch) || IsPunctuation(ch)) return CharKind::kSingle;
+  if (IsWhiteSpace(ch)) return CharKind::kSpace;
+  return CharKind::kWord;
+}
+
+// The kinds of the ASCII characters, which are most of the text and which
+// lowercase to ASCII characters of the same kind.
+const std::array<CharKind, 128>& AsciiKinds() {
+  static const std::array<CharKind, 128> kinds = [] {
+    std::array<CharKind, 128> res;
+    for (wchar_t ch = 0; ch < 128; ++ch) {
+      res[ch] = (ch == 0 || IsControl(ch)) ? CharKind::kSkip : KindOf(ch);
     }
+    return res;
+  }();
+  return kinds;
+}
+
+enum class DecodeStatus : uint8_t { kChar, kInvalid, kTruncated };
+
+// Decodes the UTF-8 character starting at text[*pos] and moves *pos past it.
+// It follows std::codecvt_utf8, which the text used to be converted with:
+// overlong forms and characters wchar_t cannot hold are invalid, surrogates
+// are not, and a character cut off by the end of the text ends it.
+inline DecodeStatus DecodeUTF8(const unsigned char* text, size_t len,
+                               size_t* pos, wchar_t* ch) {
+  size_t i = *pos;
+  unsigned char c0 = text[i];
+  uint32_t cp;
+  size_t n;
+  if (c0 < 0x80) {
+    *ch = c0;
+    *pos = i + 1;
+    return DecodeStatus::kChar;
+  } else if (c0 < 0xC2) {
+    return DecodeStatus::kInvalid;
+  } else if (c0 < 0xE0) {
+    cp = c0 & 0x1F;
+    n = 1;
+  } else if (c0 < 0xF0) {
+    cp = c0 & 0x0F;
+    n = 2;
+  } else if (c0 < 0xF5) {
+    cp = c0 & 0x07;
+    n = 3;
+  } else {
+    return DecodeStatus::kInvalid;
+  }
+  if (len - i <= n) return DecodeStatus::kTruncated;
+  for (size_t k = 1; k <= n; ++k) {
+    unsigned char c = text[i + k];
+    if ((c & 0xC0) != 0x80) return DecodeStatus::kInvalid;
+    cp = (cp << 6) | (c & 0x3F);
+  }
+  // overlong forms of 3 and 4 bytes, and characters beyond U+10FFFF
+  if ((n == 2 && cp < 0x800) || (n == 3 && (cp < 0x10000 || cp > 0x10FFFF))) {
+    return DecodeStatus::kInvalid;
+  }
+  if (cp > static_cast<uint32_t>(std::numeric_limits<wchar_t>::max())) {
+    return DecodeStatus::kInvalid;
+  }
+  *ch = static_cast<wchar_t>(cp);
+  *pos = i + n + 1;
+  return DecodeStatus::kChar;
+}
+
+}  // namespace
+
+bool BasicTokenizer::Tokenize(const string& text, wstring* chars,
+                              vector<size_t>* token_ends) const {
+  const auto& ascii_kinds = AsciiKinds();
+  const auto* data = reinterpret_cast<const unsigned char*>(text.data());
+  const size_t len = text.size();
+  const size_t chars_begin = chars->size();
+  const size_t tokens_begin = token_ends->size();
+  auto EndToken = [&]() {
+    size_t begin = token_ends->size() > tokens_begin ? token_ends->back()
+                                                      : chars_begin;
+    if (chars->size() > begin) token_ends->push_back(chars->size());
   };
-  for (auto& ch : unicode_text) {
-    if (ch == 0 || ch == 0xfffd || IsControl(ch)) {
-      continue;
-    }
-    if (do_lower_case_) {
-      ch = do_lower_case(ch);
+  size_t pos = 0;
+  while (pos < len) {
+    wchar_t ch;
+    CharKind kind;
+    if (data[pos] < 0x80) {
+      ch = data[pos++];
+      kind = ascii_kinds[ch];
+      if (kind == CharKind::kSkip) continue;
+      if (do_lower_case_ && ch >= L'A' && ch <= L'Z') ch += L'a' - L'A';
+    } else {
+      auto status = DecodeUTF8(data, len, &pos, &ch);
+      if (status == DecodeStatus::kTruncated) break;
+      if (status == DecodeStatus::kInvalid) {
+        chars->resize(chars_begin);
+        token_ends->resize(tokens_begin);
+        return false;
+      }
+      if (ch == 0xfffd || IsControl(ch)) continue;
+      if (do_lower_case_) ch = do_lower_case(ch);
+      kind = KindOf(ch);
     }
-    if (IsChineseChar(ch) || IsPunctuation(ch)) {
-      PushCacheText();
-      res->emplace_back(std::wstring{ch});
-    } else if (IsWhiteSpace(ch)) {
-      PushCacheText();
+    if (kind == CharKind::kSingle) {
+      EndToken();
+      chars->push_back(ch);
+      token_ends->push_back(chars->size());
+    } else if (kind == CharKind::kSpace) {
+      EndToken();
     } else {
-      cache_text += ch;
+      chars->push_back(ch);
     }
   }
-  PushCacheText();
+  EndToken();
+  return true;
+}
+
+constexpr uint32_t WordPieceTrie::kNotFound;
+
+WordPieceTrie::WordPieceTrie(const framework::Vocab& vocab) {
+  // Build the trie with a map per node first, then flatten it breadth first.
+  vector<std::map<wchar_t, uint32_t>> children(1);
+  vector<int32_t> ids(1, -1);
+  for (auto& item : vocab) {
+    uint32_t node = 0;
+    for (auto ch : item.first) {
+      auto it = children[node].find(ch);
+      if (it != children[node].end()) {
+        node = it->second;
+        continue;
+      }
+      // Growing children moves the maps, so `it` is not used past here.
+      uint32_t child = children.size();
+      children[node].emplace(ch, child);
+      children.emplace_back();
+      ids.push_back(-1);
+      node = child;
+    }
+    ids[node] = item.second;
+  }
+
+  const uint32_t num_nodes = children.size();
+  vector<uint32_t> order(1, 0), index(num_nodes);
+  for (size_t i = 0; i < order.size(); ++i) {
+    index[order[i]] = i;
+    for (auto& child : children[order[i]]) {
+      order.push_back(child.second);
+    }
+  }
+  first_edge_.reserve(num_nodes + 1);
+  edge_chars_.reserve(num_nodes - 1);
+  edge_children_.reserve(num_nodes - 1);
+  ids_.reserve(num_nodes);
+  for (auto node : order) {
+    first_edge_.push_back(edge_chars_.size());
+    for (auto& child : children[node]) {
+      edge_chars_.push_back(child.first);
+      edge_children_.push_back(index[child.second]);
+    }
+    ids_.push_back(ids[node]);
+  }
+  first_edge_.push_back(edge_chars_.size());
+
+  uint32_t node = Child(Root(), L'#');
+  suffix_root_ = node == kNotFound ? kNotFound : Child(node, L'#');
+}
+
+uint32_t WordPieceTrie::Child(uint32_t node, wchar_t ch) const {
+  auto begin = edge_chars_.begin() + first_edge_[node];
+  auto end = edge_chars_.begin() + first_edge_[node + 1];
+  auto it = std::lower_bound(begin, end, ch);
+  if (it == end || *it != ch) return kNotFound;
+  return edge_children_[it - edge_chars_.begin()];
+}
+
+size_t WordPieceTrie::LongestPrefix(uint32_t node, const wchar_t* text,
+                                    size_t len, int64_t* id) const {
+  size_t matched = 0;
+  for (size_t i = 0; i < len && node != kNotFound; ++i) {
+    node = Child(node, text[i]);
+    if (node != kNotFound && ids_[node] >= 0) {
+      matched = i + 1;
+      *id = ids_[node];
+    }
+  }
+  return matched;
+}
+
+bool WordPieceTrie::Find(const wchar_t* text, size_t len, int64_t* id) const {
+  uint32_t node = Root();
+  for (size_t i = 0; i < len && node != kNotFound; ++i) {
+    node = Child(node, text[i]);
+  }
+  if (node == kNotFound || ids_[node] < 0) return false;
+  *id = ids_[node];
+  return true;
 }
 
 WordPieceTokenizer::WordPieceTokenizer(
     const framework::Vocab* vocab, const wstring& unk_token /* = L"[UNK]"*/,
     const size_t max_input_chars_per_word /* = 100 */)
-    : vocab_(vocab),
-      unk_token_(unk_token),
-      max_input_chars_per_word_(max_input_chars_per_word) {
-  unk_token_id_ = vocab_->at(unk_token_);
-}
+    : trie_(std::make_shared<WordPieceTrie>(*vocab)),
+      unk_token_id_(vocab->at(unk_token)),
+      max_input_chars_per_word_(max_input_chars_per_word) {}
+
+WordPieceTokenizer::WordPieceTokenizer(
+    std::shared_ptr<const WordPieceTrie> trie, int64_t unk_token_id,
+    const size_t max_input_chars_per_word /* = 100 */)
+    : trie_(std::move(trie)),
+      unk_token_id_(unk_token_id),
+      max_input_chars_per_word_(max_input_chars_per_word) {}
 
 void WordPieceTokenizer::Tokenize(const wstring& text,
                                   vector<int64_t>* token_ids) const {
-  size_t len = text.size();
-  if (len > max_input_chars_per_word_) {
-    token_ids->emplace_back(std::move(unk_token_id_));
-    return;
-  }
+  Tokenize(text.data(), text.size(), token_ids);
+}
 
-  auto it = vocab_->find(text);
-  if (it != vocab_->end()) {
-    token_ids->emplace_back(std::move(it->second));
+// Greedy longest-match-first: the word is split into the longest tokens it
+// starts with, the pieces after the first one being looked up as "##" tokens.
+// A word which can not be split at some point is unknown as a whole.
+void WordPieceTokenizer::Tokenize(const wchar_t* text, size_t len,
+                                  vector<int64_t>* token_ids) const {
+  if (len > max_input_chars_per_word_) {
+    token_ids->emplace_back(unk_token_id_);
     return;
   }
 
+  const size_t num_ids = token_ids->size();
   size_t start = 0;
-  vector<int64_t> wordpiece_ids;
   while (start < len) {
-    size_t end = len;
-    std::wstring cur_substr;
-    int64_t cur_substr_id;
-    while (start < end) {
-      std::wstring sub = text.substr(start, end - start);
-      if (start > 0) {
-        sub = L"##" + sub;
-      }
-      auto it = vocab_->find(sub);
-      if (it != vocab_->end()) {
-        cur_substr = sub;
-        cur_substr_id = it->second;
-        break;
-      }
-      end -= 1;
-    }
-
-    if (cur_substr.empty()) {
-      token_ids->emplace_back(std::move(unk_token_id_));
+    int64_t id;
+    size_t matched = trie_->LongestPrefix(
+        start == 0 ? trie_->Root() : trie_->SuffixRoot(), text + start,
+        len - start, &id);
+    if (matched == 0) {
+      token_ids->resize(num_ids);
+      token_ids->emplace_back(unk_token_id_);
       return;
-    } else {
-      start = end;
-      wordpiece_ids.emplace_back(std::move(cur_substr_id));
     }
-  }
-  for (auto& token_id : wordpiece_ids) {
-    token_ids->emplace_back(std::move(token_id));
+    token_ids->emplace_back(id);
+    start += matched;
   }
 }
 
@@ -197,14 +376,15 @@ BertTokenizer::BertTokenizer(const framework::Vocab* vocab,
       mask_token_(mask_token),
       sep_token_(sep_token),
       padding_site_(padding_site),
-      vocab_(vocab),
+      vocab_hash_(HashVocab(*vocab)),
+      trie_(std::make_shared<WordPieceTrie>(*vocab)),
       basic_tokenizer_(do_lower_case_),
-      word_piece_tokenizer_(vocab_, unk_token) {
-  unk_token_id_ = vocab_->at(unk_token_);
-  pad_token_id_ = vocab_->at(pad_token_);
-  cls_token_id_ = vocab_->at(cls_token_);
-  mask_token_id_ = vocab_->at(mask_token_);
-  sep_token_id_ = vocab_->at(sep_token_);
+      word_piece_tokenizer_(trie_, vocab->at(unk_token)) {
+  unk_token_id_ = vocab->at(unk_token_);
+  pad_token_id_ = vocab->at(pad_token_);
+  cls_token_id_ = vocab->at(cls_token_);
+  mask_token_id_ = vocab->at(mask_token_);
+  sep_token_id_ = vocab->at(sep_token_);
 
   all_special_tokens_ = vector<wstring>(
       {unk_token_, pad_token_, cls_token_, mask_token_, sep_token_});
@@ -215,28 +395,22 @@ BertTokenizer::BertTokenizer(const framework::Vocab* vocab,
 
 void BertTokenizer::Tokenize(const string& text,
                              vector<int64_t>* split_token_ids) const {
-  std::vector<std::wstring> tmp_tokens;
-  basic_tokenizer_.Tokenize(text, &tmp_tokens);
-  if (tmp_tokens.empty()) return;
-  split_token_ids->reserve(tmp_tokens.size());
-  for (auto& w_token : tmp_tokens) {
-    const auto& vec_size = w_token.size();
-    if (vec_size == 1) {
-      if (IsChineseChar(w_token[0])) {
-        auto vocab_it = vocab_->find(w_token);
-        if (vocab_it != vocab_->end()) {
-          split_token_ids->emplace_back(std::move(vocab_it->second));
-        } else {
-          split_token_ids->emplace_back(std::move(unk_token_id_));
-        }
-      } else {
-        word_piece_tokenizer_.Tokenize(w_token, split_token_ids);
-      }
-    } else if (vec_size > 1) {
-      word_piece_tokenizer_.Tokenize(w_token, split_token_ids);
-    } else {
-      continue;
-    }
+  // Reused by the calls of each thread, so that tokenizing does not allocate
+  // once the buffers are large enough.
+  thread_local wstring chars;
+  thread_local vector<size_t> token_ends;
+  chars.clear();
+  token_ends.clear();
+  if (!basic_tokenizer_.Tokenize(text, &chars, &token_ends)) return;
+  if (token_ends.empty()) return;
+  split_token_ids->reserve(split_token_ids->size() + token_ends.size());
+  size_t begin = 0;
+  for (auto end : token_ends) {
+    // A single Chinese character is looked up as it is, which is also what
+    // the word piece tokenizer does with a word of one character.
+    word_piece_tokenizer_.Tokenize(chars.data() + begin, end - begin,
+                                   split_token_ids);
+    begin = end;
   }
 }
 
@@ -310,6 +484,84 @@ void BertTokenizer::TruncateSequence(
 
 int64_t BertTokenizer::GetPadTokenID() const { return pad_token_id_; }
 
+size_t HashVocab(const framework::Vocab& vocab) {
+  // Summing the hashes of the entries does not depend on their order.
+  size_t hash = vocab.size();
+  std::hash<wstring> hash_token;
+  for (auto& item : vocab) {
+    uint64_t h = hash_token(item.first) ^
+                 (static_cast<uint64_t>(item.second) * 0x9e3779b97f4a7c15ULL);
+    // the finalizer of splitmix64
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    hash += static_cast<size_t>(h ^ (h >> 31));
+  }
+  return hash;
+}
+
+bool BertTokenizer::IsBuiltFrom(size_t vocab_hash, bool do_lower_case) const {
+  return vocab_hash == vocab_hash_ && do_lower_case == do_lower_case_;
+}
+
+// Identifies a vocab object without reading all of it: its address, size
+// and first entries. The kernels pass the same vocab on every batch, so
+// HashVocab only runs when this identity is new.
+struct VocabIdentity {
+  const framework::Vocab* vocab;
+  size_t size;
+  size_t head_hash;
+
+  bool operator==(const VocabIdentity& other) const {
+    return vocab == other.vocab && size == other.size &&
+           head_hash == other.head_hash;
+  }
+};
+
+static VocabIdentity IdentifyVocab(const framework::Vocab* vocab) {
+  constexpr size_t kHeadEntries = 8;
+  std::hash<wstring> hash_token;
+  size_t head_hash = 0;
+  size_t n = 0;
+  for (auto it = vocab->begin(); it != vocab->end() && n < kHeadEntries;
+       ++it, ++n) {
+    head_hash = head_hash * 31 + hash_token(it->first) + it->second;
+  }
+  return {vocab, vocab->size(), head_hash};
+}
+
+std::shared_ptr<const BertTokenizer> GetBertTokenizer(
+    const framework::Vocab* vocab, bool do_lower_case) {
+  // A program seldom has more than a couple of vocabs.
+  constexpr size_t kMaxCachedTokenizers = 8;
+  static std::mutex mutex;
+  static std::deque<std::pair<VocabIdentity, size_t>> vocab_hashes;
+  static std::deque<std::shared_ptr<const BertTokenizer>> tokenizers;
+  VocabIdentity identity = IdentifyVocab(vocab);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto known = std::find_if(
+      vocab_hashes.begin(), vocab_hashes.end(),
+      [&](const std::pair<VocabIdentity, size_t>& item) {
+        return item.first == identity;
+      });
+  size_t vocab_hash = 0;
+  if (known != vocab_hashes.end()) {
+    vocab_hash = known->second;
+  } else {
+    vocab_hash = HashVocab(*vocab);
+    if (vocab_hashes.size() >= kMaxCachedTokenizers) vocab_hashes.pop_front();
+    vocab_hashes.emplace_back(identity, vocab_hash);
+  }
+  for (auto& tokenizer : tokenizers) {
+    if (tokenizer->IsBuiltFrom(vocab_hash, do_lower_case)) return tokenizer;
+  }
+  if (tokenizers.size() >= kMaxCachedTokenizers) tokenizers.pop_front();
+  tokenizers.push_back(
+      std::make_shared<const BertTokenizer>(vocab, do_lower_case));
+  VLOG(3) << "Build the tokenizer of a vocab of " << vocab->size()
+          << " tokens";
+  return tokenizers.back();
+}
+
 int BertTokenizer::Encode(
     unordered_map<string, vector<int64_t>>* encoded_inputs, const string& text,
     const string& text_pair /* = "" */, bool is_split_into_words /* = false */,
@@ -331,12 +583,11 @@ int BertTokenizer::Encode(
       return 0;
     }
     for (size_t i = 0; i < unicode_text.size(); i++) {
-      wstring token = unicode_text.substr(i, 1);
-      auto it = vocab_->find(token);
-      if (it != vocab_->end()) {
-        ids.emplace_back(std::move(it->second));
+      int64_t id;
+      if (trie_->Find(&unicode_text[i], 1, &id)) {
+        ids.emplace_back(id);
       } else {
-        ids.emplace_back(std::move(unk_token_id_));
+        ids.emplace_back(unk_token_id_);
       }
     }
   }
@@ -13,6 +13,7 @@ limitations under the License. */
 
 #include <utf8proc.h>
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -47,6 +48,12 @@ class BasicTokenizer {
  public:
   explicit BasicTokenizer(bool do_lower_case = true);
   void Tokenize(const string& text, vector<wstring>* res) const;
+  // Decodes the UTF-8 text and splits it in one pass. The characters of all
+  // the tokens are appended to chars, and token_ends holds where every token
+  // ends in chars. Returns false if the text is not valid UTF-8, in which
+  // case it has no tokens.
+  bool Tokenize(const string& text, wstring* chars,
+                vector<size_t>* token_ends) const;
 
  private:
   wchar_t do_lower_case(wchar_t ch) const;
@@ -54,16 +61,53 @@ class BasicTokenizer {
   bool do_lower_case_;
 };
 
+// A trie of the vocab tokens, flattened so that the children of a node are
+// contiguous and sorted by character. It finds the longest token a text
+// starts with in one walk, instead of hashing every prefix of the text.
+class WordPieceTrie {
+ public:
+  explicit WordPieceTrie(const framework::Vocab& vocab);
+
+  static constexpr uint32_t kNotFound = static_cast<uint32_t>(-1);
+
+  uint32_t Root() const { return 0; }
+  // The node of the "##" prefix, whose subtree holds the pieces which
+  // continue a word.
+  uint32_t SuffixRoot() const { return suffix_root_; }
+
+  // Returns the length of the longest token under node that text starts
+  // with, 0 if there is none, and its id in id.
+  size_t LongestPrefix(uint32_t node, const wchar_t* text, size_t len,
+                       int64_t* id) const;
+  // Returns whether text is a token, and its id in id.
+  bool Find(const wchar_t* text, size_t len, int64_t* id) const;
+
+ private:
+  uint32_t Child(uint32_t node, wchar_t ch) const;
+
+  // The children of node i are edge_chars_[first_edge_[i], first_edge_[i+1]).
+  vector<uint32_t> first_edge_;
+  vector<wchar_t> edge_chars_;
+  vector<uint32_t> edge_children_;
+  // The token id of every node, -1 if the node is not a token.
+  vector<int32_t> ids_;
+  uint32_t suffix_root_{kNotFound};
+};
+
 class WordPieceTokenizer {
  public:
   explicit WordPieceTokenizer(const framework::Vocab* vocab,
                               const wstring& unk_token = L"[UNK]",
                               const size_t max_input_chars_per_word = 100);
+  WordPieceTokenizer(std::shared_ptr<const WordPieceTrie> trie,
+                     int64_t unk_token_id,
+                     const size_t max_input_chars_per_word = 100);
   void Tokenize(const wstring& text, vector<int64_t>* output) const;
+  void Tokenize(const wchar_t* text, size_t len,
+                vector<int64_t>* output) const;
 
  private:
-  const framework::Vocab* vocab_;
-  wstring unk_token_{L"[UNK]"};
+  std::shared_ptr<const WordPieceTrie> trie_;
   int64_t unk_token_id_;
   size_t max_input_chars_per_word_;
 };
@@ -103,11 +147,17 @@ class BertTokenizer {
 
   int64_t GetPadTokenID() const;
 
+  // Whether the tokenizer was built from a vocab of the same tokens and ids,
+  // given by its HashVocab, with the same options.
+  bool IsBuiltFrom(size_t vocab_hash, bool do_lower_case) const;
+
  private:
   bool do_lower_case_;
   wstring unk_token_, pad_token_, cls_token_, mask_token_, sep_token_;
   string padding_site_;
-  const framework::Vocab* vocab_;
+  // Only identifies the vocab, all the lookups go through the trie.
+  size_t vocab_hash_;
+  std::shared_ptr<const WordPieceTrie> trie_;
   BasicTokenizer basic_tokenizer_;
   WordPieceTokenizer word_piece_tokenizer_;
   int64_t unk_token_id_, cls_token_id_, mask_token_id_, pad_token_id_,
@@ -117,6 +167,17 @@ class BertTokenizer {
   InvVocab inv_vocab_;
 };
 
+// A hash of the tokens and ids of the vocab, in any order.
+size_t HashVocab(const framework::Vocab& vocab);
+
+// Returns the tokenizer of the vocab, which is built once and shared by the
+// kernels using a vocab of the same content. The content is only hashed
+// the first time a vocab object is seen with its size and first entries,
+// so a vocab reloaded in place gets a new tokenizer when one of those
+// changes.
+std::shared_ptr<const BertTokenizer> GetBertTokenizer(
+    const framework::Vocab* vocab, bool do_lower_case);
+
 template <typename T>
 class FasterTokenizerKernel : public framework::OpKernel<T> {
  public:
@@ -141,18 +202,18 @@ class FasterTokenizerKernel : public framework::OpKernel<T> {
       return;
     }
 
-    BertTokenizer tokenizer(vocab, do_lower_case);
+    auto tokenizer = GetBertTokenizer(vocab, do_lower_case);
     size_t batch_max_seq_len = 0;
     size_t batch_size = text->size();
 
     vector<unordered_map<string, vector<int64_t>>> batch_encode_inputs(
         batch_size);
     if (text_pair) {
-      tokenizer.BatchEncode(&batch_encode_inputs, *text, *text_pair,
+      tokenizer->BatchEncode(&batch_encode_inputs, *text, *text_pair,
                             is_split_into_words, max_seq_len,
                             pad_to_max_seq_len);
     } else {
-      tokenizer.BatchEncode(&batch_encode_inputs, *text, vector<string>(),
+      tokenizer->BatchEncode(&batch_encode_inputs, *text, vector<string>(),
                             is_split_into_words, max_seq_len,
                             pad_to_max_seq_len);
     }
@@ -173,7 +234,7 @@ class FasterTokenizerKernel : public framework::OpKernel<T> {
                               static_cast<int64_t>(batch_max_seq_len)}));
     auto* seg_ids_data = seg_ids->mutable_data<T>(ctx.GetPlace());
 
-    auto pad_token_id = tokenizer.GetPadTokenID();
+    auto pad_token_id = tokenizer->GetPadTokenID();
     for (size_t i = 0; i < batch_size; i++) {
       auto& encoder_input_ids = batch_encode_inputs[i]["input_ids"];
       auto& encoder_seg_ids = batch_encode_inputs[i]["token_type_ids"];
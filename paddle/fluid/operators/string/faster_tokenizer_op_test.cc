@@ -0,0 +1,284 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/operators/string/faster_tokenizer_op.h"
+
+#include <utf8proc.h>
+
+#include <chrono>  // NOLINT
+#include <functional>
+#include <random>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace operators {
+
+// The tokenizer as it was before the trie and the UTF-8 decoding, to check
+// the ids against and to compare the speed with.
+class ReferenceTokenizer {
+ public:
+  ReferenceTokenizer(const framework::Vocab* vocab, bool do_lower_case)
+      : vocab_(vocab),
+        do_lower_case_(do_lower_case),
+        unk_token_id_(vocab->at(L"[UNK]")) {}
+
+  void Tokenize(const string& text, vector<int64_t>* ids) const {
+    wstring unicode_text;
+    if (!framework::ConvertStrToWstr(text, &unicode_text)) return;
+    wstring cache_text;
+    auto PushCacheText = [&]() {
+      if (!cache_text.empty()) {
+        WordPiece(cache_text, ids);
+        cache_text.clear();
+      }
+    };
+    for (auto ch : unicode_text) {
+      if (ch == 0 || ch == 0xfffd || IsControl(ch)) continue;
+      if (do_lower_case_) ch = utf8proc_tolower(ch);
+      if (IsChineseChar(ch) || IsPunctuation(ch)) {
+        PushCacheText();
+        WordPiece(wstring{ch}, ids);
+      } else if (IsWhiteSpace(ch)) {
+        PushCacheText();
+      } else {
+        cache_text += ch;
+      }
+    }
+    PushCacheText();
+  }
+
+ private:
+  static bool IsControl(wchar_t ch) {
+    if (ch == L'\t' || ch == L'\n' || ch == L'\r') return false;
+    auto cat = utf8proc_category(ch);
+    return cat == UTF8PROC_CATEGORY_CC || cat == UTF8PROC_CATEGORY_CF;
+  }
+
+  static bool IsChineseChar(wchar_t ch) {
+    return (ch >= 0x4E00 && ch <= 0x9FFF) || (ch >= 0x3400 && ch <= 0x4DBF) ||
+           (ch >= 0x20000 && ch <= 0x2A6DF) ||
+           (ch >= 0x2A700 && ch <= 0x2B73F) ||
+           (ch >= 0x2B740 && ch <= 0x2B81F) ||
+           (ch >= 0x2B820 && ch <= 0x2CEAF) ||
+           (ch >= 0xF900 && ch <= 0xFAFF) || (ch >= 0x2F800 && ch <= 0x2FA1F);
+  }
+
+  static bool IsWhiteSpace(wchar_t ch) {
+    if (ch == L' ' || ch == L'\t' || ch == L'\n' || ch == L'\r') return true;
+    return utf8proc_category(ch) == UTF8PROC_CATEGORY_ZS;
+  }
+
+  static bool IsPunctuation(wchar_t ch) {
+    if ((ch >= 33 && ch <= 47) || (ch >= 58 && ch <= 64) ||
+        (ch >= 91 && ch <= 96) || (ch >= 123 && ch <= 126))
+      return true;
+    auto cat = utf8proc_category(ch);
+    return cat == UTF8PROC_CATEGORY_PD || cat == UTF8PROC_CATEGORY_PS ||
+           cat == UTF8PROC_CATEGORY_PE || cat == UTF8PROC_CATEGORY_PC ||
+           cat == UTF8PROC_CATEGORY_PO || cat == UTF8PROC_CATEGORY_PI ||
+           cat == UTF8PROC_CATEGORY_PF;
+  }
+
+  void WordPiece(const wstring& text, vector<int64_t>* ids) const {
+    size_t len = text.size();
+    if (len > 100) {
+      ids->push_back(unk_token_id_);
+      return;
+    }
+    vector<int64_t> piece_ids;
+    size_t start = 0;
+    while (start < len) {
+      size_t end = len;
+      bool found = false;
+      while (start < end) {
+        wstring sub = text.substr(start, end - start);
+        if (start > 0) sub = L"##" + sub;
+        auto it = vocab_->find(sub);
+        if (it != vocab_->end()) {
+          piece_ids.push_back(it->second);
+          found = true;
+          break;
+        }
+        end -= 1;
+      }
+      if (!found) {
+        ids->push_back(unk_token_id_);
+        return;
+      }
+      start = end;
+    }
+    ids->insert(ids->end(), piece_ids.begin(), piece_ids.end());
+  }
+
+  const framework::Vocab* vocab_;
+  bool do_lower_case_;
+  int64_t unk_token_id_;
+};
+
+framework::Vocab MakeVocab() {
+  framework::Vocab vocab;
+  for (auto token : {L"[PAD]", L"[UNK]", L"[CLS]", L"[SEP]", L"[MASK]"}) {
+    vocab.emplace(token, static_cast<int32_t>(vocab.size()));
+  }
+  const vector<wstring> words = {
+      L"the",  L"a",     L"token", L"##izer", L"##s",   L"##ing", L"play",
+      L"##ed", L"un",    L"##aff", L"##able", L"paddle", L"fast", L"##er",
+      L"ca",   L"##fé",  L"über",  L"Über",   L"The",    L"中",   L"文",
+      L"分",   L"词",    L"ß",     L"##ß",    L"1",      L"##0",  L"2021"};
+  for (auto& word : words) {
+    vocab.emplace(word, static_cast<int32_t>(vocab.size()));
+  }
+  for (wchar_t ch = 33; ch < 127; ++ch) {
+    vocab.emplace(wstring{ch}, static_cast<int32_t>(vocab.size()));
+    vocab.emplace(L"##" + wstring{ch}, static_cast<int32_t>(vocab.size()));
+  }
+  return vocab;
+}
+
+vector<string> MakeTexts(size_t num_texts) {
+  // words, punctuation, Chinese, accents, spaces, control characters, a
+  // zero width space, no-break and ideographic spaces, U+FFFD and a
+  // surrogate
+  const vector<string> pieces = {"the",
+                                 "The",
+                                 "tokenizers",
+                                 "playing",
+                                 "unaffable",
+                                 "PaddlePaddle",
+                                 "faster",
+                                 "caf\xc3\xa9",
+                                 "\xc3\x9c"
+                                 "ber",
+                                 "\xc3\xbc"
+                                 "ber",
+                                 "STRASSE",
+                                 "stra\xc3\x9f"
+                                 "e",
+                                 "\xe4\xb8\xad\xe6\x96\x87",
+                                 "\xe6\x97\xa5\xe6\x9c\xac",
+                                 ",",
+                                 "!",
+                                 "##",
+                                 "2021",
+                                 "10.5%",
+                                 " ",
+                                 "\t",
+                                 "\n",
+                                 "\x01",
+                                 "\xe2\x80\x8b",
+                                 "\xc2\xa0",
+                                 "\xe3\x80\x80",
+                                 "\xef\xbf\xbd",
+                                 "\xed\xa0\x80"};
+  // an invalid byte, an overlong form, and a character cut off by the end
+  const vector<string> invalid_pieces = {"\xff", "\xc0\x80", "\xe4\xb8"};
+  std::mt19937 rng(2021);
+  std::uniform_int_distribution<size_t> piece(0, pieces.size() - 1);
+  std::uniform_int_distribution<size_t> length(1, 40);
+  vector<string> texts(num_texts);
+  for (auto& text : texts) {
+    for (size_t i = length(rng); i > 0; --i) {
+      text += pieces[piece(rng)];
+      text += " ";
+    }
+    if (rng() % 20 == 0) text += invalid_pieces[rng() % 3];
+  }
+  return texts;
+}
+
+TEST(FasterTokenizer, same_ids_as_reference) {
+  auto vocab = MakeVocab();
+  auto texts = MakeTexts(2000);
+  for (bool do_lower_case : {false, true}) {
+    BertTokenizer tokenizer(&vocab, do_lower_case);
+    ReferenceTokenizer reference(&vocab, do_lower_case);
+    for (auto& text : texts) {
+      vector<int64_t> ids, ref_ids;
+      tokenizer.Tokenize(text, &ids);
+      reference.Tokenize(text, &ref_ids);
+      ASSERT_EQ(ids, ref_ids) << "text: " << text;
+    }
+  }
+}
+
+TEST(FasterTokenizer, basic_tokens) {
+  BasicTokenizer tokenizer(true);
+  vector<wstring> tokens;
+  // a zero width space, which is a format character, is skipped
+  tokenizer.Tokenize("Hello,\tWORLD!  \xe4\xb8\xad\xe6\x96\x87\xe2\x80\x8b",
+                     &tokens);
+  EXPECT_EQ(tokens, vector<wstring>({L"hello", L",", L"world", L"!", L"中",
+                                     L"文"}));
+  tokens.clear();
+  tokenizer.Tokenize("invalid \xff utf-8", &tokens);
+  EXPECT_TRUE(tokens.empty());
+}
+
+TEST(FasterTokenizer, cached_per_vocab) {
+  auto vocab = MakeVocab();
+  auto tokenizer = GetBertTokenizer(&vocab, false);
+  EXPECT_EQ(tokenizer, GetBertTokenizer(&vocab, false));
+  EXPECT_NE(tokenizer, GetBertTokenizer(&vocab, true));
+
+  // Another vocab of the same tokens shares the tokenizer.
+  auto other_vocab = MakeVocab();
+  EXPECT_EQ(tokenizer, GetBertTokenizer(&other_vocab, false));
+  // A vocab of the same size with two ids swapped does not.
+  auto swapped_vocab = MakeVocab();
+  std::swap(swapped_vocab.at(L"a"), swapped_vocab.at(L"b"));
+  EXPECT_NE(tokenizer, GetBertTokenizer(&swapped_vocab, false));
+
+  // A vocab reloaded in place with other tokens gets a new tokenizer.
+  vocab.emplace(L"tokenizer", static_cast<int32_t>(vocab.size()));
+  auto reloaded = GetBertTokenizer(&vocab, false);
+  EXPECT_NE(tokenizer, reloaded);
+  vector<int64_t> ids;
+  reloaded->Tokenize("tokenizer", &ids);
+  EXPECT_EQ(ids, vector<int64_t>({vocab.at(L"tokenizer")}));
+}
+
+// Tokens per second of the tokenizer and of the reference one.
+TEST(BENCHMARK, FasterTokenizer) {
+  auto vocab = MakeVocab();
+  auto texts = MakeTexts(20000);
+  BertTokenizer tokenizer(&vocab, true);
+  ReferenceTokenizer reference(&vocab, true);
+
+  auto Measure = [&texts](const char* name, std::function<void(
+                                                const string&,
+                                                vector<int64_t>*)> tokenize) {
+    vector<int64_t> ids;
+    size_t num_tokens = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < 5; ++repeat) {
+      for (auto& text : texts) {
+        ids.clear();
+        tokenize(text, &ids);
+        num_tokens += ids.size();
+      }
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    LOG(INFO) << name << ": " << num_tokens / seconds << " tokens/s";
+  };
+  Measure("reference", [&reference](const string& text, vector<int64_t>* ids) {
+    reference.Tokenize(text, ids);
+  });
+  Measure("trie", [&tokenizer](const string& text, vector<int64_t>* ids) {
+    tokenizer.Tokenize(text, ids);
+  });
+}
+
+}  // namespace operators
+}  // namespace paddle
@@ -356,8 +356,8 @@ PADDLE_DEFINE_EXPORTED_double(
  * Allocator related FLAG
  * Name: FLAGS_allocator_strategy
  * Since Version: 1.2
- * Value Range: string, {naive_best_fit, auto_growth, thread_local},
- * default=auto_growth
+ * Value Range: string, {naive_best_fit, auto_growth, thread_local,
+ * thread_caching}, default=auto_growth
  * Example:
  * Note: For selecting allocator policy of PaddlePaddle.
  */
@@ -378,7 +378,10 @@ PADDLE_DEFINE_EXPORTED_string(
     "size of models may be larger). auto_growth strategy would allocate "
     "GPU memory on demand, which allows users to start several Paddle jobs "
     "on the same GPU card but may lead to more memory fragmentation "
-    "(i.e., maximum batch size of models may be smaller).");
+    "(i.e., maximum batch size of models may be smaller). "
+    "thread_caching is auto_growth on devices, with CPU memory served from "
+    "size classed free lists cached per thread, which avoids a global lock "
+    "for CPU allocations in multi-threaded jobs.");
 
 /**
  * Memory related FLAG
@@ -772,3 +775,8 @@ DEFINE_bool(enable_slotrecord_reset_shrink, false,
             "enable slotrecord obejct reset shrink memory, default false");
 DEFINE_bool(enable_ins_parser_file, false,
             "enable parser ins file , default false");
+DEFINE_string(slotrecord_binary_cache_dir, "",
+              "SlotRecordDataset caches every parsed local file as columnar "
+              "binary under this local dir and loads it from there next "
+              "time; hdfs/afs files and sampled loads are never cached, "
+              "default empty means no cache");
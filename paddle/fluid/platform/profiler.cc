@@ -22,6 +22,7 @@ limitations under the License. */
 #include "paddle/fluid/platform/enforce.h"
 #include "paddle/fluid/platform/profiler.h"
 #include "paddle/fluid/platform/profiler/host_event_recorder.h"
+#include "paddle/fluid/platform/profiler/sampling_event_recorder.h"
 #include "paddle/fluid/platform/profiler_helper.h"
 #ifdef PADDLE_WITH_CUDA
 #include "paddle/fluid/platform/dynload/nvtx.h"
@@ -74,6 +75,14 @@ RecordEvent::RecordEvent(const char *name, const EventRole role) {
 #endif
 #endif
   if (UNLIKELY(FLAGS_enable_host_event_recorder_hook == false)) {
+    if (UNLIKELY(SamplingEventRecorder::IsSampling()) &&
+        g_state == ProfilerState::kDisabled) {
+      shallow_copy_name_ = name;
+      role_ = role;
+      start_ns_ = PosixInNsec();
+      is_sampled_ = true;
+      return;
+    }
     OriginalConstruct(name, role, "none");
     return;
   }
@@ -92,6 +101,14 @@ RecordEvent::RecordEvent(const std::string &name, const EventRole role) {
 #endif
 #endif
   if (UNLIKELY(FLAGS_enable_host_event_recorder_hook == false)) {
+    if (UNLIKELY(SamplingEventRecorder::IsSampling()) &&
+        g_state == ProfilerState::kDisabled) {
+      name_ = new std::string(name);
+      role_ = role;
+      start_ns_ = PosixInNsec();
+      is_sampled_ = true;
+      return;
+    }
     OriginalConstruct(name, role, "none");
     return;
   }
@@ -111,6 +128,14 @@ RecordEvent::RecordEvent(const std::string &name, const EventRole role,
 #endif
 #endif
   if (UNLIKELY(FLAGS_enable_host_event_recorder_hook == false)) {
+    if (UNLIKELY(SamplingEventRecorder::IsSampling()) &&
+        g_state == ProfilerState::kDisabled) {
+      name_ = new std::string(name);
+      role_ = role;
+      start_ns_ = PosixInNsec();
+      is_sampled_ = true;
+      return;
+    }
     OriginalConstruct(name, role, attr);
     return;
   }
@@ -150,6 +175,13 @@ void RecordEvent::End() {
 #endif
 #endif
   uint64_t end_ns = PosixInNsec();
+  if (UNLIKELY(is_sampled_)) {
+    SamplingEventRecorder::GetInstance().RecordEvent(
+        shallow_copy_name_ != nullptr ? shallow_copy_name_ : name_->c_str(),
+        start_ns_, end_ns, role_);
+    delete name_;
+    return;
+  }
   if (LIKELY(FLAGS_enable_host_event_recorder_hook)) {
     if (LIKELY(shallow_copy_name_ != nullptr)) {
       HostEventRecorder::GetInstance().RecordEvent(shallow_copy_name_,
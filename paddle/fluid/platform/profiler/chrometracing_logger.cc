@@ -0,0 +1,271 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/platform/profiler/chrometracing_logger.h"
+
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/profiler/event_node.h"
+
+namespace paddle {
+namespace platform {
+
+static const char* kTracerEventTypeNames[] = {
+    "Operator", "Dataloader", "ProfileStep", "CudaRuntime",
+    "Kernel",   "Memcpy",     "Memset",      "UserDefined"};
+
+static const char* StringTracerEventType(TracerEventType type) {
+  size_t index = static_cast<size_t>(type);
+  if (index < static_cast<size_t>(TracerEventType::NumTypes)) {
+    return kTracerEventTypeNames[index];
+  }
+  return "Unknown";
+}
+
+// Chrome tracing timestamps are in microseconds. Printing them from
+// integers keeps the nanoseconds, which a double can't hold for epoch
+// timestamps.
+static std::string Microseconds(uint64_t ns) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%llu.%03llu",
+           static_cast<unsigned long long>(ns / 1000),    // NOLINT
+           static_cast<unsigned long long>(ns % 1000));  // NOLINT
+  return buf;
+}
+
+static std::string JsonEscape(const std::string& str) {
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      case '\t':
+        escaped += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          escaped += buf;
+        } else {
+          escaped += c;
+        }
+    }
+  }
+  return escaped;
+}
+
+ChromeTracingLogger::ChromeTracingLogger(const std::string& filename)
+    : filename_(filename) {
+  OpenFile();
+  StartLog();
+}
+
+ChromeTracingLogger::ChromeTracingLogger(const char* filename)
+    : filename_(filename) {
+  OpenFile();
+  StartLog();
+}
+
+ChromeTracingLogger::~ChromeTracingLogger() {
+  EndLog();
+  output_file_stream_.close();
+}
+
+void ChromeTracingLogger::OpenFile() {
+  output_file_stream_.open(filename_,
+                           std::ofstream::out | std::ofstream::trunc);
+  PADDLE_ENFORCE_EQ(
+      output_file_stream_.is_open(), true,
+      platform::errors::Unavailable("File (%s) open failed.", filename_));
+}
+
+void ChromeTracingLogger::StartLog() {
+  output_file_stream_ << "{\n  \"displayTimeUnit\": \"ns\",\n"
+                      << "  \"traceEvents\": [";
+}
+
+void ChromeTracingLogger::EndLog() {
+  LogMetaInfo();
+  output_file_stream_ << "\n  ]\n}\n";
+}
+
+void ChromeTracingLogger::NextEvent() {
+  output_file_stream_ << (is_first_event_ ? "\n    " : ",\n    ");
+  is_first_event_ = false;
+}
+
+void ChromeTracingLogger::LogNodeTrees(const NodeTrees& node_trees) {
+  // The root node of each thread only holds the tree, it is not an event.
+  const std::map<uint64_t, std::vector<HostTraceEventNode*>> thread2host_nodes =
+      node_trees.Traverse(true);
+  for (auto it = thread2host_nodes.begin(); it != thread2host_nodes.end();
+       ++it) {
+    for (auto hostnode = it->second.begin(); hostnode != it->second.end();
+         ++hostnode) {
+      if (hostnode != it->second.begin()) {
+        (*hostnode)->LogMe(this);
+      }
+      for (auto runtimenode : (*hostnode)->GetRuntimeTraceEventNodes()) {
+        runtimenode->LogMe(this);
+        for (auto devicenode : runtimenode->GetDeviceTraceEventNodes()) {
+          devicenode->LogMe(this);
+        }
+      }
+    }
+  }
+}
+
+void ChromeTracingLogger::LogHostTraceEventNode(
+    const HostTraceEventNode& host_node) {
+  host_process_ids_.insert(host_node.process_id());
+  NextEvent();
+  output_file_stream_ << "{\"name\": \"" << JsonEscape(host_node.name())
+                      << "\", \"cat\": \""
+                      << StringTracerEventType(host_node.type())
+                      << "\", \"ph\": \"X\", \"pid\": "
+                      << host_node.process_id()
+                      << ", \"tid\": " << host_node.thread_id()
+                      << ", \"ts\": " << Microseconds(host_node.start_ns())
+                      << ", \"dur\": " << Microseconds(host_node.duration())
+                      << ", \"args\": {\"start_ns\": " << host_node.start_ns()
+                      << ", \"end_ns\": " << host_node.end_ns() << "}}";
+}
+
+void ChromeTracingLogger::LogRuntimeTraceEventNode(
+    const CudaRuntimeTraceEventNode& runtime_node) {
+  host_process_ids_.insert(runtime_node.process_id());
+  NextEvent();
+  output_file_stream_ << "{\"name\": \"" << JsonEscape(runtime_node.name())
+                      << "\", \"cat\": \""
+                      << StringTracerEventType(runtime_node.type())
+                      << "\", \"ph\": \"X\", \"pid\": "
+                      << runtime_node.process_id()
+                      << ", \"tid\": " << runtime_node.thread_id()
+                      << ", \"ts\": " << Microseconds(runtime_node.start_ns())
+                      << ", \"dur\": "
+                      << Microseconds(runtime_node.duration())
+                      << ", \"args\": {\"correlation_id\": "
+                      << runtime_node.correlation_id()
+                      << ", \"callback_id\": " << runtime_node.callback_id()
+                      << "}}";
+  // the flow to the device events launched
+  NextEvent();
+  output_file_stream_ << "{\"name\": \"launch\", \"cat\": \"flow\", "
+                      << "\"ph\": \"s\", \"id\": "
+                      << runtime_node.correlation_id()
+                      << ", \"pid\": " << runtime_node.process_id()
+                      << ", \"tid\": " << runtime_node.thread_id()
+                      << ", \"ts\": " << Microseconds(runtime_node.start_ns())
+                      << "}";
+}
+
+void ChromeTracingLogger::LogDeviceTraceEventNode(
+    const DeviceTraceEventNode& device_node) {
+  device_ids_.insert(device_node.device_id());
+  NextEvent();
+  output_file_stream_ << "{\"name\": \"" << JsonEscape(device_node.name())
+                      << "\", \"cat\": \""
+                      << StringTracerEventType(device_node.type())
+                      << "\", \"ph\": \"X\", \"pid\": \"GPU "
+                      << device_node.device_id() << "\", \"tid\": \"stream "
+                      << device_node.stream_id()
+                      << "\", \"ts\": " << Microseconds(device_node.start_ns())
+                      << ", \"dur\": " << Microseconds(device_node.duration())
+                      << ", \"args\": {\"correlation_id\": "
+                      << device_node.correlation_id()
+                      << ", \"context_id\": " << device_node.context_id();
+  switch (device_node.type()) {
+    case TracerEventType::Kernel: {
+      KernelEventInfo info = device_node.kernel_info();
+      output_file_stream_ << ", \"grid\": [" << info.grid_x << ", "
+                          << info.grid_y << ", " << info.grid_z
+                          << "], \"block\": [" << info.block_x << ", "
+                          << info.block_y << ", " << info.block_z
+                          << "], \"registers_per_thread\": "
+                          << info.registers_per_thread
+                          << ", \"shared_memory\": "
+                          << info.dynamic_shared_memory +
+                                 info.static_shared_memory;
+      break;
+    }
+    case TracerEventType::Memcpy: {
+      MemcpyEventInfo info = device_node.memcpy_info();
+      output_file_stream_ << ", \"num_bytes\": " << info.num_bytes
+                          << ", \"copy_kind\": \""
+                          << JsonEscape(info.copy_kind) << "\"";
+      break;
+    }
+    case TracerEventType::Memset: {
+      MemsetEventInfo info = device_node.memset_info();
+      output_file_stream_ << ", \"num_bytes\": " << info.num_bytes
+                          << ", \"value\": " << info.value;
+      break;
+    }
+    default:
+      break;
+  }
+  output_file_stream_ << "}}";
+  NextEvent();
+  output_file_stream_ << "{\"name\": \"launch\", \"cat\": \"flow\", "
+                      << "\"ph\": \"f\", \"bp\": \"e\", \"id\": "
+                      << device_node.correlation_id() << ", \"pid\": \"GPU "
+                      << device_node.device_id() << "\", \"tid\": \"stream "
+                      << device_node.stream_id()
+                      << "\", \"ts\": " << Microseconds(device_node.start_ns())
+                      << "}";
+}
+
+void ChromeTracingLogger::LogMetaInfo() {
+  // names the processes, and shows the host above the devices
+  for (uint64_t process_id : host_process_ids_) {
+    NextEvent();
+    output_file_stream_ << "{\"name\": \"process_name\", \"ph\": \"M\", "
+                        << "\"pid\": " << process_id
+                        << ", \"args\": {\"name\": \"Host (pid " << process_id
+                        << ")\"}}";
+    NextEvent();
+    output_file_stream_ << "{\"name\": \"process_sort_index\", \"ph\": \"M\", "
+                        << "\"pid\": " << process_id
+                        << ", \"args\": {\"sort_index\": 0}}";
+  }
+  for (uint64_t device_id : device_ids_) {
+    NextEvent();
+    output_file_stream_ << "{\"name\": \"process_name\", \"ph\": \"M\", "
+                        << "\"pid\": \"GPU " << device_id
+                        << "\", \"args\": {\"name\": \"GPU " << device_id
+                        << "\"}}";
+    NextEvent();
+    output_file_stream_ << "{\"name\": \"process_sort_index\", \"ph\": \"M\", "
+                        << "\"pid\": \"GPU " << device_id
+                        << "\", \"args\": {\"sort_index\": " << device_id + 1
+                        << "}}";
+  }
+  host_process_ids_.clear();
+  device_ids_.clear();
+}
+
+}  // namespace platform
+}  // namespace paddle
@@ -0,0 +1,62 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <set>
+#include <string>
+
+#include "paddle/fluid/platform/profiler/output_logger.h"
+
+namespace paddle {
+namespace platform {
+
+// Writes the events in the Chrome Trace Event Format, which can be opened
+// by chrome://tracing and by the Perfetto UI (https://ui.perfetto.dev).
+// Events are written to the file as they are logged, the file is complete
+// once the logger is destroyed.
+//
+// - Host and runtime events are complete events of their process and
+//   thread.
+// - Device events are complete events of a process per device, with a
+//   thread per stream, and are linked to the runtime events which launched
+//   them by flow events.
+class ChromeTracingLogger : public BaseLogger {
+ public:
+  explicit ChromeTracingLogger(const std::string& filename);
+  explicit ChromeTracingLogger(const char* filename);
+  ~ChromeTracingLogger();
+  std::string filename() { return filename_; }
+  void LogDeviceTraceEventNode(const DeviceTraceEventNode&) override;
+  void LogHostTraceEventNode(const HostTraceEventNode&) override;
+  void LogRuntimeTraceEventNode(const CudaRuntimeTraceEventNode&) override;
+  void LogNodeTrees(const NodeTrees&) override;
+  void LogMetaInfo() override;
+
+ private:
+  void OpenFile();
+  void StartLog();
+  void EndLog();
+  // separates the events, as the last one can't be followed by a comma
+  void NextEvent();
+
+  std::string filename_;
+  std::ofstream output_file_stream_;
+  bool is_first_event_{true};
+  std::set<uint64_t> host_process_ids_;
+  std::set<uint64_t> device_ids_;
+};
+
+}  // namespace platform
+}  // namespace paddle
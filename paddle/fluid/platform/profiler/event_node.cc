@@ -0,0 +1,216 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/platform/profiler/event_node.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <unordered_map>
+
+namespace paddle {
+namespace platform {
+
+HostTraceEventNode::~HostTraceEventNode() {
+  // delete all runtime nodes and recursive delete children
+  for (auto it = runtime_node_ptrs_.begin(); it != runtime_node_ptrs_.end();
+       ++it) {
+    delete *it;
+  }
+  for (auto it = children_.begin(); it != children_.end(); ++it) {
+    delete *it;
+  }
+}
+
+CudaRuntimeTraceEventNode::~CudaRuntimeTraceEventNode() {
+  // delete all device nodes
+  for (auto it = device_node_ptrs_.begin(); it != device_node_ptrs_.end();
+       ++it) {
+    delete *it;
+  }
+}
+
+NodeTrees::~NodeTrees() {
+  // delete all root nodes, which recursively delete the whole trees
+  for (auto it = thread_event_trees_map_.begin();
+       it != thread_event_trees_map_.end(); ++it) {
+    delete it->second;
+  }
+}
+
+void NodeTrees::BuildTrees(
+    const std::vector<HostTraceEventNode*>& host_event_nodes,
+    std::vector<CudaRuntimeTraceEventNode*>& runtime_event_nodes,
+    const std::vector<DeviceTraceEventNode*>& device_event_nodes) {
+  // separate host and runtime nodes by thread
+  std::map<uint64_t, std::vector<HostTraceEventNode*>> thread2host_event_nodes;
+  std::map<uint64_t, std::vector<CudaRuntimeTraceEventNode*>>
+      thread2runtime_event_nodes;
+  // device nodes are attached to the runtime node which launched them
+  std::unordered_map<uint32_t, CudaRuntimeTraceEventNode*>
+      correlation_id2runtime_event_node;
+  for (auto it = host_event_nodes.begin(); it != host_event_nodes.end();
+       ++it) {
+    thread2host_event_nodes[(*it)->thread_id()].push_back(*it);
+  }
+  for (auto it = runtime_event_nodes.begin(); it != runtime_event_nodes.end();
+       ++it) {
+    thread2runtime_event_nodes[(*it)->thread_id()].push_back(*it);
+    correlation_id2runtime_event_node[(*it)->correlation_id()] = *it;
+  }
+  for (auto it = device_event_nodes.begin(); it != device_event_nodes.end();
+       ++it) {
+    auto dst = correlation_id2runtime_event_node.find((*it)->correlation_id());
+    if (dst == correlation_id2runtime_event_node.end()) {
+      // the runtime event which launched it is not recorded
+      delete *it;
+      continue;
+    }
+    dst->second->AddDeviceTraceEventNode(*it);
+  }
+  // build a tree for each thread
+  for (auto it = thread2host_event_nodes.begin();
+       it != thread2host_event_nodes.end(); ++it) {
+    thread_event_trees_map_[it->first] = BuildTreeRelationship(
+        it->second, thread2runtime_event_nodes[it->first]);
+  }
+  // threads which have runtime events only
+  for (auto it = thread2runtime_event_nodes.begin();
+       it != thread2runtime_event_nodes.end(); ++it) {
+    if (thread_event_trees_map_.count(it->first) == 0) {
+      thread_event_trees_map_[it->first] = BuildTreeRelationship(
+          std::vector<HostTraceEventNode*>(), it->second);
+    }
+  }
+}
+
+HostTraceEventNode* NodeTrees::BuildTreeRelationship(
+    std::vector<HostTraceEventNode*> host_event_nodes,
+    std::vector<CudaRuntimeTraceEventNode*> runtime_event_nodes) {
+  uint64_t process_id = 0, thread_id = 0;
+  if (!host_event_nodes.empty()) {
+    process_id = host_event_nodes.front()->process_id();
+    thread_id = host_event_nodes.front()->thread_id();
+  } else if (!runtime_event_nodes.empty()) {
+    process_id = runtime_event_nodes.front()->process_id();
+    thread_id = runtime_event_nodes.front()->thread_id();
+  }
+  // a root node spanning all the time, so every thread has a single tree
+  HostTraceEventNode* root = new HostTraceEventNode(HostTraceEvent(
+      std::string("root node"), TracerEventType::UserDefined, 0,
+      std::numeric_limits<uint64_t>::max(), process_id, thread_id));
+
+  // An event which starts earlier, or starts at the same time and ends
+  // later, is the parent of the events it contains. Events only partially
+  // overlapping are siblings.
+  std::sort(host_event_nodes.begin(), host_event_nodes.end(),
+            [](HostTraceEventNode* a, HostTraceEventNode* b) {
+              if (a->start_ns() != b->start_ns()) {
+                return a->start_ns() < b->start_ns();
+              }
+              return a->end_ns() > b->end_ns();
+            });
+  std::vector<HostTraceEventNode*> stack = {root};
+  for (auto it = host_event_nodes.begin(); it != host_event_nodes.end();
+       ++it) {
+    while ((*it)->end_ns() > stack.back()->end_ns()) {
+      stack.pop_back();
+    }
+    stack.back()->AddChild(*it);
+    stack.push_back(*it);
+  }
+
+  // A runtime event belongs to the innermost host event containing it.
+  // Children are added in order of start time, so the candidate on each
+  // level is the last child starting no later than the runtime event.
+  for (auto it = runtime_event_nodes.begin(); it != runtime_event_nodes.end();
+       ++it) {
+    HostTraceEventNode* parent = root;
+    while (true) {
+      auto& children = parent->GetChildren();
+      auto child = std::upper_bound(
+          children.begin(), children.end(), (*it)->start_ns(),
+          [](uint64_t start_ns, HostTraceEventNode* node) {
+            return start_ns < node->start_ns();
+          });
+      if (child == children.begin()) {
+        break;
+      }
+      --child;
+      if ((*child)->end_ns() < (*it)->end_ns()) {
+        break;
+      }
+      parent = *child;
+    }
+    parent->AddCudaRuntimeNode(*it);
+  }
+  return root;
+}
+
+void NodeTrees::LogMe(BaseLogger* logger) { logger->LogNodeTrees(*this); }
+
+void NodeTrees::HandleTrees(
+    std::function<void(HostTraceEventNode*)> host_event_node_handle,
+    std::function<void(CudaRuntimeTraceEventNode*)> runtime_event_node_handle,
+    std::function<void(DeviceTraceEventNode*)> device_event_node_handle) {
+  // using different user-defined function to handle different nodes
+  const std::map<uint64_t, std::vector<HostTraceEventNode*>> thread2host_nodes =
+      Traverse(true);
+  for (auto it = thread2host_nodes.begin(); it != thread2host_nodes.end();
+       ++it) {
+    for (auto hostnode = it->second.begin(); hostnode != it->second.end();
+         ++hostnode) {
+      host_event_node_handle(*hostnode);
+      for (auto runtimenode : (*hostnode)->GetRuntimeTraceEventNodes()) {
+        runtime_event_node_handle(runtimenode);
+        for (auto devicenode : runtimenode->GetDeviceTraceEventNodes()) {
+          device_event_node_handle(devicenode);
+        }
+      }
+    }
+  }
+}
+
+std::map<uint64_t, std::vector<HostTraceEventNode*>> NodeTrees::Traverse(
+    bool bfs) const {
+  // traverse the tree of each thread, the root node first
+  std::map<uint64_t, std::vector<HostTraceEventNode*>> thread2host_nodes;
+  for (auto it = thread_event_trees_map_.begin();
+       it != thread_event_trees_map_.end(); ++it) {
+    auto& nodes = thread2host_nodes[it->first];
+    std::deque<HostTraceEventNode*> pending = {it->second};
+    while (!pending.empty()) {
+      HostTraceEventNode* node = nullptr;
+      if (bfs) {
+        node = pending.front();
+        pending.pop_front();
+      } else {
+        node = pending.back();
+        pending.pop_back();
+      }
+      nodes.push_back(node);
+      auto& children = node->GetChildren();
+      if (bfs) {
+        pending.insert(pending.end(), children.begin(), children.end());
+      } else {
+        // the earliest child is visited first
+        pending.insert(pending.end(), children.rbegin(), children.rend());
+      }
+    }
+  }
+  return thread2host_nodes;
+}
+
+}  // namespace platform
+}  // namespace paddle
@@ -54,6 +54,8 @@ class RecordEvent {
 
   bool is_enabled_{false};
   bool is_pushed_{false};
+  // recorded by SamplingEventRecorder
+  bool is_sampled_{false};
   // Event name
   std::string* name_{nullptr};
   const char* shallow_copy_name_{nullptr};
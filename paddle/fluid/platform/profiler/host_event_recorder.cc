@@ -17,11 +17,13 @@ namespace platform {
 
 ThreadEventRecorder::ThreadEventRecorder() {
   thread_id_ = GetCurrentThreadSysId();
+  thread_name_ = GetCurrentThreadName();
   HostEventRecorder::GetInstance().RegisterThreadRecorder(thread_id_, this);
 }
 
 HostEventSection HostEventRecorder::GatherEvents() {
   HostEventSection host_sec;
+  host_sec.process_id = GetProcessId();
   host_sec.thr_sections.reserve(thread_recorders_.size());
   for (auto &kv : thread_recorders_) {
     host_sec.thr_sections.emplace_back(std::move(kv.second->GatherEvents()));
@@ -29,5 +31,19 @@ HostEventSection HostEventRecorder::GatherEvents() {
   return host_sec;
 }
 
+std::list<HostTraceEvent> ToHostTraceEvents(const HostEventSection &host_sec) {
+  std::list<HostTraceEvent> host_events;
+  for (const auto &thr_sec : host_sec.thr_sections) {
+    for (const auto &evt : thr_sec.events) {
+      TracerEventType type = evt.role == EventRole::kSpecial
+                                 ? TracerEventType::UserDefined
+                                 : TracerEventType::Operator;
+      host_events.emplace_back(evt.name, type, evt.start_ns, evt.end_ns,
+                               host_sec.process_id, thr_sec.thread_id);
+    }
+  }
+  return host_events;
+}
+
 }  // namespace platform
 }  // namespace paddle
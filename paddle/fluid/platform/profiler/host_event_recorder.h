@@ -15,12 +15,14 @@ limitations under the License. */
 #pragma once
 
 #include <cstring>
+#include <list>
 #include <mutex>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
 #include "paddle/fluid/platform/event.h"
+#include "paddle/fluid/platform/profiler/trace_event.h"
 
 namespace paddle {
 namespace platform {
@@ -291,5 +293,10 @@ class HostEventRecorder {
   std::unordered_map<uint64_t, ThreadEventRecorder *> thread_recorders_;
 };
 
+// Converts the gathered events to HostTraceEvents, to build NodeTrees from.
+// Events of the op roles are TracerEventType::Operator, the others are
+// TracerEventType::UserDefined.
+std::list<HostTraceEvent> ToHostTraceEvents(const HostEventSection &host_sec);
+
 }  // namespace platform
 }  // namespace paddle
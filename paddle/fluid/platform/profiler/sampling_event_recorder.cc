@@ -0,0 +1,323 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/platform/profiler/sampling_event_recorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>  // NOLINT
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/flags.h"
+#include "paddle/fluid/platform/os_info.h"
+#include "paddle/fluid/platform/profiler/chrometracing_logger.h"
+#include "paddle/fluid/platform/profiler/event_node.h"
+
+PADDLE_DEFINE_EXPORTED_bool(
+    enable_sampling_profiler, false,
+    "Keep the host events of the recent steps in per-thread ring buffers, "
+    "see SamplingEventRecorder. The steps are marked by "
+    "SamplingEventRecorder::Step().");
+PADDLE_DEFINE_EXPORTED_uint64(
+    sampling_profiler_step_interval, 100,
+    "The sampling profiler records the RecordEvents of one in this many "
+    "steps. The duration of every step is recorded regardless.");
+PADDLE_DEFINE_EXPORTED_uint64(
+    sampling_profiler_events_per_thread, 8192,
+    "The number of events kept by the sampling profiler for each thread, "
+    "rounded up to a power of 2. Each event takes 128 bytes.");
+PADDLE_DEFINE_EXPORTED_int32(
+    sampling_profiler_dump_signal, 0,
+    "If not 0, the signal, e.g. 12 for SIGUSR2 on Linux, makes the sampling "
+    "profiler dump its recent events.");
+PADDLE_DEFINE_EXPORTED_uint64(
+    sampling_profiler_dump_seconds, 10,
+    "The sampling profiler dumps the events of this many last seconds on "
+    "the signal.");
+PADDLE_DEFINE_EXPORTED_string(
+    sampling_profiler_dump_path, "sampling_profile",
+    "The prefix of the files dumped by the sampling profiler on the signal, "
+    "which are followed by the process id and the time of the dump.");
+
+namespace paddle {
+namespace platform {
+
+std::atomic<bool> SamplingEventRecorder::is_sampling_{false};
+
+// A ring buffer written by a single thread and read by any thread.
+//
+// Each slot is guarded by a sequence number: 2 * index + 1 while the event
+// of the index is being written, 2 * index + 2 once it is written. A reader
+// keeps an event only if the sequence number is the expected one both
+// before and after reading it. All the fields are atomics accessed with
+// relaxed ordering, which are plain loads and stores on common hardware.
+class SamplingEventRecorder::EventRing {
+ public:
+  static constexpr size_t kNameWords = (kMaxNameLength + 1) / sizeof(uint64_t);
+
+  explicit EventRing(size_t capacity)
+      : mask_(capacity - 1),
+        thread_id_(GetCurrentThreadSysId()),
+        slots_(new Slot[capacity]()) {}
+
+  uint64_t thread_id() const { return thread_id_; }
+
+  void Push(const char *name, uint64_t start_ns, uint64_t end_ns,
+            TracerEventType type) {
+    uint64_t words[kNameWords];
+    size_t length = strnlen(name, kMaxNameLength);
+    size_t num_words = length / sizeof(uint64_t) + 1;
+    words[num_words - 1] = 0;
+    memcpy(words, name, length);
+
+    uint64_t index = head_.load(std::memory_order_relaxed);
+    Slot &slot = slots_[index & mask_];
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.end_ns.store(end_ns, std::memory_order_relaxed);
+    slot.type.store(static_cast<uint64_t>(type), std::memory_order_relaxed);
+    for (size_t i = 0; i < num_words; ++i) {
+      slot.name[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+    head_.store(index + 1, std::memory_order_release);
+  }
+
+  // Appends the events ended since since_ns, oldest first.
+  void Read(uint64_t process_id, uint64_t since_ns,
+            std::list<HostTraceEvent> *events) const {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t capacity = mask_ + 1;
+    for (uint64_t index = head > capacity ? head - capacity : 0; index < head;
+         ++index) {
+      const Slot &slot = slots_[index & mask_];
+      uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      if (seq != 2 * index + 2) {
+        continue;  // overwritten by a newer event
+      }
+      uint64_t start_ns = slot.start_ns.load(std::memory_order_relaxed);
+      uint64_t end_ns = slot.end_ns.load(std::memory_order_relaxed);
+      uint64_t type = slot.type.load(std::memory_order_relaxed);
+      uint64_t words[kNameWords + 1];
+      words[kNameWords] = 0;
+      for (size_t i = 0; i < kNameWords; ++i) {
+        words[i] = slot.name[i].load(std::memory_order_relaxed);
+        if (memchr(&words[i], 0, sizeof(uint64_t)) != nullptr) {
+          break;
+        }
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != seq ||
+          end_ns < since_ns) {
+        continue;
+      }
+      events->emplace_back(reinterpret_cast<const char *>(words),
+                           static_cast<TracerEventType>(type), start_ns,
+                           end_ns, process_id, thread_id_);
+    }
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> start_ns;
+    std::atomic<uint64_t> end_ns;
+    std::atomic<uint64_t> type;
+    std::atomic<uint64_t> name[kNameWords];
+  };
+  static_assert(sizeof(Slot) == 128, "Slot should take 128 bytes");
+
+  const uint64_t mask_;
+  const uint64_t thread_id_;
+  std::atomic<uint64_t> head_{0};
+  std::unique_ptr<Slot[]> slots_;
+};
+
+SamplingEventRecorder &SamplingEventRecorder::GetInstance() {
+  // never destroyed, as the rings are unregistered at thread exit
+  static SamplingEventRecorder *instance = new SamplingEventRecorder;
+  return *instance;
+}
+
+void SamplingEventRecorder::Step() {
+  if (!FLAGS_enable_sampling_profiler) {
+    is_sampling_.store(false, std::memory_order_relaxed);
+    return;
+  }
+  std::call_once(init_flag_, [this] {
+    if (FLAGS_sampling_profiler_dump_signal != 0) {
+      InstallDumpSignalHandler(FLAGS_sampling_profiler_dump_signal);
+    }
+  });
+  uint64_t now_ns = PosixInNsec();
+  uint64_t start_ns = step_start_ns_.exchange(now_ns);
+  uint64_t step = step_.fetch_add(1);
+  if (start_ns != 0) {
+    char name[32];
+    snprintf(name, sizeof(name), "ProfileStep#%llu",
+             static_cast<unsigned long long>(step - 1));  // NOLINT
+    Record(name, start_ns, now_ns, TracerEventType::ProfileStep);
+  }
+  uint64_t interval = std::max<uint64_t>(FLAGS_sampling_profiler_step_interval,
+                                         1);
+  is_sampling_.store(step % interval == 0, std::memory_order_relaxed);
+}
+
+void SamplingEventRecorder::RecordEvent(const char *name, uint64_t start_ns,
+                                        uint64_t end_ns, EventRole role) {
+  Record(name, start_ns, end_ns,
+         role == EventRole::kSpecial ? TracerEventType::UserDefined
+                                     : TracerEventType::Operator);
+}
+
+void SamplingEventRecorder::Record(const char *name, uint64_t start_ns,
+                                   uint64_t end_ns, TracerEventType type) {
+  GetThreadLocalRing()->Push(name, start_ns, end_ns, type);
+}
+
+SamplingEventRecorder::EventRing *SamplingEventRecorder::GetThreadLocalRing() {
+  struct RingHolder {
+    ~RingHolder() {
+      if (ring != nullptr) {
+        SamplingEventRecorder::GetInstance().UnregisterRing(ring);
+      }
+    }
+    EventRing *ring = nullptr;
+  };
+  static thread_local RingHolder holder;
+  if (UNLIKELY(holder.ring == nullptr)) {
+    size_t capacity = 1;
+    while (capacity < FLAGS_sampling_profiler_events_per_thread) {
+      capacity <<= 1;
+    }
+    auto ring = std::make_shared<EventRing>(capacity);
+    const std::lock_guard<std::mutex> guard(rings_lock_);
+    rings_.push_back(ring);
+    holder.ring = ring.get();
+  }
+  return holder.ring;
+}
+
+void SamplingEventRecorder::UnregisterRing(EventRing *ring) {
+  const std::lock_guard<std::mutex> guard(rings_lock_);
+  rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                              [ring](const std::shared_ptr<EventRing> &r) {
+                                return r.get() == ring;
+                              }),
+               rings_.end());
+}
+
+std::list<HostTraceEvent> SamplingEventRecorder::Snapshot(
+    uint64_t duration_ns) {
+  std::vector<std::shared_ptr<EventRing>> rings;
+  {
+    const std::lock_guard<std::mutex> guard(rings_lock_);
+    rings = rings_;
+  }
+  uint64_t now_ns = PosixInNsec();
+  uint64_t since_ns =
+      duration_ns == 0 || duration_ns > now_ns ? 0 : now_ns - duration_ns;
+  std::list<HostTraceEvent> events;
+  uint64_t process_id = GetProcessId();
+  for (auto &ring : rings) {
+    ring->Read(process_id, since_ns, &events);
+  }
+  return events;
+}
+
+void SamplingEventRecorder::Dump(const std::string &filename,
+                                 uint64_t duration_ns) {
+  NodeTrees trees(Snapshot(duration_ns), std::list<RuntimeTraceEvent>(),
+                  std::list<DeviceTraceEvent>());
+  ChromeTracingLogger logger(filename);
+  trees.LogMe(&logger);
+}
+
+#ifndef _WIN32
+// The signal handler only wakes up the dumping thread, as writing to a pipe
+// is one of the few things safe to do in a signal handler. The write end is
+// non-blocking, so the handler never waits on a full pipe.
+static int g_dump_pipe[2] = {-1, -1};
+
+static void DumpSignalHandler(int) {
+  int saved_errno = errno;
+  char c = 0;
+  if (write(g_dump_pipe[1], &c, 1) < 0) {
+    // the pipe is full, the pending dumps include this one
+  }
+  errno = saved_errno;
+}
+
+void SamplingEventRecorder::InstallDumpSignalHandler(int signo) {
+  PADDLE_ENFORCE_EQ(pipe(g_dump_pipe), 0,
+                    platform::errors::Unavailable(
+                        "Failed to create the pipe of the sampling profiler."));
+  int flags = fcntl(g_dump_pipe[1], F_GETFL);
+  PADDLE_ENFORCE_EQ(
+      flags != -1 && fcntl(g_dump_pipe[1], F_SETFL, flags | O_NONBLOCK) != -1,
+      true, platform::errors::Unavailable(
+                "Failed to make the pipe of the sampling profiler "
+                "non-blocking."));
+  std::thread([this] {
+    char c;
+    while (true) {
+      ssize_t ret = read(g_dump_pipe[0], &c, 1);
+      if (ret < 0 && errno == EINTR) {
+        continue;
+      }
+      if (ret <= 0) {
+        return;
+      }
+      std::string filename = FLAGS_sampling_profiler_dump_path + "." +
+                             std::to_string(GetProcessId()) + "." +
+                             std::to_string(PosixInNsec() / 1000000) +
+                             ".json";
+      try {
+        Dump(filename, FLAGS_sampling_profiler_dump_seconds * 1000000000UL);
+        LOG(INFO) << "The sampling profiler dumped to " << filename;
+      } catch (std::exception &e) {
+        LOG(WARNING) << "The sampling profiler failed to dump to " << filename
+                     << ": " << e.what();
+      }
+    }
+  }).detach();
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = DumpSignalHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  PADDLE_ENFORCE_EQ(sigaction(signo, &action, nullptr), 0,
+                    platform::errors::InvalidArgument(
+                        "Failed to handle the signal %d of "
+                        "FLAGS_sampling_profiler_dump_signal.",
+                        signo));
+}
+#else
+void SamplingEventRecorder::InstallDumpSignalHandler(int signo) {
+  LOG(WARNING) << "FLAGS_sampling_profiler_dump_signal is not supported on "
+                  "Windows, call SamplingEventRecorder::Dump() instead.";
+}
+#endif
+
+}  // namespace platform
+}  // namespace paddle
@@ -0,0 +1,96 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/platform/event.h"
+#include "paddle/fluid/platform/macros.h"
+#include "paddle/fluid/platform/profiler/trace_event.h"
+
+namespace paddle {
+namespace platform {
+
+// SamplingEventRecorder keeps the host events of the recent steps in
+// per-thread ring buffers of fixed size, to profile long-running jobs
+// continuously, at a low cost, without restarting them.
+//
+// - Step() ends a step of the job, e.g. a training iteration, and begins
+//   the next one. Every step is recorded as a ProfileStep event, and the
+//   RecordEvents of one in FLAGS_sampling_profiler_step_interval steps are
+//   recorded too. Nothing is recorded before Step() is first called with
+//   FLAGS_enable_sampling_profiler set.
+// - Each thread writes its events to its own ring buffer of
+//   FLAGS_sampling_profiler_events_per_thread events without any lock,
+//   overwriting the oldest ones. The buffer of a thread is freed when the
+//   thread exits.
+// - Snapshot() and Dump() may run on any thread while events are being
+//   recorded, they skip the events being overwritten.
+// - If FLAGS_sampling_profiler_dump_signal is set, receiving the signal
+//   dumps the events of the last FLAGS_sampling_profiler_dump_seconds
+//   seconds to a file prefixed FLAGS_sampling_profiler_dump_path.
+class SamplingEventRecorder {
+ public:
+  // longer names are truncated
+  static constexpr size_t kMaxNameLength = 95;
+
+  static SamplingEventRecorder &GetInstance();
+
+  // Whether the RecordEvents of the current step are to be recorded.
+  static bool IsSampling() {
+    return is_sampling_.load(std::memory_order_relaxed);
+  }
+
+  void Step();
+
+  void RecordEvent(const char *name, uint64_t start_ns, uint64_t end_ns,
+                   EventRole role);
+
+  // The events of all threads which ended in the last `duration_ns`, or
+  // all the events kept if `duration_ns` is 0.
+  std::list<HostTraceEvent> Snapshot(uint64_t duration_ns = 0);
+
+  // Writes Snapshot(duration_ns) to filename in the Chrome trace format.
+  void Dump(const std::string &filename, uint64_t duration_ns = 0);
+
+  class EventRing;
+
+ private:
+  SamplingEventRecorder() = default;
+  DISABLE_COPY_AND_ASSIGN(SamplingEventRecorder);
+
+  void Record(const char *name, uint64_t start_ns, uint64_t end_ns,
+              TracerEventType type);
+  EventRing *GetThreadLocalRing();
+  void UnregisterRing(EventRing *ring);
+  void InstallDumpSignalHandler(int signo);
+
+  static std::atomic<bool> is_sampling_;
+
+  std::once_flag init_flag_;
+  std::atomic<uint64_t> step_{0};
+  std::atomic<uint64_t> step_start_ns_{0};
+
+  std::mutex rings_lock_;
+  std::vector<std::shared_ptr<EventRing>> rings_;
+};
+
+}  // namespace platform
+}  // namespace paddle
@@ -0,0 +1,151 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/platform/profiler/statistics_logger.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/platform/profiler/event_node.h"
+
+namespace paddle {
+namespace platform {
+
+void EventStatistics::Add(uint64_t inclusive, uint64_t exclusive,
+                          uint64_t device) {
+  ++calls;
+  inclusive_ns += inclusive;
+  exclusive_ns += exclusive;
+  min_ns = std::min(min_ns, inclusive);
+  max_ns = std::max(max_ns, inclusive);
+  device_ns += device;
+}
+
+void EventStatistics::Merge(const EventStatistics& other) {
+  calls += other.calls;
+  inclusive_ns += other.inclusive_ns;
+  exclusive_ns += other.exclusive_ns;
+  min_ns = std::min(min_ns, other.min_ns);
+  max_ns = std::max(max_ns, other.max_ns);
+  device_ns += other.device_ns;
+}
+
+void StatisticsLogger::LogNodeTrees(const NodeTrees& node_trees) {
+  const std::map<uint64_t, std::vector<HostTraceEventNode*>> thread2host_nodes =
+      node_trees.Traverse(true);
+  for (auto it = thread2host_nodes.begin(); it != thread2host_nodes.end();
+       ++it) {
+    auto& stats = thread_statistics_[it->first];
+    // the root node only holds the tree, it is not an event
+    for (auto child : it->second.front()->GetChildren()) {
+      Aggregate(child, &stats);
+    }
+  }
+  statistics_.clear();
+  for (auto it = thread_statistics_.begin(); it != thread_statistics_.end();
+       ++it) {
+    for (auto& name_stats : it->second) {
+      statistics_[name_stats.first].Merge(name_stats.second);
+    }
+  }
+}
+
+uint64_t StatisticsLogger::Aggregate(
+    HostTraceEventNode* node, std::map<std::string, EventStatistics>* stats) {
+  uint64_t children_ns = 0;
+  uint64_t device_ns = 0;
+  for (auto child : node->GetChildren()) {
+    children_ns += child->duration();
+    device_ns += Aggregate(child, stats);
+  }
+  for (auto runtime_node : node->GetRuntimeTraceEventNodes()) {
+    for (auto device_node : runtime_node->GetDeviceTraceEventNodes()) {
+      device_ns += device_node->duration();
+    }
+  }
+  // children only partially overlapping may add up to more than the parent
+  uint64_t exclusive_ns =
+      node->duration() > children_ns ? node->duration() - children_ns : 0;
+  (*stats)[node->name()].Add(node->duration(), exclusive_ns, device_ns);
+  return device_ns;
+}
+
+static void PrintTable(std::ostream& os,
+                       const std::map<std::string, EventStatistics>& stats,
+                       size_t max_rows) {
+  std::vector<std::pair<std::string, EventStatistics>> rows(stats.begin(),
+                                                            stats.end());
+  std::sort(rows.begin(), rows.end(),
+            [](const std::pair<std::string, EventStatistics>& a,
+               const std::pair<std::string, EventStatistics>& b) {
+              return a.second.inclusive_ns > b.second.inclusive_ns;
+            });
+  // the exclusive times add up to the time covered by the events
+  uint64_t total_exclusive_ns = 0;
+  size_t name_width = 5;
+  for (auto& row : rows) {
+    total_exclusive_ns += row.second.exclusive_ns;
+  }
+  for (size_t i = 0; i < rows.size() && i < max_rows; ++i) {
+    name_width = std::max(name_width, rows[i].first.size());
+  }
+  name_width += 2;
+  const size_t data_width = 14;
+  auto ms = [](uint64_t ns) { return ns / 1000000.0; };
+
+  os << std::setw(name_width) << "Event";
+  for (const char* column : {"Calls", "Total(ms)", "Self(ms)", "Self(%)",
+                             "Avg(ms)", "Min(ms)", "Max(ms)", "Device(ms)"}) {
+    os << std::setw(data_width) << column;
+  }
+  os << std::endl;
+  for (size_t i = 0; i < rows.size() && i < max_rows; ++i) {
+    const EventStatistics& s = rows[i].second;
+    double ratio = total_exclusive_ns == 0
+                       ? 0.0
+                       : 100.0 * static_cast<double>(s.exclusive_ns) /
+                             static_cast<double>(total_exclusive_ns);
+    os << std::setw(name_width) << rows[i].first << std::setw(data_width)
+       << s.calls << std::setw(data_width) << ms(s.inclusive_ns)
+       << std::setw(data_width) << ms(s.exclusive_ns) << std::setw(data_width)
+       << ratio << std::setw(data_width) << ms(s.inclusive_ns) / s.calls
+       << std::setw(data_width) << ms(s.min_ns) << std::setw(data_width)
+       << ms(s.max_ns) << std::setw(data_width) << ms(s.device_ns)
+       << std::endl;
+  }
+  if (rows.size() > max_rows) {
+    os << "... " << rows.size() - max_rows << " more events" << std::endl;
+  }
+}
+
+void StatisticsLogger::Print(std::ostream& os, size_t max_rows) const {
+  auto flags = os.flags();
+  os.setf(std::ios::left);
+  os << "\n------------------------->"
+     << "     Profiling Report     "
+     << "<-------------------------\n\n";
+  os << "All threads:\n";
+  PrintTable(os, statistics_, max_rows);
+  for (auto it = thread_statistics_.begin(); it != thread_statistics_.end();
+       ++it) {
+    os << "\nThread " << it->first << ":\n";
+    PrintTable(os, it->second, max_rows);
+  }
+  os.flags(flags);
+}
+
+}  // namespace platform
+}  // namespace paddle
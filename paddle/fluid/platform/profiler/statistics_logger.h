@@ -0,0 +1,86 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <limits>
+#include <map>
+#include <string>
+
+#include "paddle/fluid/platform/profiler/output_logger.h"
+
+namespace paddle {
+namespace platform {
+
+// The time of the host events of the same name.
+struct EventStatistics {
+  uint64_t calls = 0;
+  // including the events called by it
+  uint64_t inclusive_ns = 0;
+  // excluding the events called by it
+  uint64_t exclusive_ns = 0;
+  uint64_t min_ns = std::numeric_limits<uint64_t>::max();
+  uint64_t max_ns = 0;
+  // of the device events launched by it and by the events it called
+  uint64_t device_ns = 0;
+
+  void Add(uint64_t inclusive, uint64_t exclusive, uint64_t device);
+  void Merge(const EventStatistics& other);
+};
+
+// Aggregates the host events of NodeTrees by name, over all threads and
+// per thread, e.g. to print the time of each operator after profiling:
+//
+//   NodeTrees trees(ToHostTraceEvents(
+//                       HostEventRecorder::GetInstance().GatherEvents()),
+//                   {}, {});
+//   StatisticsLogger logger;
+//   trees.LogMe(&logger);
+//   logger.Print(std::cout);
+//
+// The exclusive time of an event is its duration minus the durations of
+// its children. An event called recursively by an event of the same name is
+// counted in the inclusive time of both.
+class StatisticsLogger : public BaseLogger {
+ public:
+  StatisticsLogger() {}
+  void LogNodeTrees(const NodeTrees&) override;
+
+  // event name -> statistics
+  const std::map<std::string, EventStatistics>& GetStatistics() const {
+    return statistics_;
+  }
+  // thread id -> event name -> statistics
+  const std::map<uint64_t, std::map<std::string, EventStatistics>>&
+  GetThreadStatistics() const {
+    return thread_statistics_;
+  }
+
+  // Prints the statistics of all threads and then of each thread, the
+  // events sorted by inclusive time. Only the first `max_rows` events of
+  // each table are printed.
+  void Print(std::ostream& os, size_t max_rows = 100) const;
+
+ private:
+  // Adds the events of the subtree of node, returns their device time.
+  uint64_t Aggregate(HostTraceEventNode* node,
+                     std::map<std::string, EventStatistics>* stats);
+
+  std::map<std::string, EventStatistics> statistics_;
+  std::map<uint64_t, std::map<std::string, EventStatistics>>
+      thread_statistics_;
+};
+
+}  // namespace platform
+}  // namespace paddle
@@ -0,0 +1,159 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/platform/profiler/event_node.h"
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/platform/profiler/chrometracing_logger.h"
+#include "paddle/fluid/platform/profiler/host_event_recorder.h"
+#include "paddle/fluid/platform/profiler/statistics_logger.h"
+
+namespace paddle {
+namespace platform {
+
+// Thread 10 runs op1, which calls inner and launches a kernel, and then op2.
+// Thread 11 runs op3.
+static NodeTrees* MakeNodeTrees() {
+  std::list<HostTraceEvent> host_events;
+  std::list<RuntimeTraceEvent> runtime_events;
+  std::list<DeviceTraceEvent> device_events;
+  host_events.push_back(
+      HostTraceEvent("op2", TracerEventType::Operator, 200, 300, 1, 10));
+  host_events.push_back(
+      HostTraceEvent("inner", TracerEventType::Operator, 110, 150, 1, 10));
+  host_events.push_back(
+      HostTraceEvent("op1", TracerEventType::Operator, 100, 200, 1, 10));
+  host_events.push_back(HostTraceEvent("op3 \"quoted\"",
+                                       TracerEventType::UserDefined, 50, 400,
+                                       1, 11));
+  runtime_events.push_back(
+      RuntimeTraceEvent("cudaLaunchKernel", 120, 130, 1, 10, 1, 211));
+  device_events.push_back(DeviceTraceEvent("kernel", TracerEventType::Kernel,
+                                           140, 180, 0, 0, 7, 1,
+                                           KernelEventInfo()));
+  // launched by a runtime event which is not recorded
+  device_events.push_back(DeviceTraceEvent("lost", TracerEventType::Kernel,
+                                           140, 180, 0, 0, 7, 2,
+                                           KernelEventInfo()));
+  return new NodeTrees(host_events, runtime_events, device_events);
+}
+
+TEST(NodeTrees, build_trees) {
+  std::unique_ptr<NodeTrees> trees(MakeNodeTrees());
+  auto roots = trees->GetNodeTrees();
+  ASSERT_EQ(roots.size(), 2UL);
+
+  auto& children = roots[10]->GetChildren();
+  ASSERT_EQ(children.size(), 2UL);
+  EXPECT_EQ(children[0]->name(), "op1");
+  EXPECT_EQ(children[1]->name(), "op2");
+  ASSERT_EQ(children[0]->GetChildren().size(), 1UL);
+  HostTraceEventNode* inner = children[0]->GetChildren()[0];
+  EXPECT_EQ(inner->name(), "inner");
+  ASSERT_EQ(inner->GetRuntimeTraceEventNodes().size(), 1UL);
+  CudaRuntimeTraceEventNode* runtime = inner->GetRuntimeTraceEventNodes()[0];
+  ASSERT_EQ(runtime->GetDeviceTraceEventNodes().size(), 1UL);
+  EXPECT_EQ(runtime->GetDeviceTraceEventNodes()[0]->name(), "kernel");
+  EXPECT_EQ(roots[11]->GetChildren().size(), 1UL);
+
+  std::vector<std::string> names;
+  auto bfs = trees->Traverse(true);
+  for (auto node : bfs[10]) names.push_back(node->name());
+  EXPECT_EQ(names, std::vector<std::string>(
+                       {"root node", "op1", "op2", "inner"}));
+  names.clear();
+  auto dfs = trees->Traverse(false);
+  for (auto node : dfs[10]) names.push_back(node->name());
+  EXPECT_EQ(names, std::vector<std::string>(
+                       {"root node", "op1", "inner", "op2"}));
+}
+
+TEST(NodeTrees, chrome_tracing_logger) {
+  std::unique_ptr<NodeTrees> trees(MakeNodeTrees());
+  const std::string filename = "test_event_node_trace.json";
+  {
+    ChromeTracingLogger logger(filename);
+    trees->LogMe(&logger);
+  }
+  std::ifstream file(filename);
+  std::stringstream content;
+  content << file.rdbuf();
+  std::string json = content.str();
+  EXPECT_EQ(json.front(), '{');
+  EXPECT_EQ(json.substr(json.size() - 2), "}\n");
+  size_t complete_events = 0;
+  for (size_t pos = json.find("\"ph\": \"X\""); pos != std::string::npos;
+       pos = json.find("\"ph\": \"X\"", pos + 1)) {
+    ++complete_events;
+  }
+  // 4 host events, 1 runtime event and 1 device event
+  EXPECT_EQ(complete_events, 6UL);
+  EXPECT_NE(json.find("\"ph\": \"f\""), std::string::npos);
+  EXPECT_NE(json.find("\"ts\": 0.140"), std::string::npos);
+  EXPECT_NE(json.find("op3 \\\"quoted\\\""), std::string::npos);
+  EXPECT_EQ(json.find("root node"), std::string::npos);
+}
+
+TEST(NodeTrees, statistics_logger) {
+  std::unique_ptr<NodeTrees> trees(MakeNodeTrees());
+  StatisticsLogger logger;
+  trees->LogMe(&logger);
+
+  const EventStatistics& op1 = logger.GetStatistics().at("op1");
+  EXPECT_EQ(op1.calls, 1UL);
+  EXPECT_EQ(op1.inclusive_ns, 100UL);
+  EXPECT_EQ(op1.exclusive_ns, 60UL);
+  EXPECT_EQ(op1.device_ns, 40UL);
+  const EventStatistics& inner = logger.GetStatistics().at("inner");
+  EXPECT_EQ(inner.exclusive_ns, 40UL);
+  EXPECT_EQ(inner.device_ns, 40UL);
+  EXPECT_EQ(logger.GetStatistics().count("root node"), 0UL);
+  EXPECT_EQ(logger.GetThreadStatistics().at(10).size(), 3UL);
+  EXPECT_EQ(logger.GetThreadStatistics().at(11).size(), 1UL);
+
+  // the trees of another step add up
+  std::unique_ptr<NodeTrees> next_step(MakeNodeTrees());
+  next_step->LogMe(&logger);
+  EXPECT_EQ(logger.GetStatistics().at("op1").calls, 2UL);
+  EXPECT_EQ(logger.GetStatistics().at("op1").inclusive_ns, 200UL);
+
+  std::stringstream table;
+  logger.Print(table);
+  EXPECT_NE(table.str().find("op1"), std::string::npos);
+}
+
+TEST(NodeTrees, host_event_recorder) {
+  HostEventRecorder::GetInstance().RecordEvent("outer", 1000, 2000,
+                                               EventRole::kOrdinary);
+  HostEventRecorder::GetInstance().RecordEvent("nested", 1200, 1500,
+                                               EventRole::kInnerOp);
+  NodeTrees trees(
+      ToHostTraceEvents(HostEventRecorder::GetInstance().GatherEvents()),
+      std::list<RuntimeTraceEvent>(), std::list<DeviceTraceEvent>());
+  auto roots = trees.GetNodeTrees();
+  ASSERT_EQ(roots.size(), 1UL);
+  auto& children = roots.begin()->second->GetChildren();
+  ASSERT_EQ(children.size(), 1UL);
+  EXPECT_EQ(children[0]->name(), "outer");
+  EXPECT_EQ(children[0]->type(), TracerEventType::Operator);
+  ASSERT_EQ(children[0]->GetChildren().size(), 1UL);
+  EXPECT_EQ(children[0]->GetChildren()[0]->name(), "nested");
+}
+
+}  // namespace platform
+}  // namespace paddle
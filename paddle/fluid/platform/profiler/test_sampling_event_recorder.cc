@@ -0,0 +1,161 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/platform/profiler/sampling_event_recorder.h"
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <sstream>
+#include <thread>  // NOLINT
+#ifndef _WIN32
+#include <dirent.h>
+#include <signal.h>
+#endif
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/platform/os_info.h"
+
+DECLARE_bool(enable_sampling_profiler);
+DECLARE_uint64(sampling_profiler_step_interval);
+DECLARE_uint64(sampling_profiler_events_per_thread);
+DECLARE_int32(sampling_profiler_dump_signal);
+DECLARE_string(sampling_profiler_dump_path);
+
+namespace paddle {
+namespace platform {
+
+// The events recorded by the calling thread.
+static std::vector<HostTraceEvent> ThreadEvents() {
+  std::vector<HostTraceEvent> events;
+  for (auto &event : SamplingEventRecorder::GetInstance().Snapshot()) {
+    if (event.thread_id == GetCurrentThreadSysId()) {
+      events.push_back(event);
+    }
+  }
+  return events;
+}
+
+TEST(SamplingEventRecorder, ring_buffer) {
+  FLAGS_sampling_profiler_events_per_thread = 100;
+  std::thread([] {
+    auto &recorder = SamplingEventRecorder::GetInstance();
+    for (uint64_t i = 0; i < 1000; ++i) {
+      recorder.RecordEvent(("event_" + std::to_string(i)).c_str(), i, i + 1,
+                           EventRole::kOrdinary);
+    }
+    // rounded up to 128 events, the oldest ones overwritten
+    auto events = ThreadEvents();
+    ASSERT_EQ(events.size(), 128UL);
+    EXPECT_EQ(events.front().name, "event_872");
+    EXPECT_EQ(events.back().name, "event_999");
+    EXPECT_EQ(events.back().start_ns, 999UL);
+    EXPECT_EQ(events.back().type, TracerEventType::Operator);
+
+    std::string long_name(200, 'x');
+    recorder.RecordEvent(long_name.c_str(), 0, 1, EventRole::kSpecial);
+    EXPECT_EQ(ThreadEvents().back().name,
+              long_name.substr(0, SamplingEventRecorder::kMaxNameLength));
+  }).join();
+  FLAGS_sampling_profiler_events_per_thread = 8192;
+}
+
+TEST(SamplingEventRecorder, snapshot_while_recording) {
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    auto &recorder = SamplingEventRecorder::GetInstance();
+    for (uint64_t i = 0; i < 200000; ++i) {
+      // names of different lengths
+      std::string name = std::to_string(i) + std::string(i % 50, '.');
+      recorder.RecordEvent(name.c_str(), i, i, EventRole::kOrdinary);
+    }
+    done = true;
+  });
+  size_t snapshots = 0;
+  while (!done || snapshots == 0) {
+    for (auto &event : SamplingEventRecorder::GetInstance().Snapshot()) {
+      // an event is never mixed with the one overwriting it
+      ASSERT_EQ(event.name, std::to_string(event.start_ns) +
+                                std::string(event.start_ns % 50, '.'));
+    }
+    ++snapshots;
+  }
+  writer.join();
+}
+
+TEST(SamplingEventRecorder, step_sampling) {
+  FLAGS_enable_sampling_profiler = true;
+  FLAGS_sampling_profiler_step_interval = 3;
+#ifndef _WIN32
+  FLAGS_sampling_profiler_dump_signal = SIGUSR2;
+  FLAGS_sampling_profiler_dump_path = "test_sampling_event_recorder";
+#endif
+  std::thread([] {
+    auto &recorder = SamplingEventRecorder::GetInstance();
+    std::vector<bool> sampled;
+    for (int step = 0; step < 7; ++step) {
+      recorder.Step();
+      sampled.push_back(SamplingEventRecorder::IsSampling());
+    }
+    EXPECT_EQ(sampled, std::vector<bool>({true, false, false, true, false,
+                                          false, true}));
+    auto events = ThreadEvents();
+    ASSERT_EQ(events.size(), 6UL);
+    EXPECT_EQ(events.front().name, "ProfileStep#0");
+    EXPECT_EQ(events.front().type, TracerEventType::ProfileStep);
+    EXPECT_EQ(events.back().name, "ProfileStep#5");
+  }).join();
+
+#ifndef _WIN32
+  // the signal dumps to a file named by the process id and the time
+  std::string prefix = FLAGS_sampling_profiler_dump_path + "." +
+                       std::to_string(GetProcessId()) + ".";
+  raise(SIGUSR2);
+  bool dumped = false;
+  for (int i = 0; i < 100 && !dumped; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    DIR *dir = opendir(".");
+    ASSERT_NE(dir, nullptr);
+    for (dirent *entry = readdir(dir); entry != nullptr;
+         entry = readdir(dir)) {
+      dumped |= std::string(entry->d_name).compare(0, prefix.size(),
+                                                    prefix) == 0;
+    }
+    closedir(dir);
+  }
+  EXPECT_TRUE(dumped);
+#endif
+  FLAGS_enable_sampling_profiler = false;
+  SamplingEventRecorder::GetInstance().Step();
+  EXPECT_FALSE(SamplingEventRecorder::IsSampling());
+}
+
+TEST(SamplingEventRecorder, dump) {
+  auto &recorder = SamplingEventRecorder::GetInstance();
+  recorder.RecordEvent("old_op", 0, 1, EventRole::kOrdinary);
+  recorder.RecordEvent("outer_op", PosixInNsec() - 2000, PosixInNsec(),
+                       EventRole::kOrdinary);
+  const std::string filename = "test_sampling_event_recorder.json";
+  // the events of the last minute
+  recorder.Dump(filename, 60UL * 1000000000UL);
+  std::ifstream file(filename);
+  std::stringstream content;
+  content << file.rdbuf();
+  EXPECT_NE(content.str().find("outer_op"), std::string::npos);
+  EXPECT_EQ(content.str().find("old_op"), std::string::npos);
+}
+
+}  // namespace platform
+}  // namespace paddle
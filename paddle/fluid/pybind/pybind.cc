@@ -74,6 +74,7 @@ limitations under the License. */
 #include "paddle/fluid/platform/monitor.h"
 #include "paddle/fluid/platform/place.h"
 #include "paddle/fluid/platform/profiler.h"
+#include "paddle/fluid/platform/profiler/sampling_event_recorder.h"
 #include "paddle/fluid/pybind/cuda_streams_py.h"
 #include "paddle/pten/core/lod_utils.h"
 #ifndef PADDLE_ON_INFERENCE
@@ -2701,6 +2702,14 @@ All parameter, weight, gradient are variables in Paddle.
   m.def("disable_profiler", platform::DisableProfiler);
   m.def("is_profiler_enabled", platform::IsProfileEnabled);
   m.def("reset_profiler", platform::ResetProfiler);
+  m.def("sampling_profiler_step",
+        [] { platform::SamplingEventRecorder::GetInstance().Step(); });
+  m.def("sampling_profiler_dump",
+        [](const std::string &filename, double seconds) {
+          platform::SamplingEventRecorder::GetInstance().Dump(
+              filename, static_cast<uint64_t>(seconds * 1e9));
+        },
+        py::arg("filename"), py::arg("seconds") = 0.0);
   m.def("register_pass", [](const std::string &pass_type, py::object callable) {
     PADDLE_ENFORCE_EQ(
         framework::ir::PassRegistry::Instance().Has(pass_type), false,